@@ -0,0 +1,225 @@
+#include "ciWMFVideoNetSync.h"
+
+#include "cinder/Log.h"
+
+ciWMFVideoNetSync::ciWMFVideoNetSync( ciWMFVideoPlayer* player, uint32_t groupId, const SyncTuning& tuning )
+	: mPlayer( player )
+	, mMode( OFF )
+	, mMaster( groupId )
+	, mFollower( groupId, tuning )
+	, mBeaconInterval( 1000000 )
+	, mLastBeacon( 0 )
+	, mLastPlaying( false )
+	, mMirrored( false )
+	, mSkew( 0 )
+{
+}
+
+ciWMFVideoNetSync::~ciWMFVideoNetSync()
+{
+	stop();
+}
+
+bool ciWMFVideoNetSync::startMaster( const std::string& address, uint16_t port )
+{
+	stop();
+
+	if( !mSocket.OpenSender( address, port ) ) {
+		CI_LOG_E( "Opening the sync socket to " << address << ":" << port << " failed" );
+		return false;
+	}
+
+	mMode = MASTER;
+	mLastBeacon = 0;
+	return true;
+}
+
+bool ciWMFVideoNetSync::startFollower( uint16_t port, const std::string& multicastGroup )
+{
+	stop();
+
+	if( !mSocket.OpenReceiver( port, multicastGroup ) ) {
+		CI_LOG_E( "Opening the sync socket on port " << port << " failed" );
+		return false;
+	}
+
+	mMode = FOLLOWER;
+	mFollower.Reset();
+	mMirrored = false;
+	return true;
+}
+
+void ciWMFVideoNetSync::stop()
+{
+	if( mMode == FOLLOWER && mPlayer->mPlayer ) {
+		mPlayer->mPlayer->SetPlaybackRate( FALSE, 1.0f );
+	}
+
+	mSocket.Close();
+	mMode = OFF;
+	mSkew = 0;
+}
+
+void ciWMFVideoNetSync::update()
+{
+	if( mMode == MASTER ) {
+		updateMaster();
+	}
+	else if( mMode == FOLLOWER ) {
+		updateFollower();
+	}
+}
+
+void ciWMFVideoNetSync::updateMaster()
+{
+	CPlayer* player = mPlayer->mPlayer;
+
+	if( !player ) {
+		return;
+	}
+
+	MFTIME now = MFGetSystemTime();
+	bool playing = player->GetState() == STARTED;
+
+	// Followers hear about play and pause straight away.
+	if( playing != mLastPlaying || now - mLastBeacon >= mBeaconInterval ) {
+		mLastPlaying = playing;
+		sendBeacon( now );
+	}
+}
+
+void ciWMFVideoNetSync::sendBeacon( MFTIME now )
+{
+	ClockSample sample;
+
+	if( FAILED( mPlayer->mPlayer->GetClockSample( &sample ) ) ) {
+		return;
+	}
+
+	uint8_t buffer[SYNC_BEACON_SIZE];
+	SyncBeacon beacon = mMaster.MakeBeacon( sample.presentationTime, sample.systemTime, sample.rate, mLastPlaying );
+	size_t cbBeacon = SyncProtocol::Encode( beacon, buffer );
+
+	if( !mSocket.Send( buffer, cbBeacon ) ) {
+		CI_LOG_W( "Sending a sync beacon failed" );
+	}
+
+	mLastBeacon = now;
+}
+
+void ciWMFVideoNetSync::updateFollower()
+{
+	uint8_t buffer[256];
+	int cbReceived;
+
+	// Stamp each beacon as it is read; the clock estimate keeps the least delayed.
+	while( ( cbReceived = mSocket.Receive( buffer, sizeof( buffer ) ) ) > 0 ) {
+		mFollower.OnDatagram( buffer, ( size_t )cbReceived, MFGetSystemTime() );
+	}
+
+	CPlayer* player = mPlayer->mPlayer;
+
+	if( !player || !mFollower.HasMaster() ) {
+		return;
+	}
+
+	PlayerState state = player->GetState();
+
+	if( state != STARTED && state != PAUSED && state != STOPPED ) {
+		return;
+	}
+
+	MFTIME now = MFGetSystemTime();
+	MFTIME duration = player->GetDurationHns();
+	MFTIME master = mFollower.MasterPosition( now );
+	MFTIME target = master;
+
+	if( mPlayer->isLooping() && duration > 0 ) {
+		target %= duration;
+	}
+
+	// Mirror the master's play and pause, once each: the player takes a few frames to change state. A paused
+	// follower is moved to where the master stopped.
+	if( !mMirrored || mFollower.IsMasterPlaying() != mLastPlaying ) {
+		mMirrored = true;
+		mLastPlaying = mFollower.IsMasterPlaying();
+
+		if( mLastPlaying ) {
+			mPlayer->setPosition( ( float )( target / 10000000.0 ) );
+			mPlayer->play();
+		}
+		else {
+			mPlayer->pause();
+			mPlayer->setPosition( ( float )( target / 10000000.0 ) );
+		}
+
+		settle( now );
+		return;
+	}
+
+	ClockSample sample;
+
+	if( state != STARTED || FAILED( player->GetClockSample( &sample ) ) ) {
+		return;
+	}
+
+	MFTIME position = sample.presentationTime + ( MFTIME )( ( now - sample.systemTime ) * sample.rate );
+	int64_t skew = position - master;
+
+	// A looping follower that wrapped round just before or after the master is only slightly off.
+	if( mPlayer->isLooping() ) {
+		skew = PlaybackSync::WrapSkew( skew, duration );
+	}
+
+	mSkew = skew;
+
+	SyncCorrection correction = mFollower.Update( master + skew, now );
+	HRESULT hr = S_OK;
+
+	if( correction.action == SyncNudge ) {
+		hr = player->SetPlaybackRate( FALSE, ( float )( mFollower.MasterRate() * ( 1.0 + correction.nudge ) ) );
+	}
+	else if( correction.action == SyncSeek ) {
+		// The controller ignores the error while the seek settles.
+		hr = player->SetPlaybackRate( FALSE, ( float )mFollower.MasterRate() );
+		mPlayer->setPosition( ( float )( target / 10000000.0 ) );
+	}
+
+	if( FAILED( hr ) ) {
+		// The player kept its rate: the controller must not build on a nudge that was never applied.
+		CI_LOG_W( "Setting the follower's rate failed, hr=0x" << std::hex << hr );
+		mFollower.Settle( now );
+	}
+}
+
+void ciWMFVideoNetSync::settle( MFTIME now )
+{
+	if( mPlayer->mPlayer ) {
+		mPlayer->mPlayer->SetPlaybackRate( FALSE, ( float )mFollower.MasterRate() );
+	}
+
+	mFollower.Settle( now );
+}
+
+float ciWMFVideoNetSync::getSkewFrames() const
+{
+	CPlayer* player = mPlayer->mPlayer;
+
+	if( !player ) {
+		return 0.0f;
+	}
+
+	return ( float )mSkew / ( float )player->GetFrameDuration();
+}
+
+SyncFollowerStats ciWMFVideoNetSync::getStats() const
+{
+	SyncFollowerStats stats;
+	mFollower.GetStats( &stats, MFGetSystemTime() );
+	return stats;
+}
+
+void ciWMFVideoNetSync::resetStats()
+{
+	mFollower.ResetStats();
+}
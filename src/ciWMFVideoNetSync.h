@@ -0,0 +1,67 @@
+#pragma once
+
+#include "ciWMFVideoPlayer.h"
+
+#include <string>
+
+// Keeps players on several machines frame-locked over UDP. One machine runs a master: its update() sends beacons
+// with its player's presentation time and system clock. The others run followers: they estimate the offset and drift
+// between the master's clock and their own, mirror play and pause, and remove their player's error against the
+// master with rate nudges of a fraction of a percent, or a seek if it is far out. Each machine loads the same movie.
+class ciWMFVideoNetSync
+{
+	public:
+		static const uint16_t DEFAULT_PORT = 47405;
+
+		// groupId keeps several walls on one network apart. The player must outlive the sync.
+		ciWMFVideoNetSync( ciWMFVideoPlayer* player, uint32_t groupId = 0, const SyncTuning& tuning = SyncTuning() );
+		~ciWMFVideoNetSync();
+
+		// address may be a follower's, a subnet broadcast address, or a multicast group.
+		bool startMaster( const std::string& address = "255.255.255.255", uint16_t port = DEFAULT_PORT );
+		// Joins multicastGroup if given one.
+		bool startFollower( uint16_t port = DEFAULT_PORT, const std::string& multicastGroup = "" );
+		void stop();
+
+		bool isMaster() const { return mMode == MASTER; }
+		bool isFollower() const { return mMode == FOLLOWER; }
+
+		// How often the master sends beacons; it also sends one whenever it starts or pauses. Default 100 ms.
+		void setBeaconInterval( MFTIME interval ) { mBeaconInterval = interval; }
+		// A known one-way network delay, taken off the follower's clock estimate.
+		void setLatency( MFTIME latency ) { mFollower.SetLatency( latency ); }
+
+		// Sends or receives, and corrects. Call once per frame, after the player's update().
+		void update();
+
+		// Whether a follower has heard from its master.
+		bool hasMaster() const { return mFollower.HasMaster(); }
+
+		// The follower's error against the master at the last update(), positive when ahead.
+		int64_t getSkew() const { return mSkew; }
+		float getSkewFrames() const;
+
+		// Beacons received, the clock estimate, and the corrections made.
+		SyncFollowerStats getStats() const;
+		void resetStats();
+
+	private:
+		enum Mode { OFF, MASTER, FOLLOWER };
+
+		void updateMaster();
+		void updateFollower();
+		void sendBeacon( MFTIME now );
+		// After the follower moved the player itself: back to the master's rate, and let it settle.
+		void settle( MFTIME now );
+
+		ciWMFVideoPlayer* mPlayer;
+		Mode mMode;
+		SyncSocket mSocket;
+		SyncMaster mMaster;
+		SyncFollower mFollower;
+		MFTIME mBeaconInterval;
+		MFTIME mLastBeacon;
+		bool mLastPlaying;	// Master: the state last sent. Follower: the master's state last mirrored.
+		bool mMirrored;
+		int64_t mSkew;
+};
@@ -17,12 +17,22 @@ LRESULT CALLBACK WndProc( HWND hwnd, UINT message, WPARAM wParam, LPARAM lParam
 
 ciWMFVideoPlayer::ScopedVideoTextureBind::ScopedVideoTextureBind( const ciWMFVideoPlayer& video, uint8_t textureUnit )
 	: mCtx( gl::context() )
-	, mTarget( video.mTex->getTarget() )
+	, mTarget( GL_TEXTURE_RECTANGLE )
 	, mTextureUnit( textureUnit )
 	, mPlayer( video.mPlayer )
 {
+	WMF_TRACE_ZONE( "ScopedVideoTextureBind" );
+
 	mPlayer->mEVRPresenter->lockSharedTexture();
-	mCtx->pushTextureBinding( mTarget, video.mTex->getId(), mTextureUnit );
+
+	// In zero-copy mode, which texture to bind is only known once locked.
+	gl::TextureRef tex = video.getLockedTexture();
+
+	if( tex ) {
+		mTarget = tex->getTarget();
+	}
+
+	mCtx->pushTextureBinding( mTarget, tex ? tex->getId() : 0, mTextureUnit );
 }
 
 ciWMFVideoPlayer::ScopedVideoTextureBind::ScopedVideoTextureBind(const std::shared_ptr<ciWMFVideoPlayer> video, uint8_t textureUnit)
@@ -31,6 +41,8 @@ ciWMFVideoPlayer::ScopedVideoTextureBind::ScopedVideoTextureBind(const std::shar
 
 ciWMFVideoPlayer::ScopedVideoTextureBind::~ScopedVideoTextureBind()
 {
+	WMF_TRACE_ZONE( "~ScopedVideoTextureBind" );
+
 	mCtx->popTextureBinding( mTarget, mTextureUnit );
 	mPlayer->mEVRPresenter->unlockSharedTexture();
 }
@@ -45,10 +57,16 @@ ciWMFVideoPlayer* findPlayers( HWND hwnd )
 }
 
 int  ciWMFVideoPlayer::mInstanceCount = 0;
+bool ciWMFVideoPlayer::sUseEventQueueByDefault = false;
 
 ciWMFVideoPlayer::ciWMFVideoPlayer()
 	: mPlayer( NULL )
 	, mVideoFill( VideoFill::FILL )
+	, mSharedTextureCount( SHARED_TEXTURE_DEFAULT_COUNT )
+	, mZeroCopy( false )
+	, mSurfaceGeneration( 0 )
+	, mAsyncLoading( false )
+	, mIsLooping( false )
 {
 	if( mInstanceCount == 0 )  {
 		HRESULT hr = MFStartup( MF_VERSION );
@@ -64,6 +82,7 @@ ciWMFVideoPlayer::ciWMFVideoPlayer()
 
 	mWaitForLoadedToPlay = false;
 	mSharedTextureCreated = false;
+	mRecreateSharedTextures = false;
 
 	// Make sure the video is closed before the rendering context is lost.
 	auto window = app::App::get()->getWindow();
@@ -71,11 +90,17 @@ ciWMFVideoPlayer::ciWMFVideoPlayer()
 	if( window ) {
 		mWinCloseConnection = window->getSignalClose().connect( std::bind( &ciWMFVideoPlayer::close, this ) );
 	}
+
+	// Playlist clips can differ in size. Connected first, so the textures are ready for the app's handlers.
+	if( mPlayer ) {
+		mClipChangedConnection = mPlayer->getClipChangedSignal().connect( [this]( size_t ) { onMovieOpened(); } );
+	}
 }
 
 ciWMFVideoPlayer::~ciWMFVideoPlayer()
 {
 	mWinCloseConnection.disconnect();
+	mClipChangedConnection.disconnect();
 
 	if( mPlayer ) {
 		mPlayer->Shutdown();
@@ -123,64 +148,219 @@ bool ciWMFVideoPlayer::loadMovie( const fs::path& filePath, const string& audioD
 	std::wstring a( audioDevice.length(), L' ' );
 	std::copy( audioDevice.begin(), audioDevice.end(), a.begin() );
 
+	mAsyncLoading = false;
 	hr = mPlayer->OpenURL( w.c_str(), a.c_str() );
 
 	//	CI_LOG_D(GetPlayerStateString(mPlayer->GetState()));
 
-	if( !mSharedTextureCreated ) {
-		mWidth = mPlayer->getWidth();
-		mHeight = mPlayer->getHeight();
+	onMovieOpened();
+
+	mWaitForLoadedToPlay = false;
+	return true;
+}
 
-		gl::Texture::Format format;
-		format.setInternalFormat( GL_RGBA );
-		format.setTargetRect();
-		format.loadTopDown( true );
-		mTex = gl::Texture::create( mWidth, mHeight, format );
-		mPlayer->mEVRPresenter->createSharedTexture( mWidth, mHeight, mTex->getId() );
-		mSharedTextureCreated = true;
+bool ciWMFVideoPlayer::loadMovieAsync( const fs::path& filePath, const string& audioDevice )
+{
+	if( !mPlayer ) {
+		return false;
 	}
-	else {
-		if( ( mWidth != mPlayer->getWidth() ) || ( mHeight != mPlayer->getHeight() ) ) {
-			mPlayer->mEVRPresenter->releaseSharedTexture();
-
-			mWidth = mPlayer->getWidth();
-			mHeight = mPlayer->getHeight();
-
-			gl::Texture::Format format;
-			format.setInternalFormat( GL_RGBA );
-			format.setTargetRect();
-			format.loadTopDown( true );
-			mTex = gl::Texture::create( mWidth, mHeight, format );
-			mPlayer->mEVRPresenter->createSharedTexture( mWidth, mHeight, mTex->getId() );
-		}
+
+	std::wstring w = filePath.wstring();
+
+	mAsyncAudioDevice.assign( audioDevice.length(), L' ' );
+	std::copy( audioDevice.begin(), audioDevice.end(), mAsyncAudioDevice.begin() );
+
+	mWaitForLoadedToPlay = false;
+
+	HRESULT hr = mPlayer->OpenURLAsync( w.c_str() );
+
+	if( FAILED( hr ) ) {
+		CI_LOG_E( "Opening " << filePath << " failed, hr=0x" << std::hex << hr );
+		mAsyncLoading = false;
+		return false;
+	}
+
+	mAsyncLoading = true;
+	return true;
+}
+
+bool ciWMFVideoPlayer::loadPlaylist( const std::vector<fs::path>& filePaths, const string& audioDevice )
+{
+	if( !mPlayer || filePaths.empty() ) {
+		return false;
 	}
 
+	std::vector<std::wstring> urls;
+
+	for( size_t i = 0; i < filePaths.size(); i++ ) {
+		urls.push_back( filePaths[i].wstring() );
+	}
+
+	std::wstring a( audioDevice.length(), L' ' );
+	std::copy( audioDevice.begin(), audioDevice.end(), a.begin() );
+
+	mAsyncLoading = false;
 	mWaitForLoadedToPlay = false;
+
+	if( FAILED( mPlayer->OpenPlaylist( urls, a.c_str() ) ) ) {
+		return false;
+	}
+
+	onMovieOpened();
 	return true;
 }
 
+bool ciWMFVideoPlayer::appendToPlaylist( const fs::path& filePath )
+{
+	return mPlayer && SUCCEEDED( mPlayer->PlaylistAppend( filePath.wstring().c_str() ) );
+}
+
+bool ciWMFVideoPlayer::insertIntoPlaylist( size_t index, const fs::path& filePath )
+{
+	return mPlayer && SUCCEEDED( mPlayer->PlaylistInsert( index, filePath.wstring().c_str() ) );
+}
+
+bool ciWMFVideoPlayer::removeFromPlaylist( size_t index )
+{
+	return mPlayer && SUCCEEDED( mPlayer->PlaylistRemove( index ) );
+}
+
+bool ciWMFVideoPlayer::skipToClip( size_t index )
+{
+	return mPlayer && SUCCEEDED( mPlayer->PlaylistSkipTo( index ) );
+}
+
+size_t ciWMFVideoPlayer::getClipIndex() const
+{
+	size_t index = 0;
+
+	if( mPlayer ) {
+		mPlayer->GetPlaylistIndex( &index );
+	}
+
+	return index;
+}
+
+// The media info is known: size the textures for it.
+void ciWMFVideoPlayer::onMovieOpened()
+{
+	if( mZeroCopy ) {
+		// The textures follow the presenter's surfaces; see updateSurfaceTextures.
+		mWidth = mPlayer->getWidth();
+		mHeight = mPlayer->getHeight();
+	}
+	else {
+		updateSharedTextureSize();
+	}
+}
+
+// Moves a loadMovieAsync along, without ever waiting on the session.
+void ciWMFVideoPlayer::updateAsyncLoad()
+{
+	mPlayer->PollOpenURL();
+
+	switch( mPlayer->GetState() ) {
+		case OPEN_ASYNC_PENDING:
+		case OPEN_PENDING:
+			break;
+
+		case OPEN_ASYNC_COMPLETE:
+			// EndOpenURL would wait for the previous session to release the presenter.
+			if( mPlayer->IsTearingDown() ) {
+				break;
+			}
+
+			// Only builds and queues the topology; the session loads it asynchronously.
+			if( FAILED( mPlayer->EndOpenURL( mAsyncAudioDevice.c_str() ) ) ) {
+				finishAsyncLoad( false );
+				break;
+			}
+
+			onMovieOpened();
+			break;
+
+		case CLOSED:
+		case CLOSING:
+			finishAsyncLoad( false );
+			break;
+
+		default:
+			finishAsyncLoad( true );
+			break;
+	}
+}
+
+void ciWMFVideoPlayer::setAsyncTeardown( bool enable )
+{
+	if( mPlayer ) {
+		mPlayer->SetAsyncTeardown( enable );
+	}
+}
+
+bool ciWMFVideoPlayer::isAsyncTeardown() const
+{
+	return mPlayer && mPlayer->IsAsyncTeardown();
+}
+
+TeardownStats ciWMFVideoPlayer::getTeardownStats() const
+{
+	TeardownStats stats;
+
+	if( mPlayer ) {
+		mPlayer->GetTeardownStats( &stats );
+	}
+
+	return stats;
+}
+
+void ciWMFVideoPlayer::resetTeardownStats()
+{
+	if( mPlayer ) {
+		mPlayer->ResetTeardownStats();
+	}
+}
+
+void ciWMFVideoPlayer::finishAsyncLoad( bool success )
+{
+	mAsyncLoading = false;
+
+	if( !success ) {
+		mWaitForLoadedToPlay = false;
+		CI_LOG_E( "Player " << mId << " failed to open the movie" );
+	}
+
+	mMovieLoadedSignal.emit( success );
+}
+
 void ciWMFVideoPlayer::draw( int x, int y, int w, int h )
 {
 	if( !mPlayer ) {
 		return;
 	}
 
+	WMF_TRACE_ZONE( "ciWMFVideoPlayer::draw" );
+
+	Rectf destRect = Rectf( x, y, x + w, y + h );
+	if( mZeroCopy ) {
+		updateSurfaceTextures();
+	}
+
 	mPlayer->mEVRPresenter->lockSharedTexture();
 
-	if( mTex ) {
-		Rectf destRect = Rectf( x, y, x + w, y + h );
+	gl::TextureRef tex = getLockedTexture();
 
+	if( tex ) {
 		switch( mVideoFill ) {
 			case VideoFill::FILL:
-				gl::draw( mTex, destRect );
+				gl::draw( tex, destRect );
 				break;
 
 			case VideoFill::ASPECT_FIT:
-				gl::draw( mTex, Rectf( mTex->getBounds() ).getCenteredFit( destRect, true ) ) ;
+				gl::draw( tex, Rectf( tex->getBounds() ).getCenteredFit( destRect, true ) ) ;
 				break;
 
 			case VideoFill::CROP_FIT:
-				gl::draw( mTex, Area( destRect.getCenteredFit( mTex->getBounds(), true ) ), destRect );
+				gl::draw( tex, Area( destRect.getCenteredFit( tex->getBounds(), true ) ), destRect );
 				break;
 		}
 
@@ -213,11 +393,25 @@ void ciWMFVideoPlayer::update()
 {
 	if( !mPlayer ) { return; }
 
+	if( mPlayer->UsesEventQueue() ) {
+		mPlayer->DrainEvents();
+	}
+
+	if( mAsyncLoading ) {
+		updateAsyncLoad();
+	}
+
 	if( ( mWaitForLoadedToPlay ) && mPlayer->GetState() == PAUSED ) {
 		mWaitForLoadedToPlay = false;
 		mPlayer->Play();
 	}
 
+	const bool deviceReady = updateDeviceState();
+
+	if( mZeroCopy && deviceReady ) {
+		updateSurfaceTextures();
+	}
+
 	return;
 }
 
@@ -225,7 +419,7 @@ void ciWMFVideoPlayer::play()
 {
 	if( !mPlayer ) { return; }
 
-	if( mPlayer->GetState()  == OPEN_PENDING ) { mWaitForLoadedToPlay = true; }
+	if( mPlayer->GetState()  == OPEN_PENDING || mAsyncLoading ) { mWaitForLoadedToPlay = true; }
 
 	mPlayer->Play();
 }
@@ -265,6 +459,58 @@ void ciWMFVideoPlayer::setPosition( float pos )
 	mPlayer->setPosition( pos );
 }
 
+bool ciWMFVideoPlayer::seekToFrame( int64_t frame )
+{
+	return SUCCEEDED( mPlayer->SeekToFrame( frame ) );
+}
+
+bool ciWMFVideoPlayer::seekToTime( int64_t hns )
+{
+	return SUCCEEDED( mPlayer->SeekToTime( hns ) );
+}
+
+bool ciWMFVideoPlayer::isSeeking() const
+{
+	return mPlayer && mPlayer->IsSeekPending();
+}
+
+int64_t ciWMFVideoPlayer::getTime()
+{
+	return mPlayer->GetPositionHns();
+}
+
+void ciWMFVideoPlayer::setKeyframeIndexing( bool enable )
+{
+	if( mPlayer ) {
+		mPlayer->SetKeyframeIndexing( enable );
+	}
+}
+
+int64_t ciWMFVideoPlayer::getLongestKeyframeInterval()
+{
+	std::shared_ptr<const KeyframeIndex> index = mPlayer ? mPlayer->GetKeyframeIndex() : std::shared_ptr<const KeyframeIndex>();
+
+	return index ? index->LongestInterval() : -1;
+}
+
+SeekStats ciWMFVideoPlayer::getSeekStats() const
+{
+	SeekStats stats;
+
+	if( mPlayer && mPlayer->mEVRPresenter ) {
+		mPlayer->mEVRPresenter->getSeekStats( &stats );
+	}
+
+	return stats;
+}
+
+void ciWMFVideoPlayer::resetSeekStats()
+{
+	if( mPlayer && mPlayer->mEVRPresenter ) {
+		mPlayer->mEVRPresenter->resetSeekStats();
+	}
+}
+
 void ciWMFVideoPlayer::setVolume( float vol )
 {
 	mPlayer->setVolume( vol );
@@ -349,6 +595,274 @@ bool ciWMFVideoPlayer::setSpeed( float speed, bool useThinning )
 	}
 }
 
+void ciWMFVideoPlayer::setHighResolutionTiming( bool enable, float spinBudgetMs )
+{
+	if( mPlayer && mPlayer->mEVRPresenter ) {
+		mPlayer->mEVRPresenter->setHighResolutionTiming( enable, (LONGLONG)( spinBudgetMs * 10000.0f ) );
+	}
+}
+
+MediaFoundationSamples::HistogramSnapshot ciWMFVideoPlayer::getPresentJitter() const
+{
+	MediaFoundationSamples::HistogramSnapshot snapshot;
+
+	if( mPlayer && mPlayer->mEVRPresenter ) {
+		mPlayer->mEVRPresenter->getPresentJitter( &snapshot );
+	}
+
+	return snapshot;
+}
+
+void ciWMFVideoPlayer::resetPresentJitter()
+{
+	if( mPlayer && mPlayer->mEVRPresenter ) {
+		mPlayer->mEVRPresenter->resetPresentJitter();
+	}
+}
+
+void ciWMFVideoPlayer::getStats( PresenterStats *stats ) const
+{
+	if( mPlayer && mPlayer->mEVRPresenter ) {
+		mPlayer->mEVRPresenter->getStats( stats );
+	}
+}
+
+void ciWMFVideoPlayer::resetStats()
+{
+	if( mPlayer && mPlayer->mEVRPresenter ) {
+		mPlayer->mEVRPresenter->resetStats();
+	}
+}
+
+void ciWMFVideoPlayer::setUseSharedScheduler( bool shared )
+{
+	if( mPlayer && mPlayer->mEVRPresenter ) {
+		mPlayer->mEVRPresenter->setUseSharedScheduler( shared );
+	}
+}
+
+void ciWMFVideoPlayer::setSharedSchedulerStepBudget( float ms )
+{
+	SharedScheduleService::SetStepBudget( (int64_t)( ms * 10000 ) );
+}
+
+SharedScheduleStats ciWMFVideoPlayer::getSharedSchedulerStats()
+{
+	SharedScheduleStats stats;
+	SharedScheduleService::GetStats( &stats );
+	return stats;
+}
+
+void ciWMFVideoPlayer::resetSharedSchedulerStats()
+{
+	SharedScheduleService::ResetStats();
+}
+
+void ciWMFVideoPlayer::setLateFramePolicy( ScheduleEngine::LatePolicy policy, int lateFrames )
+{
+	if( mPlayer && mPlayer->mEVRPresenter ) {
+		mPlayer->mEVRPresenter->setLatePolicy( policy, lateFrames );
+	}
+}
+
+ScheduleCounters ciWMFVideoPlayer::getFrameCounters() const
+{
+	ScheduleCounters counters;
+
+	if( mPlayer && mPlayer->mEVRPresenter ) {
+		mPlayer->mEVRPresenter->getFrameCounters( &counters );
+	}
+
+	return counters;
+}
+
+void ciWMFVideoPlayer::resetFrameCounters()
+{
+	if( mPlayer && mPlayer->mEVRPresenter ) {
+		mPlayer->mEVRPresenter->resetFrameCounters();
+	}
+}
+
+void ciWMFVideoPlayer::setCadenceMode( bool enable )
+{
+	if( mPlayer && mPlayer->mEVRPresenter ) {
+		mPlayer->mEVRPresenter->setCadenceMode( enable );
+	}
+}
+
+CadenceStats ciWMFVideoPlayer::getCadenceStats() const
+{
+	CadenceStats stats;
+
+	if( mPlayer && mPlayer->mEVRPresenter ) {
+		mPlayer->mEVRPresenter->getCadenceStats( &stats );
+	}
+
+	return stats;
+}
+
+void ciWMFVideoPlayer::resetCadenceStats()
+{
+	if( mPlayer && mPlayer->mEVRPresenter ) {
+		mPlayer->mEVRPresenter->resetCadenceStats();
+	}
+}
+
+void ciWMFVideoPlayer::setSharedTextureCount( int count )
+{
+	if( count < 1 ) {
+		count = 1;
+	}
+	else if( count > SHARED_TEXTURE_MAX ) {
+		count = SHARED_TEXTURE_MAX;
+	}
+
+	mSharedTextureCount = count;
+}
+
+void ciWMFVideoPlayer::setOutputSize( int width, int height )
+{
+	setOutputSizePolicy( OutputSizePolicy::FixedSize( width > 0 ? width : 0, height > 0 ? height : 0 ) );
+}
+
+void ciWMFVideoPlayer::setMaxOutputDimension( int maxDimension )
+{
+	setOutputSizePolicy( OutputSizePolicy::MaxSize( maxDimension > 0 ? maxDimension : 0 ) );
+}
+
+void ciWMFVideoPlayer::resetOutputSize()
+{
+	setOutputSizePolicy( OutputSizePolicy::SourceSize() );
+}
+
+ivec2 ciWMFVideoPlayer::getOutputSize() const
+{
+	UINT width = 0, height = 0;
+
+	if( mPlayer && mPlayer->mEVRPresenter ) {
+		mPlayer->mEVRPresenter->getOutputSize( (UINT)mPlayer->getWidth(), (UINT)mPlayer->getHeight(), &width, &height );
+	}
+	return ivec2( width, height );
+}
+
+void ciWMFVideoPlayer::setOutputSizePolicy( const OutputSizePolicy& policy )
+{
+	if( !mPlayer || !mPlayer->mEVRPresenter ) {
+		return;
+	}
+
+	HRESULT hr = mPlayer->mEVRPresenter->setOutputSizePolicy( policy );
+
+	if( FAILED( hr ) ) {
+		CI_LOG_E( "Posting the output size change failed, hr=0x" << std::hex << hr );
+	}
+
+	// Zero-copy textures follow the presenter's surfaces on their own.
+	if( mSharedTextureCreated && !mZeroCopy ) {
+		updateSharedTextureSize();
+	}
+}
+
+bool ciWMFVideoPlayer::setUseSharedDevice( bool shared )
+{
+	if( mPlayer && mPlayer->mEVRPresenter ) {
+		HRESULT hr = mPlayer->mEVRPresenter->setUseSharedDevice( shared );
+
+		if( FAILED( hr ) ) {
+			CI_LOG_E( "Switching the Direct3D device failed, hr=0x" << std::hex << hr );
+			return false;
+		}
+		return true;
+	}
+	return false;
+}
+
+bool ciWMFVideoPlayer::isUsingSharedDevice() const
+{
+	return mPlayer && mPlayer->mEVRPresenter && mPlayer->mEVRPresenter->isUsingSharedDevice();
+}
+
+void ciWMFVideoPlayer::setUseSharedDeviceByDefault( bool shared )
+{
+	D3DPresentEngine::setUseSharedDeviceByDefault( shared );
+}
+
+VideoMemoryUsage ciWMFVideoPlayer::getVideoMemoryUsage() const
+{
+	VideoMemoryUsage usage = {};
+
+	if( mPlayer && mPlayer->mEVRPresenter ) {
+		mPlayer->mEVRPresenter->getVideoMemoryUsage( &usage );
+	}
+	return usage;
+}
+
+PresentedFrameInfo ciWMFVideoPlayer::getPresentedFrameInfo() const
+{
+	PresentedFrameInfo info;
+
+	if( mPlayer && mPlayer->mEVRPresenter ) {
+		info = mPlayer->mEVRPresenter->getPresentedFrameInfo();
+	}
+
+	return info;
+}
+
+bool ciWMFVideoPlayer::hasNewFrame( uint64_t lastSerial ) const
+{
+	if( mPlayer && mPlayer->mEVRPresenter ) {
+		return mPlayer->mEVRPresenter->getPresentedFrameSerial() > lastSerial;
+	}
+
+	return false;
+}
+
+void ciWMFVideoPlayer::setUseEventQueueByDefault( bool enable )
+{
+	sUseEventQueueByDefault = enable;
+}
+
+void ciWMFVideoPlayer::setHeadless( bool enable )
+{
+	if( mPlayer && mPlayer->mEVRPresenter ) {
+		// Without a window, presenting is not an option.
+		mPlayer->mEVRPresenter->setHeadless( enable || mPlayer->UsesEventQueue() );
+	}
+}
+
+bool ciWMFVideoPlayer::isHeadless() const
+{
+	return mPlayer && mPlayer->mEVRPresenter && mPlayer->mEVRPresenter->isHeadless();
+}
+
+void ciWMFVideoPlayer::setZeroCopy( bool enable )
+{
+	if( mPlayer && mPlayer->mEVRPresenter ) {
+		mZeroCopy = enable;
+		mPlayer->mEVRPresenter->setZeroCopy( enable );
+	}
+}
+
+void ciWMFVideoPlayer::setTracingEnabled( bool enable )
+{
+#ifndef WMFVIDEO_TRACE_ZONES
+	if( enable ) {
+		CI_LOG_W( "Tracing requested, but zones are not compiled in. Define WMFVIDEO_TRACE_ZONES." );
+	}
+#endif
+	TraceRecorder::SetEnabled( enable );
+}
+
+bool ciWMFVideoPlayer::writeTrace( const ci::fs::path& path )
+{
+	return TraceRecorder::WriteChromeTrace( path.string() );
+}
+
+void ciWMFVideoPlayer::clearTrace()
+{
+	TraceRecorder::Clear();
+}
+
 PresentationEndedSignal& ciWMFVideoPlayer::getPresentationEndedSignal()
 {
 	if( mPlayer ) {
@@ -360,10 +874,161 @@ float ciWMFVideoPlayer::getHeight() { return mPlayer->getHeight(); }
 float ciWMFVideoPlayer::getWidth() { return mPlayer->getWidth(); }
 void  ciWMFVideoPlayer::setLoop( bool isLooping ) { mIsLooping = isLooping; mPlayer->setLooping( isLooping ); }
 
+void ciWMFVideoPlayer::setGaplessLoop( bool gapless )
+{
+	if( mPlayer ) {
+		mPlayer->setGaplessLooping( gapless );
+	}
+}
+
+bool ciWMFVideoPlayer::isGaplessLoop() const
+{
+	return mPlayer && mPlayer->isGaplessLooping();
+}
+
+LoopStats ciWMFVideoPlayer::getLoopStats() const
+{
+	LoopStats stats;
+
+	if( mPlayer && mPlayer->mEVRPresenter ) {
+		mPlayer->mEVRPresenter->getLoopStats( &stats );
+	}
+
+	return stats;
+}
+
+void ciWMFVideoPlayer::resetLoopStats()
+{
+	if( mPlayer && mPlayer->mEVRPresenter ) {
+		mPlayer->mEVRPresenter->resetLoopStats();
+	}
+}
+
 //-----------------------------------
 // Prvate Functions
 //-----------------------------------
 
+// (Re-)creates the shared textures when the presenter's output size no longer matches them.
+void ciWMFVideoPlayer::updateSharedTextureSize()
+{
+	UINT width = 0, height = 0;
+	mPlayer->mEVRPresenter->getOutputSize( (UINT)mPlayer->getWidth(), (UINT)mPlayer->getHeight(), &width, &height );
+
+	if( mSharedTextureCreated && mWidth == (int)width && mHeight == (int)height ) {
+		return;
+	}
+
+	if( mSharedTextureCreated ) {
+		mPlayer->mEVRPresenter->releaseSharedTexture();
+	}
+
+	mWidth = width;
+	mHeight = height;
+
+	createSharedTextures();
+	mSharedTextureCreated = true;
+}
+
+// After a lost device the presenter runs on a new one. Releases everything GL registered with the old
+// device, then registers it again once the device can be opened; with the shared device, that is once
+// every player using it has released its own. Returns false until then.
+bool ciWMFVideoPlayer::updateDeviceState()
+{
+	EVRCustomPresenter* presenter = mPlayer->mEVRPresenter;
+
+	if( !presenter ) {
+		return false;
+	}
+
+	if( presenter->isGLDeviceLost() ) {
+		CI_LOG_I( "Player " << mId << ": device lost, re-creating shared textures" );
+		presenter->releaseGLDevice();
+
+		mSharedTextures.clear();
+		mSurfaceTextures.clear();
+		mSurfaceGeneration = 0;
+		mRecreateSharedTextures = mSharedTextureCreated;
+		mSharedTextureCreated = false;
+	}
+
+	if( !presenter->canOpenGLDevice() ) {
+		return false;
+	}
+
+	if( mRecreateSharedTextures ) {
+		mRecreateSharedTextures = false;
+		updateSharedTextureSize();
+	}
+	return true;
+}
+
+// Creates the ring of textures the presenter copies frames into. The presenter owns the GL names:
+// registering them gives them their storage, and releasing the shared textures deletes them.
+void ciWMFVideoPlayer::createSharedTextures()
+{
+	std::vector<GLuint> names( mSharedTextureCount, 0 );
+	glGenTextures( mSharedTextureCount, names.data() );
+
+	mSharedTextures.clear();
+
+	for( int i = 0; i < mSharedTextureCount; i++ ) {
+		gl::TextureRef texture = gl::Texture::create( GL_TEXTURE_RECTANGLE, names[i], mWidth, mHeight, true );
+		texture->setTopDown( true );
+		mSharedTextures.push_back( texture );
+	}
+
+	mPlayer->mEVRPresenter->createSharedTextures( mWidth, mHeight, names.data(), mSharedTextureCount );
+}
+
+// Zero-copy mode: when the presenter has re-created its surfaces, make one texture per surface and
+// register them with the presenter. Needs the GL context, so it runs from update() and draw().
+void ciWMFVideoPlayer::updateSurfaceTextures()
+{
+	EVRCustomPresenter* presenter = mPlayer->mEVRPresenter;
+	uint32_t generation = presenter->getSharedSurfaceGeneration();
+	int count = presenter->getSharedSurfaceCount();
+
+	if( generation == mSurfaceGeneration || count == 0 ) {
+		return;
+	}
+
+	UINT width = 0, height = 0;
+	presenter->getSharedSurfaceSize( &width, &height );
+
+	// The mixer usually outputs X8R8G8B8, whose alpha is undefined.
+	gl::Texture::Format format;
+	format.setInternalFormat( GL_RGBA );
+	format.setTargetRect();
+	format.loadTopDown( true );
+	format.setSwizzleMask( GL_RED, GL_GREEN, GL_BLUE, GL_ONE );
+
+	std::vector<gl::TextureRef> textures;
+	std::vector<GLuint> names;
+
+	for( int i = 0; i < count; i++ ) {
+		textures.push_back( gl::Texture::create( width, height, format ) );
+		names.push_back( textures.back()->getId() );
+	}
+
+	// Registering unregisters the previous textures, so they can go once it returns.
+	if( presenter->registerSharedSurfaces( generation, names.data(), count ) ) {
+		mSurfaceTextures.swap( textures );
+		mSurfaceGeneration = generation;
+	}
+}
+
+ci::gl::TextureRef ciWMFVideoPlayer::getLockedTexture() const
+{
+	const std::vector<gl::TextureRef>& textures = mZeroCopy ? mSurfaceTextures : mSharedTextures;
+	int index = mPlayer->mEVRPresenter->getLockedSurface();
+
+	if( index < 0 || index >= (int)textures.size() ) {
+		return nullptr;
+	}
+
+	return textures[index];
+}
+
 // Handler for Media Session events.
 void ciWMFVideoPlayer::OnPlayerEvent( HWND hwnd, WPARAM pUnkPtr )
 {
@@ -420,6 +1085,12 @@ BOOL ciWMFVideoPlayer::InitInstance()
 	HWND hwnd;
 	WNDCLASSEX wcex;
 
+	if( sUseEventQueueByDefault ) {
+		// No window at all: events are queued for update(), and frames only go to the textures.
+		mHWNDPlayer = NULL;
+		return SUCCEEDED( CPlayer::CreateInstance( NULL, NULL, &mPlayer ) );
+	}
+
 	//   g_hInstance = hInst; // Store the instance handle.
 	// Register the window class.
 	ZeroMemory( &wcex, sizeof( WNDCLASSEX ) );
@@ -35,27 +35,54 @@ enum VideoFill {
 
 typedef std::shared_ptr<class ciWMFVideoPlayer> ciWMFVideoPlayerRef;
 
+// Emitted by loadMovieAsync's completion: true once the movie is ready to play, false if it failed to open.
+typedef cinder::signals::Signal<void( bool )> MovieLoadedSignal;
+
 class ciWMFVideoPlayer
 {
 	private:
 		static int mInstanceCount;
+		static bool sUseEventQueueByDefault;
 		HWND mHWNDPlayer;
 
 		int mWidth;
 		int mHeight;
 
 		bool mWaitForLoadedToPlay;
+
+		// loadMovieAsync: waiting for the source to resolve and the session to be ready.
+		bool mAsyncLoading;
+		std::wstring mAsyncAudioDevice;
+		MovieLoadedSignal mMovieLoadedSignal;
 		bool mIsLooping;
 		VideoFill mVideoFill;
 
 		bool mSharedTextureCreated;
+		bool mRecreateSharedTextures;	// The device was lost; create the textures again when it can be opened.
+
+		// Ring of textures the presenter copies frames into; draw binds the newest complete one.
+		std::vector<ci::gl::TextureRef> mSharedTextures;
+		int mSharedTextureCount;
 
-		ci::gl::TextureRef mTex;
+		// Zero-copy mode: one texture per presenter surface, re-created when the surfaces are.
+		bool mZeroCopy;
+		std::vector<ci::gl::TextureRef> mSurfaceTextures;
+		uint32_t mSurfaceGeneration;
 
 		cinder::signals::Connection mWinCloseConnection;
+		cinder::signals::Connection mClipChangedConnection;
 
 		BOOL InitInstance();
 		void OnPlayerEvent( HWND hwnd, WPARAM pUnkPtr );
+		void createSharedTextures();
+		void updateSharedTextureSize();
+		bool updateDeviceState();
+		void onMovieOpened();
+		void updateAsyncLoad();
+		void finishAsyncLoad( bool success );
+		void setOutputSizePolicy( const OutputSizePolicy& policy );
+		void updateSurfaceTextures();
+		ci::gl::TextureRef getLockedTexture() const;
 
 	public:
 		friend struct ScopedVideoTextureBind;
@@ -79,6 +106,41 @@ class ciWMFVideoPlayer
 		~ciWMFVideoPlayer();
 
 		bool loadMovie( const ci::fs::path& filePath, const std::string& audioDevice = "" );
+
+		// Like loadMovie, but returns at once; the file is opened on a Media Foundation thread and update()
+		// finishes the load, creating the textures once the movie's size is known. getMovieLoadedSignal fires
+		// from update() when the movie is ready to play, or has failed to open. play() before then starts
+		// playback once ready. Returns false if the load could not be started.
+		bool loadMovieAsync( const ci::fs::path& filePath, const std::string& audioDevice = "" );
+		bool isLoading() const { return mAsyncLoading; }
+		MovieLoadedSignal& getMovieLoadedSignal() { return mMovieLoadedSignal; }
+
+		// Plays the files back to back in one session, each clip prerolled while the previous one plays, with
+		// no gap and no session rebuild between them (see CPlayer::OpenPlaylist). Clips can be added and
+		// removed while playing. The textures follow each clip's size. With setLoop the playlist starts over
+		// after the last clip.
+		bool loadPlaylist( const std::vector<ci::fs::path>& filePaths, const std::string& audioDevice = "" );
+		bool appendToPlaylist( const ci::fs::path& filePath );
+		bool insertIntoPlaylist( size_t index, const ci::fs::path& filePath );
+		bool removeFromPlaylist( size_t index );
+		bool skipToClip( size_t index );
+		bool isPlaylist() const { return mPlayer && mPlayer->IsPlaylist(); }
+		size_t getPlaylistSize() const { return mPlayer ? mPlayer->GetPlaylistSize() : 0; }
+		// Index of the clip playing, or 0 without a playlist.
+		size_t getClipIndex() const;
+		// Fires from update() (or the event window) when the next clip starts, after the textures are resized.
+		ClipChangedSignal& getClipChangedSignal() { return mPlayer->getClipChangedSignal(); }
+
+		// Close the previous movie's session on a background thread instead of waiting for it on every
+		// load. The next movie's source is opened meanwhile; only binding it to the presenter waits for the
+		// old session to let go (loadMovie blocks for what is left of it, loadMovieAsync does not).
+		// loadMovieAsync turns it on, as it never waits on the calling thread. close() and destruction still wait.
+		void setAsyncTeardown( bool enable );
+		bool isAsyncTeardown() const;
+		// How long loads were held up by closing the previous session, and how long the closes took in the
+		// background, across all players.
+		TeardownStats getTeardownStats() const;
+		void resetTeardownStats();
 		void close();
 		void update();
 
@@ -92,6 +154,23 @@ class ciWMFVideoPlayer
 		float getVolume();
 
 		void setPosition( float pos );
+		// Frame-accurate seeks, by frame number or in 100ns units: the first frame shown is the target, not
+		// the keyframe before it. A paused or stopped movie is left paused on the target frame.
+		bool seekToFrame( int64_t frame );
+		bool seekToTime( int64_t hns );
+		// The target frame of the last seek is not on screen yet.
+		bool isSeeking() const;
+		// Position in 100ns units.
+		int64_t getTime();
+		// Index keyframes in the background as soon as a movie is loaded, instead of on the first seek.
+		void setKeyframeIndexing( bool enable );
+		// The longest keyframe interval in the movie, in 100ns units: the most a seek decodes through.
+		// -1 until the index has been built.
+		int64_t getLongestKeyframeInterval();
+		// Seek latency, how many frames each seek decoded and dropped, and the distance to the preceding
+		// keyframe, for tuning the GOP size of encodes.
+		SeekStats getSeekStats() const;
+		void resetSeekStats();
 		void stepForward();
 		void setVolume( float vol );
 
@@ -107,9 +186,103 @@ class ciWMFVideoPlayer
 
 		void setLoop( bool isLooping );
 		bool isLooping() const { return mIsLooping; }
+		// Loop without stopping and restarting at the end: the next pass is prerolled while the current one
+		// plays and follows it with no gap and no frame skipped. Call before loadMovie or loadMovieAsync.
+		// getPresentationEndedSignal fires as each pass ends; seekToFrame/seekToTime are not supported.
+		void setGaplessLoop( bool gapless );
+		bool isGaplessLoop() const;
+		// Loop count, how long the last frame of each pass overstayed, and how long restarts took. Both
+		// loop modes are measured.
+		LoopStats getLoopStats() const;
+		void resetLoopStats();
 
 		void setVideoFill( VideoFill videoFill ) { mVideoFill = videoFill; }
 
+		// Number of shared textures frames are copied into (default 3). With three or more, drawing never
+		// waits for the presenter's copy and vice versa. Call before loadMovie.
+		void setSharedTextureCount( int count );
+
+		// Have the mixer scale frames down to the size they are drawn at, shrinking the presenter's surfaces,
+		// the shared textures and the copies between them. Renegotiates immediately if a movie is loaded.
+		// setOutputSize(w, h) outputs exactly w x h; setMaxOutputDimension keeps the aspect ratio and only
+		// scales down; resetOutputSize goes back to the source size. Sizes are rounded down to even numbers.
+		void setOutputSize( int width, int height );
+		void setMaxOutputDimension( int maxDimension );
+		void resetOutputSize();
+		ci::ivec2 getOutputSize() const;
+
+		// Use one Direct3D device (and GL interop handle) shared by every player that opts in, instead of
+		// a device per player. Call before loadMovie. The static default applies to players created
+		// afterwards, and avoids creating a device of their own first.
+		bool setUseSharedDevice( bool shared );
+		bool isUsingSharedDevice() const;
+		static void setUseSharedDeviceByDefault( bool shared );
+
+		// Estimated video memory this player's surfaces and textures use, and the total across players on
+		// the shared device.
+		VideoMemoryUsage getVideoMemoryUsage() const;
+
+		// Deliver media session events through a lock-free queue that update() drains, instead of a hidden
+		// window per player and the app's message pump. No window is created, so such players are always
+		// headless and getHandle() returns NULL. Applies to players created afterwards; update() must then
+		// be called every frame, or loading and looping stall.
+		static void setUseEventQueueByDefault( bool enable );
+		bool isUsingEventQueue() const { return mPlayer && mPlayer->UsesEventQueue(); }
+
+		// Only feed the shared textures: skip presenting every frame to the player's hidden window, and
+		// allocate plain render targets instead of one swap chain per sample. Call before loadMovie.
+		void setHeadless( bool enable );
+		bool isHeadless() const;
+
+		// The frame last presented to the textures: its sample time, duration, serial and when it was presented
+		// (100ns units). hasNewFrame is true once a frame after lastSerial has been presented, so apps can skip
+		// redrawing while the video has not advanced. Both are lock-free; the serial starts at 0 before any frame.
+		PresentedFrameInfo getPresentedFrameInfo() const;
+		bool hasNewFrame( uint64_t lastSerial ) const;
+
+		// Let the decoder render straight into textures GL reads, instead of copying every frame into
+		// a single shared texture. Call before loadMovie.
+		void setZeroCopy( bool enable );
+		bool isZeroCopy() const { return mZeroCopy; }
+
+		// Sleep, then spin for up to spinBudgetMs before each frame instead of relying on the OS timer alone.
+		void setHighResolutionTiming( bool enable, float spinBudgetMs = 2.0f );
+		// Histogram of scheduler wake-up error (actual minus target), in 100ns units.
+		MediaFoundationSamples::HistogramSnapshot getPresentJitter() const;
+		void resetPresentJitter();
+
+		// Frame statistics: lateness, queue and pool occupancy, mixer latency, presented/dropped/repeated
+		// frames and repaints. Cheap enough to poll every frame; reuse the same stats object.
+		void getStats( PresenterStats *stats ) const;
+		void resetStats();
+
+		// Schedule this player's frames on one thread shared by all players that opt in, instead of a
+		// thread per player. Takes effect the next time playback starts streaming.
+		void setUseSharedScheduler( bool shared );
+		// How long the shared scheduler thread runs one player before other players with due frames get
+		// a turn, and how much the players on it have delayed each other.
+		static void setSharedSchedulerStepBudget( float ms );
+		static SharedScheduleStats getSharedSchedulerStats();
+		static void resetSharedSchedulerStats();
+
+		// What to do with frames that miss their present window. lateFrames applies to LateDropByFrames.
+		void setLateFramePolicy( ScheduleEngine::LatePolicy policy, int lateFrames = 1 );
+		// On-time, late and dropped frame counts since load (or the last reset).
+		ScheduleCounters getFrameCounters() const;
+		void resetFrameCounters();
+
+		// Phase-lock frames to display refresh ticks with a stable repeat pattern (3:2 for 24p on 60 Hz).
+		void setCadenceMode( bool enable );
+		CadenceStats getCadenceStats() const;
+		void resetCadenceStats();
+
+		// Record pipeline timing zones (mixer, scheduler, present, texture lock, draw) for all players.
+		// Zones are only compiled in when WMFVIDEO_TRACE_ZONES is defined.
+		static void setTracingEnabled( bool enable );
+		// Writes the recorded zones as Chrome Trace JSON, for chrome://tracing or ui.perfetto.dev.
+		static bool writeTrace( const ci::fs::path& path );
+		static void clearTrace();
+
 		void draw( int x, int y , int w, int h );
 		void draw( int x, int y ) { draw( x, y, getWidth(), getHeight() ); }
 
@@ -99,9 +99,19 @@ HRESULT CPlayer::Initialize()
 		hr = HRESULT_FROM_WIN32( GetLastError() );
 	}
 
+	// Manual reset; signaled while no teardown is pending.
+	mTeardownDone = CreateEventA( NULL, TRUE, TRUE, NULL );
+
+	if( mTeardownDone == NULL ) {
+		hr = HRESULT_FROM_WIN32( GetLastError() );
+	}
+
 	if( !mEVRPresenter )  {
 		mEVRPresenter = new EVRCustomPresenter( hr );
-		mEVRPresenter->SetVideoWindow( mHWNDVideo );
+
+		// Without a video window there is nothing to present to; only feed the textures.
+		if( mHWNDVideo ) { mEVRPresenter->SetVideoWindow( mHWNDVideo ); }
+		else { mEVRPresenter->setHeadless( true ); }
 	}
 
 	return hr;
@@ -111,6 +121,9 @@ CPlayer::CPlayer( HWND hVideo, HWND hEvent ) :
 	mSession( NULL ),
 	mSource( NULL ),
 	mSourceResolver( NULL ),
+	mResolvedSource( NULL ),
+	mResolveResult( S_OK ),
+	mResolveDone( false ),
 	mVideoDisplay( NULL ),
 	mHWNDVideo( hVideo ),
 	mHWNDEvent( hEvent ),
@@ -121,7 +134,39 @@ CPlayer::CPlayer( HWND hVideo, HWND hEvent ) :
 	mSequencerSource( NULL ),
 	mVolumeControl( NULL ),
 	mPreviousTopoID( 0 ),
-	mIsLooping( false )
+	mIsLooping( false ),
+	mGaplessLoop( false ),
+	mSingleClip( false ),
+	mSkipKey( 0 ),
+	mSegmentResolvedCB( this, &CPlayer::OnSegmentResolved ),
+	mResolvingKey( 0 ),
+	mSegmentResolver( NULL ),
+	mSegmentSource( NULL ),
+	mSegmentResult( S_OK ),
+	mClipOffset( 0 ),
+	mNextClipStart( 0 ),
+	mNextClipOffset( 0 ),
+	mNextClipPending( false ),
+	mIndexKeyframes( false ),
+	mKeyframeIndexes( NULL ),
+	mSegmentQueued( false ),
+	mPlaylistVideoSink( NULL ),
+	mPlaylistAudioSink( NULL ),
+	mClock( NULL ),
+	mDuration( 0 ),
+	mFrameRateNum( 0 ),
+	mFrameRateDen( 1 ),
+	mNumFrames( 0 ),
+	mStreamCount( 0 ),
+	mVideoStreamIndex( MAXDWORD ),
+	mWidth( 0 ),
+	mHeight( 0 ),
+	mPlaybackRate( 1.0f ),
+	mTimeSource( NULL ),
+	mReaper( NULL ),
+	mTeardownsPending( 0 ),
+	mTeardownDone( NULL ),
+	mCloseBlocking( TEARDOWN_HISTOGRAM_BIN_WIDTH, 0 )
 {
 
 }
@@ -150,6 +195,11 @@ CPlayer::~CPlayer()
 	Shutdown();
 	//SAFE_RELEASE(mEVRPresenter);
 	SafeRelease( &mSequencerSource );
+	SafeRelease( &mTimeSource );
+
+	if( mKeyframeIndexes ) {
+		KeyframeIndexService::Release();
+	}
 
 
 }
@@ -185,6 +235,8 @@ HRESULT CPlayer::OpenMultipleURL( vector<const WCHAR*>& urls )
 {
 	if( mState == OPEN_PENDING ) { return S_FALSE; }
 
+	mUrl.clear();
+
 	IMFTopology* pTopology = NULL;
 	IMFPresentationDescriptor* pSourcePD = NULL;
 
@@ -208,6 +260,8 @@ HRESULT CPlayer::OpenMultipleURL( vector<const WCHAR*>& urls )
 		hr = CreateSession();
 		CHECK_HR( hr );
 
+		WaitForTeardown();
+
 		hr = mSequencerSource->QueryInterface( IID_PPV_ARGS( &mSource ) );
 		CHECK_HR( hr );
 	}
@@ -217,7 +271,8 @@ HRESULT CPlayer::OpenMultipleURL( vector<const WCHAR*>& urls )
 
 	for( int i = nPresenters; i < nUrl; i ++ ) {
 		EVRCustomPresenter* presenter = new EVRCustomPresenter( hr );
-		presenter->SetVideoWindow( mHWNDVideo );
+		if( mHWNDVideo ) { presenter->SetVideoWindow( mHWNDVideo ); }
+		else { presenter->setHeadless( true ); }
 		mEVRPresenters.push_back( presenter );
 	}
 
@@ -302,6 +357,12 @@ HRESULT CPlayer::OpenURL( const WCHAR* sURL, const WCHAR* audioDeviceId )
 	HRESULT hr = CreateSession();
 	CHECK_HR( hr );
 
+	mUrl = sURL;
+
+	if( mIndexKeyframes ) {
+		GetKeyframeIndex();
+	}
+
 	// Create the media source.
 	hr = CreateMediaSource( sURL, &mSource );
 	CHECK_HR( hr );
@@ -341,17 +402,36 @@ HRESULT CPlayer::OpenURLAsync( const WCHAR* sURL )
 	// 1. Create a new media session.
 	// 2. Create the media source.
 
+	// The caller's thread must never wait for the previous session: always
+	// hand it to the reaper, whether or not asynchronous teardown was asked for.
+	SetAsyncTeardown( true );
+
 	// Create the media session.
 	HRESULT hr = S_OK;
 	hr = CreateSession();
 	CHECK_HR( hr );
 
-	// Create the media source.
-	hr = BeginCreateMediaSource( sURL, this, &mSourceResolver );
-	CHECK_HR( hr );
+	mUrl = sURL;
+
+	if( mIndexKeyframes ) {
+		GetKeyframeIndex();
+	}
 
-	/////MADE ASYNCHRONOUS
 	mState = OPEN_ASYNC_PENDING;
+
+	// Create the media source. The lock is held until mSourceResolver is set,
+	// as OnSourceResolved can be called before BeginCreateMediaSource returns.
+	{
+		AutoLock lock( mResolveLock );
+
+		SafeRelease( &mSourceResolver );
+		SafeRelease( &mResolvedSource );
+		mResolveDone = false;
+
+		hr = BeginCreateMediaSource( sURL, this, &mSourceResolver );
+	}
+	CHECK_HR( hr );
+
 done:
 
 	if( FAILED( hr ) ) {
@@ -361,6 +441,41 @@ done:
 	return hr;
 }
 
+//  Takes the result OnSourceResolved published, moving OPEN_ASYNC_PENDING on
+//  to OPEN_ASYNC_COMPLETE or CLOSED. Call on the owning thread.
+void CPlayer::PollOpenURL()
+{
+	if( mState != OPEN_ASYNC_PENDING ) {
+		return;
+	}
+
+	IMFMediaSource* pSource = NULL;
+	HRESULT hr = S_OK;
+
+	{
+		AutoLock lock( mResolveLock );
+
+		if( !mResolveDone ) {
+			return;
+		}
+
+		pSource = mResolvedSource;
+		mResolvedSource = NULL;
+		hr = mResolveResult;
+		mResolveDone = false;
+	}
+
+	if( SUCCEEDED( hr ) ) {
+		SafeRelease( &mSource );
+		mSource = pSource;
+		mState = OPEN_ASYNC_COMPLETE;
+	}
+	else {
+		SafeRelease( &pSource );
+		mState = CLOSED;
+	}
+}
+
 HRESULT CPlayer::EndOpenURL( const WCHAR* audioDeviceId )
 {
 	HRESULT hr;
@@ -372,6 +487,33 @@ HRESULT CPlayer::EndOpenURL( const WCHAR* audioDeviceId )
 	IMFTopology* pTopology = NULL;
 	IMFPresentationDescriptor* pSourcePD = NULL;
 
+	// The previous session's EVR must let go of the presenter first. Only the
+	// rest of its close is left, as the new source was resolved meanwhile.
+	WaitForTeardown();
+
+	if( mGaplessLoop ) {
+		// A one-clip playlist, so the sequencer prerolls each pass behind the last.
+		IMFMediaSource* pSource = mSource;
+		mSource = NULL;
+
+		mPlaylist.Clear();
+		mPlaylist.Insert( 0, mUrl );
+
+		hr = StartPlaylist( audioDeviceId, pSource );
+
+		if( FAILED( hr ) ) {
+			( void )pSource->Shutdown();
+		}
+
+		SafeRelease( &pSource );
+
+		if( SUCCEEDED( hr ) ) {
+			mSingleClip = true;
+		}
+
+		goto done;
+	}
+
 	// Create the presentation descriptor for the media source.
 	hr = mSource->CreatePresentationDescriptor( &pSourcePD );
 	CHECK_HR( hr );
@@ -472,6 +614,105 @@ HRESULT CPlayer::setPosition( float pos )
 	return S_OK;
 }
 
+HRESULT CPlayer::SeekToTime( MFTIME hnsTarget )
+{
+	if( mSession == NULL || mEVRPresenter == NULL ) {
+		return E_UNEXPECTED;
+	}
+
+	if( mState != STARTED && mState != PAUSED && mState != STOPPED ) {
+		CI_LOG_E( "Error cannot seek before the movie is ready" );
+		return MF_E_INVALIDREQUEST;
+	}
+
+	if( IsSequenced() ) {
+		CI_LOG_E( "Frame-accurate seeks are not supported in playlists or gapless loops" );
+		return MF_E_INVALIDREQUEST;
+	}
+
+	// No further than the start of the last frame.
+	if( mDuration > 0 && hnsTarget > mDuration - GetFrameDuration() ) {
+		hnsTarget = mDuration - GetFrameDuration();
+	}
+
+	if( hnsTarget < 0 ) {
+		hnsTarget = 0;
+	}
+
+	LONGLONG keyframe = -1;
+	std::shared_ptr<const KeyframeIndex> index = GetKeyframeIndex();
+
+	if( index && !index->IsEmpty() ) {
+		keyframe = index->Preceding( hnsTarget );
+	}
+
+	// Before the session starts: the presenter starts filtering when the clock jumps.
+	mEVRPresenter->noteSeek( hnsTarget, keyframe, GetFrameDuration() );
+
+	PROPVARIANT varStart;
+	PropVariantInit( &varStart );
+	varStart.vt = VT_I8;
+	varStart.hVal.QuadPart = hnsTarget;
+
+	PlayerState curState = mState;
+	HRESULT hr = mSession->Start( &GUID_NULL, &varStart );
+
+	PropVariantClear( &varStart );
+
+	if( FAILED( hr ) ) {
+		CI_LOG_E( "Seek failed, hr=0x" << std::hex << hr );
+		return hr;
+	}
+
+	mState = STARTED;
+
+	// Pausing shows the target frame and holds it. A stopped session would go back to the start on
+	// its next Start, so it is left paused too.
+	if( curState != STARTED ) {
+		hr = Pause();
+	}
+
+	return hr;
+}
+
+HRESULT CPlayer::SeekToFrame( LONGLONG frame )
+{
+	if( mFrameRateNum == 0 ) {
+		return SeekToTime( frame * GetFrameDuration() );
+	}
+
+	return SeekToTime( FrameTime::ToTime( frame, mFrameRateNum, mFrameRateDen ) );
+}
+
+bool CPlayer::IsSeekPending() const
+{
+	return mEVRPresenter && mEVRPresenter->isSeekPending();
+}
+
+MFTIME CPlayer::GetPositionHns()
+{
+	MFTIME position = 0;
+
+	if( mClock == NULL || FAILED( mClock->GetTime( &position ) ) ) {
+		return 0;
+	}
+
+	return ClipTime( position );
+}
+
+std::shared_ptr<const KeyframeIndex> CPlayer::GetKeyframeIndex()
+{
+	if( mUrl.empty() ) {
+		return std::shared_ptr<const KeyframeIndex>();
+	}
+
+	if( mKeyframeIndexes == NULL ) {
+		mKeyframeIndexes = KeyframeIndexService::Acquire();
+	}
+
+	return mKeyframeIndexes->Find( mUrl );
+}
+
 HRESULT CPlayer::setVolume( float vol )
 {
 	//Should we lock here as well ?
@@ -508,44 +749,33 @@ HRESULT CPlayer::Invoke( IMFAsyncResult* pResult )
 {
 	MediaEventType meType = MEUnknown;  // Event type
 	IMFMediaEvent* pEvent = NULL;
+	IMFMediaSession* pSession = NULL;
 
 	HRESULT hr;
 
-	if( !mSession ) {
-		CI_LOG_W( "Called with a null session" );
-		return -1; //Sometimes Invoke is called but mSession is closed
-	}
-
-	// Handle async-loading
-	if( mState == OPEN_ASYNC_PENDING ) {
-		if( !&mSourceResolver ) {
-			CI_LOG_E( "Async request returned with NULL session" );
-			//ofLogError( "CPlayer::Invoke" ) << "Async request returned with NULL session";
-			return -1;
-		}
+	// Sessions pass themselves as the state object; the source resolver passes none.
+	IUnknown* pState = NULL;
 
-		MF_OBJECT_TYPE ObjectType = MF_OBJECT_INVALID;
-		IUnknown*  	pSourceUnk = NULL;
-		//CheckPointer(mSource, E_POINTER);
+	if( SUCCEEDED( pResult->GetState( &pState ) ) && pState ) {
+		pState->QueryInterface( IID_PPV_ARGS( &pSession ) );
+	}
 
-		hr = mSourceResolver->EndCreateObjectFromURL(
-		         pResult,					// Invoke result
-		         &ObjectType,                // Receives the created object type.
-		         &pSourceUnk                  // Receives a pointer to the media source.
-		     );
+	SafeRelease( &pState );
 
-		// Get the IMFMediaSource interface from the media source.
-		if( SUCCEEDED( hr ) ) {
-			hr = pSourceUnk->QueryInterface( __uuidof( IMFMediaSource ), ( void** )( &mSource ) );
-			mState = OPEN_ASYNC_COMPLETE; // Session finished opening URL
-		}
+	// Handle async-loading: only the source resolver calls back without a session.
+	if( pSession == NULL ) {
+		return OnSourceResolved( pResult );
+	}
 
-		SafeRelease( &pSourceUnk );
+	if( pSession != mSession ) {
+		// A session that was handed to the reaper.
+		hr = OnClosingSessionEvent( pSession, pResult );
+		SafeRelease( &pSession );
 		return hr;
 	}
 
 	// Get the event from the event queue.
-	hr = mSession->EndGetEvent( pResult, &pEvent );
+	hr = pSession->EndGetEvent( pResult, &pEvent );
 	CHECK_HR( hr );
 
 	// Get the event type.
@@ -559,7 +789,7 @@ HRESULT CPlayer::Invoke( IMFAsyncResult* pResult )
 	}
 	else {
 		// For all other events, get the next event in the queue.
-		hr = mSession->BeginGetEvent( this, NULL );
+		hr = pSession->BeginGetEvent( this, pSession );
 		CHECK_HR( hr );
 	}
 
@@ -569,21 +799,116 @@ HRESULT CPlayer::Invoke( IMFAsyncResult* pResult )
 	// application is waiting on the mCloseEvent event and
 	// the application's message loop is blocked.
 
-	// Otherwise, post a private window message to the application.
+	// Otherwise, post a private window message to the application, or
+	// queue the event for DrainEvents if there is no event window.
 
-	if( mState != CLOSING ) {
-		// Leave a reference count on the event.
-		pEvent->AddRef();
+	if( mState != CLOSING && pSession == mSession ) {
+		PostPlayerEvent( pEvent, meType );
+	}
+
+done:
+	SafeRelease( &pEvent );
+	SafeRelease( &pSession );
+	return S_OK;
+}
+
+//  Hands an event to the owning thread, leaving a reference count on it for HandleEvent.
+//  Called on Media Foundation threads.
+void CPlayer::PostPlayerEvent( IMFMediaEvent* pEvent, MediaEventType meType )
+{
+	pEvent->AddRef();
 
+	if( mHWNDEvent ) {
 		PostMessage( mHWNDEvent, WM_APP_PLAYER_EVENT,
 		             ( WPARAM )pEvent, ( LPARAM )meType );
 	}
+	else if( !mEventQueue.Post( pEvent, meType ) ) {
+		// Runs on a Media Foundation thread; queue the message rather than log synchronously.
+		WMF_LOG_ERROR( L"Player event queue full, dropping event %u\n", ( unsigned int )meType );
+		pEvent->Release();
+	}
+}
+
+//  Invoke for OpenURLAsync's source resolver, on a Media Foundation thread.
+//  The result is only published here; PollOpenURL takes it on the owning
+//  thread, so mState and mSource are never written from this one.
+HRESULT CPlayer::OnSourceResolved( IMFAsyncResult* pResult )
+{
+	AutoLock lock( mResolveLock );
+
+	if( mSourceResolver == NULL ) {
+		CI_LOG_E( "Async request returned with no source resolver" );
+		return E_UNEXPECTED;
+	}
+
+	MF_OBJECT_TYPE ObjectType = MF_OBJECT_INVALID;
+	IUnknown* pSourceUnk = NULL;
+
+	HRESULT hr = mSourceResolver->EndCreateObjectFromURL(
+	                 pResult,					// Invoke result
+	                 &ObjectType,                // Receives the created object type.
+	                 &pSourceUnk                  // Receives a pointer to the media source.
+	             );
+
+	// Get the IMFMediaSource interface from the media source.
+	if( SUCCEEDED( hr ) ) {
+		hr = pSourceUnk->QueryInterface( __uuidof( IMFMediaSource ), ( void** )( &mResolvedSource ) );
+	}
+
+	mResolveResult = hr;
+	mResolveDone = true;
+
+	SafeRelease( &pSourceUnk );
+	return hr;
+}
+
+//  Invoke for a session CloseSessionAsync handed to the reaper. Its events
+//  are no longer the application's; only MESessionClosed matters.
+HRESULT CPlayer::OnClosingSessionEvent( IMFMediaSession* pSession, IMFAsyncResult* pResult )
+{
+	IMFMediaEvent* pEvent = NULL;
+	MediaEventType meType = MEUnknown;
+
+	HRESULT hr = pSession->EndGetEvent( pResult, &pEvent );
+
+	if( SUCCEEDED( hr ) ) {
+		hr = pEvent->GetType( &meType );
+	}
+
+	if( meType == MESessionClosed ) {
+		AutoLock lock( mClosingLock );
+
+		for( size_t i = 0; i < mClosingSessions.size(); i++ ) {
+			if( mClosingSessions[i].pSession == pSession ) {
+				SetEvent( mClosingSessions[i].hClosed );
+			}
+		}
+	}
+	else if( SUCCEEDED( hr ) ) {
+		pSession->BeginGetEvent( this, pSession );
+	}
 
-done:
 	SafeRelease( &pEvent );
 	return S_OK;
 }
 
+//  Handles the events Invoke queued, when there is no event window. Call
+//  on the thread that owns the player, typically once per frame.
+size_t CPlayer::DrainEvents()
+{
+	return mEventQueue.Drain( [this]( const PlayerEvent & ev ) {
+		HandleEvent( ( UINT_PTR )ev.pEvent );
+	} );
+}
+
+//  Releases queued events without handling them; they belong to a closed session.
+void CPlayer::DiscardEvents()
+{
+	mEventQueue.Drain( []( const PlayerEvent & ev ) {
+		( ( IMFMediaEvent* )ev.pEvent )->Release();
+	} );
+}
+
 HRESULT CPlayer::HandleEvent( UINT_PTR pEventPtr )
 {
 	HRESULT hrStatus = S_OK;
@@ -626,6 +951,24 @@ HRESULT CPlayer::HandleEvent( UINT_PTR pEventPtr )
 			CI_LOG_V( "New Presentation" );
 			break;
 
+		case MESessionNotifyPresentationTime:
+			hr = OnPresentationTime( pEvent );
+			break;
+
+		case ME_PLAYLIST_CLIP_RESOLVED: {
+			PROPVARIANT varKey;
+			PropVariantInit( &varKey );
+
+			hr = pEvent->GetValue( &varKey );
+
+			if( SUCCEEDED( hr ) && varKey.vt == VT_UI8 ) {
+				hr = QueueResolvedSegment( varKey.uhVal.QuadPart );
+			}
+
+			PropVariantClear( &varKey );
+			break;
+		}
+
 		case MESessionTopologySet:
 			IMFTopology* topology;
 			GetEventObject<IMFTopology> ( pEvent, &topology );
@@ -696,8 +1039,18 @@ HRESULT CPlayer::Shutdown()
 {
 	HRESULT hr = S_OK;
 
-	// Close the session
+	// Close the session. The presenter is released below, so wait for the
+	// reaper too: its sessions' EVRs still use the presenter until they close.
 	hr = CloseSession();
+	SetAsyncTeardown( false );
+
+	{
+		AutoLock lock( mResolveLock );
+
+		SafeRelease( &mSourceResolver );
+		SafeRelease( &mResolvedSource );
+		mResolveDone = false;
+	}
 
 	// Shutdown the Media Foundation platform
 	if( mCloseEvent ) {
@@ -705,6 +1058,11 @@ HRESULT CPlayer::Shutdown()
 		mCloseEvent = NULL;
 	}
 
+	if( mTeardownDone ) {
+		CloseHandle( mTeardownDone );
+		mTeardownDone = NULL;
+	}
+
 	if( mEVRPresenters.size() > 0 ) {
 		if( mEVRPresenters[0] ) { mEVRPresenters[0]->releaseSharedTexture(); }
 
@@ -730,12 +1088,41 @@ HRESULT CPlayer::OnTopologyStatus( IMFMediaEvent* pEvent )
 
 	HRESULT hr = pEvent->GetUINT32( MF_EVENT_TOPOLOGY_STATUS, &status );
 
-	if( SUCCEEDED( hr ) && ( status == MF_TOPOSTATUS_READY ) ) {
+	// A playlist's next clip becomes ready while the current one plays; only the first one starts playback.
+	if( SUCCEEDED( hr ) && ( status == MF_TOPOSTATUS_READY ) && ( !IsSequenced() || mState == OPEN_PENDING ) ) {
 		SafeRelease( &mVideoDisplay );
+
+		// Keep the clock for getPosition, so it does not query the session each time.
+		SafeRelease( &mClock );
+		IMFClock* pClock = NULL;
+
+		if( SUCCEEDED( mSession->GetClock( &pClock ) ) ) {
+			pClock->QueryInterface( IID_PPV_ARGS( &mClock ) );
+		}
+
+		SafeRelease( &pClock );
+
+		// A sync group's shared time source, in place of the one the session picked.
+		if( mClock && mTimeSource ) {
+			HRESULT hrTimeSource = mClock->SetTimeSource( mTimeSource );
+
+			if( FAILED( hrTimeSource ) ) {
+				CI_LOG_E( "Setting the shared time source failed, hr=0x" << std::hex << hrTimeSource );
+			}
+		}
+
+		mPlaybackRate = 1.0f;
+
 		hr = StartPlayback();
 		hr = Pause();
 	}
 
+	// The session has moved on to the prerolled clip. ENDED of the previous one covers a session that
+	// does not report the switch.
+	if( SUCCEEDED( hr ) && ( status == MF_TOPOSTATUS_SINK_SWITCHED || status == MF_TOPOSTATUS_ENDED ) && mSegmentQueued ) {
+		AdvancePlaylist();
+	}
+
 	return hr;
 }
 
@@ -744,7 +1131,15 @@ HRESULT CPlayer::OnPresentationEnded( IMFMediaEvent* pEvent )
 {
 	HRESULT hr = S_OK;
 
-	if( mIsLooping ) {
+	if( IsSequenced() ) {
+		// Only a playlist or gapless loop that does not loop ends; see SyncPlaylist.
+		hr = Pause();
+	}
+	else if( mIsLooping ) {
+		if( mEVRPresenter ) {
+			mEVRPresenter->noteLoopRestart();
+		}
+
 		hr = Stop();
 		hr = Play();
 	}
@@ -775,6 +1170,12 @@ HRESULT CPlayer::OnNewPresentation( IMFMediaEvent* pEvent )
 	hr = GetEventObject( pEvent, &pPD );
 	CHECK_HR( hr );
 
+	if( IsSequenced() ) {
+		// The next clip, prerolled into the running session.
+		hr = QueuePlaylistPresentation( pPD );
+		goto done;
+	}
+
 	// Create a partial topology.
 	hr = CreatePlaybackTopology( mSource, pPD,  mHWNDVideo, &pTopology, mEVRPresenter );
 	CHECK_HR( hr );
@@ -792,6 +1193,46 @@ done:
 	return S_OK;
 }
 
+//  Handler for MESessionNotifyPresentationTime, sent by the session ahead of each sequenced clip: the
+//  presentation time the clip's first sample is rendered at, and the offset of its samples from their
+//  source times. The clip takes over for ClipTime once the clock reaches it.
+HRESULT CPlayer::OnPresentationTime( IMFMediaEvent* pEvent )
+{
+	UINT64 start = 0;
+	UINT64 offset = 0;
+
+	HRESULT hr = pEvent->GetUINT64( MF_EVENT_START_PRESENTATION_TIME_AT_OUTPUT, &start );
+
+	if( SUCCEEDED( hr ) ) {
+		hr = pEvent->GetUINT64( MF_EVENT_PRESENTATION_TIME_OFFSET, &offset );
+	}
+
+	if( FAILED( hr ) ) {
+		return S_OK;
+	}
+
+	mNextClipStart = ( MFTIME )start;
+	mNextClipOffset = ( MFTIME )offset;
+	mNextClipPending = true;
+
+	// Where the prerolled next pass begins, for the loop stats.
+	if( mSingleClip && mSegmentQueued && mEVRPresenter ) {
+		mEVRPresenter->noteLoopBoundary( mNextClipStart );
+	}
+
+	return S_OK;
+}
+
+//  The position in the current clip at a presentation clock time.
+MFTIME CPlayer::ClipTime( MFTIME presentationTime ) const
+{
+	if( mNextClipPending && presentationTime >= mNextClipStart ) {
+		return presentationTime - mNextClipOffset;
+	}
+
+	return presentationTime - mClipOffset;
+}
+
 //  Create a new instance of the media session.
 HRESULT CPlayer::CreateSession()
 {
@@ -801,12 +1242,16 @@ HRESULT CPlayer::CreateSession()
 
 	assert( mState == CLOSED );
 
+	mClipOffset = 0;
+	mNextClipPending = false;
+
 	// Create the media session.
 	hr = MFCreateMediaSession( NULL, &mSession );
 	CHECK_HR( hr );
 
-	// Start pulling events from the media session
-	hr = mSession->BeginGetEvent( ( IMFAsyncCallback* )this, NULL );
+	// Start pulling events from the media session. The session is the state
+	// object, so Invoke can tell it from a session that is being reaped.
+	hr = mSession->BeginGetEvent( ( IMFAsyncCallback* )this, mSession );
 	CHECK_HR( hr );
 
 	mState = READY;
@@ -825,11 +1270,27 @@ HRESULT CPlayer::CloseSession()
 	//  media session fires.
 
 	HRESULT hr = S_OK;
+	MFTIME start = MFGetSystemTime();
 
 	if( mVideoDisplay != NULL ) { SafeRelease( &mVideoDisplay ); }
 
 	if( mVolumeControl != NULL ) { SafeRelease( &mVolumeControl ); }
 
+	SafeRelease( &mClock );
+
+	// The playlist's sources and sinks go with the session.
+	ClosingSession playlist;
+	DetachPlaylist( &playlist );
+
+	// With asynchronous teardown, the reaper closes and shuts down the session
+	// instead; the sync path below is the fallback if the hand-off fails.
+	if( mSession && mReaper && SUCCEEDED( CloseSessionAsync( &playlist ) ) ) {
+		DiscardEvents();
+		mState = CLOSED;
+		mCloseBlocking.Record( MFGetSystemTime() - start );
+		return S_OK;
+	}
+
 	// First close the media session.
 	if( mSession ) {
 		DWORD dwWaitResult = 0;
@@ -863,52 +1324,167 @@ HRESULT CPlayer::CloseSession()
 		}
 	}
 
+	ShutdownPlaylist( &playlist );
 	SafeRelease( &mSource );
 	SafeRelease( &mSession );
+	DiscardEvents();
 	mState = CLOSED;
+	mCloseBlocking.Record( MFGetSystemTime() - start );
 	return hr;
 }
 
-//  Start playback from the current position.
-HRESULT CPlayer::StartPlayback()
+//  Hands the session and source to the reaper, which closes them on its own
+//  thread. The presenter is released by the old session's EVR during the
+//  close, so nothing may bind it to a new topology until IsTearingDown()
+//  is false; see WaitForTeardown.
+HRESULT CPlayer::CloseSessionAsync( ClosingSession* pPlaylist )
 {
-	assert( mSession != NULL );
+	ClosingSession closing;
+	closing.pSession = mSession;
+	closing.pSource = mSource;
+	closing.hClosed = CreateEventA( NULL, FALSE, FALSE, NULL );
 
-	PROPVARIANT varStart;
-	PropVariantInit( &varStart );
+	if( closing.hClosed == NULL ) {
+		return HRESULT_FROM_WIN32( GetLastError() );
+	}
 
-	HRESULT hr = mSession->Start( &GUID_NULL, &varStart );
+	{
+		AutoLock lock( mClosingLock );
+		mClosingSessions.push_back( closing );
+	}
 
-	if( SUCCEEDED( hr ) ) {
-		// Note: Start is an asynchronous operation. However, we
-		// can treat our state as being already started. If Start
-		// fails later, we'll get an MESessionStarted event with
-		// an error code, and we will update our state then.
-		mState = STARTED;
+	// The reaper owns the references now.
+	mSession = NULL;
+	mSource = NULL;
+	closing.segmentSources.swap( pPlaylist->segmentSources );
+	closing.sinks.swap( pPlaylist->sinks );
+
+	if( InterlockedIncrement( &mTeardownsPending ) == 1 ) {
+		ResetEvent( mTeardownDone );
 	}
 
-	PropVariantClear( &varStart );
+	// The job calls back into this object.
+	AddRef();
 
-	return hr;
+	mReaper->Post( [this, closing]() {
+		ReapSession( closing );
+	} );
+
+	return S_OK;
 }
 
-//  Start playback from paused or stopped.
-HRESULT CPlayer::Play()
+//  Runs on the reaper thread: the synchronous part of CloseSession.
+void CPlayer::ReapSession( ClosingSession closing )
 {
-	if( mState != PAUSED && mState != STOPPED ) {
-		return MF_E_INVALIDREQUEST;
+	HRESULT hr = closing.pSession->Close();
+
+	// OnClosingSessionEvent signals hClosed on MESessionClosed.
+	if( SUCCEEDED( hr ) && WaitForSingleObject( closing.hClosed, 5000 ) == WAIT_TIMEOUT ) {
+		WMF_LOG_WARNING( L"Timed out waiting for a media session to close\n" );
 	}
 
-	if( mSession == NULL || mSource == NULL ) {
-		return E_UNEXPECTED;
+	if( closing.pSource ) {
+		( void )closing.pSource->Shutdown();
 	}
 
-	return StartPlayback();
-}
+	( void )closing.pSession->Shutdown();
+	ShutdownPlaylist( &closing );
 
-// Gaz: Already defined in mfutils.h
-//  Create a media source from a URL.
-//HRESULT CreateMediaSource(PCWSTR sURL, IMFMediaSource **ppSource)
+	{
+		AutoLock lock( mClosingLock );
+
+		for( size_t i = 0; i < mClosingSessions.size(); i++ ) {
+			if( mClosingSessions[i].pSession == closing.pSession ) {
+				mClosingSessions.erase( mClosingSessions.begin() + i );
+				break;
+			}
+		}
+	}
+
+	CloseHandle( closing.hClosed );
+	SafeRelease( &closing.pSource );
+	SafeRelease( &closing.pSession );
+
+	if( InterlockedDecrement( &mTeardownsPending ) == 0 ) {
+		SetEvent( mTeardownDone );
+	}
+
+	Release();
+}
+
+void CPlayer::SetAsyncTeardown( bool enable )
+{
+	if( enable && !mReaper ) {
+		mReaper = TeardownReaper::Acquire();
+	}
+	else if( !enable && mReaper ) {
+		WaitForTeardown();
+		TeardownReaper::Release();
+		mReaper = NULL;
+	}
+}
+
+//  Blocks until every session handed to the reaper has been shut down.
+void CPlayer::WaitForTeardown()
+{
+	if( mTeardownDone && mTeardownsPending > 0 ) {
+		WMF_TRACE_ZONE( "WaitForTeardown" );
+		WaitForSingleObject( mTeardownDone, INFINITE );
+	}
+}
+
+void CPlayer::GetTeardownStats( TeardownStats* pStats ) const
+{
+	TeardownReaper::GetStats( pStats );
+	mCloseBlocking.GetSnapshot( &pStats->blocking );
+}
+
+void CPlayer::ResetTeardownStats()
+{
+	TeardownReaper::ResetStats();
+	mCloseBlocking.Reset();
+}
+
+//  Start playback from the current position.
+HRESULT CPlayer::StartPlayback()
+{
+	assert( mSession != NULL );
+
+	PROPVARIANT varStart;
+	PropVariantInit( &varStart );
+
+	HRESULT hr = mSession->Start( &GUID_NULL, &varStart );
+
+	if( SUCCEEDED( hr ) ) {
+		// Note: Start is an asynchronous operation. However, we
+		// can treat our state as being already started. If Start
+		// fails later, we'll get an MESessionStarted event with
+		// an error code, and we will update our state then.
+		mState = STARTED;
+	}
+
+	PropVariantClear( &varStart );
+
+	return hr;
+}
+
+//  Start playback from paused or stopped.
+HRESULT CPlayer::Play()
+{
+	if( mState != PAUSED && mState != STOPPED ) {
+		return MF_E_INVALIDREQUEST;
+	}
+
+	if( mSession == NULL || mSource == NULL ) {
+		return E_UNEXPECTED;
+	}
+
+	return StartPlayback();
+}
+
+// Gaz: Already defined in mfutils.h
+//  Create a media source from a URL.
+//HRESULT CreateMediaSource(PCWSTR sURL, IMFMediaSource **ppSource)
 //{
 //    MF_OBJECT_TYPE ObjectType = MF_OBJECT_INVALID;
 //
@@ -1370,193 +1946,841 @@ done:
 }
 
 ///------------
-/// Extra functions
+/// Playlist
 //---------------
 
-float CPlayer::getDuration()
+//  Opens a playlist in a new session and starts it paused on the first clip, like OpenURL. The sequencer
+//  source holds the current clip and the next; SyncPlaylist keeps it that way as the playlist changes.
+HRESULT CPlayer::OpenPlaylist( const std::vector<std::wstring>& urls, const WCHAR* audioDeviceId )
 {
-	float duration = 0.0;
+	if( urls.empty() ) {
+		return E_INVALIDARG;
+	}
 
-	if( mSource == NULL ) {
-		return 0.0;
+	HRESULT hr = CreateSession();
+	CHECK_HR( hr );
+
+	mUrl.clear();
+
+	// The previous session's EVR must let go of the presenter first.
+	WaitForTeardown();
+
+	mPlaylist.Clear();
+
+	for( size_t i = 0; i < urls.size(); i++ ) {
+		mPlaylist.Insert( i, urls[i] );
 	}
 
-	IMFPresentationDescriptor* pDescriptor = NULL;
-	HRESULT hr = mSource->CreatePresentationDescriptor( &pDescriptor );
+	hr = StartPlaylist( audioDeviceId, NULL );
 
-	if( SUCCEEDED( hr ) ) {
-		UINT64 longDuration = 0;
-		hr = pDescriptor->GetUINT64( MF_PD_DURATION, &longDuration );
+done:
 
-		if( SUCCEEDED( hr ) ) {
-			duration = ( float )longDuration / 10000000.0;
+	if( FAILED( hr ) ) {
+		CI_LOG_E( "Opening the playlist failed, hr=0x" << std::hex << hr );
+		mState = CLOSED;
+	}
+
+	return hr;
+}
+
+//  Queues the first clip of mPlaylist on a new sequencer source and sets its topology on the session.
+//  pFirstSource, if not NULL, is the first clip's source, already resolved.
+HRESULT CPlayer::StartPlaylist( const WCHAR* audioDeviceId, IMFMediaSource* pFirstSource )
+{
+	IMFPresentationDescriptor* pPD = NULL;
+	IMFMediaSourceTopologyProvider* pProvider = NULL;
+	IMFTopology* pTopology = NULL;
+
+	SafeRelease( &mSequencerSource );
+	mPreviousTopoID = 0;
+	mSingleClip = false;
+
+	HRESULT hr = MFCreateSequencerSource( NULL, &mSequencerSource );
+	CHECK_HR( hr );
+
+	hr = mSequencerSource->QueryInterface( IID_PPV_ARGS( &mSource ) );
+	CHECK_HR( hr );
+
+	mPlaylistAudioDevice = audioDeviceId ? audioDeviceId : L"";
+
+	hr = AppendSegment( mPlaylist.At( 0 ).key, pFirstSource );
+	CHECK_HR( hr );
+
+	hr = SyncPlaylist();
+	CHECK_HR( hr );
+
+	SetMediaInfo( mSegments[0].pPD );
+
+	// The sequencer's presentation is the first clip's.
+	hr = mSource->CreatePresentationDescriptor( &pPD );
+	CHECK_HR( hr );
+
+	hr = mSequencerSource->QueryInterface( IID_PPV_ARGS( &pProvider ) );
+	CHECK_HR( hr );
+
+	hr = pProvider->GetMediaSourceTopology( pPD, &pTopology );
+	CHECK_HR( hr );
+
+	hr = mSession->SetTopology( 0, pTopology );
+	CHECK_HR( hr );
+
+	mState = OPEN_PENDING;
+	mCurrentVolume = 1.0f;
+
+done:
+
+	if( FAILED( hr ) ) {
+		mState = CLOSED;
+	}
+
+	SafeRelease( &pTopology );
+	SafeRelease( &pProvider );
+	SafeRelease( &pPD );
+	return hr;
+}
+
+//  Inserts a clip. The current clip and a prerolling one keep their places: an insert between them goes
+//  after the prerolling one.
+HRESULT CPlayer::PlaylistInsert( size_t index, const WCHAR* url )
+{
+	if( !IsPlaylist() ) {
+		return MF_E_INVALIDREQUEST;
+	}
+
+	size_t committed = 0;
+
+	if( mPlaylist.Find( mSegments[mSegmentQueued ? 1 : 0].key, &committed ) ) {
+		size_t current = 0;
+
+		if( mPlaylist.Find( mSegments[0].key, &current ) && index > current && index <= committed ) {
+			index = committed + 1;
 		}
 	}
 
-	SafeRelease( &pDescriptor );
-	return duration;
+	mPlaylist.Insert( index, url );
+	return SyncPlaylist();
 }
 
-float CPlayer::getPosition()
+//  Removes a clip. The current clip, a prerolling one and the target of a skip that has not happened yet
+//  cannot be removed; skip past them first.
+HRESULT CPlayer::PlaylistRemove( size_t index )
 {
-	float position = 0.0;
+	if( !IsPlaylist() ) {
+		return MF_E_INVALIDREQUEST;
+	}
 
-	if( mSession == NULL ) {
-		return 0.0;
+	if( index >= mPlaylist.Size() ) {
+		return E_INVALIDARG;
+	}
+
+	if( mPlaylist.At( index ).key == mSkipKey ) {
+		return MF_E_INVALIDREQUEST;
+	}
+
+	for( size_t i = 0; i < mSegments.size(); i++ ) {
+		if( mSegments[i].key == mPlaylist.At( index ).key && ( i == 0 || ( i == 1 && mSegmentQueued ) ) ) {
+			return MF_E_INVALIDREQUEST;
+		}
+	}
+
+	mPlaylist.Remove( index );
+	return SyncPlaylist();
+}
+
+//  Jumps to a clip, in the same session: once its source has resolved, the sequencer switches to it as to
+//  a seek target (see StartSkip). The current clip plays on until then.
+HRESULT CPlayer::PlaylistSkipTo( size_t index )
+{
+	if( !IsPlaylist() || mState == OPEN_PENDING ) {
+		return MF_E_INVALIDREQUEST;
+	}
+
+	if( index >= mPlaylist.Size() ) {
+		return E_INVALIDARG;
+	}
+
+	// Everything after the current clip goes, a prerolling one too; the target takes its place.
+	while( mSegments.size() > 1 ) {
+		RemoveSegment( mSegments.size() - 1 );
 	}
 
-	IMFPresentationClock* pClock = NULL;
-	HRESULT hr = mSession->GetClock( ( IMFClock** )&pClock );
+	mSegmentQueued = false;
+	mSkipKey = mPlaylist.At( index ).key;
+
+	HRESULT hr = SyncPlaylist();
+
+	if( FAILED( hr ) ) {
+		CI_LOG_E( "Skipping to clip " << index << " failed, hr=0x" << std::hex << hr );
+		mSkipKey = 0;
+	}
+
+	return hr;
+}
+
+//  Switches to the skip target, queued after the current clip. Playback carries on in the state it was in.
+HRESULT CPlayer::StartSkip()
+{
+	PlayerState curState = mState;
+	PROPVARIANT varStart;
+	PropVariantInit( &varStart );
+
+	// Committed from here on: OnNewPresentation sets it on the session.
+	mSkipKey = 0;
+	mSegmentQueued = true;
+
+	HRESULT hr = SyncPlaylist();
+	CHECK_HR( hr );
+
+	hr = MFCreateSequencerSegmentOffset( mSegments[1].id, 0, &varStart );
+	CHECK_HR( hr );
+
+	hr = mSession->Start( &MF_TIME_FORMAT_SEGMENT_OFFSET, &varStart );
+	CHECK_HR( hr );
+
+	mState = STARTED;
+
+	if( curState == PAUSED ) { hr = Pause(); }
+	else if( curState == STOPPED ) { hr = Stop(); }
+
+done:
+	PropVariantClear( &varStart );
+	return hr;
+}
+
+bool CPlayer::GetPlaylistIndex( size_t* pIndex ) const
+{
+	return IsPlaylist() && mPlaylist.Find( mSegments[0].key, pIndex );
+}
+
+void CPlayer::setLooping( bool isLooping )
+{
+	mIsLooping = isLooping;
+
+	// Whether anything follows the last clip.
+	if( IsSequenced() ) {
+		SyncPlaylist();
+	}
+}
+
+//  Queues a clip's topology on the sequencer, at the end. Resolves its source synchronously unless it is
+//  given; only StartPlaylist relies on that, for a first clip OpenPlaylist was asked to open.
+HRESULT CPlayer::AppendSegment( UINT64 key, IMFMediaSource* pSource )
+{
+	PlaylistSegment segment = { 0, key, NULL, NULL, false };
+	IMFTopology* pTopology = NULL;
+	size_t index = 0;
+
+	HRESULT hr = mPlaylist.Find( key, &index ) ? S_OK : E_INVALIDARG;
+	CHECK_HR( hr );
+
+	if( pSource ) {
+		segment.pSource = pSource;
+		segment.pSource->AddRef();
+	}
+	else {
+		hr = CreateMediaSource( mPlaylist.At( index ).url.c_str(), &segment.pSource );
+		CHECK_HR( hr );
+	}
+
+	hr = segment.pSource->CreatePresentationDescriptor( &segment.pPD );
+	CHECK_HR( hr );
+
+	hr = CreatePlaylistTopology( segment.pSource, segment.pPD, &pTopology );
+	CHECK_HR( hr );
+
+	hr = mSequencerSource->AppendTopology( pTopology, 0, &segment.id );
+	CHECK_HR( hr );
+
+	mSegments.push_back( segment );
+
+done:
+
+	if( FAILED( hr ) ) {
+		if( segment.pSource ) {
+			( void )segment.pSource->Shutdown();
+		}
+
+		SafeRelease( &segment.pPD );
+		SafeRelease( &segment.pSource );
+	}
+
+	SafeRelease( &pTopology );
+	return hr;
+}
+
+void CPlayer::RemoveSegment( size_t index )
+{
+	PlaylistSegment& segment = mSegments[index];
+
+	( void )mSequencerSource->DeleteTopology( segment.id );
+	( void )segment.pSource->Shutdown();
+	SafeRelease( &segment.pPD );
+	SafeRelease( &segment.pSource );
+
+	mSegments.erase( mSegments.begin() + index );
+}
+
+HRESULT CPlayer::SetSegmentLast( size_t index, bool last )
+{
+	if( mSegments[index].last == last ) {
+		return S_OK;
+	}
+
+	HRESULT hr = mSequencerSource->UpdateTopologyFlags( mSegments[index].id, last ? SequencerTopologyFlags_Last : 0 );
 
 	if( SUCCEEDED( hr ) ) {
-		MFTIME longPosition = 0;
-		hr = pClock->GetTime( &longPosition );
+		mSegments[index].last = last;
+	}
+
+	return hr;
+}
+
+//  The clip that plays after the committed ones: a pending skip's target, or the next in the playlist.
+bool CPlayer::NextSegmentKey( UINT64* pKey ) const
+{
+	if( mSkipKey != 0 && !mSegmentQueued ) {
+		*pKey = mSkipKey;
+		return true;
+	}
+
+	const size_t committed = mSegmentQueued ? 2 : 1;
+	return mPlaylist.Next( mSegments[committed - 1].key, mIsLooping, pKey );
+}
+
+//  Brings the sequencer in line with the playlist: after the clips that are playing or prerolling there is
+//  exactly the clip that comes next, or nothing, and the last clip queued is flagged as the last. A next
+//  clip that is not queued yet is resolved; QueueResolvedSegment appends it and calls this again.
+HRESULT CPlayer::SyncPlaylist()
+{
+	const size_t committed = mSegmentQueued ? 2 : 1;
+	UINT64 nextKey = 0;
+	HRESULT hr = S_OK;
+
+	bool hasNext = NextSegmentKey( &nextKey );
+
+	// Keep an already queued next clip if it is still the right one; it has its source resolved.
+	size_t keep = committed;
+
+	if( hasNext && mSegments.size() > committed && mSegments[committed].key == nextKey ) {
+		keep = committed + 1;
+	}
+
+	while( mSegments.size() > keep ) {
+		RemoveSegment( mSegments.size() - 1 );
+	}
+
+	if( hasNext && mSegments.size() == committed ) {
+		hr = ResolveSegment( nextKey );
+		CHECK_HR( hr );
+	}
+
+	for( size_t i = 0; i + 1 < mSegments.size(); i++ ) {
+		hr = SetSegmentLast( i, false );
+		CHECK_HR( hr );
+	}
+
+	// With looping there is always a next clip, and the sequence never ends. While the next one resolves,
+	// the last queued is not flagged either: the sequencer waits for it rather than ending.
+	hr = SetSegmentLast( mSegments.size() - 1, !hasNext );
+	CHECK_HR( hr );
+
+done:
+	return hr;
+}
+
+//  Starts resolving a clip's source on a Media Foundation thread. One clip resolves at a time: if another
+//  is still resolving, this one is resolved after it, when QueueResolvedSegment syncs the playlist again.
+HRESULT CPlayer::ResolveSegment( UINT64 key )
+{
+	if( mResolvingKey != 0 ) {
+		return S_OK;
+	}
+
+	size_t index = 0;
+
+	HRESULT hr = mPlaylist.Find( key, &index ) ? S_OK : E_INVALIDARG;
+	CHECK_HR( hr );
+
+	// The lock is held until mSegmentResolver is set, as OnSegmentResolved can be called before
+	// BeginCreateObjectFromURL returns.
+	{
+		AutoLock lock( mResolveLock );
+
+		hr = MFCreateSourceResolver( &mSegmentResolver );
+
+		if( SUCCEEDED( hr ) ) {
+			hr = mSegmentResolver->BeginCreateObjectFromURL( mPlaylist.At( index ).url.c_str(),
+			        MF_RESOLUTION_MEDIASOURCE, NULL, NULL, &mSegmentResolvedCB, mSegmentResolver );
+		}
 
 		if( SUCCEEDED( hr ) ) {
-			position = ( float )longPosition / 10000000.0;
+			mResolvingKey = key;
+		}
+		else {
+			SafeRelease( &mSegmentResolver );
 		}
 	}
 
-	SafeRelease( &pClock );
-	return position;
+done:
+	return hr;
 }
 
-float CPlayer::getFrameRate()
+//  Invoke for ResolveSegment's source resolver, on a Media Foundation thread. Publishes the source and
+//  posts ME_PLAYLIST_CLIP_RESOLVED to the owning thread. A resolver the playlist has let go of since
+//  only has its source shut down.
+HRESULT CPlayer::OnSegmentResolved( IMFAsyncResult* pResult )
 {
-	float fps = 0.0;
+	IUnknown* pState = NULL;
+	IMFSourceResolver* pResolver = NULL;
+	IUnknown* pSourceUnk = NULL;
+	IMFMediaSource* pSource = NULL;
+	IMFMediaEvent* pEvent = NULL;
+	MF_OBJECT_TYPE ObjectType = MF_OBJECT_INVALID;
+	UINT64 key = 0;
 
-	if( mSource == NULL ) {
-		return 0.0;
+	HRESULT hr = pResult->GetState( &pState );
+
+	if( SUCCEEDED( hr ) ) {
+		hr = pState->QueryInterface( IID_PPV_ARGS( &pResolver ) );
 	}
 
-	IMFPresentationDescriptor* pDescriptor = NULL;
-	IMFStreamDescriptor* pStreamHandler = NULL;
-	IMFMediaTypeHandler* pMediaType = NULL;
-	IMFMediaType*  pType;
-	DWORD nStream;
+	SafeRelease( &pState );
 
-	if FAILED( mSource->CreatePresentationDescriptor( &pDescriptor ) ) { goto done; }
+	if( FAILED( hr ) ) {
+		return hr;
+	}
 
-	if FAILED( pDescriptor->GetStreamDescriptorCount( &nStream ) ) { goto done; }
+	hr = pResolver->EndCreateObjectFromURL( pResult, &ObjectType, &pSourceUnk );
 
-	for( int i = 0; i < nStream; i++ ) {
-		BOOL selected;
-		GUID type;
+	if( SUCCEEDED( hr ) ) {
+		hr = pSourceUnk->QueryInterface( IID_PPV_ARGS( &pSource ) );
+	}
+
+	{
+		AutoLock lock( mResolveLock );
+
+		if( pResolver == mSegmentResolver ) {
+			mSegmentSource = pSource;
+			mSegmentResult = hr;
+			key = mResolvingKey;
+			pSource = NULL;
+		}
+	}
+
+	if( pSource ) {
+		// Stale: the playlist was closed or reopened while it resolved.
+		( void )pSource->Shutdown();
+		SafeRelease( &pSource );
+	}
+	else if( key != 0 ) {
+		PROPVARIANT varKey;
+		PropVariantInit( &varKey );
+		varKey.vt = VT_UI8;
+		varKey.uhVal.QuadPart = key;
+
+		if( SUCCEEDED( MFCreateMediaEvent( ME_PLAYLIST_CLIP_RESOLVED, GUID_NULL, S_OK, &varKey, &pEvent ) ) ) {
+			PostPlayerEvent( pEvent, ME_PLAYLIST_CLIP_RESOLVED );
+		}
+		else {
+			WMF_LOG_ERROR( L"Cannot post the resolved playlist clip\n" );
+		}
+	}
 
-		if FAILED( pDescriptor->GetStreamDescriptorByIndex( i, &selected, &pStreamHandler ) ) { goto done; }
+	SafeRelease( &pEvent );
+	SafeRelease( &pSourceUnk );
+	SafeRelease( &pResolver );
+	return S_OK;
+}
 
-		if FAILED( pStreamHandler->GetMediaTypeHandler( &pMediaType ) ) { goto done; }
+//  ME_PLAYLIST_CLIP_RESOLVED, on the owning thread: queues the clip if it is still the one that comes next,
+//  and switches to it if it is a skip's target. Otherwise the playlist changed while it resolved; the
+//  source is dropped and the clip that comes next now is resolved instead.
+HRESULT CPlayer::QueueResolvedSegment( UINT64 key )
+{
+	if( key != mResolvingKey ) {
+		// From a playlist that has been closed since; DetachPlaylist released its source.
+		return S_OK;
+	}
 
-		if FAILED( pMediaType->GetMajorType( &type ) ) { goto done; }
+	IMFMediaSource* pSource = NULL;
+	HRESULT hrResolve = S_OK;
 
-		if FAILED( pMediaType->GetCurrentMediaType( &pType ) ) { goto done; }
+	{
+		AutoLock lock( mResolveLock );
 
-		if( type == MFMediaType_Video ) {
-			UINT32 num = 0;
-			UINT32 denum = 1;
+		pSource = mSegmentSource;
+		mSegmentSource = NULL;
+		hrResolve = mSegmentResult;
+		SafeRelease( &mSegmentResolver );
+		mResolvingKey = 0;
+	}
 
-			MFGetAttributeRatio(
-			    pType,
-			    MF_MT_FRAME_RATE,
-			    &num,
-			    &denum
-			);
+	const size_t committed = mSegmentQueued ? 2 : 1;
+	const bool isSkip = ( key == mSkipKey );
+	UINT64 nextKey = 0;
+	HRESULT hr = S_OK;
+
+	if( !IsSequenced() || !NextSegmentKey( &nextKey ) || nextKey != key || mSegments.size() != committed ) {
+		if( pSource ) {
+			( void )pSource->Shutdown();
+		}
 
-			if( denum != 0 ) {
-				fps = ( float ) num / ( float ) denum;
-				mNumFrames = denum;
+		hr = IsSequenced() ? SyncPlaylist() : S_OK;
+	}
+	else {
+		hr = FAILED( hrResolve ) ? hrResolve : AppendSegment( key, pSource );
+
+		if( SUCCEEDED( hr ) ) {
+			hr = isSkip ? StartSkip() : SyncPlaylist();
+		}
+		else {
+			size_t index = 0;
+			mPlaylist.Find( key, &index );
+			CI_LOG_E( "Opening clip " << index << " of the playlist failed, hr=0x" << std::hex << hr );
+
+			if( isSkip ) {
+				// Carry on with the current clip.
+				mSkipKey = 0;
+				hr = SyncPlaylist();
+			}
+			else {
+				// Nothing can follow: end the session rather than wait.
+				hr = SetSegmentLast( mSegments.size() - 1, true );
 			}
 		}
+	}
+
+	if( FAILED( hr ) ) {
+		CI_LOG_E( "Queueing the next clip failed, hr=0x" << std::hex << hr );
+	}
+
+	SafeRelease( &pSource );
+	return hr;
+}
+
+//  MENewPresentation from the sequencer: its next clip is ready to be prerolled. Setting the topology while
+//  the session is running queues it; the session switches to it when the current clip ends.
+HRESULT CPlayer::QueuePlaylistPresentation( IMFPresentationDescriptor* pPD )
+{
+	IMFMediaSourceTopologyProvider* pProvider = NULL;
+	IMFTopology* pTopology = NULL;
+	MFSequencerElementId id = 0;
+
+	HRESULT hr = mSequencerSource->GetPresentationContext( pPD, &id, NULL );
+	CHECK_HR( hr );
 
-		SafeRelease( &pStreamHandler );
-		SafeRelease( &pMediaType );
-		SafeRelease( &pType );
+	hr = mSequencerSource->QueryInterface( IID_PPV_ARGS( &pProvider ) );
+	CHECK_HR( hr );
+
+	hr = pProvider->GetMediaSourceTopology( pPD, &pTopology );
+	CHECK_HR( hr );
+
+	hr = mSession->SetTopology( 0, pTopology );
+	CHECK_HR( hr );
 
-		if( fps != 0.0 ) { break; }  // we found the right stream, no point in continuing the loop
+	if( mSegments.size() > 1 && mSegments[1].id == id ) {
+		mSegmentQueued = true;
 	}
 
 done:
-	SafeRelease( &pDescriptor );
-	SafeRelease( &pStreamHandler );
-	SafeRelease( &pMediaType );
-	SafeRelease( &pType );
-	return fps;
+
+	if( FAILED( hr ) ) {
+		CI_LOG_E( "Queueing the next clip failed, hr=0x" << std::hex << hr );
+	}
+
+	SafeRelease( &pTopology );
+	SafeRelease( &pProvider );
+	return hr;
 }
 
-int CPlayer::getCurrentFrame()
+//  The session is playing the prerolled clip: retire the previous one and queue the one after.
+void CPlayer::AdvancePlaylist()
 {
-	int frame = 0;
+	mSegmentQueued = false;
+	RemoveSegment( 0 );
 
-	if( mSource == NULL ) {
-		return 0.0;
+	SetMediaInfo( mSegments[0].pPD );
+
+	if( mNextClipPending ) {
+		mClipOffset = mNextClipOffset;
+		mNextClipPending = false;
 	}
 
-	IMFPresentationDescriptor* pDescriptor = NULL;
-	IMFStreamDescriptor* pStreamHandler = NULL;
-	IMFMediaTypeHandler* pMediaType = NULL;
-	IMFMediaType*  pType;
-	DWORD nStream;
+	HRESULT hr = SyncPlaylist();
 
-	if FAILED( mSource->CreatePresentationDescriptor( &pDescriptor ) ) { goto done; }
+	if( FAILED( hr ) ) {
+		CI_LOG_E( "Queueing the clip after the current one failed, hr=0x" << std::hex << hr );
+	}
 
-	if FAILED( pDescriptor->GetStreamDescriptorCount( &nStream ) ) { goto done; }
+	size_t index = 0;
 
-	for( int i = 0; i < nStream; i++ ) {
-		BOOL selected;
-		GUID type;
+	if( mSingleClip ) {
+		// One pass of a gapless loop has given way to the next.
+		mPresentationEndedSignal.emit();
+	}
+	else if( mPlaylist.Find( mSegments[0].key, &index ) ) {
+		mClipChangedSignal.emit( index );
+	}
+}
 
-		if FAILED( pDescriptor->GetStreamDescriptorByIndex( i, &selected, &pStreamHandler ) ) { goto done; }
+//  A topology for one clip. Every clip renders to the same sinks, created with the first clip that needs
+//  them, so the session can switch clips without tearing the renderers down or rebinding the presenter.
+HRESULT CPlayer::CreatePlaylistTopology( IMFMediaSource* pSource, IMFPresentationDescriptor* pPD, IMFTopology** ppTopology )
+{
+	IMFTopology* pTopology = NULL;
+	DWORD cSourceStreams = 0;
+
+	HRESULT hr = MFCreateTopology( &pTopology );
+	CHECK_HR( hr );
 
-		if FAILED( pStreamHandler->GetMediaTypeHandler( &pMediaType ) ) { goto done; }
+	hr = pPD->GetStreamDescriptorCount( &cSourceStreams );
+	CHECK_HR( hr );
+
+	for( DWORD i = 0; i < cSourceStreams; i++ ) {
+		IMFStreamDescriptor* pSD = NULL;
+		IMFStreamSink* pStreamSink = NULL;
+		IMFTopologyNode* pSourceNode = NULL;
+		IMFTopologyNode* pOutputNode = NULL;
+		BOOL fSelected = FALSE;
 
-		if FAILED( pMediaType->GetMajorType( &type ) ) { goto done; }
+		hr = pPD->GetStreamDescriptorByIndex( i, &fSelected, &pSD );
 
-		if FAILED( pMediaType->GetCurrentMediaType( &pType ) ) { goto done; }
+		if( SUCCEEDED( hr ) && fSelected ) {
+			hr = GetPlaylistSink( pSD, &pStreamSink );
 
-		if( type == MFMediaType_Video ) {
-			UINT32 num = 0;
-			UINT32 denum = 1;
+			if( hr == MF_E_INVALIDMEDIATYPE ) {
+				// Neither audio nor video: leave it out.
+				hr = pPD->DeselectStream( i );
+			}
+			else {
+				if( SUCCEEDED( hr ) ) {
+					hr = AddSourceNode( pTopology, pSource, pPD, pSD, &pSourceNode );
+				}
 
-			MFGetAttributeRatio(
-			    pType,
-			    MF_MT_FRAME_RATE,
-			    &num,
-			    &denum
-			);
+				if( SUCCEEDED( hr ) ) {
+					hr = AddOutputNode( pTopology, pStreamSink, &pOutputNode );
+				}
 
-			if( denum != 0 ) {
-				frame = num;
-				mNumFrames = denum; //update things
+				if( SUCCEEDED( hr ) ) {
+					hr = pSourceNode->ConnectOutput( 0, pOutputNode, 0 );
+				}
 			}
 		}
 
-		SafeRelease( &pStreamHandler );
-		SafeRelease( &pMediaType );
-		SafeRelease( &pType );
+		SafeRelease( &pOutputNode );
+		SafeRelease( &pSourceNode );
+		SafeRelease( &pStreamSink );
+		SafeRelease( &pSD );
+		CHECK_HR( hr );
+	}
+
+	*ppTopology = pTopology;
+	( *ppTopology )->AddRef();
 
-		if( frame != 0 ) { break; }  // we found the right stream, no point in continuing the loop
+done:
+	SafeRelease( &pTopology );
+	return hr;
+}
+
+//  The playlist's stream sink for a stream, creating its renderer on first use: the EVR on the player's
+//  presenter, or the audio renderer on the device given to OpenPlaylist.
+HRESULT CPlayer::GetPlaylistSink( IMFStreamDescriptor* pSD, IMFStreamSink** ppStreamSink )
+{
+	IMFMediaTypeHandler* pHandler = NULL;
+	IMFActivate* pActivate = NULL;
+	IMFMediaSink* pSink = NULL;
+	GUID guidMajorType = GUID_NULL;
+
+	HRESULT hr = pSD->GetMediaTypeHandler( &pHandler );
+	CHECK_HR( hr );
+
+	hr = pHandler->GetMajorType( &guidMajorType );
+	CHECK_HR( hr );
+
+	if( guidMajorType == MFMediaType_Video ) {
+		if( mPlaylistVideoSink == NULL ) {
+			hr = CreateMediaSinkActivate( pSD, mHWNDVideo, &pActivate, mEVRPresenter, &mPlaylistVideoSink );
+			CHECK_HR( hr );
+		}
+
+		pSink = mPlaylistVideoSink;
 	}
+	else if( guidMajorType == MFMediaType_Audio ) {
+		if( mPlaylistAudioSink == NULL ) {
+			hr = CreateMediaSinkActivate( pSD, mHWNDVideo, &pActivate, mEVRPresenter, NULL, mPlaylistAudioDevice.c_str() );
+			CHECK_HR( hr );
+
+			hr = pActivate->ActivateObject( IID_PPV_ARGS( &mPlaylistAudioSink ) );
+			CHECK_HR( hr );
+		}
+
+		pSink = mPlaylistAudioSink;
+	}
+	else {
+		hr = MF_E_INVALIDMEDIATYPE;
+		goto done;
+	}
+
+	hr = pSink->GetStreamSinkByIndex( 0, ppStreamSink );
 
 done:
-	SafeRelease( &pDescriptor );
-	SafeRelease( &pStreamHandler );
-	SafeRelease( &pMediaType );
-	SafeRelease( &pType );
-	return frame;
+	SafeRelease( &pActivate );
+	SafeRelease( &pHandler );
+	return hr;
+}
+
+//  Moves the playlist's sources and sinks into pClosing, to be shut down once the session has closed, and
+//  empties the playlist.
+void CPlayer::DetachPlaylist( ClosingSession* pClosing )
+{
+	pClosing->pSession = NULL;
+	pClosing->pSource = NULL;
+	pClosing->hClosed = NULL;
+
+	for( size_t i = 0; i < mSegments.size(); i++ ) {
+		SafeRelease( &mSegments[i].pPD );
+		pClosing->segmentSources.push_back( mSegments[i].pSource );
+	}
+
+	if( mPlaylistVideoSink ) {
+		pClosing->sinks.push_back( mPlaylistVideoSink );
+		mPlaylistVideoSink = NULL;
+	}
+
+	if( mPlaylistAudioSink ) {
+		pClosing->sinks.push_back( mPlaylistAudioSink );
+		mPlaylistAudioSink = NULL;
+	}
+
+	// A clip still resolving is dropped; OnSegmentResolved shuts its source down.
+	{
+		AutoLock lock( mResolveLock );
+
+		if( mSegmentSource ) {
+			pClosing->segmentSources.push_back( mSegmentSource );
+			mSegmentSource = NULL;
+		}
+
+		SafeRelease( &mSegmentResolver );
+		mResolvingKey = 0;
+	}
+
+	mSegments.clear();
+	mSegmentQueued = false;
+	mSkipKey = 0;
+	mSingleClip = false;
+	mPlaylist.Clear();
+}
+
+void CPlayer::ShutdownPlaylist( ClosingSession* pClosing )
+{
+	for( size_t i = 0; i < pClosing->segmentSources.size(); i++ ) {
+		( void )pClosing->segmentSources[i]->Shutdown();
+		SafeRelease( &pClosing->segmentSources[i] );
+	}
+
+	for( size_t i = 0; i < pClosing->sinks.size(); i++ ) {
+		( void )pClosing->sinks[i]->Shutdown();
+		SafeRelease( &pClosing->sinks[i] );
+	}
+
+	pClosing->segmentSources.clear();
+	pClosing->sinks.clear();
+}
+
+///------------
+/// Extra functions
+//---------------
+
+float CPlayer::getDuration()
+{
+	return ( float )mDuration / 10000000.0;
+}
+
+float CPlayer::getPosition()
+{
+	if( mClock == NULL ) {
+		return 0.0;
+	}
+
+	MFTIME longPosition = 0;
+
+	if( FAILED( mClock->GetTime( &longPosition ) ) ) {
+		return 0.0;
+	}
+
+	return ( float )ClipTime( longPosition ) / 10000000.0;
+}
+
+//  One frame, in 100ns units; 30 fps if the frame rate is not known.
+LONGLONG CPlayer::GetFrameDuration() const
+{
+	if( mFrameRateNum == 0 ) {
+		return 333333;
+	}
+
+	return ( 10000000LL * mFrameRateDen ) / mFrameRateNum;
+}
+
+float CPlayer::getFrameRate()
+{
+	if( mFrameRateDen == 0 ) {
+		return 0.0;
+	}
+
+	return ( float )mFrameRateNum / ( float )mFrameRateDen;
+}
+
+void CPlayer::getFrameRate( UINT32* pNum, UINT32* pDen )
+{
+	*pNum = mFrameRateNum;
+	*pDen = mFrameRateDen;
+}
+
+int CPlayer::getCurrentFrame()
+{
+	if( mClock == NULL || mFrameRateNum == 0 ) {
+		return 0;
+	}
+
+	MFTIME longPosition = 0;
+
+	if( FAILED( mClock->GetTime( &longPosition ) ) ) {
+		return 0;
+	}
+
+	// frame = time * num / den, in 100ns units
+	return ( int )( ( ClipTime( longPosition ) * mFrameRateNum ) / ( 10000000LL * mFrameRateDen ) );
 }
 
+//  Caches the properties of the presentation that do not change while it
+//  plays, so the getters above never have to go back to the source.
 HRESULT CPlayer:: SetMediaInfo( IMFPresentationDescriptor* pPD )
 {
 	mWidth = 0;
 	mHeight = 0;
+	mDuration = 0;
+	mFrameRateNum = 0;
+	mFrameRateDen = 1;
+	mNumFrames = 0;
+	mStreamCount = 0;
+	mVideoStreamIndex = MAXDWORD;
+
 	HRESULT hr = S_OK;
 	GUID guidMajorType = GUID_NULL;
 	IMFMediaTypeHandler* pHandler = NULL;
 	IMFStreamDescriptor* spStreamDesc = NULL;
 	IMFMediaType* sourceType = NULL;
 
-	DWORD count;
+	UINT64 duration = 0;
+
+	if( SUCCEEDED( pPD->GetUINT64( MF_PD_DURATION, &duration ) ) ) {
+		mDuration = ( MFTIME )duration;
+	}
+
+	DWORD count = 0;
 	pPD->GetStreamDescriptorCount( &count );
+	mStreamCount = count;
 
 	for( DWORD i = 0; i < count; i++ ) {
 		BOOL selected;
@@ -1571,8 +2795,11 @@ HRESULT CPlayer:: SetMediaInfo( IMFPresentationDescriptor* pPD )
 			CHECK_HR( hr );
 
 			if( MFMediaType_Video == guidMajorType ) {
+				mVideoStreamIndex = i;
+
 				// first get the source video size and allocate a new texture
 				hr = pHandler->GetCurrentMediaType( &sourceType ) ;
+				CHECK_HR( hr );
 
 				UINT32 w, h;
 				hr = MFGetAttributeSize( sourceType, MF_MT_FRAME_SIZE, &w, &h );
@@ -1593,13 +2820,19 @@ HRESULT CPlayer:: SetMediaInfo( IMFPresentationDescriptor* pPD )
 				);
 
 				if( denum != 0 ) {
-					mNumFrames = denum;
+					mFrameRateNum = num;
+					mFrameRateDen = denum;
+					mNumFrames = ( int )( ( mDuration * num ) / ( 10000000LL * denum ) );
 				}
 
+				hr = S_OK;
 				goto done;
 			}
 
+			SafeRelease( &pHandler );
 		}
+
+		SafeRelease( &spStreamDesc );
 	}
 
 done:
@@ -1638,12 +2871,51 @@ HRESULT  CPlayer::SetPlaybackRate( BOOL bThin, float rateRequested )
 		hr = pRateControl->SetRate( bThin, rateRequested );
 	}
 
+	if( SUCCEEDED( hr ) ) {
+		mPlaybackRate = rateRequested;
+	}
+
 	// Clean up.
 	SAFE_RELEASE( pRateControl );
 
 	return hr;
 }
 
+HRESULT CPlayer::GetClockSample( ClockSample* pSample )
+{
+	if( mClock == NULL ) {
+		return MF_E_NOT_INITIALIZED;
+	}
+
+	LONGLONG clockTime = 0;
+	MFTIME systemTime = 0;
+
+	HRESULT hr = mClock->GetCorrelatedTime( 0, &clockTime, &systemTime );
+
+	if( SUCCEEDED( hr ) ) {
+		pSample->presentationTime = ClipTime( clockTime );
+		pSample->systemTime = systemTime;
+		pSample->rate = mPlaybackRate;
+	}
+
+	return hr;
+}
+
+void CPlayer::SetTimeSource( IMFPresentationTimeSource* pTimeSource )
+{
+	SafeRelease( &mTimeSource );
+	mTimeSource = pTimeSource;
+
+	if( mTimeSource ) {
+		mTimeSource->AddRef();
+	}
+
+	// A running clock cannot change time source; it gets it with the next movie.
+	if( mClock && mTimeSource && mState != STARTED ) {
+		( void )mClock->SetTimeSource( mTimeSource );
+	}
+}
+
 float  CPlayer::GetPlaybackRate()
 {
 	HRESULT hr = S_OK;
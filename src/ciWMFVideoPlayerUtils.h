@@ -46,6 +46,9 @@ const UINT WM_APP_PLAYER_EVENT = WM_APP + 1;
 
 // WPARAM = IMFMediaEvent*, WPARAM = MediaEventType
 
+// Posted like a session event once a playlist clip's source has resolved; the value is the clip's key.
+const MediaEventType ME_PLAYLIST_CLIP_RESOLVED = MEReservedMax + 1;
+
 enum PlayerState {
 	CLOSED = 0,			// No session.
 	READY,				// Session was created, ready to open a file.
@@ -62,6 +65,9 @@ const std::string& GetPlayerStateString( const PlayerState p );
 
 typedef cinder::signals::Signal<void()> PresentationEndedSignal;
 
+// Emitted when a playlist moves on to another clip, with the clip's index in the playlist.
+typedef cinder::signals::Signal<void( size_t )> ClipChangedSignal;
+
 class CPlayer : public IMFAsyncCallback
 {
 	public:
@@ -83,7 +89,11 @@ class CPlayer : public IMFAsyncCallback
 		// Playback
 		HRESULT OpenURL( const WCHAR* sURL, const WCHAR* audioDeviceId = 0 );
 
+		// The source is resolved on a Media Foundation thread, and the previous session is always closed
+		// on the reaper (this turns asynchronous teardown on). Call PollOpenURL on the owning thread until
+		// GetState() is OPEN_ASYNC_COMPLETE, then call EndOpenURL; CLOSED means resolving failed.
 		HRESULT	OpenURLAsync( const WCHAR* sURL );
+		void PollOpenURL();
 		HRESULT EndOpenURL( const WCHAR* audioDeviceId = 0 );
 
 		//Open multiple url in a same topology... Play with that of you want to do some video syncing
@@ -93,6 +103,21 @@ class CPlayer : public IMFAsyncCallback
 		HRESULT Stop();
 		HRESULT Shutdown();
 		HRESULT HandleEvent( UINT_PTR pUnkPtr );
+
+		// With no event window (hEvent NULL), session events are queued instead of posted;
+		// DrainEvents handles them on the calling thread. Returns how many were handled.
+		size_t DrainEvents();
+		bool UsesEventQueue() const { return mHWNDEvent == NULL; }
+
+		// Asynchronous teardown: CloseSession hands the session and source to a shared reaper thread
+		// instead of waiting for them to close, so a new session can be created at once. Topologies are
+		// only built once IsTearingDown() is false (EndOpenURL waits for it). Shutdown always waits.
+		void SetAsyncTeardown( bool enable );
+		bool IsAsyncTeardown() const { return mReaper != NULL; }
+		bool IsTearingDown() const { return mTeardownsPending > 0; }
+		void WaitForTeardown();
+		void GetTeardownStats( TeardownStats* pStats ) const;
+		void ResetTeardownStats();
 		HRESULT GetBufferProgress( DWORD* pProgress );
 		PlayerState GetState() const { return mState; }
 		BOOL HasVideo() const { return ( mVideoDisplay != NULL );  }
@@ -110,27 +135,85 @@ class CPlayer : public IMFAsyncCallback
 		HRESULT SetPlaybackRate( BOOL bThin, float rateRequested );
 		float GetPlaybackRate();
 
+		// Sync: the clock's time with the system time it was read at, and the time source the clock runs on.
+		// SetTimeSource applies to a clock that is not running, and to every movie opened after.
+		HRESULT GetClockSample( ClockSample* pSample );
+		void SetTimeSource( IMFPresentationTimeSource* pTimeSource );
+		MFTIME GetDurationHns() const { return mDuration; }
+
 		float getWidth() { return mWidth; }
 		float getHeight() { return mHeight; }
 
 		HRESULT setPosition( float pos );
 
+		// Frame-accurate seeking, in 100ns units or frames. The source starts decoding at the keyframe
+		// before the target, and the presenter drops the frames up to the target instead of showing
+		// them, so the first frame on screen is the target frame. A playing player goes on playing from
+		// there; a paused or stopped one is left paused on it. A source that seeks to the nearest keyframe
+		// can start after the target instead; the seek stats count those as overshot. Not supported in
+		// playlists or gapless loops. The first seek in a file queues a keyframe index of it on a
+		// background thread (see SetKeyframeIndexing); the index only feeds the seek stats, the seek
+		// does not wait for it or start from it.
+		HRESULT SeekToTime( MFTIME hnsTarget );
+		HRESULT SeekToFrame( LONGLONG frame );
+		bool IsSeekPending() const;
+		MFTIME GetPositionHns();
+
+		// Index keyframes as soon as a file is opened instead of on the first seek.
+		void SetKeyframeIndexing( bool enable ) { mIndexKeyframes = enable; }
+		bool IsKeyframeIndexing() const { return mIndexKeyframes; }
+		// The open file's index, or NULL until it has been built.
+		std::shared_ptr<const KeyframeIndex> GetKeyframeIndex();
+
 		bool isLooping() { return mIsLooping; }
-		void setLooping( bool isLooping ) { mIsLooping = isLooping; }
+		void setLooping( bool isLooping );
+
+		// Gapless looping: instead of a Stop/Play round trip after the end of the presentation has been
+		// handled, the file is opened as a one-clip playlist on the sequencer source, which prerolls the
+		// next pass while the current one plays and switches to it without a gap or a skipped frame.
+		// The presentation ended signal fires as each pass gives way to the next. Takes effect with the
+		// next OpenURL or EndOpenURL. Frame-accurate seeks are not supported on such a clip.
+		void setGaplessLooping( bool enable ) { mGaplessLoop = enable; }
+		bool isGaplessLooping() const { return mGaplessLoop; }
+		LONGLONG GetFrameDuration() const;
 
 		HRESULT setVolume( float vol );
 		float getVolume() { return mCurrentVolume; }
 
 		float getFrameRate();
+		void getFrameRate( UINT32* pNum, UINT32* pDen );
 		int getCurrentFrame();
 		int getTotalNumFrames() { return mNumFrames; }
 
+		DWORD getStreamCount() const { return mStreamCount; }
+		DWORD getVideoStreamIndex() const { return mVideoStreamIndex; }
+
 		void firstFrame() { setPosition( 0 ); }
 		// void nextFrame();
 		// void previousFrame();
 
 		PresentationEndedSignal& getPresentationEndedSignal() { return mPresentationEndedSignal; }
 
+		// Playlist on the sequencer source. The clip that is playing and the next one are queued on the
+		// sequencer; the session prerolls the next before the current one ends and switches without a
+		// gap, in the same session, through the same renderers. Clips can be added and removed while
+		// playing, except the current one and one that is already prerolling: those stay as they are,
+		// and an insert between them goes after the prerolling one. Only OpenPlaylist resolves a source
+		// on the calling thread, the first clip's; every clip after it is resolved on a Media Foundation
+		// thread and queued when the owning thread handles the completion, so clip changes and edits never
+		// wait on a file open. With looping, the playlist starts over after the last clip; otherwise the
+		// session ends there. PlaylistSkipTo switches once the target's source has resolved.
+		HRESULT OpenPlaylist( const std::vector<std::wstring>& urls, const WCHAR* audioDeviceId = 0 );
+		HRESULT PlaylistInsert( size_t index, const WCHAR* url );
+		HRESULT PlaylistAppend( const WCHAR* url ) { return PlaylistInsert( mPlaylist.Size(), url ); }
+		HRESULT PlaylistRemove( size_t index );
+		HRESULT PlaylistSkipTo( size_t index );
+		bool IsPlaylist() const { return !mSegments.empty() && !mSingleClip; }
+		size_t GetPlaylistSize() const { return mPlaylist.Size(); }
+		const std::wstring& GetPlaylistUrl( size_t index ) const { return mPlaylist.At( index ).url; }
+		bool GetPlaylistIndex( size_t* pIndex ) const;
+		ClipChangedSignal& getClipChangedSignal() { return mClipChangedSignal; }
+
 	protected:
 
 		// Constructor is private. Use static CreateInstance method to instantiate.
@@ -145,11 +228,57 @@ class CPlayer : public IMFAsyncCallback
 		HRESULT StartPlayback();
 
 		HRESULT SetMediaInfo( IMFPresentationDescriptor* pPD );
+		void DiscardEvents();
+		MFTIME ClipTime( MFTIME presentationTime ) const;
+
+		struct ClosingSession {
+			IMFMediaSession* pSession;
+			IMFMediaSource* pSource;
+			HANDLE hClosed;	// Signaled on the session's MESessionClosed.
+
+			// A playlist's clip sources and shared sinks; the session does not shut them down.
+			std::vector<IMFMediaSource*> segmentSources;
+			std::vector<IMFMediaSink*> sinks;
+		};
+
+		// One playlist clip queued on the sequencer source.
+		struct PlaylistSegment {
+			MFSequencerElementId id;
+			UINT64 key;	// PlaylistOrder key of the clip.
+			IMFMediaSource* pSource;
+			IMFPresentationDescriptor* pPD;
+			bool last;	// Appended with SequencerTopologyFlags_Last.
+		};
+
+		bool IsSequenced() const { return !mSegments.empty(); }
+		HRESULT StartPlaylist( const WCHAR* audioDeviceId, IMFMediaSource* pFirstSource );
+		HRESULT AppendSegment( UINT64 key, IMFMediaSource* pSource = NULL );
+		bool NextSegmentKey( UINT64* pKey ) const;
+		HRESULT ResolveSegment( UINT64 key );
+		HRESULT OnSegmentResolved( IMFAsyncResult* pResult );
+		HRESULT QueueResolvedSegment( UINT64 key );
+		HRESULT StartSkip();
+		void PostPlayerEvent( IMFMediaEvent* pEvent, MediaEventType meType );
+		void RemoveSegment( size_t index );
+		HRESULT SetSegmentLast( size_t index, bool last );
+		HRESULT SyncPlaylist();
+		HRESULT QueuePlaylistPresentation( IMFPresentationDescriptor* pPD );
+		void AdvancePlaylist();
+		HRESULT CreatePlaylistTopology( IMFMediaSource* pSource, IMFPresentationDescriptor* pPD, IMFTopology** ppTopology );
+		HRESULT GetPlaylistSink( IMFStreamDescriptor* pSD, IMFStreamSink** ppStreamSink );
+		void DetachPlaylist( ClosingSession* pClosing );
+		static void ShutdownPlaylist( ClosingSession* pClosing );
+
+		HRESULT CloseSessionAsync( ClosingSession* pPlaylist );
+		void ReapSession( ClosingSession closing );
+		HRESULT OnClosingSessionEvent( IMFMediaSession* pSession, IMFAsyncResult* pResult );
+		HRESULT OnSourceResolved( IMFAsyncResult* pResult );
 
 		// Media event handlers
 		virtual HRESULT OnTopologyStatus( IMFMediaEvent* pEvent );
 		virtual HRESULT OnPresentationEnded( IMFMediaEvent* pEvent );
 		virtual HRESULT OnNewPresentation( IMFMediaEvent* pEvent );
+		HRESULT OnPresentationTime( IMFMediaEvent* pEvent );
 
 		// Override to handle additional session events.
 		virtual HRESULT OnSessionEvent( IMFMediaEvent*, MediaEventType )
@@ -162,18 +291,63 @@ class CPlayer : public IMFAsyncCallback
 
 		IMFSequencerSource* mSequencerSource;
 		IMFSourceResolver* mSourceResolver;
+		CritSec mResolveLock;	// Protects mSourceResolver, the resolve result below and the playlist's resolve.
+		IMFMediaSource* mResolvedSource;	// Set by OnSourceResolved, taken by PollOpenURL.
+		HRESULT mResolveResult;
+		bool mResolveDone;
 		IMFMediaSource* mSource;
 		IMFVideoDisplayControl* mVideoDisplay;
 		MFSequencerElementId mPreviousTopoID;
 		HWND mHWNDVideo;	// Video window.
-		HWND mHWNDEvent;	// App window to receive events.
+		HWND mHWNDEvent;	// App window to receive events, or NULL to queue them.
+		PlayerEventQueue mEventQueue;	// Events for DrainEvents, when mHWNDEvent is NULL.
 		PlayerState mState;	// Current state of the media session.
 		HANDLE mCloseEvent;	// Event to wait on while closing.
 		PresentationEndedSignal mPresentationEndedSignal; // Signal when presentation ends
 		IMFAudioStreamVolume* mVolumeControl;
 
 		bool mIsLooping;
+		bool mGaplessLoop;
+
+		// Playlist; see OpenPlaylist. mSegments[0] is the current clip.
+		PlaylistOrder mPlaylist;
+		std::vector<PlaylistSegment> mSegments;
+		bool mSegmentQueued;	// mSegments[1] is set on the session and prerolling.
+		IMFMediaSink* mPlaylistVideoSink;
+		IMFMediaSink* mPlaylistAudioSink;
+		std::wstring mPlaylistAudioDevice;
+		ClipChangedSignal mClipChangedSignal;
+		bool mSingleClip;	// The sequencer holds one file, opened with gapless looping; not a playlist.
+		UINT64 mSkipKey;	// PlaylistSkipTo's target while its source resolves, or 0.
+
+		// The clip after the committed ones, resolving on a Media Foundation thread: one at a time, the
+		// resolver passing itself as the state object so a stale completion can be told apart.
+		AsyncCallback<CPlayer> mSegmentResolvedCB;
+		UINT64 mResolvingKey;	// 0 if none. Written on the owning thread under mResolveLock.
+		IMFSourceResolver* mSegmentResolver;
+		IMFMediaSource* mSegmentSource;	// Set by OnSegmentResolved, taken by QueueResolvedSegment.
+		HRESULT mSegmentResult;
+
+		// Presentation time is continuous across sequenced clips; each clip's samples are offset by the
+		// time it started at. See OnPresentationTime.
+		MFTIME mClipOffset;
+		MFTIME mNextClipStart;	// When the next clip takes over, once the session has announced it.
+		MFTIME mNextClipOffset;
+		bool mNextClipPending;
+
+		// Frame-accurate seeking; see SeekToTime.
+		std::wstring mUrl;	// The open file; empty for playlists.
+		bool mIndexKeyframes;
+		KeyframeIndexService* mKeyframeIndexes;	// Acquired on first use.
+
+		// Cached by SetMediaInfo and OnTopologyStatus; see the getters.
+		IMFPresentationClock* mClock;
+		MFTIME mDuration;
+		UINT32 mFrameRateNum;
+		UINT32 mFrameRateDen;
 		int mNumFrames;
+		DWORD mStreamCount;
+		DWORD mVideoStreamIndex;
 
 	public:
 		EVRCustomPresenter*	mEVRPresenter; // Custom EVR for texture sharing
@@ -186,6 +360,16 @@ class CPlayer : public IMFAsyncCallback
 		int mWidth;
 		int mHeight;
 		float mCurrentVolume;
+		float mPlaybackRate;	// Last rate set with SetPlaybackRate.
+		IMFPresentationTimeSource* mTimeSource;	// See SetTimeSource.
+
+		// Asynchronous teardown; see SetAsyncTeardown.
+		TeardownReaper* mReaper;
+		CritSec mClosingLock;	// Protects mClosingSessions.
+		std::vector<ClosingSession> mClosingSessions;
+		volatile LONG mTeardownsPending;
+		HANDLE mTeardownDone;	// Signaled while mTeardownsPending is 0.
+		TimingHistogram mCloseBlocking;	// Time CloseSession held up the caller, 100ns units.
 };
 
 #endif PLAYER_H
@@ -0,0 +1,206 @@
+#include "ciWMFVideoSyncGroup.h"
+
+#include "cinder/Log.h"
+
+#include <math.h>
+
+ciWMFVideoSyncGroup::ciWMFVideoSyncGroup( const SyncTuning& tuning )
+	: mTimeSource( NULL )
+	, mTuning( tuning )
+{
+	HRESULT hr = MFCreateSystemTimeSource( &mTimeSource );
+
+	if( FAILED( hr ) ) {
+		CI_LOG_E( "Creating the sync group's time source failed, hr=0x" << std::hex << hr );
+	}
+}
+
+ciWMFVideoSyncGroup::~ciWMFVideoSyncGroup()
+{
+	while( !mMembers.empty() ) {
+		remove( mMembers.back()->player );
+	}
+
+	SafeRelease( &mTimeSource );
+}
+
+void ciWMFVideoSyncGroup::add( ciWMFVideoPlayer* player )
+{
+	for( size_t i = 0; i < mMembers.size(); i++ ) {
+		if( mMembers[i]->player == player ) {
+			return;
+		}
+	}
+
+	if( player->mPlayer && mTimeSource ) {
+		player->mPlayer->SetTimeSource( mTimeSource );
+	}
+
+	mMembers.push_back( std::unique_ptr<Member>( new Member( player, mTuning ) ) );
+}
+
+void ciWMFVideoSyncGroup::remove( ciWMFVideoPlayer* player )
+{
+	for( size_t i = 0; i < mMembers.size(); i++ ) {
+		if( mMembers[i]->player != player ) {
+			continue;
+		}
+
+		if( player->mPlayer ) {
+			player->mPlayer->SetTimeSource( NULL );
+
+			if( mMembers[i]->controller.Nudge() != 0.0 ) {
+				player->mPlayer->SetPlaybackRate( FALSE, 1.0f );
+			}
+		}
+
+		mMembers.erase( mMembers.begin() + i );
+		return;
+	}
+}
+
+void ciWMFVideoSyncGroup::play()
+{
+	for( size_t i = 0; i < mMembers.size(); i++ ) {
+		mMembers[i]->player->play();
+	}
+
+	settle();
+}
+
+void ciWMFVideoSyncGroup::pause()
+{
+	for( size_t i = 0; i < mMembers.size(); i++ ) {
+		mMembers[i]->player->pause();
+	}
+
+	settle();
+}
+
+void ciWMFVideoSyncGroup::stop()
+{
+	for( size_t i = 0; i < mMembers.size(); i++ ) {
+		mMembers[i]->player->stop();
+	}
+
+	settle();
+}
+
+void ciWMFVideoSyncGroup::setPosition( float pos )
+{
+	for( size_t i = 0; i < mMembers.size(); i++ ) {
+		mMembers[i]->player->setPosition( pos );
+	}
+
+	settle();
+}
+
+void ciWMFVideoSyncGroup::settle()
+{
+	MFTIME now = MFGetSystemTime();
+
+	for( size_t i = 0; i < mMembers.size(); i++ ) {
+		Member& member = *mMembers[i];
+
+		if( member.controller.Nudge() != 0.0 && member.player->mPlayer ) {
+			member.player->mPlayer->SetPlaybackRate( FALSE, 1.0f );
+		}
+
+		member.controller.Settle( now );
+	}
+}
+
+void ciWMFVideoSyncGroup::update()
+{
+	if( mMembers.size() < 2 ) {
+		return;
+	}
+
+	CPlayer* leader = mMembers[0]->player->mPlayer;
+	ClockSample reference;
+
+	if( !leader || leader->GetState() != STARTED || FAILED( leader->GetClockSample( &reference ) ) ) {
+		return;
+	}
+
+	MFTIME now = MFGetSystemTime();
+
+	for( size_t i = 1; i < mMembers.size(); i++ ) {
+		Member& member = *mMembers[i];
+		CPlayer* player = member.player->mPlayer;
+		ClockSample sample;
+
+		if( !player || player->GetState() != STARTED || FAILED( player->GetClockSample( &sample ) ) ) {
+			continue;
+		}
+
+		int64_t skew = PlaybackSync::Skew( sample, reference );
+
+		// A looping follower that wrapped round just before or after the leader is only slightly off.
+		if( member.player->isLooping() ) {
+			skew = PlaybackSync::WrapSkew( skew, player->GetDurationHns() );
+		}
+
+		member.skew = skew;
+
+		SyncCorrection correction = member.controller.Update( skew, now );
+		HRESULT hr = S_OK;
+
+		if( correction.action == SyncNudge ) {
+			hr = player->SetPlaybackRate( FALSE, ( float )( reference.rate * ( 1.0 + correction.nudge ) ) );
+		}
+		else if( correction.action == SyncSeek ) {
+			// Where the leader is now; the controller ignores the error while the seek settles.
+			MFTIME target = reference.presentationTime + ( MFTIME )( ( now - reference.systemTime ) * reference.rate );
+
+			hr = player->SetPlaybackRate( FALSE, ( float )reference.rate );
+			player->setPosition( ( float )( target / 10000000.0 ) );
+		}
+
+		if( FAILED( hr ) ) {
+			// The player kept its rate: the controller must not build on a nudge that was never applied.
+			CI_LOG_W( "Setting sync group member " << i << "'s rate failed, hr=0x" << std::hex << hr );
+			member.controller.Settle( now );
+		}
+	}
+}
+
+float ciWMFVideoSyncGroup::getSkewFrames( size_t index ) const
+{
+	CPlayer* player = mMembers[index]->player->mPlayer;
+
+	if( !player ) {
+		return 0.0f;
+	}
+
+	return ( float )mMembers[index]->skew / ( float )player->GetFrameDuration();
+}
+
+float ciWMFVideoSyncGroup::getMaxSkewFrames() const
+{
+	float maxSkew = 0.0f;
+
+	for( size_t i = 1; i < mMembers.size(); i++ ) {
+		float skew = fabsf( getSkewFrames( i ) );
+
+		if( skew > maxSkew ) {
+			maxSkew = skew;
+		}
+	}
+
+	return maxSkew;
+}
+
+SyncStats ciWMFVideoSyncGroup::getStats( size_t index ) const
+{
+	SyncStats stats;
+	mMembers[index]->controller.GetStats( &stats );
+	return stats;
+}
+
+void ciWMFVideoSyncGroup::resetStats()
+{
+	for( size_t i = 0; i < mMembers.size(); i++ ) {
+		mMembers[i]->controller.ResetStats();
+	}
+}
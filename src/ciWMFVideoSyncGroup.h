@@ -0,0 +1,56 @@
+#pragma once
+
+#include "ciWMFVideoPlayer.h"
+
+#include <memory>
+#include <vector>
+
+// Keeps several players in this process frame-locked: their clocks run on one shared time source, they start,
+// pause and seek together, and every update() measures each follower's skew against the leader (the first
+// player added) and removes it, with rate nudges of a fraction of a percent, or a seek if it is far out.
+class ciWMFVideoSyncGroup
+{
+	public:
+		ciWMFVideoSyncGroup( const SyncTuning& tuning = SyncTuning() );
+		~ciWMFVideoSyncGroup();
+
+		// Players must outlive the group, or be removed first. Add them before loading: a clock that is already
+		// running keeps its own time source until the next movie.
+		void add( ciWMFVideoPlayer* player );
+		void remove( ciWMFVideoPlayer* player );
+		size_t size() const { return mMembers.size(); }
+
+		void play();
+		void pause();
+		void stop();
+		void setPosition( float pos );
+
+		// Measures and corrects. Call once per frame, after the players' update().
+		void update();
+
+		// A player's skew against the leader at the last update(), positive when ahead; 0 for the leader.
+		int64_t getSkew( size_t index ) const { return mMembers[index]->skew; }
+		float getSkewFrames( size_t index ) const;
+		// The largest skew in the group, in frames.
+		float getMaxSkewFrames() const;
+
+		// Corrections made for a player, and the size of its skew over time.
+		SyncStats getStats( size_t index ) const;
+		void resetStats();
+
+	private:
+		struct Member {
+			Member( ciWMFVideoPlayer* player, const SyncTuning& tuning ) : player( player ), controller( tuning ), skew( 0 ) {}
+
+			ciWMFVideoPlayer* player;
+			PlaybackSyncController controller;
+			int64_t skew;
+		};
+
+		// After the group moved the players itself: back to the nominal rate, and let them settle.
+		void settle();
+
+		std::vector<std::unique_ptr<Member> > mMembers;
+		IMFPresentationTimeSource* mTimeSource;
+		SyncTuning mTuning;
+};
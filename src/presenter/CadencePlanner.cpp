@@ -0,0 +1,217 @@
+//////////////////////////////////////////////////////////////////////////
+//
+// CadencePlanner.cpp: Maps video frames onto display refresh ticks.
+//
+//////////////////////////////////////////////////////////////////////////
+
+#include "CadencePlanner.h"
+
+#include <cmath>
+
+// Integer division that rounds toward negative infinity.
+static int64_t FloorDiv(int64_t a, int64_t b)
+{
+    int64_t q = a / b;
+    if ((a % b != 0) && ((a < 0) != (b < 0)))
+    {
+        q--;
+    }
+    return q;
+}
+
+//-----------------------------------------------------------------------------
+// Constructor
+//-----------------------------------------------------------------------------
+
+CadencePlanner::CadencePlanner() :
+    m_hnsFrame(0),
+    m_Refresh(0),
+    m_TicksPerCycle(0),
+    m_FramesPerCycle(0),
+    m_bAnchored(false),
+    m_hnsAnchor(0),
+    m_AnchorTick(0),
+    m_AnchorPhase(0),
+    m_bHasVblank(false),
+    m_hnsVblank(0)
+{
+}
+
+//-----------------------------------------------------------------------------
+// Configure
+//-----------------------------------------------------------------------------
+
+bool CadencePlanner::Configure(int64_t hnsFrame, double hnsRefresh)
+{
+    m_hnsFrame = hnsFrame;
+    m_Refresh = hnsRefresh;
+    m_TicksPerCycle = 0;
+    m_FramesPerCycle = 0;
+    m_bAnchored = false;
+
+    if (hnsFrame <= 0 || hnsRefresh <= 0)
+    {
+        return false;
+    }
+
+    double ratio = (double)hnsFrame / hnsRefresh;
+
+    if (!ApproximateRatio(ratio, CADENCE_MAX_PATTERN_FRAMES, CADENCE_RATIO_TOLERANCE, &m_TicksPerCycle, &m_FramesPerCycle))
+    {
+        m_TicksPerCycle = 0;
+        m_FramesPerCycle = 0;
+        return false;
+    }
+
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+// ApproximateRatio
+//
+// Tries each denominator in turn, so the first match is the shortest
+// pattern. Frames faster than the refresh (p < q) have no useful pattern.
+//-----------------------------------------------------------------------------
+
+bool CadencePlanner::ApproximateRatio(double ratio, int maxFrames, double tolerance, int *pTicks, int *pFrames)
+{
+    if (ratio <= 0)
+    {
+        return false;
+    }
+
+    for (int q = 1; q <= maxFrames; q++)
+    {
+        int p = (int)std::floor(ratio * q + 0.5);
+
+        if (p < q)
+        {
+            // More than one frame per tick. Cadence planning does not apply.
+            continue;
+        }
+
+        if (std::fabs((double)p / q - ratio) <= tolerance * ratio)
+        {
+            *pTicks = p;
+            *pFrames = q;
+            return true;
+        }
+    }
+    return false;
+}
+
+//-----------------------------------------------------------------------------
+// BuildPattern
+// Frame n of a p/q cycle holds ceil((n+1)p/q) - ceil(np/q) ticks.
+//-----------------------------------------------------------------------------
+
+void CadencePlanner::BuildPattern(int ticks, int frames, std::vector<int> *pPattern)
+{
+    pPattern->clear();
+
+    for (int n = 0; n < frames; n++)
+    {
+        pPattern->push_back((int)(-FloorDiv(-(int64_t)(n + 1) * ticks, frames) + FloorDiv(-(int64_t)n * ticks, frames)));
+    }
+}
+
+//-----------------------------------------------------------------------------
+// TickForFrame
+// ceil(n * p / q).
+//-----------------------------------------------------------------------------
+
+int64_t CadencePlanner::TickForFrame(int64_t n) const
+{
+    if (m_FramesPerCycle == 0)
+    {
+        return 0;
+    }
+    return -FloorDiv(-n * m_TicksPerCycle, m_FramesPerCycle);
+}
+
+//-----------------------------------------------------------------------------
+// Anchor
+//
+// Makes the given sample frame 0. It is shown on the measured blank nearest
+// its time stamp, or at its time stamp if no blank has been measured.
+//-----------------------------------------------------------------------------
+
+void CadencePlanner::Anchor(int64_t hnsSampleTime)
+{
+    m_hnsAnchor = hnsSampleTime;
+    m_AnchorTick = (double)hnsSampleTime;
+
+    if (m_bHasVblank)
+    {
+        m_AnchorTick -= VblankOffset(m_AnchorTick);
+    }
+
+    m_AnchorPhase = m_AnchorTick - (double)hnsSampleTime;
+    m_bAnchored = true;
+}
+
+//-----------------------------------------------------------------------------
+// VblankOffset
+// Time minus the nearest measured blank: within half a tick either way.
+//-----------------------------------------------------------------------------
+
+double CadencePlanner::VblankOffset(double time) const
+{
+    double ticks = (time - (double)m_hnsVblank) / m_Refresh;
+
+    return (ticks - std::floor(ticks + 0.5)) * m_Refresh;
+}
+
+//-----------------------------------------------------------------------------
+// FrameIndex
+// Nearest frame number to the sample time, relative to the anchor.
+//-----------------------------------------------------------------------------
+
+int64_t CadencePlanner::FrameIndex(int64_t hnsSampleTime) const
+{
+    return FloorDiv(hnsSampleTime - m_hnsAnchor + m_hnsFrame / 2, m_hnsFrame);
+}
+
+//-----------------------------------------------------------------------------
+// PlanSample
+//-----------------------------------------------------------------------------
+
+int64_t CadencePlanner::PlanSample(int64_t hnsSampleTime, bool *pbResync)
+{
+    *pbResync = false;
+
+    if (!IsConfigured())
+    {
+        return hnsSampleTime;
+    }
+
+    if (!m_bAnchored)
+    {
+        Anchor(hnsSampleTime);
+    }
+
+    double target = m_AnchorTick + (double)TickForFrame(FrameIndex(hnsSampleTime)) * m_Refresh;
+
+    // Follow the display: move the whole grid onto the measured blanks.
+    if (m_bHasVblank)
+    {
+        double offset = VblankOffset(target);
+
+        m_AnchorTick -= offset;
+        target -= offset;
+    }
+
+    // The pulldown itself moves a frame by less than one tick from where
+    // the anchor's phase puts it. Anything more is drift: the pattern only
+    // approximates the true ratio, or the clocks have moved apart.
+    double drift = target - (double)hnsSampleTime - m_AnchorPhase;
+
+    if (drift > m_Refresh || drift < -m_Refresh)
+    {
+        Anchor(hnsSampleTime);
+        target = m_AnchorTick;
+        *pbResync = true;
+    }
+
+    return (int64_t)std::floor(target + 0.5);
+}
@@ -0,0 +1,137 @@
+//////////////////////////////////////////////////////////////////////////
+//
+// CadencePlanner.h: Maps video frames onto display refresh ticks.
+//
+// This file and CadencePlanner.cpp have no Windows or Media Foundation
+// dependencies, so the planner can be exercised with synthetic rates.
+//
+//////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+#include "common/TimingHistogram.h"
+
+// Longest repeat pattern the planner will use, in frames. 24p on 60 Hz is
+// 2 frames (3:2), 25p on 60 Hz is 5 frames (3:2:3:2:2).
+const int CADENCE_MAX_PATTERN_FRAMES = 12;
+
+// How far (relative) the chosen pattern may be from the true ratio of the
+// frame interval to the refresh interval. Covers 23.976p on a display that
+// reports 60 Hz.
+const double CADENCE_RATIO_TOLERANCE = 0.005;
+
+
+//-----------------------------------------------------------------------------
+// CadenceStats
+//
+// Snapshot of the cadence metrics. Times are in 100ns units.
+//-----------------------------------------------------------------------------
+
+struct CadenceStats
+{
+    CadenceStats() : patternTicks(0), patternFrames(0), breaks(0), resyncs(0)
+    {
+    }
+
+    int                 patternTicks;   // Refresh ticks per pattern cycle.
+    int                 patternFrames;  // Frames per pattern cycle. 0 if no plan.
+    std::vector<int>    pattern;        // Ticks held by each frame of the cycle.
+
+    // Per frame: (actual interval since the previous frame) minus (planned interval).
+    MediaFoundationSamples::HistogramSnapshot error;
+
+    uint64_t            breaks;         // Frames whose error exceeded half a tick.
+    uint64_t            resyncs;        // Times the plan was re-anchored.
+};
+
+
+//-----------------------------------------------------------------------------
+// CadencePlanner class
+//
+// Chooses a repeat pattern of refresh ticks per frame (p ticks for every q
+// frames) and maps each sample time to the refresh tick on which the frame
+// should first be shown. Frame n starts on tick ceil(n * p / q), counted from
+// the anchor sample, which gives 3:2 for 24p on 60 Hz and 2:2 for 25p on
+// 50 Hz.
+//
+// The refresh period is fractional (59.94 Hz is 166833.3 units), so the
+// grid does not drift from the display by a third of a unit per tick.
+//
+// The tick grid is phase-locked to the display. SetVblank gives the
+// presentation time of a measured vertical blank; the anchor sample is
+// shown on the blank nearest its time stamp, and every later target is
+// pulled onto the nearest measured blank, so the grid follows the display
+// even if the presentation clock and the display clock drift apart.
+// Without a measurement the grid starts at the anchor sample's time.
+//
+// If the plan drifts more than one tick from the sample time stamps (the
+// pattern is an approximation, or the clocks drift), the planner re-anchors
+// on the blank nearest the current sample.
+//-----------------------------------------------------------------------------
+
+class CadencePlanner
+{
+public:
+    CadencePlanner();
+
+    // Sets the frame and refresh intervals, in 100ns units, and clears the
+    // anchor. Returns false (and clears the plan) if either is not positive.
+    bool Configure(int64_t hnsFrame, double hnsRefresh);
+
+    bool IsConfigured() const { return m_FramesPerCycle > 0; }
+
+    int64_t FrameInterval() const { return m_hnsFrame; }
+    int64_t RefreshInterval() const { return (int64_t)(m_Refresh + 0.5); }
+    double RefreshPeriod() const { return m_Refresh; }
+    int TicksPerCycle() const { return m_TicksPerCycle; }
+    int FramesPerCycle() const { return m_FramesPerCycle; }
+
+    // Ticks held by each frame of one cycle, starting with frame 0.
+    void GetPattern(std::vector<int> *pPattern) const { BuildPattern(m_TicksPerCycle, m_FramesPerCycle, pPattern); }
+    static void BuildPattern(int ticks, int frames, std::vector<int> *pPattern);
+
+    // First tick of frame n, relative to the anchor frame. n can be negative.
+    int64_t TickForFrame(int64_t n) const;
+
+    // Number of ticks frame n is held for.
+    int RepeatCount(int64_t n) const { return (int)(TickForFrame(n + 1) - TickForFrame(n)); }
+
+    void Reset() { m_bAnchored = false; }
+    bool IsAnchored() const { return m_bAnchored; }
+    void Anchor(int64_t hnsSampleTime);
+
+    // Presentation time of a measured vertical blank. Any recent blank will
+    // do; the grid only needs its phase.
+    void SetVblank(int64_t hnsVblank) { m_hnsVblank = hnsVblank; m_bHasVblank = true; }
+    void ClearVblank() { m_bHasVblank = false; }
+    bool HasVblank() const { return m_bHasVblank; }
+
+    // Returns the presentation time of the tick on which the sample should
+    // first be shown. Anchors on the first call after Reset, and re-anchors
+    // if the plan has drifted; *pbResync is set to true when that happens.
+    int64_t PlanSample(int64_t hnsSampleTime, bool *pbResync);
+
+    // Finds the fraction p/q, q <= maxFrames, closest to ratio within the
+    // relative tolerance, preferring the smallest q. Returns false if none.
+    static bool ApproximateRatio(double ratio, int maxFrames, double tolerance, int *pTicks, int *pFrames);
+
+private:
+    int64_t FrameIndex(int64_t hnsSampleTime) const;
+    double VblankOffset(double time) const;
+
+    int64_t     m_hnsFrame;
+    double      m_Refresh;
+    int         m_TicksPerCycle;        // p
+    int         m_FramesPerCycle;       // q
+
+    bool        m_bAnchored;
+    int64_t     m_hnsAnchor;            // Sample time of frame 0.
+    double      m_AnchorTick;           // Presentation time of frame 0's tick.
+    double      m_AnchorPhase;          // m_AnchorTick - m_hnsAnchor when anchored.
+
+    bool        m_bHasVblank;
+    int64_t     m_hnsVblank;            // Latest measured blank.
+};
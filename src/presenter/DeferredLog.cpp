@@ -0,0 +1,490 @@
+//////////////////////////////////////////////////////////////////////////
+//
+// DeferredLog.cpp: Logging that defers formatting to a background thread.
+//
+//////////////////////////////////////////////////////////////////////////
+
+#include "DeferredLog.h"
+#include "common/MpscRing.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <stdio.h>
+#include <thread>
+#include <type_traits>
+#include <wchar.h>
+
+using namespace MediaFoundationSamples;
+
+// Visual C++ 2013 has no thread_local.
+#if defined(_MSC_VER) && (_MSC_VER < 1900)
+#define LOG_THREAD_LOCAL __declspec(thread)
+#else
+#define LOG_THREAD_LOCAL thread_local
+#endif
+
+// How often the consumer looks for new messages. Producers do not signal
+// the consumer, so that writing a message never makes a system call.
+static const std::chrono::milliseconds LOG_POLL_INTERVAL(10);
+
+static MpscRing<LogRecord, LOG_RING_SIZE>   s_Ring;
+
+static std::atomic<LogSink*>    s_pSink(NULL);
+static std::atomic<uint64_t>    s_Pushed(0);
+static std::atomic<uint64_t>    s_Consumed(0);
+static std::atomic<uint64_t>    s_Dropped(0);
+static std::atomic<uint32_t>    s_NextTid(0);
+
+static LOG_THREAD_LOCAL uint32_t t_Tid = 0;
+
+static const std::chrono::steady_clock::time_point s_LogBase = std::chrono::steady_clock::now();
+
+// Consumer thread lifetime. Held across the join in Stop.
+static std::mutex               s_LifetimeLock;
+static int                      s_RefCount = 0;
+static std::thread              s_Thread;
+
+// Consumer signaling.
+static std::mutex               s_Mutex;
+static std::condition_variable  s_WakeCond;         // Signals the consumer.
+static std::condition_variable  s_DrainedCond;      // Signals Flush.
+static bool                     s_bRunning = false;
+static bool                     s_bTerminate = false;
+static bool                     s_bFlushRequested = false;
+
+
+//-----------------------------------------------------------------------------
+// Consumer
+//-----------------------------------------------------------------------------
+
+static const wchar_t* LevelName(uint8_t level)
+{
+    switch (level)
+    {
+    case LogLevelTrace:     return L"trace";
+    case LogLevelInfo:      return L"info";
+    case LogLevelWarning:   return L"warning";
+    case LogLevelError:     return L"error";
+    default:                return L"?";
+    }
+}
+
+static void Sink(LogLevel level, const wchar_t *message)
+{
+    LogSink *pSink = s_pSink.load(std::memory_order_acquire);
+
+    if (pSink)
+    {
+        pSink->Write(level, message);
+    }
+}
+
+// Formats and sinks everything currently in the ring.
+static void Drain(uint64_t *pDroppedReported)
+{
+    LogRecord rec;
+    wchar_t prefix[64];
+
+    while (s_Ring.TryPop(rec))
+    {
+        swprintf(prefix, 64, L"[%10.3f] T%u %ls: ", rec.timeNs / 1e6, rec.tid, LevelName(rec.level));
+
+        std::wstring line(prefix);
+        line += DeferredLog::Format(rec);
+
+        Sink((LogLevel)rec.level, line.c_str());
+        s_Consumed++;
+    }
+
+    const uint64_t dropped = s_Dropped.load();
+
+    if (dropped != *pDroppedReported)
+    {
+        wchar_t message[96];
+        swprintf(message, 96, L"DeferredLog: %llu messages dropped (ring full)\n", (unsigned long long)(dropped - *pDroppedReported));
+
+        Sink(LogLevelWarning, message);
+        *pDroppedReported = dropped;
+    }
+}
+
+static void ThreadProc()
+{
+    uint64_t droppedReported = s_Dropped.load();
+
+    std::unique_lock<std::mutex> lock(s_Mutex);
+
+    for (;;)
+    {
+        const bool bTerminate = s_bTerminate;
+
+        s_bFlushRequested = false;
+        lock.unlock();
+
+        Drain(&droppedReported);
+
+        lock.lock();
+        s_DrainedCond.notify_all();
+
+        if (bTerminate)
+        {
+            break;
+        }
+
+        s_WakeCond.wait_for(lock, LOG_POLL_INTERVAL, [] { return s_bTerminate || s_bFlushRequested; });
+    }
+
+    s_bRunning = false;
+    s_DrainedCond.notify_all();
+}
+
+
+//-----------------------------------------------------------------------------
+// Start / Stop
+//-----------------------------------------------------------------------------
+
+void DeferredLog::Start(LogSink *pSink)
+{
+    std::lock_guard<std::mutex> lifetime(s_LifetimeLock);
+
+    if (pSink)
+    {
+        SetSink(pSink);
+    }
+
+    if (s_RefCount++ == 0)
+    {
+        {
+            std::lock_guard<std::mutex> lock(s_Mutex);
+            s_bRunning = true;
+            s_bTerminate = false;
+        }
+        s_Thread = std::thread(ThreadProc);
+    }
+}
+
+void DeferredLog::Stop()
+{
+    std::lock_guard<std::mutex> lifetime(s_LifetimeLock);
+
+    if (s_RefCount == 0 || --s_RefCount > 0)
+    {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(s_Mutex);
+        s_bTerminate = true;
+    }
+    s_WakeCond.notify_one();
+
+    // The consumer drains the ring once more before it exits.
+    s_Thread.join();
+}
+
+void DeferredLog::SetSink(LogSink *pSink)
+{
+    s_pSink.store(pSink, std::memory_order_release);
+}
+
+void DeferredLog::Flush()
+{
+    const uint64_t target = s_Pushed.load();
+
+    std::unique_lock<std::mutex> lock(s_Mutex);
+
+    // A message that was claimed but not yet published holds up the ones
+    // behind it, so keep asking until the consumer catches up.
+    while (s_bRunning && s_Consumed.load() < target)
+    {
+        s_bFlushRequested = true;
+        s_WakeCond.notify_one();
+        s_DrainedCond.wait_for(lock, LOG_POLL_INTERVAL);
+    }
+}
+
+uint64_t DeferredLog::Dropped()
+{
+    return s_Dropped.load();
+}
+
+
+//-----------------------------------------------------------------------------
+// Producer side
+//-----------------------------------------------------------------------------
+
+void DeferredLog::Submit(LogRecord& rec)
+{
+    if (t_Tid == 0)
+    {
+        t_Tid = ++s_NextTid;
+    }
+
+    rec.tid = t_Tid;
+    rec.timeNs = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - s_LogBase).count();
+
+    if (s_Ring.TryPush(rec))
+    {
+        s_Pushed++;
+    }
+    else
+    {
+        s_Dropped++;
+    }
+}
+
+void DeferredLog::CaptureSigned(LogRecord& rec, int64_t value)
+{
+    if (rec.argCount < LOG_MAX_ARGS)
+    {
+        rec.argTypes[rec.argCount] = LogRecord::ArgSigned;
+        rec.args[rec.argCount++].i = value;
+    }
+}
+
+void DeferredLog::CaptureUnsigned(LogRecord& rec, uint64_t value)
+{
+    if (rec.argCount < LOG_MAX_ARGS)
+    {
+        rec.argTypes[rec.argCount] = LogRecord::ArgUnsigned;
+        rec.args[rec.argCount++].u = value;
+    }
+}
+
+void DeferredLog::CaptureDouble(LogRecord& rec, double value)
+{
+    if (rec.argCount < LOG_MAX_ARGS)
+    {
+        rec.argTypes[rec.argCount] = LogRecord::ArgDouble;
+        rec.args[rec.argCount++].d = value;
+    }
+}
+
+void DeferredLog::CapturePointer(LogRecord& rec, const void *value)
+{
+    if (rec.argCount < LOG_MAX_ARGS)
+    {
+        rec.argTypes[rec.argCount] = LogRecord::ArgPointer;
+        rec.args[rec.argCount++].p = value;
+    }
+}
+
+// Copies a string into the record's text area, truncating it to the room
+// left. When there is no room at all, the argument refers to the previous
+// string's terminator, so it reads as empty.
+template <class CharT>
+static void CaptureText(LogRecord& rec, const CharT *value)
+{
+    if (rec.argCount >= LOG_MAX_ARGS)
+    {
+        return;
+    }
+
+    size_t offset = rec.textUsed;
+
+    if (offset >= LOG_TEXT_CHARS)
+    {
+        offset = LOG_TEXT_CHARS - 1;
+    }
+    else
+    {
+        size_t i = offset;
+
+        for (; value && *value && i + 1 < LOG_TEXT_CHARS; value++, i++)
+        {
+            rec.text[i] = (wchar_t)(typename std::make_unsigned<CharT>::type)*value;
+        }
+        rec.text[i++] = L'\0';
+        rec.textUsed = (uint16_t)i;
+    }
+
+    rec.argTypes[rec.argCount] = LogRecord::ArgString;
+    rec.args[rec.argCount++].u = offset;
+}
+
+void DeferredLog::CaptureString(LogRecord& rec, const wchar_t *value)
+{
+    CaptureText(rec, value);
+}
+
+void DeferredLog::CaptureString(LogRecord& rec, const char *value)
+{
+    CaptureText(rec, value);
+}
+
+
+//-----------------------------------------------------------------------------
+// Format
+//-----------------------------------------------------------------------------
+
+static int64_t AsSigned(const LogRecord& rec, size_t arg)
+{
+    switch (rec.argTypes[arg])
+    {
+    case LogRecord::ArgDouble:  return (int64_t)rec.args[arg].d;
+    case LogRecord::ArgPointer: return (int64_t)(uintptr_t)rec.args[arg].p;
+    default:                    return rec.args[arg].i;
+    }
+}
+
+static uint64_t AsUnsigned(const LogRecord& rec, size_t arg)
+{
+    return (uint64_t)AsSigned(rec, arg);
+}
+
+static double AsDouble(const LogRecord& rec, size_t arg)
+{
+    switch (rec.argTypes[arg])
+    {
+    case LogRecord::ArgDouble:      return rec.args[arg].d;
+    case LogRecord::ArgUnsigned:    return (double)rec.args[arg].u;
+    default:                        return (double)AsSigned(rec, arg);
+    }
+}
+
+std::wstring DeferredLog::Format(const LogRecord& rec)
+{
+    std::wstring out;
+    wchar_t buf[LOG_LINE_CHARS];
+    size_t arg = 0;
+
+    for (const wchar_t *p = rec.format; p && *p; )
+    {
+        if (*p != L'%')
+        {
+            out += *p++;
+            continue;
+        }
+
+        if (p[1] == L'%')
+        {
+            out += L'%';
+            p += 2;
+            continue;
+        }
+
+        const wchar_t *start = p++;
+
+        // Keep flags, width and precision; rebuild the length modifier.
+        std::wstring spec(L"%");
+
+        while (*p == L'-' || *p == L'+' || *p == L' ' || *p == L'#' || *p == L'0')
+        {
+            spec += *p++;
+        }
+        while (*p >= L'0' && *p <= L'9')
+        {
+            spec += *p++;
+        }
+        if (*p == L'.')
+        {
+            spec += *p++;
+            while (*p >= L'0' && *p <= L'9')
+            {
+                spec += *p++;
+            }
+        }
+
+        for (;;)
+        {
+            if (p[0] == L'I' && ((p[1] == L'6' && p[2] == L'4') || (p[1] == L'3' && p[2] == L'2')))
+            {
+                p += 3;
+            }
+            else if (*p == L'h' || *p == L'l' || *p == L'L' || *p == L'z' || *p == L'j' || *p == L't' || *p == L'w' || *p == L'I')
+            {
+                p++;
+            }
+            else
+            {
+                break;
+            }
+        }
+
+        const wchar_t conv = *p;
+
+        if (conv == L'\0')
+        {
+            out.append(start);
+            break;
+        }
+        p++;
+
+        if (arg >= rec.argCount)
+        {
+            out += L"<?>";
+            continue;
+        }
+
+        const size_t a = arg++;
+        int cch = -1;
+
+        if (rec.argTypes[a] == LogRecord::ArgString)
+        {
+            // Print strings whatever the conversion asked for.
+            spec += L"ls";
+            cch = swprintf(buf, LOG_LINE_CHARS, spec.c_str(), rec.text + rec.args[a].u);
+        }
+        else
+        {
+            switch (conv)
+            {
+            case L'd':
+            case L'i':
+                spec += L"lld";
+                cch = swprintf(buf, LOG_LINE_CHARS, spec.c_str(), (long long)AsSigned(rec, a));
+                break;
+
+            case L'u':
+            case L'x':
+            case L'X':
+            case L'o':
+                spec += L"ll";
+                spec += conv;
+                cch = swprintf(buf, LOG_LINE_CHARS, spec.c_str(), (unsigned long long)AsUnsigned(rec, a));
+                break;
+
+            case L'c':
+            case L'C':
+                buf[0] = (wchar_t)AsUnsigned(rec, a);
+                buf[1] = L'\0';
+                cch = 1;
+                break;
+
+            case L'e':
+            case L'E':
+            case L'f':
+            case L'F':
+            case L'g':
+            case L'G':
+            case L'a':
+            case L'A':
+                spec += conv;
+                cch = swprintf(buf, LOG_LINE_CHARS, spec.c_str(), AsDouble(rec, a));
+                break;
+
+            case L'p':
+                spec += L'p';
+                cch = swprintf(buf, LOG_LINE_CHARS, spec.c_str(), rec.args[a].p);
+                break;
+
+            default:
+                break;
+            }
+        }
+
+        if (cch >= 0)
+        {
+            out += buf;
+        }
+        else
+        {
+            // Unknown conversion, or too wide for the buffer: show it as written.
+            out.append(start, p - start);
+        }
+    }
+
+    return out;
+}
@@ -0,0 +1,215 @@
+//////////////////////////////////////////////////////////////////////////
+//
+// DeferredLog.h: Logging that defers formatting to a background thread.
+//
+// This file and DeferredLog.cpp have no Windows or Media Foundation
+// dependencies.
+//
+// The calling thread only copies the format string pointer and the binary
+// argument values into a lock-free ring. A consumer thread formats the
+// messages and hands them to a LogSink. Hot threads (the scheduler, the
+// presenter's Media Foundation callbacks) therefore never format text or
+// block on a debugger or file.
+//
+// Format strings are stored by pointer and read later, so they must be
+// string literals. String arguments are copied.
+//
+// Levels below WMF_LOG_LEVEL are removed at compile time, arguments and
+// all.
+//
+//////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <stdint.h>
+#include <string>
+
+// Compile-time levels, for WMF_LOG_LEVEL.
+#define WMF_LOG_LEVEL_TRACE     0
+#define WMF_LOG_LEVEL_INFO      1
+#define WMF_LOG_LEVEL_WARNING   2
+#define WMF_LOG_LEVEL_ERROR     3
+#define WMF_LOG_LEVEL_NONE      4
+
+// Lowest level compiled in. Debug builds keep everything; release builds
+// keep warnings and errors only.
+#ifndef WMF_LOG_LEVEL
+    #ifdef _DEBUG
+        #define WMF_LOG_LEVEL WMF_LOG_LEVEL_TRACE
+    #else
+        #define WMF_LOG_LEVEL WMF_LOG_LEVEL_WARNING
+    #endif
+#endif
+
+enum LogLevel
+{
+    LogLevelTrace   = WMF_LOG_LEVEL_TRACE,
+    LogLevelInfo    = WMF_LOG_LEVEL_INFO,
+    LogLevelWarning = WMF_LOG_LEVEL_WARNING,
+    LogLevelError   = WMF_LOG_LEVEL_ERROR
+};
+
+const size_t LOG_MAX_ARGS = 8;          // Arguments kept per message. Extra arguments are ignored.
+const size_t LOG_TEXT_CHARS = 128;      // Room per message for copied string arguments.
+const size_t LOG_RING_SIZE = 512;       // Messages buffered between the producers and the consumer.
+const size_t LOG_LINE_CHARS = 1024;     // Longest formatted message.
+
+
+//-----------------------------------------------------------------------------
+// LogRecord
+//
+// One message as captured on the calling thread.
+//-----------------------------------------------------------------------------
+
+struct LogRecord
+{
+    enum ArgType
+    {
+        ArgSigned,
+        ArgUnsigned,
+        ArgDouble,
+        ArgPointer,
+        ArgString       // Offset into text.
+    };
+
+    union ArgValue
+    {
+        int64_t     i;
+        uint64_t    u;
+        double      d;
+        const void  *p;
+    };
+
+    const wchar_t   *format;
+    int64_t         timeNs;             // Set by DeferredLog::Submit.
+    uint32_t        tid;                // Set by DeferredLog::Submit.
+    uint8_t         level;
+    uint8_t         argCount;
+    uint16_t        textUsed;
+    uint8_t         argTypes[LOG_MAX_ARGS];
+    ArgValue        args[LOG_MAX_ARGS];
+    wchar_t         text[LOG_TEXT_CHARS];
+};
+
+
+//-----------------------------------------------------------------------------
+// LogSink class
+//
+// Receives formatted messages on the consumer thread, one call per message.
+//-----------------------------------------------------------------------------
+
+class LogSink
+{
+public:
+    virtual ~LogSink() {}
+    virtual void Write(LogLevel level, const wchar_t *message) = 0;
+};
+
+
+//-----------------------------------------------------------------------------
+// DeferredLog class
+//
+// Process-wide. Start and Stop are reference counted: the consumer thread
+// runs while at least one Start is outstanding. Messages written while it
+// is stopped wait in the ring, and are dropped once the ring is full.
+//-----------------------------------------------------------------------------
+
+class DeferredLog
+{
+public:
+    // Starts the consumer thread. pSink replaces the current sink if not NULL.
+    static void Start(LogSink *pSink);
+
+    // Drains the ring and stops the consumer thread on the last Stop.
+    static void Stop();
+
+    static void SetSink(LogSink *pSink);
+
+    // Blocks until every message written before the call has been sunk.
+    // Returns immediately if the consumer is not running.
+    static void Flush();
+
+    // Messages lost because the ring was full.
+    static uint64_t Dropped();
+
+    // Producer side. Safe from any thread; never blocks.
+    template <typename... Args>
+    static void Write(LogLevel level, const wchar_t *format, Args... args)
+    {
+        LogRecord rec;
+
+        rec.format = format;
+        rec.level = (uint8_t)level;
+        rec.argCount = 0;
+        rec.textUsed = 0;
+
+        Capture(rec, args...);
+        Submit(rec);
+    }
+
+    // Formats one record. Used by the consumer; public so it can be tested
+    // on its own. Understands the printf conversions (including MSVC's I64
+    // and %S), with strings taken from the record whatever their width.
+    static std::wstring Format(const LogRecord& rec);
+
+private:
+    static void Submit(LogRecord& rec);
+
+    static void Capture(LogRecord&) {}
+
+    template <typename T, typename... Rest>
+    static void Capture(LogRecord& rec, T first, Rest... rest)
+    {
+        CaptureArg(rec, first);
+        Capture(rec, rest...);
+    }
+
+    static void CaptureSigned(LogRecord& rec, int64_t value);
+    static void CaptureUnsigned(LogRecord& rec, uint64_t value);
+    static void CaptureDouble(LogRecord& rec, double value);
+    static void CapturePointer(LogRecord& rec, const void *value);
+    static void CaptureString(LogRecord& rec, const wchar_t *value);
+    static void CaptureString(LogRecord& rec, const char *value);
+
+    static void CaptureArg(LogRecord& rec, int value)                   { CaptureSigned(rec, value); }
+    static void CaptureArg(LogRecord& rec, long value)                  { CaptureSigned(rec, value); }
+    static void CaptureArg(LogRecord& rec, long long value)             { CaptureSigned(rec, value); }
+    static void CaptureArg(LogRecord& rec, unsigned int value)          { CaptureUnsigned(rec, value); }
+    static void CaptureArg(LogRecord& rec, unsigned long value)         { CaptureUnsigned(rec, value); }
+    static void CaptureArg(LogRecord& rec, unsigned long long value)    { CaptureUnsigned(rec, value); }
+    static void CaptureArg(LogRecord& rec, double value)                { CaptureDouble(rec, value); }
+    static void CaptureArg(LogRecord& rec, const wchar_t *value)        { CaptureString(rec, value); }
+    static void CaptureArg(LogRecord& rec, wchar_t *value)              { CaptureString(rec, value); }
+    static void CaptureArg(LogRecord& rec, const char *value)           { CaptureString(rec, value); }
+    static void CaptureArg(LogRecord& rec, char *value)                 { CaptureString(rec, value); }
+
+    template <typename T>
+    static void CaptureArg(LogRecord& rec, T *value)                    { CapturePointer(rec, value); }
+};
+
+
+// Logging macros, filtered by WMF_LOG_LEVEL. Disabled levels evaluate nothing.
+
+#if WMF_LOG_LEVEL <= WMF_LOG_LEVEL_TRACE
+    #define WMF_LOG_TRACE(...) DeferredLog::Write(LogLevelTrace, __VA_ARGS__)
+#else
+    #define WMF_LOG_TRACE(...) ((void)0)
+#endif
+
+#if WMF_LOG_LEVEL <= WMF_LOG_LEVEL_INFO
+    #define WMF_LOG_INFO(...) DeferredLog::Write(LogLevelInfo, __VA_ARGS__)
+#else
+    #define WMF_LOG_INFO(...) ((void)0)
+#endif
+
+#if WMF_LOG_LEVEL <= WMF_LOG_LEVEL_WARNING
+    #define WMF_LOG_WARNING(...) DeferredLog::Write(LogLevelWarning, __VA_ARGS__)
+#else
+    #define WMF_LOG_WARNING(...) ((void)0)
+#endif
+
+#if WMF_LOG_LEVEL <= WMF_LOG_LEVEL_ERROR
+    #define WMF_LOG_ERROR(...) DeferredLog::Write(LogLevelError, __VA_ARGS__)
+#else
+    #define WMF_LOG_ERROR(...) ((void)0)
+#endif
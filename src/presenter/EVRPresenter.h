@@ -25,6 +25,7 @@
 #include <dxva2api.h>
 #include <evr9.h>
 #include <evcode.h> // EVR event codes (IMediaEventSink)
+#include <dwmapi.h>
 
 // Common helper code.
 #define USE_LOGGING
@@ -74,7 +75,25 @@ public:
 
 // Project headers.
 #include "PresenterHelpers.h"
+#include "ScheduleEngine.h"
 #include "Scheduler.h"
+#include "PresenterStats.h"
+#include "PipelineTrace.h"
+#include "SharedSurfaceTracker.h"
+#include "TextureMailbox.h"
+#include "OutputSizePolicy.h"
+#include "FrameSnapshot.h"
+#include "LoopMonitor.h"
+#include "KeyframeIndex.h"
+#include "SeekMonitor.h"
+#include "PlayerEventQueue.h"
+#include "TeardownReaper.h"
+#include "PlaylistOrder.h"
+#include "PlaybackSync.h"
+#include "SyncProtocol.h"
+#include "SyncSocket.h"
+#include "SharedDeviceService.h"
+#include "KeyframeIndexService.h"
 #include "PresentEngine.h"
 #include "Presenter.h"
 
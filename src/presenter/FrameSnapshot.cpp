@@ -0,0 +1,53 @@
+//////////////////////////////////////////////////////////////////////////
+//
+// FrameSnapshot.cpp: The last presented frame, published without locks.
+//
+//////////////////////////////////////////////////////////////////////////
+
+#include "FrameSnapshot.h"
+
+FrameSnapshot::FrameSnapshot() :
+    m_sequence(0),
+    m_serial(0),
+    m_sampleTime(0),
+    m_sampleDuration(0),
+    m_presentTime(0)
+{
+}
+
+void FrameSnapshot::Publish(int64_t sampleTime, int64_t sampleDuration, int64_t presentTime)
+{
+    m_sequence.fetch_add(1);
+
+    m_sampleTime.store(sampleTime);
+    m_sampleDuration.store(sampleDuration);
+    m_presentTime.store(presentTime);
+    m_serial.store(m_serial.load() + 1);
+
+    m_sequence.fetch_add(1);
+}
+
+PresentedFrameInfo FrameSnapshot::Read() const
+{
+    PresentedFrameInfo info;
+
+    for (;;)
+    {
+        uint32_t before = m_sequence.load();
+
+        if (before & 1)
+        {
+            continue;   // A write is in progress; it only stores four values.
+        }
+
+        info.sampleTime = m_sampleTime.load();
+        info.sampleDuration = m_sampleDuration.load();
+        info.presentTime = m_presentTime.load();
+        info.serial = m_serial.load();
+
+        if (m_sequence.load() == before)
+        {
+            return info;
+        }
+    }
+}
@@ -0,0 +1,67 @@
+//////////////////////////////////////////////////////////////////////////
+//
+// FrameSnapshot.h: The last presented frame, published without locks.
+//
+// This file and FrameSnapshot.cpp have no Windows or Media Foundation
+// dependencies.
+//
+//////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+
+
+//-----------------------------------------------------------------------------
+// PresentedFrameInfo
+//
+// Times are in 100ns units. serial counts the frames presented, starting at
+// 1; a serial of 0 means nothing has been presented yet.
+//-----------------------------------------------------------------------------
+
+struct PresentedFrameInfo
+{
+    PresentedFrameInfo() : serial(0), sampleTime(0), sampleDuration(0), presentTime(0)
+    {
+    }
+
+    uint64_t    serial;
+    int64_t     sampleTime;         // The sample's presentation time on the media timeline.
+    int64_t     sampleDuration;     // 0 if the sample has no duration.
+    int64_t     presentTime;        // System time (MFGetSystemTime) when it was presented.
+};
+
+
+//-----------------------------------------------------------------------------
+// FrameSnapshot class
+//
+// A sequence lock around one PresentedFrameInfo. The writer makes the
+// sequence odd, stores the fields and makes it even again; a reader retries
+// if the sequence was odd or changed while it copied the fields. Readers
+// never block the writer, and Serial() is a single atomic load.
+//
+// Only one thread may call Publish at a time.
+//-----------------------------------------------------------------------------
+
+class FrameSnapshot
+{
+public:
+    FrameSnapshot();
+
+    // Writer side. Publishes the next serial with these times.
+    void Publish(int64_t sampleTime, int64_t sampleDuration, int64_t presentTime);
+
+    // Reader side. A consistent copy of the last published frame.
+    PresentedFrameInfo Read() const;
+
+    // Reader side. The serial of the last published frame.
+    uint64_t Serial() const { return m_serial.load(); }
+
+private:
+    std::atomic<uint32_t>   m_sequence;
+    std::atomic<uint64_t>   m_serial;
+    std::atomic<int64_t>    m_sampleTime;
+    std::atomic<int64_t>    m_sampleDuration;
+    std::atomic<int64_t>    m_presentTime;
+};
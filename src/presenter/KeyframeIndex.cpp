@@ -0,0 +1,78 @@
+//////////////////////////////////////////////////////////////////////////
+//
+// KeyframeIndex.cpp: Keyframe times of a video stream, and frame/time
+// conversions for frame-accurate seeking.
+//
+//////////////////////////////////////////////////////////////////////////
+
+#include "KeyframeIndex.h"
+
+#include <algorithm>
+
+KeyframeIndex::KeyframeIndex() :
+    m_LongestInterval(0)
+{
+}
+
+void KeyframeIndex::Add(int64_t time)
+{
+    m_Times.push_back(time);
+}
+
+void KeyframeIndex::Finish(int64_t duration)
+{
+    // Samples are read in decode order; with B-frames that is not the
+    // presentation order.
+    std::sort(m_Times.begin(), m_Times.end());
+    m_Times.erase(std::unique(m_Times.begin(), m_Times.end()), m_Times.end());
+
+    m_LongestInterval = 0;
+
+    for (size_t i = 0; i < m_Times.size(); i++)
+    {
+        const int64_t end = (i + 1 < m_Times.size()) ? m_Times[i + 1] : duration;
+
+        if (end - m_Times[i] > m_LongestInterval)
+        {
+            m_LongestInterval = end - m_Times[i];
+        }
+    }
+}
+
+int64_t KeyframeIndex::Preceding(int64_t time) const
+{
+    if (m_Times.empty())
+    {
+        return -1;
+    }
+
+    // The first keyframe after time, and the one before it.
+    std::vector<int64_t>::const_iterator next = std::upper_bound(m_Times.begin(), m_Times.end(), time);
+
+    if (next == m_Times.begin())
+    {
+        return m_Times.front();
+    }
+    return *(next - 1);
+}
+
+int64_t FrameTime::ToTime(int64_t frame, uint32_t num, uint32_t den)
+{
+    if (num == 0)
+    {
+        return 0;
+    }
+    return (frame * 10000000LL * den + num / 2) / num;
+}
+
+int64_t FrameTime::ToFrame(int64_t time, uint32_t num, uint32_t den)
+{
+    if (den == 0)
+    {
+        return 0;
+    }
+
+    // Rounding in ToTime can put a frame's start up to 50ns early; a time
+    // that close to the next frame belongs to it.
+    return ((time + 1) * num) / (10000000LL * den);
+}
@@ -0,0 +1,66 @@
+//////////////////////////////////////////////////////////////////////////
+//
+// KeyframeIndex.h: Keyframe times of a video stream, and frame/time
+// conversions for frame-accurate seeking.
+//
+// This file and KeyframeIndex.cpp have no Windows or Media Foundation
+// dependencies. Times are in 100ns units.
+//
+//////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+
+//-----------------------------------------------------------------------------
+// KeyframeIndex class
+//
+// Built once per file, by reading every sample of the video stream without
+// decoding it: Add each keyframe's time, in any order, then Finish. After
+// Finish the index does not change and can be read from any thread.
+//-----------------------------------------------------------------------------
+
+class KeyframeIndex
+{
+public:
+    KeyframeIndex();
+
+    void Add(int64_t time);
+    void Finish(int64_t duration);
+
+    size_t Count() const { return m_Times.size(); }
+    bool IsEmpty() const { return m_Times.empty(); }
+    int64_t At(size_t index) const { return m_Times[index]; }
+
+    // The last keyframe at or before time; the first keyframe if time is
+    // before it, and -1 if the index is empty.
+    int64_t Preceding(int64_t time) const;
+
+    // The longest time between two keyframes, or from the last keyframe to
+    // the end of the stream: the worst case a seek has to decode through.
+    int64_t LongestInterval() const { return m_LongestInterval; }
+
+private:
+    std::vector<int64_t>    m_Times;
+    int64_t                 m_LongestInterval;
+};
+
+
+//-----------------------------------------------------------------------------
+// FrameTime
+//
+// Frame numbers and presentation times at a frame rate of num / den frames
+// per second. Frame n starts at n * den / num seconds, rounded to the
+// nearest 100ns, as the encoder stamped it.
+//-----------------------------------------------------------------------------
+
+namespace FrameTime
+{
+    int64_t ToTime(int64_t frame, uint32_t num, uint32_t den);
+
+    // The frame whose time span contains time.
+    int64_t ToFrame(int64_t time, uint32_t num, uint32_t den);
+}
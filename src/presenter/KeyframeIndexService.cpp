@@ -0,0 +1,202 @@
+//////////////////////////////////////////////////////////////////////////
+//
+// KeyframeIndexService.cpp: Keyframe indexes of the files players open.
+//
+//////////////////////////////////////////////////////////////////////////
+
+#include "EVRPresenter.h"
+#include "cinder/Log.h"
+
+#include <mfreadwrite.h>
+
+#pragma comment(lib, "mfreadwrite.lib")
+
+// The process-wide instance and its reference count.
+static std::mutex               s_ServiceLock;
+static KeyframeIndexService     *s_pService = NULL;
+static int                      s_ServiceRefCount = 0;
+
+//-----------------------------------------------------------------------------
+// Acquire / Release
+//-----------------------------------------------------------------------------
+
+KeyframeIndexService* KeyframeIndexService::Acquire()
+{
+    std::lock_guard<std::mutex> lock(s_ServiceLock);
+
+    if (s_pService == NULL)
+    {
+        s_pService = new KeyframeIndexService();
+    }
+    s_ServiceRefCount++;
+    return s_pService;
+}
+
+void KeyframeIndexService::Release()
+{
+    KeyframeIndexService *pService = NULL;
+
+    {
+        std::lock_guard<std::mutex> lock(s_ServiceLock);
+
+        if (--s_ServiceRefCount == 0)
+        {
+            pService = s_pService;
+            s_pService = NULL;
+        }
+    }
+
+    // Stop and join outside the lock.
+    delete pService;
+}
+
+//-----------------------------------------------------------------------------
+// Constructor / Destructor
+//-----------------------------------------------------------------------------
+
+KeyframeIndexService::KeyframeIndexService() :
+    m_bTerminate(false)
+{
+    m_Thread = std::thread(&KeyframeIndexService::ThreadProc, this);
+}
+
+KeyframeIndexService::~KeyframeIndexService()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_bTerminate = true;
+    }
+    m_WorkCond.notify_one();
+    m_Thread.join();
+}
+
+std::shared_ptr<const KeyframeIndex> KeyframeIndexService::Find(const std::wstring& url)
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+
+    std::map<std::wstring, std::shared_ptr<const KeyframeIndex> >::const_iterator it = m_Indexes.find(url);
+
+    if (it != m_Indexes.end())
+    {
+        return it->second;
+    }
+
+    m_Indexes[url] = std::shared_ptr<const KeyframeIndex>();
+    m_Queue.push_back(url);
+    m_WorkCond.notify_one();
+    return std::shared_ptr<const KeyframeIndex>();
+}
+
+//-----------------------------------------------------------------------------
+// ThreadProc
+//
+// Builds queued indexes one at a time, until told to terminate.
+//-----------------------------------------------------------------------------
+
+void KeyframeIndexService::ThreadProc()
+{
+    // The source reader needs COM on this thread.
+    HRESULT hrCom = CoInitializeEx(NULL, COINIT_MULTITHREADED);
+
+    std::unique_lock<std::mutex> lock(m_Mutex);
+
+    for (;;)
+    {
+        m_WorkCond.wait(lock, [this] { return m_bTerminate || !m_Queue.empty(); });
+
+        if (m_bTerminate)
+        {
+            break;
+        }
+
+        std::wstring url = m_Queue.front();
+        m_Queue.pop_front();
+
+        lock.unlock();
+
+        std::shared_ptr<KeyframeIndex> index(new KeyframeIndex());
+        HRESULT hr = Build(url, index.get());
+
+        lock.lock();
+
+        if (SUCCEEDED(hr))
+        {
+            m_Indexes[url] = index;
+        }
+        else if (hr != E_ABORT)
+        {
+            CI_LOG_W("Indexing keyframes failed, hr=0x" << std::hex << hr);
+        }
+    }
+
+    lock.unlock();
+
+    if (SUCCEEDED(hrCom))
+    {
+        CoUninitialize();
+    }
+}
+
+//-----------------------------------------------------------------------------
+// Build
+//
+// Reads every sample of the first video stream in its compressed form, and
+// records those marked as clean points. E_ABORT if the service is stopping.
+//-----------------------------------------------------------------------------
+
+HRESULT KeyframeIndexService::Build(const std::wstring& url, KeyframeIndex *pIndex)
+{
+    HRESULT hr = S_OK;
+    IMFSourceReader *pReader = NULL;
+    IMFSample *pSample = NULL;
+    PROPVARIANT varDuration;
+    LONGLONG hnsDuration = 0;
+
+    PropVariantInit(&varDuration);
+
+    CHECK_HR(hr = MFCreateSourceReaderFromURL(url.c_str(), NULL, &pReader));
+
+    // Only the video, and no media type set: the reader does not decode.
+    CHECK_HR(hr = pReader->SetStreamSelection((DWORD)MF_SOURCE_READER_ALL_STREAMS, FALSE));
+    CHECK_HR(hr = pReader->SetStreamSelection((DWORD)MF_SOURCE_READER_FIRST_VIDEO_STREAM, TRUE));
+
+    if (SUCCEEDED(pReader->GetPresentationAttribute((DWORD)MF_SOURCE_READER_MEDIASOURCE, MF_PD_DURATION, &varDuration)) &&
+        varDuration.vt == VT_UI8)
+    {
+        hnsDuration = (LONGLONG)varDuration.uhVal.QuadPart;
+    }
+
+    for (;;)
+    {
+        DWORD dwFlags = 0;
+        LONGLONG hnsTime = 0;
+
+        if (m_bTerminate)
+        {
+            CHECK_HR(hr = E_ABORT);
+        }
+
+        CHECK_HR(hr = pReader->ReadSample((DWORD)MF_SOURCE_READER_FIRST_VIDEO_STREAM, 0, NULL, &dwFlags, &hnsTime, &pSample));
+
+        if (dwFlags & MF_SOURCE_READERF_ENDOFSTREAM)
+        {
+            break;
+        }
+
+        // Uncompressed streams leave the attribute off: every frame is a keyframe.
+        if (pSample && MFGetAttributeUINT32(pSample, MFSampleExtension_CleanPoint, TRUE))
+        {
+            pIndex->Add(hnsTime);
+        }
+
+        SAFE_RELEASE(pSample);
+    }
+
+    pIndex->Finish(hnsDuration);
+
+done:
+    SAFE_RELEASE(pSample);
+    SAFE_RELEASE(pReader);
+    PropVariantClear(&varDuration);
+    return hr;
+}
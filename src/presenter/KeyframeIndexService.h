@@ -0,0 +1,54 @@
+//////////////////////////////////////////////////////////////////////////
+//
+// KeyframeIndexService.h: Keyframe indexes of the files players open.
+//
+//////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+
+//-----------------------------------------------------------------------------
+// KeyframeIndexService class
+//
+// Builds a KeyframeIndex for each file on a background thread, once per
+// process: players of the same file share it. Building reads the whole
+// video stream (without decoding it) through a source reader, so it takes
+// about as long as copying the file.
+//
+// The service is shared by reference count, like SharedDeviceService:
+// Acquire starts the thread on first use, and Release stops it, abandoning
+// any build in progress, when the last user lets go.
+//-----------------------------------------------------------------------------
+
+class KeyframeIndexService
+{
+public:
+    static KeyframeIndexService* Acquire();
+    static void Release();
+
+    // The file's index, or NULL until it has been built. The first call for
+    // a file queues the build. A file that cannot be indexed stays NULL.
+    std::shared_ptr<const KeyframeIndex> Find(const std::wstring& url);
+
+private:
+    KeyframeIndexService();
+    ~KeyframeIndexService();
+
+    void ThreadProc();
+    HRESULT Build(const std::wstring& url, KeyframeIndex *pIndex);
+
+    std::mutex                                                      m_Mutex;
+    std::condition_variable                                         m_WorkCond;
+    std::deque<std::wstring>                                        m_Queue;
+    std::map<std::wstring, std::shared_ptr<const KeyframeIndex> >   m_Indexes;  // NULL while queued or failed.
+    volatile bool                                                   m_bTerminate;
+    std::thread                                                     m_Thread;
+};
@@ -0,0 +1,88 @@
+//////////////////////////////////////////////////////////////////////////
+//
+// LoopMonitor.cpp: Measures loop transitions.
+//
+//////////////////////////////////////////////////////////////////////////
+
+#include "LoopMonitor.h"
+
+LoopMonitor::LoopMonitor() :
+    m_bHavePrev(false),
+    m_prevSampleTime(0),
+    m_prevDuration(0),
+    m_prevPresentTime(0),
+    m_restartTime(0),
+    m_boundary(LOOP_NO_BOUNDARY),
+    m_loops(0),
+    m_gap(LOOP_GAP_BIN_WIDTH, LOOP_GAP_MIN),
+    m_restart(LOOP_RESTART_BIN_WIDTH, 0)
+{
+}
+
+void LoopMonitor::OnFramePresented(int64_t sampleTime, int64_t sampleDuration, int64_t presentTime)
+{
+    bool loop = false;
+
+    int64_t restartTime = m_restartTime.load();
+    int64_t boundary = m_boundary.load();
+
+    if (restartTime != 0 && m_bHavePrev && sampleTime < m_prevSampleTime)
+    {
+        loop = true;
+
+        m_restartTime.store(0);
+        m_restart.Record(presentTime - restartTime);
+    }
+    else if (boundary != LOOP_NO_BOUNDARY && m_bHavePrev)
+    {
+        // Timestamps are not exact: half a frame early still starts the pass.
+        // A sink that sees each pass from 0 again goes backwards instead.
+        if ((m_prevSampleTime < boundary && sampleTime + sampleDuration / 2 >= boundary) ||
+            sampleTime < m_prevSampleTime)
+        {
+            loop = true;
+            m_boundary.compare_exchange_strong(boundary, LOOP_NO_BOUNDARY);
+        }
+        else if (m_prevSampleTime >= boundary)
+        {
+            // Reported after the pass had begun; nothing to measure.
+            m_boundary.compare_exchange_strong(boundary, LOOP_NO_BOUNDARY);
+        }
+    }
+
+    if (loop)
+    {
+        m_loops.fetch_add(1);
+        m_gap.Record(presentTime - (m_prevPresentTime + m_prevDuration));
+    }
+
+    m_bHavePrev = true;
+    m_prevSampleTime = sampleTime;
+    m_prevDuration = sampleDuration;
+    m_prevPresentTime = presentTime;
+}
+
+void LoopMonitor::OnLoopRestart(int64_t now)
+{
+    // 0 means "none pending".
+    m_restartTime.store(now != 0 ? now : 1);
+}
+
+void LoopMonitor::OnLoopBoundary(int64_t sampleTime)
+{
+    m_boundary.store(sampleTime);
+}
+
+void LoopMonitor::GetStats(LoopStats *pStats) const
+{
+    pStats->loops = m_loops.load();
+    m_gap.GetSnapshot(&pStats->gap);
+    m_restart.GetSnapshot(&pStats->restart);
+}
+
+void LoopMonitor::Reset()
+{
+    m_loops.store(0);
+    m_gap.Reset();
+    m_restart.Reset();
+}
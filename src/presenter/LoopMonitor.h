@@ -0,0 +1,94 @@
+//////////////////////////////////////////////////////////////////////////
+//
+// LoopMonitor.h: Measures loop transitions.
+//
+// This file and LoopMonitor.cpp have no Windows or Media Foundation
+// dependencies.
+//
+//////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+
+#include "common/TimingHistogram.h"
+
+// Gaps are binned in 2 ms steps from -32 ms; restart latency in 5 ms steps
+// from 0. Both in 100ns units.
+const int64_t LOOP_GAP_BIN_WIDTH = 20000;
+const int64_t LOOP_GAP_MIN = -320000;
+const int64_t LOOP_RESTART_BIN_WIDTH = 50000;
+
+// No gapless pass boundary pending.
+const int64_t LOOP_NO_BOUNDARY = INT64_MIN;
+
+
+//-----------------------------------------------------------------------------
+// LoopStats
+//
+// All times are in 100ns units.
+//-----------------------------------------------------------------------------
+
+struct LoopStats
+{
+    LoopStats() : loops(0)
+    {
+    }
+
+    uint64_t    loops;      // Loop transitions seen.
+
+    // How much longer than its duration the last frame of a pass stayed on
+    // screen before the first frame of the next one replaced it. 0 is a
+    // perfect loop; negative means the new frame came early.
+    MediaFoundationSamples::HistogramSnapshot   gap;
+
+    // From a loop restart (Stop and Play) to the first frame of the next
+    // pass. Gapless loops are prerolled and have no restart.
+    MediaFoundationSamples::HistogramSnapshot   restart;
+};
+
+
+//-----------------------------------------------------------------------------
+// LoopMonitor class
+//
+// The presenter reports every frame it presents; the player reports where
+// each pass begins. A loop that restarts the session is reported as it is
+// issued, and its first frame is the one whose sample time is earlier than
+// the previous frame's. A gapless loop is reported by the sample time the
+// prerolled next pass starts at, and its first frame is the first one at
+// that time (or, if sample times start over with each pass, the first one
+// that goes backwards). Either way the monitor records the gap, and for a restart the
+// restart latency. Seeks that are not loops (setPosition) are not reported,
+// so they are not counted.
+//
+// OnFramePresented is called by one thread at a time; OnLoopRestart,
+// OnLoopBoundary and the readers can be called from any thread.
+//-----------------------------------------------------------------------------
+
+class LoopMonitor
+{
+public:
+    LoopMonitor();
+
+    void OnFramePresented(int64_t sampleTime, int64_t sampleDuration, int64_t presentTime);
+    void OnLoopRestart(int64_t now);
+    void OnLoopBoundary(int64_t sampleTime);
+
+    void GetStats(LoopStats *pStats) const;
+    void Reset();
+
+private:
+    // Last presented frame; OnFramePresented's thread only.
+    bool                    m_bHavePrev;
+    int64_t                 m_prevSampleTime;
+    int64_t                 m_prevDuration;
+    int64_t                 m_prevPresentTime;
+
+    std::atomic<int64_t>    m_restartTime;      // Pending loop restart, or 0.
+    std::atomic<int64_t>    m_boundary;         // Pending pass boundary, or LOOP_NO_BOUNDARY.
+    std::atomic<uint64_t>   m_loops;
+
+    MediaFoundationSamples::TimingHistogram     m_gap;
+    MediaFoundationSamples::TimingHistogram     m_restart;
+};
@@ -0,0 +1,83 @@
+//////////////////////////////////////////////////////////////////////////
+//
+// OutputSizePolicy.cpp: The size the mixer renders video frames at.
+//
+//////////////////////////////////////////////////////////////////////////
+
+#include "OutputSizePolicy.h"
+
+static uint32_t EvenSize(uint64_t size)
+{
+    return (size < 2) ? 2 : (uint32_t)(size & ~1ULL);
+}
+
+OutputSizePolicy OutputSizePolicy::SourceSize()
+{
+    return OutputSizePolicy();
+}
+
+OutputSizePolicy OutputSizePolicy::FixedSize(uint32_t width, uint32_t height)
+{
+    OutputSizePolicy policy;
+
+    if (width > 0 && height > 0)
+    {
+        policy.mode = Fixed;
+        policy.width = width;
+        policy.height = height;
+    }
+    return policy;
+}
+
+OutputSizePolicy OutputSizePolicy::MaxSize(uint32_t maxDimension)
+{
+    OutputSizePolicy policy;
+
+    if (maxDimension > 0)
+    {
+        policy.mode = MaxDimension;
+        policy.maxDimension = maxDimension;
+    }
+    return policy;
+}
+
+void OutputSizePolicy::Apply(uint32_t srcWidth, uint32_t srcHeight, uint32_t *pWidth, uint32_t *pHeight) const
+{
+    uint64_t w = srcWidth;
+    uint64_t h = srcHeight;
+
+    if (mode == Fixed)
+    {
+        w = width;
+        h = height;
+    }
+    else if (mode == MaxDimension && (w > maxDimension || h > maxDimension))
+    {
+        // Scale the longer side to maxDimension, rounding the other.
+        if (w >= h)
+        {
+            h = (h * maxDimension + w / 2) / w;
+            w = maxDimension;
+        }
+        else
+        {
+            w = (w * maxDimension + h / 2) / h;
+            h = maxDimension;
+        }
+    }
+    else
+    {
+        // Unscaled: leave the source size alone; the mixer already expects it.
+        *pWidth = srcWidth;
+        *pHeight = srcHeight;
+        return;
+    }
+
+    *pWidth = EvenSize(w);
+    *pHeight = EvenSize(h);
+}
+
+bool OutputSizePolicy::operator==(const OutputSizePolicy& rhs) const
+{
+    return mode == rhs.mode && width == rhs.width && height == rhs.height && maxDimension == rhs.maxDimension;
+}
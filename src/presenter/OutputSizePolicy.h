@@ -0,0 +1,57 @@
+//////////////////////////////////////////////////////////////////////////
+//
+// OutputSizePolicy.h: The size the mixer renders video frames at.
+//
+// This file and OutputSizePolicy.cpp have no Windows or Media Foundation
+// dependencies.
+//
+//////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <stdint.h>
+
+
+//-----------------------------------------------------------------------------
+// OutputSizePolicy
+//
+// By default the mixer outputs frames at the source's display size. A
+// player drawn much smaller than its source can ask for smaller frames
+// instead: the mixer scales them down, and the samples, the shared
+// textures and every copy between them shrink with it.
+//
+//   Source:        the source's display size.
+//   Fixed:         exactly width x height.
+//   MaxDimension:  the source size scaled down, keeping its aspect ratio,
+//                  until neither side exceeds maxDimension. Never scales up.
+//
+// Scaled sizes are rounded down to even numbers (4:2:0 formats need
+// them), and are at least 2 x 2.
+//-----------------------------------------------------------------------------
+
+struct OutputSizePolicy
+{
+    enum Mode
+    {
+        Source,
+        Fixed,
+        MaxDimension
+    };
+
+    OutputSizePolicy() : mode(Source), width(0), height(0), maxDimension(0) { }
+
+    static OutputSizePolicy SourceSize();
+    static OutputSizePolicy FixedSize(uint32_t width, uint32_t height);
+    static OutputSizePolicy MaxSize(uint32_t maxDimension);
+
+    // The output size for a source of the given display size.
+    void Apply(uint32_t srcWidth, uint32_t srcHeight, uint32_t *pWidth, uint32_t *pHeight) const;
+
+    bool operator==(const OutputSizePolicy& rhs) const;
+    bool operator!=(const OutputSizePolicy& rhs) const { return !(*this == rhs); }
+
+    Mode        mode;
+    uint32_t    width;          // Fixed
+    uint32_t    height;         // Fixed
+    uint32_t    maxDimension;   // MaxDimension
+};
@@ -0,0 +1,259 @@
+//////////////////////////////////////////////////////////////////////////
+//
+// PipelineTrace.cpp: Scoped timing zones, exported as Chrome Trace JSON.
+//
+//////////////////////////////////////////////////////////////////////////
+
+#include "PipelineTrace.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <mutex>
+
+// Visual C++ 2013 has no thread_local.
+#if defined(_MSC_VER) && (_MSC_VER < 1900)
+#define TRACE_THREAD_LOCAL __declspec(thread)
+#else
+#define TRACE_THREAD_LOCAL thread_local
+#endif
+
+std::atomic<bool> TraceRecorder::s_bEnabled(false);
+
+// All rings ever created. Rings are never freed, because a dump may be
+// reading one while its thread exits.
+static std::mutex                   s_RingLock;
+static std::vector<TraceRing*>      s_Rings;
+
+static TRACE_THREAD_LOCAL TraceRing *t_pRing = NULL;
+
+static const std::chrono::steady_clock::time_point s_TraceBase = std::chrono::steady_clock::now();
+
+
+//-----------------------------------------------------------------------------
+// TraceRing
+//-----------------------------------------------------------------------------
+
+TraceRing::TraceRing(uint32_t tid) : m_tid(tid), m_name(NULL), m_head(0), m_base(0)
+{
+    for (size_t i = 0; i < TRACE_RING_SIZE; i++)
+    {
+        m_slots[i].seq.store(0, std::memory_order_relaxed);
+        m_slots[i].name.store(NULL, std::memory_order_relaxed);
+        m_slots[i].startNs.store(0, std::memory_order_relaxed);
+        m_slots[i].durationNs.store(0, std::memory_order_relaxed);
+    }
+}
+
+void TraceRing::Record(const char *name, int64_t startNs, int64_t durationNs)
+{
+    const uint64_t index = m_head.load(std::memory_order_relaxed);
+    Slot& slot = m_slots[index % TRACE_RING_SIZE];
+
+    // Invalidate the slot before overwriting it, so a concurrent reader
+    // sees a sequence mismatch instead of a torn event.
+    slot.seq.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    slot.name.store(name, std::memory_order_relaxed);
+    slot.startNs.store(startNs, std::memory_order_relaxed);
+    slot.durationNs.store(durationNs, std::memory_order_relaxed);
+
+    slot.seq.store(index + 1, std::memory_order_release);
+    m_head.store(index + 1, std::memory_order_release);
+}
+
+void TraceRing::CopyTo(std::vector<TraceEventRecord> *pEvents) const
+{
+    const uint64_t head = m_head.load(std::memory_order_acquire);
+    uint64_t first = (head > TRACE_RING_SIZE) ? head - TRACE_RING_SIZE : 0;
+
+    first = (std::max)(first, m_base.load(std::memory_order_relaxed));
+
+    for (uint64_t i = first; i < head; i++)
+    {
+        const Slot& slot = m_slots[i % TRACE_RING_SIZE];
+
+        if (slot.seq.load(std::memory_order_acquire) != i + 1)
+        {
+            continue;
+        }
+
+        TraceEventRecord ev;
+        ev.name = slot.name.load(std::memory_order_relaxed);
+        ev.startNs = slot.startNs.load(std::memory_order_relaxed);
+        ev.durationNs = slot.durationNs.load(std::memory_order_relaxed);
+        ev.tid = m_tid;
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+
+        // Overwritten while we copied it.
+        if (slot.seq.load(std::memory_order_relaxed) != i + 1)
+        {
+            continue;
+        }
+
+        pEvents->push_back(ev);
+    }
+}
+
+void TraceRing::Clear()
+{
+    m_base.store(m_head.load(std::memory_order_acquire), std::memory_order_relaxed);
+}
+
+
+//-----------------------------------------------------------------------------
+// TraceRecorder
+//-----------------------------------------------------------------------------
+
+int64_t TraceRecorder::Now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - s_TraceBase).count();
+}
+
+TraceRing* TraceRecorder::ThreadRing()
+{
+    if (t_pRing == NULL)
+    {
+        std::lock_guard<std::mutex> lock(s_RingLock);
+
+        t_pRing = new TraceRing((uint32_t)s_Rings.size() + 1);
+        s_Rings.push_back(t_pRing);
+    }
+    return t_pRing;
+}
+
+void TraceRecorder::Clear()
+{
+    std::lock_guard<std::mutex> lock(s_RingLock);
+
+    for (size_t i = 0; i < s_Rings.size(); i++)
+    {
+        s_Rings[i]->Clear();
+    }
+}
+
+void TraceRecorder::WriteChromeTrace(std::ostream& out)
+{
+    std::vector<TraceEventRecord> events;
+    std::vector<std::string> threadNames;
+
+    {
+        std::lock_guard<std::mutex> lock(s_RingLock);
+
+        for (size_t i = 0; i < s_Rings.size(); i++)
+        {
+            const char *name = s_Rings[i]->Name();
+
+            s_Rings[i]->CopyTo(&events);
+            threadNames.push_back(name ? name : "");
+        }
+    }
+
+    WriteChromeTrace(out, events, threadNames);
+}
+
+bool TraceRecorder::WriteChromeTrace(const std::string& path)
+{
+    std::ofstream file(path.c_str(), std::ios::out | std::ios::trunc);
+
+    if (!file)
+    {
+        return false;
+    }
+
+    WriteChromeTrace(file);
+    return file.good();
+}
+
+
+//-----------------------------------------------------------------------------
+// Serializer
+//-----------------------------------------------------------------------------
+
+// Writes a JSON string literal.
+static void WriteJsonString(std::ostream& out, const char *s)
+{
+    out << '"';
+
+    for (; s && *s; s++)
+    {
+        unsigned char c = (unsigned char)*s;
+
+        if (c == '"' || c == '\\')
+        {
+            out << '\\' << (char)c;
+        }
+        else if (c < 0x20)
+        {
+            static const char hex[] = "0123456789abcdef";
+            out << "\\u00" << hex[c >> 4] << hex[c & 0xF];
+        }
+        else
+        {
+            out << (char)c;
+        }
+    }
+
+    out << '"';
+}
+
+// Writes nanoseconds as microseconds with three decimals, the unit of
+// Chrome trace timestamps.
+static void WriteMicroseconds(std::ostream& out, int64_t ns)
+{
+    if (ns < 0)
+    {
+        out << '-';
+        ns = -ns;
+    }
+
+    int64_t frac = ns % 1000;
+
+    out << (ns / 1000) << '.' << (char)('0' + frac / 100) << (char)('0' + (frac / 10) % 10) << (char)('0' + frac % 10);
+}
+
+static bool EventStartsBefore(const TraceEventRecord& a, const TraceEventRecord& b)
+{
+    return a.startNs < b.startNs;
+}
+
+void TraceRecorder::WriteChromeTrace(std::ostream& out, const std::vector<TraceEventRecord>& events, const std::vector<std::string>& threadNames)
+{
+    std::vector<TraceEventRecord> sorted(events);
+    std::stable_sort(sorted.begin(), sorted.end(), EventStartsBefore);
+
+    bool bFirst = true;
+
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+
+    for (size_t i = 0; i < threadNames.size(); i++)
+    {
+        if (threadNames[i].empty())
+        {
+            continue;
+        }
+
+        out << (bFirst ? "" : ",") << "\n{\"ph\":\"M\",\"pid\":1,\"tid\":" << (i + 1) << ",\"name\":\"thread_name\",\"args\":{\"name\":";
+        WriteJsonString(out, threadNames[i].c_str());
+        out << "}}";
+        bFirst = false;
+    }
+
+    for (size_t i = 0; i < sorted.size(); i++)
+    {
+        const TraceEventRecord& ev = sorted[i];
+
+        out << (bFirst ? "" : ",") << "\n{\"ph\":\"X\",\"pid\":1,\"tid\":" << ev.tid << ",\"name\":";
+        WriteJsonString(out, ev.name);
+        out << ",\"ts\":";
+        WriteMicroseconds(out, ev.startNs);
+        out << ",\"dur\":";
+        WriteMicroseconds(out, ev.durationNs);
+        out << "}";
+        bFirst = false;
+    }
+
+    out << "\n]}\n";
+}
@@ -0,0 +1,175 @@
+//////////////////////////////////////////////////////////////////////////
+//
+// PipelineTrace.h: Scoped timing zones, exported as Chrome Trace JSON.
+//
+// This file and PipelineTrace.cpp have no Windows or Media Foundation
+// dependencies.
+//
+// Zones are only compiled in when WMFVIDEO_TRACE_ZONES is defined. Without
+// it, WMF_TRACE_ZONE and WMF_TRACE_THREAD_NAME expand to nothing and cost
+// nothing. With it, recording can still be switched on and off at run
+// time with TraceRecorder::SetEnabled.
+//
+// Each thread records into its own fixed-size ring, so recording never
+// takes a lock. Dumping copies every ring while the threads keep running;
+// events overwritten during the copy are skipped.
+//
+// The trace file opens in chrome://tracing or ui.perfetto.dev.
+//
+//////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Events kept per thread. Older events are overwritten.
+const size_t TRACE_RING_SIZE = 4096;
+
+
+//-----------------------------------------------------------------------------
+// TraceEventRecord
+//
+// One completed zone. Names must be string literals (or otherwise outlive
+// the recorder).
+//-----------------------------------------------------------------------------
+
+struct TraceEventRecord
+{
+    const char  *name;
+    int64_t     startNs;        // Relative to the recorder's time base.
+    int64_t     durationNs;
+    uint32_t    tid;            // Recorder-assigned thread number.
+};
+
+
+//-----------------------------------------------------------------------------
+// TraceRing class
+//
+// Single-writer ring of events. The owning thread writes; any thread may
+// copy. Each slot carries a sequence number so a reader can tell whether
+// the slot was overwritten while it was being copied.
+//-----------------------------------------------------------------------------
+
+class TraceRing
+{
+public:
+    TraceRing(uint32_t tid);
+
+    uint32_t Tid() const { return m_tid; }
+
+    void SetName(const char *name) { m_name.store(name); }
+    const char* Name() const { return m_name.load(); }
+
+    // Writer side.
+    void Record(const char *name, int64_t startNs, int64_t durationNs);
+
+    // Reader side. Appends the events currently in the ring, oldest first.
+    void CopyTo(std::vector<TraceEventRecord> *pEvents) const;
+
+    void Clear();
+
+private:
+    struct Slot
+    {
+        std::atomic<uint64_t>       seq;        // Index + 1 of the event in the slot; 0 if empty.
+        std::atomic<const char*>    name;
+        std::atomic<int64_t>        startNs;
+        std::atomic<int64_t>        durationNs;
+    };
+
+    const uint32_t              m_tid;
+    std::atomic<const char*>    m_name;
+    std::atomic<uint64_t>       m_head;         // Events ever written.
+    std::atomic<uint64_t>       m_base;         // Events before this index were cleared.
+    Slot                        m_slots[TRACE_RING_SIZE];
+};
+
+
+//-----------------------------------------------------------------------------
+// TraceRecorder class
+//
+// Process-wide registry of per-thread rings.
+//-----------------------------------------------------------------------------
+
+class TraceRecorder
+{
+public:
+    static void SetEnabled(bool bEnabled) { s_bEnabled.store(bEnabled, std::memory_order_relaxed); }
+    static bool IsEnabled() { return s_bEnabled.load(std::memory_order_relaxed); }
+
+    // Nanoseconds since the recorder's time base.
+    static int64_t Now();
+
+    // The calling thread's ring, created on first use.
+    static TraceRing* ThreadRing();
+
+    static void SetThreadName(const char *name) { ThreadRing()->SetName(name); }
+
+    // Copies every ring and writes one Chrome Trace Event JSON document.
+    static void WriteChromeTrace(std::ostream& out);
+    static bool WriteChromeTrace(const std::string& path);
+
+    // Discards all recorded events.
+    static void Clear();
+
+    // Serializer, separated out so it can be fed synthetic events.
+    // threadNames[i] names tid i + 1; it can be shorter than the tid range.
+    static void WriteChromeTrace(std::ostream& out, const std::vector<TraceEventRecord>& events, const std::vector<std::string>& threadNames);
+
+private:
+    static std::atomic<bool> s_bEnabled;
+};
+
+
+//-----------------------------------------------------------------------------
+// TraceZone class
+//
+// Records the time from construction to destruction as one event.
+//-----------------------------------------------------------------------------
+
+class TraceZone
+{
+public:
+    explicit TraceZone(const char *name) : m_name(name), m_startNs(0)
+    {
+        if (TraceRecorder::IsEnabled())
+        {
+            m_startNs = TraceRecorder::Now();
+        }
+        else
+        {
+            m_name = NULL;
+        }
+    }
+
+    ~TraceZone()
+    {
+        if (m_name)
+        {
+            TraceRecorder::ThreadRing()->Record(m_name, m_startNs, TraceRecorder::Now() - m_startNs);
+        }
+    }
+
+private:
+    TraceZone(const TraceZone&);
+    TraceZone& operator=(const TraceZone&);
+
+    const char  *m_name;
+    int64_t     m_startNs;
+};
+
+
+#define WMF_TRACE_CONCAT_(a, b) a##b
+#define WMF_TRACE_CONCAT(a, b) WMF_TRACE_CONCAT_(a, b)
+
+#ifdef WMFVIDEO_TRACE_ZONES
+    #define WMF_TRACE_ZONE(name) TraceZone WMF_TRACE_CONCAT(traceZone_, __LINE__)(name)
+    #define WMF_TRACE_THREAD_NAME(name) TraceRecorder::SetThreadName(name)
+#else
+    #define WMF_TRACE_ZONE(name)
+    #define WMF_TRACE_THREAD_NAME(name)
+#endif
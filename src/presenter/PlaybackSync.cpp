@@ -0,0 +1,188 @@
+//////////////////////////////////////////////////////////////////////////
+//
+// PlaybackSync.cpp: Skew between playback clocks, and a controller that
+// removes it with small rate changes.
+//
+//////////////////////////////////////////////////////////////////////////
+
+#include "PlaybackSync.h"
+
+#include <math.h>
+
+int64_t PlaybackSync::Skew(const ClockSample& member, const ClockSample& reference)
+{
+    const double elapsed = (double)(reference.systemTime - member.systemTime) * member.rate;
+
+    return member.presentationTime + (int64_t)elapsed - reference.presentationTime;
+}
+
+int64_t PlaybackSync::WrapSkew(int64_t skew, int64_t duration)
+{
+    if (duration <= 0)
+    {
+        return skew;
+    }
+
+    skew %= duration;
+
+    if (skew > duration / 2)
+    {
+        skew -= duration;
+    }
+    else if (skew <= -duration / 2)
+    {
+        skew += duration;
+    }
+    return skew;
+}
+
+PlaybackSyncController::PlaybackSyncController(const SyncTuning& tuning) :
+    m_Tuning(tuning),
+    m_bHaveLast(false),
+    m_LastUpdate(0),
+    m_SettleUntil(0),
+    m_Integral(0.0),
+    m_bFiltered(false),
+    m_Filtered(0.0),
+    m_Nudge(0.0),
+    m_Updates(0),
+    m_Nudges(0),
+    m_Seeks(0),
+    m_LastError(0),
+    m_Error(SYNC_HISTOGRAM_BIN_WIDTH, 0)
+{
+}
+
+static double Clamp(double value, double limit)
+{
+    if (value > limit)
+    {
+        return limit;
+    }
+    if (value < -limit)
+    {
+        return -limit;
+    }
+    return value;
+}
+
+SyncCorrection PlaybackSyncController::Update(int64_t error, int64_t now)
+{
+    SyncCorrection correction;
+
+    m_Updates++;
+    m_LastError = error;
+
+    if (m_bHaveLast && now < m_SettleUntil)
+    {
+        m_LastUpdate = now;
+        return correction;
+    }
+
+    m_Error.Record(error < 0 ? -error : error);
+
+    if (error > m_Tuning.seekThreshold || error < -m_Tuning.seekThreshold)
+    {
+        correction.action = SyncSeek;
+        correction.seekBy = -error;
+
+        m_Seeks++;
+        Settle(now);
+        return correction;
+    }
+
+    const double dt = m_bHaveLast ? (double)(now - m_LastUpdate) / 10000000.0 : 0.0;
+
+    // Low-pass the error, so measurement jitter does not move the rate.
+    const double raw = (double)error / 10000000.0;
+
+    if (!m_bFiltered)
+    {
+        m_Filtered = raw;
+        m_bFiltered = true;
+    }
+    else
+    {
+        m_Filtered += (raw - m_Filtered) * dt / (m_Tuning.smoothing + dt);
+    }
+
+    const double seconds = m_Filtered;
+
+    m_bHaveLast = true;
+    m_LastUpdate = now;
+
+    // The integral is the drift estimate. It never grows further than the
+    // rate change can use (no windup).
+    if (m_Tuning.integralGain > 0.0)
+    {
+        m_Integral += seconds * dt;
+        m_Integral = Clamp(m_Integral, m_Tuning.maxNudge / m_Tuning.integralGain);
+    }
+
+    const double proportional = m_Tuning.gain * seconds;
+
+    // Ahead (positive error) means slow down.
+    double nudge = Clamp(-(proportional + m_Tuning.integralGain * m_Integral), m_Tuning.maxNudge);
+
+    // A whole step of hysteresis: a value hovering between two steps does
+    // not flip the rate back and forth.
+    if (fabs(nudge - m_Nudge) < m_Tuning.nudgeStep)
+    {
+        return correction;
+    }
+
+    if (m_Tuning.nudgeStep > 0.0)
+    {
+        nudge = floor(nudge / m_Tuning.nudgeStep + 0.5) * m_Tuning.nudgeStep;
+    }
+
+    if (nudge != m_Nudge)
+    {
+        m_Nudge = nudge;
+        m_Nudges++;
+
+        correction.action = SyncNudge;
+        correction.nudge = nudge;
+    }
+    return correction;
+}
+
+void PlaybackSyncController::Settle(int64_t now)
+{
+    m_bHaveLast = true;
+    m_LastUpdate = now;
+    m_SettleUntil = now + m_Tuning.settleTime;
+    m_Integral = 0.0;
+    m_bFiltered = false;
+    m_Nudge = 0.0;
+}
+
+void PlaybackSyncController::GetStats(SyncStats *pStats) const
+{
+    pStats->updates = m_Updates;
+    pStats->nudges = m_Nudges;
+    pStats->seeks = m_Seeks;
+    pStats->lastError = m_LastError;
+    pStats->nudge = m_Nudge;
+    m_Error.GetSnapshot(&pStats->error);
+}
+
+void PlaybackSyncController::ResetStats()
+{
+    m_Updates = 0;
+    m_Nudges = 0;
+    m_Seeks = 0;
+    m_LastError = 0;
+    m_Error.Reset();
+}
+
+void PlaybackSyncController::Reset()
+{
+    m_bHaveLast = false;
+    m_LastUpdate = 0;
+    m_SettleUntil = 0;
+    m_Integral = 0.0;
+    m_bFiltered = false;
+    m_Nudge = 0.0;
+    ResetStats();
+}
@@ -0,0 +1,166 @@
+//////////////////////////////////////////////////////////////////////////
+//
+// PlaybackSync.h: Skew between playback clocks, and a controller that
+// removes it with small rate changes.
+//
+// This file and PlaybackSync.cpp have no Windows or Media Foundation
+// dependencies.
+//
+//////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <stdint.h>
+
+#include "common/TimingHistogram.h"
+
+// Sync errors are binned in 0.5 ms steps (100ns units).
+const int64_t SYNC_HISTOGRAM_BIN_WIDTH = 5000;
+
+
+//-----------------------------------------------------------------------------
+// ClockSample
+//
+// A presentation clock read together with the system time it was read at
+// (IMFClock::GetCorrelatedTime), and the rate it was running at.
+//-----------------------------------------------------------------------------
+
+struct ClockSample
+{
+    int64_t     presentationTime;   // 100ns units.
+    int64_t     systemTime;         // 100ns units.
+    double      rate;
+};
+
+namespace PlaybackSync
+{
+    // member's presentation time minus reference's, with member projected to
+    // the system time reference was read at. Positive: member is ahead.
+    int64_t Skew(const ClockSample& member, const ClockSample& reference);
+
+    // For looping content: the skew folded into (-duration/2, duration/2],
+    // so a player that has wrapped round is not seen as a whole pass off.
+    int64_t WrapSkew(int64_t skew, int64_t duration);
+}
+
+
+//-----------------------------------------------------------------------------
+// SyncTuning
+//
+// Times are in 100ns units unless noted.
+//-----------------------------------------------------------------------------
+
+struct SyncTuning
+{
+    SyncTuning() :
+        smoothing(0.5),
+        seekThreshold(2500000),
+        settleTime(5000000),
+        gain(0.5),
+        integralGain(0.05),
+        maxNudge(0.05),
+        nudgeStep(0.0001)
+    {
+    }
+
+    double      smoothing;      // Time constant of the error filter, in seconds.
+    int64_t     seekThreshold;  // Larger errors are corrected by seeking.
+    int64_t     settleTime;     // After a seek, errors are ignored this long.
+    double      gain;           // Rate change per second of error.
+    double      integralGain;   // Rate change per second of error, per second; cancels drift.
+    double      maxNudge;       // Largest rate change, as a fraction of the rate.
+    double      nudgeStep;      // Rate changes are rounded to this; smaller ones are not applied.
+};
+
+
+enum SyncAction
+{
+    SyncNone,       // Leave the rate as it is.
+    SyncNudge,      // Set the rate to (1 + nudge) times the nominal rate.
+    SyncSeek        // Seek by seekBy, and reset the rate to nominal.
+};
+
+struct SyncCorrection
+{
+    SyncCorrection() : action(SyncNone), nudge(0.0), seekBy(0)
+    {
+    }
+
+    SyncAction  action;
+    double      nudge;
+    int64_t     seekBy;
+};
+
+struct SyncStats
+{
+    SyncStats() : updates(0), nudges(0), seeks(0), lastError(0), nudge(0.0)
+    {
+    }
+
+    uint64_t    updates;
+    uint64_t    nudges;         // Rate changes made.
+    uint64_t    seeks;
+    int64_t     lastError;      // 100ns units; positive is ahead.
+    double      nudge;          // Rate change in effect.
+
+    // Size of the error at each update, from 0, ignoring the settle time.
+    MediaFoundationSamples::HistogramSnapshot   error;
+};
+
+
+//-----------------------------------------------------------------------------
+// PlaybackSyncController class
+//
+// Keeps one player in step with a reference. Each Update takes the current
+// error and returns what to do about it: large errors are seeked away;
+// otherwise the rate is nudged by a PI controller on the low-passed error,
+// so a constant drift (clocks running at slightly different speeds) is
+// cancelled as well as the offset. The rate change is bounded, quantized
+// and only applied once it has moved a whole step, so the player's rate is
+// set rarely.
+//
+// Not thread-safe: Update, Reset and GetStats on one thread.
+//-----------------------------------------------------------------------------
+
+class PlaybackSyncController
+{
+public:
+    explicit PlaybackSyncController(const SyncTuning& tuning = SyncTuning());
+
+    // error: player time minus reference time, 100ns units. now: any
+    // monotonic time, 100ns units.
+    SyncCorrection Update(int64_t error, int64_t now);
+
+    // After the caller moved the player itself (a seek, or a start): ignore
+    // errors for the settle time and forget the rate history.
+    void Settle(int64_t now);
+
+    double Nudge() const { return m_Nudge; }
+
+    void GetStats(SyncStats *pStats) const;
+
+    // ResetStats clears the counters and the histogram only; Reset also
+    // forgets the rate change, for a player back at its nominal rate.
+    void ResetStats();
+    void Reset();
+
+private:
+    PlaybackSyncController(const PlaybackSyncController&);
+    PlaybackSyncController& operator=(const PlaybackSyncController&);
+
+    SyncTuning  m_Tuning;
+    bool        m_bHaveLast;
+    int64_t     m_LastUpdate;
+    int64_t     m_SettleUntil;
+    double      m_Integral;     // Error integrated over time, in seconds * seconds.
+    bool        m_bFiltered;
+    double      m_Filtered;     // Filtered error, in seconds.
+    double      m_Nudge;        // Applied rate change.
+
+    uint64_t    m_Updates;
+    uint64_t    m_Nudges;
+    uint64_t    m_Seeks;
+    int64_t     m_LastError;
+
+    MediaFoundationSamples::TimingHistogram     m_Error;
+};
@@ -0,0 +1,30 @@
+//////////////////////////////////////////////////////////////////////////
+//
+// PlayerEventQueue.cpp: Media session events handed to the app thread.
+//
+//////////////////////////////////////////////////////////////////////////
+
+#include "PlayerEventQueue.h"
+
+PlayerEventQueue::PlayerEventQueue() :
+    m_cPosted(0),
+    m_cDrained(0),
+    m_cDropped(0)
+{
+}
+
+bool PlayerEventQueue::Post(void *pEvent, uint32_t type)
+{
+    PlayerEvent ev;
+    ev.pEvent = pEvent;
+    ev.type = type;
+
+    if (!m_ring.TryPush(ev))
+    {
+        m_cDropped.fetch_add(1);
+        return false;
+    }
+
+    m_cPosted.fetch_add(1);
+    return true;
+}
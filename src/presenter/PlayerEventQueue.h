@@ -0,0 +1,83 @@
+//////////////////////////////////////////////////////////////////////////
+//
+// PlayerEventQueue.h: Media session events handed to the app thread.
+//
+// This file and PlayerEventQueue.cpp have no Windows or Media Foundation
+// dependencies. Events are opaque pointers; CPlayer stores IMFMediaEvent
+// pointers, and tests can store anything.
+//
+//////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+
+#include "common/MpscRing.h"
+
+// Events buffered between two drains. A session raises a handful per state
+// change, so this only fills if the app stops draining.
+const size_t PLAYER_EVENT_QUEUE_SIZE = 256;
+
+
+//-----------------------------------------------------------------------------
+// PlayerEvent
+//-----------------------------------------------------------------------------
+
+struct PlayerEvent
+{
+    void        *pEvent;    // Owned by the queue between Post and Drain.
+    uint32_t    type;       // MediaEventType, for CPlayer.
+};
+
+
+//-----------------------------------------------------------------------------
+// PlayerEventQueue class
+//
+// Replaces posting each event to a hidden window. Media Foundation callbacks
+// (any thread) Post; the app thread Drains in a batch, typically once per
+// frame. Post never blocks or allocates. If the ring is full, Post fails
+// and the caller keeps the event; it is counted in Dropped().
+//-----------------------------------------------------------------------------
+
+class PlayerEventQueue
+{
+public:
+    PlayerEventQueue();
+
+    // Producer side. Safe from any thread.
+    bool Post(void *pEvent, uint32_t type);
+
+    // Consumer side. Calls handler(const PlayerEvent&) for each event that
+    // was queued when Drain was called, oldest first, and returns how many.
+    // Events the handler posts are left for the next Drain.
+    template <class Handler>
+    size_t Drain(Handler handler)
+    {
+        size_t count = m_ring.Size();
+        size_t handled = 0;
+        PlayerEvent ev;
+
+        while (handled < count && m_ring.TryPop(ev))
+        {
+            handler(ev);
+            handled++;
+        }
+
+        m_cDrained.fetch_add(handled);
+        return handled;
+    }
+
+    size_t Pending() const { return m_ring.Size(); }
+
+    uint64_t Posted() const { return m_cPosted.load(); }
+    uint64_t Drained() const { return m_cDrained.load(); }
+    uint64_t Dropped() const { return m_cDropped.load(); }
+
+private:
+    MediaFoundationSamples::MpscRing<PlayerEvent, PLAYER_EVENT_QUEUE_SIZE> m_ring;
+
+    std::atomic<uint64_t>   m_cPosted;
+    std::atomic<uint64_t>   m_cDrained;
+    std::atomic<uint64_t>   m_cDropped;
+};
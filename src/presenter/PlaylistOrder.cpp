@@ -0,0 +1,80 @@
+//////////////////////////////////////////////////////////////////////////
+//
+// PlaylistOrder.cpp: The clips of a playlist and the order they play in.
+//
+//////////////////////////////////////////////////////////////////////////
+
+#include "PlaylistOrder.h"
+
+PlaylistOrder::PlaylistOrder() :
+    m_NextKey(1)
+{
+}
+
+uint64_t PlaylistOrder::Insert(size_t index, const std::wstring& url)
+{
+    if (index > m_Entries.size())
+    {
+        index = m_Entries.size();
+    }
+
+    PlaylistEntry entry;
+    entry.key = m_NextKey++;
+    entry.url = url;
+
+    m_Entries.insert(m_Entries.begin() + index, entry);
+    return entry.key;
+}
+
+bool PlaylistOrder::Remove(size_t index)
+{
+    if (index >= m_Entries.size())
+    {
+        return false;
+    }
+
+    m_Entries.erase(m_Entries.begin() + index);
+    return true;
+}
+
+void PlaylistOrder::Clear()
+{
+    // Keys are not reused, so stale ones never match a new entry.
+    m_Entries.clear();
+}
+
+bool PlaylistOrder::Find(uint64_t key, size_t *pIndex) const
+{
+    for (size_t i = 0; i < m_Entries.size(); i++)
+    {
+        if (m_Entries[i].key == key)
+        {
+            *pIndex = i;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool PlaylistOrder::Next(uint64_t key, bool loop, uint64_t *pNextKey) const
+{
+    size_t index = 0;
+
+    if (!Find(key, &index))
+    {
+        return false;
+    }
+
+    if (index + 1 < m_Entries.size())
+    {
+        *pNextKey = m_Entries[index + 1].key;
+        return true;
+    }
+
+    if (loop)
+    {
+        *pNextKey = m_Entries[0].key;
+        return true;
+    }
+    return false;
+}
@@ -0,0 +1,60 @@
+//////////////////////////////////////////////////////////////////////////
+//
+// PlaylistOrder.h: The clips of a playlist and the order they play in.
+//
+// This file and PlaylistOrder.cpp have no Windows or Media Foundation
+// dependencies.
+//
+//////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+struct PlaylistEntry
+{
+    uint64_t        key;    // Unique for the life of the PlaylistOrder; never 0.
+    std::wstring    url;
+};
+
+
+//-----------------------------------------------------------------------------
+// PlaylistOrder class
+//
+// A list of URLs. Each entry has a key that stays the same while others are
+// inserted and removed around it, so the player can keep track of the clip
+// that is playing, and the one that is prerolling, by key rather than by
+// position.
+//-----------------------------------------------------------------------------
+
+class PlaylistOrder
+{
+public:
+    PlaylistOrder();
+
+    // index is clamped to Size(). Returns the new entry's key.
+    uint64_t Insert(size_t index, const std::wstring& url);
+
+    // Returns false if index is out of range.
+    bool Remove(size_t index);
+
+    void Clear();
+
+    size_t Size() const { return m_Entries.size(); }
+    const PlaylistEntry& At(size_t index) const { return m_Entries[index]; }
+
+    // Position of the entry with the given key; false if it was removed.
+    bool Find(uint64_t key, size_t *pIndex) const;
+
+    // The entry that plays after the one with the given key: the following
+    // one, or with loop, the first after the last (the entry itself if it is
+    // the only one). False at the end, or if key was removed.
+    bool Next(uint64_t key, bool loop, uint64_t *pNextKey) const;
+
+private:
+    std::vector<PlaylistEntry>  m_Entries;
+    uint64_t                    m_NextKey;
+};
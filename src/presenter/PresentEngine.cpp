@@ -22,6 +22,9 @@
 #include "glload/wgl_all.h"
 
 HRESULT FindAdapter(IDirect3D9 *pD3D9, HMONITOR hMonitor, UINT *puAdapterID);
+UINT64  SurfaceBytes(D3DFORMAT format, UINT width, UINT height);
+
+bool D3DPresentEngine::s_bUseSharedDeviceByDefault = false;
 
 //-----------------------------------------------------------------------------
 // Constructor
@@ -34,19 +37,50 @@ D3DPresentEngine::D3DPresentEngine(HRESULT& hr) :
     m_pDevice(NULL),
     m_pDeviceManager(NULL),
     m_pSurfaceRepaint(NULL),
+    m_pSharedDevice(NULL),
+    m_SharedDeviceGeneration(0),
+    m_DeviceGeneration(0),
+    m_GLDeviceGeneration(0),
+    m_cbSamples(0),
+    m_cbSharedTextures(0),
 	gl_handleD3D(NULL),
-	d3d_shared_texture(NULL),
-	d3d_shared_surface(NULL)
+	m_cSharedTextures(0),
+	m_ReadSlot(MAILBOX_NONE),
+	m_bHeadless(false),
+	m_bZeroCopy(false),
+	m_SurfaceWidth(0),
+	m_SurfaceHeight(0),
+	m_cGLSurfaces(0),
+	m_GLGeneration(0),
+	m_LockedSurface(SHARED_SURFACE_NONE)
 {
     SetRectEmpty(&m_rcDestRect);
 
-    ZeroMemory(&m_DisplayMode, sizeof(m_DisplayMode));
+    ZeroMemory(gl_names, sizeof(gl_names));
+    ZeroMemory(gl_handles, sizeof(gl_handles));
+    ZeroMemory(d3d_shared_surfaces, sizeof(d3d_shared_surfaces));
+    ZeroMemory(d3d_shared_textures, sizeof(d3d_shared_textures));
+    ZeroMemory(m_pSurfaceTextures, sizeof(m_pSurfaceTextures));
+    ZeroMemory(m_pSurfaces, sizeof(m_pSurfaces));
+    ZeroMemory(m_SurfaceShareHandles, sizeof(m_SurfaceShareHandles));
+    ZeroMemory(m_pHeldSamples, sizeof(m_pHeldSamples));
+    ZeroMemory(m_pGLTextures, sizeof(m_pGLTextures));
+    ZeroMemory(m_GLHandles, sizeof(m_GLHandles));
 
-    hr = InitializeD3D();
+    ZeroMemory(&m_DisplayMode, sizeof(m_DisplayMode));
 
-    if (SUCCEEDED(hr))
+    if (s_bUseSharedDeviceByDefault && SUCCEEDED(SharedDeviceService::Acquire(&m_pSharedDevice)))
     {
-       hr = CreateD3DDevice();
+        hr = AdoptSharedDevice();
+    }
+    else
+    {
+        hr = InitializeD3D();
+
+        if (SUCCEEDED(hr))
+        {
+           hr = CreateD3DDevice();
+        }
     }
 
 	//bool nvdxInteropEnabled = false;
@@ -68,18 +102,177 @@ D3DPresentEngine::~D3DPresentEngine()
 		releaseSharedTexture() ;
 
 		CI_LOG_I("Killing present engine.....");
-		if (wglDXCloseDeviceNV(gl_handleD3D)) 
-		{
-			CI_LOG_I( "SUCCESS" );
-		}
-		else {
-			CI_LOG_I( "FAILED closing handle" );
-		}
+		CloseGLDevice();
 	}
+    ReleaseZeroCopySurfaces();
+    UpdateVideoMemory(m_cbSamples, 0);
     SAFE_RELEASE(m_pDevice);
     SAFE_RELEASE(m_pSurfaceRepaint);
     SAFE_RELEASE(m_pDeviceManager);
     SAFE_RELEASE(m_pD3D9);
+
+    if (m_pSharedDevice)
+    {
+        SharedDeviceService::Release();
+    }
+}
+
+//-----------------------------------------------------------------------------
+// Shared device
+//-----------------------------------------------------------------------------
+
+HRESULT D3DPresentEngine::setUseSharedDevice(bool shared)
+{
+    HRESULT hr = S_OK;
+
+    AutoLock lock(m_ObjectLock);
+
+    if (shared == (m_pSharedDevice != NULL))
+    {
+        return S_OK;
+    }
+
+    // GL has textures registered with the current device.
+    if (gl_handleD3D != NULL)
+    {
+        return MF_E_INVALIDREQUEST;
+    }
+
+    ReleaseResources();
+
+    SAFE_RELEASE(m_pDevice);
+    SAFE_RELEASE(m_pDeviceManager);
+    SAFE_RELEASE(m_pD3D9);
+
+    if (shared)
+    {
+        hr = SharedDeviceService::Acquire(&m_pSharedDevice);
+    }
+    else
+    {
+        SharedDeviceService::Release();
+        m_pSharedDevice = NULL;
+    }
+
+    if (m_pSharedDevice)
+    {
+        return AdoptSharedDevice();
+    }
+
+    // A device of our own, also if the shared one could not be created.
+    HRESULT hrOwn = InitializeD3D();
+
+    if (SUCCEEDED(hrOwn))
+    {
+        hrOwn = CreateD3DDevice();
+    }
+    return FAILED(hr) ? hr : hrOwn;
+}
+
+//-----------------------------------------------------------------------------
+// AdoptSharedDevice
+//
+// Takes the shared service's current device, device manager and display
+// mode in place of our own.
+//-----------------------------------------------------------------------------
+
+HRESULT D3DPresentEngine::AdoptSharedDevice()
+{
+    AutoLock lock(m_ObjectLock);
+
+    SAFE_RELEASE(m_pDevice);
+    SAFE_RELEASE(m_pDeviceManager);
+    SAFE_RELEASE(m_pD3D9);
+
+    HRESULT hr = m_pSharedDevice->GetDevice(&m_pD3D9, &m_pDevice, &m_pDeviceManager, &m_SharedDeviceGeneration);
+
+    if (SUCCEEDED(hr))
+    {
+        m_DisplayMode = m_pSharedDevice->DisplayMode();
+        m_DeviceGeneration++;
+    }
+    return hr;
+}
+
+//-----------------------------------------------------------------------------
+// OpenGLDevice / CloseGLDevice
+//
+// The WGL_NV_DX_interop handle for our device. With the shared device, every
+// presenter uses the service's single handle. Call on the GL thread, with
+// the object lock held.
+//-----------------------------------------------------------------------------
+
+HANDLE D3DPresentEngine::OpenGLDevice()
+{
+    m_GLDeviceGeneration = m_DeviceGeneration.load();
+
+    return m_pSharedDevice ? m_pSharedDevice->AcquireGLDevice() : wglDXOpenDeviceNV(m_pDevice);
+}
+
+void D3DPresentEngine::CloseGLDevice()
+{
+    if (m_pSharedDevice)
+    {
+        m_pSharedDevice->ReleaseGLDevice();
+    }
+    else if (wglDXCloseDeviceNV(gl_handleD3D))
+    {
+        CI_LOG_I( "SUCCESS" );
+    }
+    else {
+        CI_LOG_I( "FAILED closing handle" );
+    }
+    gl_handleD3D = NULL;
+}
+
+bool D3DPresentEngine::canOpenGLDevice()
+{
+    return m_pSharedDevice == NULL || m_pSharedDevice->CanOpenGLDevice();
+}
+
+//-----------------------------------------------------------------------------
+// releaseGLDevice
+//
+// Unregisters and deletes every GL object registered with the interop
+// handle, then closes the handle. Call on the GL thread.
+//-----------------------------------------------------------------------------
+
+void D3DPresentEngine::releaseGLDevice()
+{
+    AutoLock lock(m_ObjectLock);
+
+    if (gl_handleD3D == NULL)
+    {
+        return;
+    }
+
+    releaseSharedTexture();
+    CloseGLDevice();
+}
+
+//-----------------------------------------------------------------------------
+// Video memory accounting
+//-----------------------------------------------------------------------------
+
+void D3DPresentEngine::UpdateVideoMemory(std::atomic<UINT64>& counter, UINT64 cb)
+{
+    const UINT64 cbOld = counter.exchange(cb);
+
+    if (m_pSharedDevice)
+    {
+        m_pSharedDevice->AddVideoMemory((INT64)cb - (INT64)cbOld);
+    }
+}
+
+void D3DPresentEngine::getVideoMemoryUsage(VideoMemoryUsage *pUsage)
+{
+    pUsage->samples = m_cbSamples.load();
+    pUsage->sharedTextures = m_cbSharedTextures.load();
+    pUsage->sharedDeviceTotal = m_pSharedDevice ? SharedDeviceService::VideoMemory() : 0;
+
+    AutoLock lock(m_ObjectLock);
+
+    pUsage->available = m_pDevice ? (UINT64)m_pDevice->GetAvailableTextureMem() : 0;
 }
 
 
@@ -89,70 +282,299 @@ D3DPresentEngine::~D3DPresentEngine()
 
 bool D3DPresentEngine::createSharedTexture(int w, int h, int textureID)
 {
+	GLuint name = textureID;
+	return createSharedTextures(w, h, &name, 1);
+}
+
+//-----------------------------------------------------------------------------
+// createSharedTextures
+//
+// Creates a ring of shared textures, one per GL texture name. The scheduler
+// copies each frame into a slot GL is not reading and publishes it; GL
+// locks the newest published slot. See TextureMailbox.
+//
+// The GL names are ours from here on: registering gives them their storage,
+// and ReleaseSharedTextures deletes them, also if this fails. Call on the GL
+// thread.
+//-----------------------------------------------------------------------------
+
+bool D3DPresentEngine::createSharedTextures(int w, int h, const GLuint *textureIDs, int count)
+{
+	AutoLock lock(m_ObjectLock);
+
+	ReleaseSharedTextures();
+
 	_w = w;
 	_h = h;
-	if (gl_handleD3D == NULL ) 	gl_handleD3D = wglDXOpenDeviceNV(m_pDevice);
+	if (gl_handleD3D == NULL ) 	gl_handleD3D = OpenGLDevice();
 
 	if (!gl_handleD3D)
 	{
 		CI_LOG_E( "Opening the shared device failed - Create SharedTexture Failed" );
 		return false;
 	}
-	gl_name=textureID;
-	HANDLE sharedHandle = NULL; //We need to create a shared handle for the ressource, otherwise the extension fails on ATI/Intel cards
-	HRESULT hr = m_pDevice->CreateTexture(w,h,1,D3DUSAGE_RENDERTARGET,D3DFMT_A8R8G8B8,D3DPOOL_DEFAULT,&d3d_shared_texture,&sharedHandle);
 
-	if (FAILED(hr))
+	if (count > SHARED_TEXTURE_MAX) count = SHARED_TEXTURE_MAX;
+
+	// Take every name now so that a failure below deletes them all.
+	for (int i = 0; i < count; i++)
 	{
-		CI_LOG_E( "Error creating D3DTexture" );
-		return false;
+		gl_names[i] = textureIDs[i];
 	}
+	m_cSharedTextures = count;
 
-	if (!sharedHandle)
+	for (int i = 0; i < count; i++)
 	{
-		CI_LOG_E( "Error creating D3D shared handle" );
-		return false;
-	}
-	
-	wglDXSetResourceShareHandleNV(d3d_shared_texture,sharedHandle);
+		HANDLE sharedHandle = NULL; //We need to create a shared handle for the ressource, otherwise the extension fails on ATI/Intel cards
+		HRESULT hr = m_pDevice->CreateTexture(w,h,1,D3DUSAGE_RENDERTARGET,D3DFMT_A8R8G8B8,D3DPOOL_DEFAULT,&d3d_shared_textures[i],&sharedHandle);
+
+		if (FAILED(hr))
+		{
+			CI_LOG_E( "Error creating D3DTexture" );
+			ReleaseSharedTextures();
+			return false;
+		}
+
+		if (!sharedHandle)
+		{
+			CI_LOG_E( "Error creating D3D shared handle" );
+			ReleaseSharedTextures();
+			return false;
+		}
 
-	d3d_shared_texture->GetSurfaceLevel(0,&d3d_shared_surface);
-		
-	gl_handle = wglDXRegisterObjectNV(gl_handleD3D, d3d_shared_texture,
-		gl_name,
-		GL_TEXTURE_RECTANGLE,
-		WGL_ACCESS_READ_ONLY_NV);
+		wglDXSetResourceShareHandleNV(d3d_shared_textures[i],sharedHandle);
 
-	if (!gl_handle) 
-	{
-		CI_LOG_E("Opening the shared texture failed - Create SharedTexture Failed");
-		return false;
+		d3d_shared_textures[i]->GetSurfaceLevel(0,&d3d_shared_surfaces[i]);
+
+		gl_handles[i] = wglDXRegisterObjectNV(gl_handleD3D, d3d_shared_textures[i],
+			gl_names[i],
+			GL_TEXTURE_RECTANGLE,
+			WGL_ACCESS_READ_ONLY_NV);
+
+		if (!gl_handles[i])
+		{
+			CI_LOG_E("Opening the shared texture failed - Create SharedTexture Failed");
+			ReleaseSharedTextures();
+			return false;
+		}
 	}
+
+	m_SharedMailbox.Reset(count);
+	UpdateVideoMemory(m_cbSharedTextures, SurfaceBytes(D3DFMT_A8R8G8B8, w, h) * count);
 	return true;
 }
 
 void D3DPresentEngine::releaseSharedTexture()
 {
 	if (!gl_handleD3D) return;
-	wglDXUnlockObjectsNV(gl_handleD3D, 1, &gl_handle);
-	//wglDXUnregisterObjectNV(gl_handleD3D,gl_handle);	// Apparently causes access violations?
-	//glDeleteTextures(1, &gl_name);
-	SAFE_RELEASE(d3d_shared_surface);
-	SAFE_RELEASE(d3d_shared_texture);
+	UnregisterSharedSurfaces();
+	ReleaseSharedTextures();
+}
+
+//-----------------------------------------------------------------------------
+// ReleaseSharedTextures
+//
+// Undoes createSharedTextures: unregisters each texture from the interop
+// device, deletes its GL name, then releases the D3D texture. Call on the GL
+// thread, with the context current and before the interop device is closed.
+// Without a context the GL objects cannot be freed, and are abandoned.
+//-----------------------------------------------------------------------------
+
+void D3DPresentEngine::ReleaseSharedTextures()
+{
+	AutoLock lock(m_ObjectLock);
+
+	const bool bGLCurrent = (wglGetCurrentContext() != NULL);
+
+	if (m_cSharedTextures > 0 && !bGLCurrent)
+	{
+		CI_LOG_W( "Releasing shared textures without a GL context; their GL objects are leaked" );
+	}
 
+	if (m_ReadSlot != MAILBOX_NONE)
+	{
+		if (bGLCurrent)
+		{
+			wglDXUnlockObjectsNV(gl_handleD3D, 1, &gl_handles[m_ReadSlot]);
+		}
+		m_SharedMailbox.EndRead(m_ReadSlot);
+		m_ReadSlot = MAILBOX_NONE;
+	}
+
+	for (int i = 0; i < m_cSharedTextures; i++)
+	{
+		// Unregister before the D3D texture goes: the driver still refers to it.
+		if (gl_handles[i] && bGLCurrent)
+		{
+			wglDXUnregisterObjectNV(gl_handleD3D, gl_handles[i]);
+		}
+		if (gl_names[i] && bGLCurrent)
+		{
+			glDeleteTextures(1, &gl_names[i]);
+		}
+		gl_handles[i] = NULL;
+		gl_names[i] = 0;
+		SAFE_RELEASE(d3d_shared_surfaces[i]);
+		SAFE_RELEASE(d3d_shared_textures[i]);
+	}
+
+	m_cSharedTextures = 0;
+	UpdateVideoMemory(m_cbSharedTextures, 0);
 }
+
 bool D3DPresentEngine::lockSharedTexture()
 {
+	WMF_TRACE_ZONE("wglDXLockObjectsNV");
 	if (!gl_handleD3D) return false;
-	if (!gl_handle) return false;
-	return wglDXLockObjectsNV(gl_handleD3D, 1, &gl_handle);
+
+	if (m_bZeroCopy)
+	{
+		if (m_LockedSurface != SHARED_SURFACE_NONE) return true;
+
+		// Claim the latest presented surface so the presenter keeps it from
+		// the mixer until we unlock.
+		int index = m_SurfaceTracker.Acquire(m_GLGeneration);
+
+		if (index < 0 || index >= m_cGLSurfaces || !wglDXLockObjectsNV(gl_handleD3D, 1, &m_GLHandles[index]))
+		{
+			m_SurfaceTracker.Release();
+			return false;
+		}
+		m_LockedSurface = index;
+		return true;
+	}
+
+	if (m_ReadSlot != MAILBOX_NONE) return true;
+
+	// The newest fully copied slot. The scheduler copies into other slots
+	// meanwhile, so holding this lock never stalls it.
+	int slot = m_SharedMailbox.BeginRead();
+
+	if (slot == MAILBOX_NONE) return false;
+
+	if (slot >= m_cSharedTextures || !wglDXLockObjectsNV(gl_handleD3D, 1, &gl_handles[slot]))
+	{
+		m_SharedMailbox.EndRead(slot);
+		return false;
+	}
+	m_ReadSlot = slot;
+	return true;
 }
 
 bool D3DPresentEngine::unlockSharedTexture()
 {
+	WMF_TRACE_ZONE("wglDXUnlockObjectsNV");
 	if (!gl_handleD3D) return false;
-	if (!gl_handle) return false;
-	return wglDXUnlockObjectsNV(gl_handleD3D, 1, &gl_handle);
+
+	if (m_bZeroCopy)
+	{
+		if (m_LockedSurface == SHARED_SURFACE_NONE) return false;
+
+		BOOL bUnlocked = wglDXUnlockObjectsNV(gl_handleD3D, 1, &m_GLHandles[m_LockedSurface]);
+
+		m_SurfaceTracker.Release();
+		m_LockedSurface = SHARED_SURFACE_NONE;
+		return bUnlocked != FALSE;
+	}
+
+	if (m_ReadSlot == MAILBOX_NONE) return false;
+
+	BOOL bUnlocked = wglDXUnlockObjectsNV(gl_handleD3D, 1, &gl_handles[m_ReadSlot]);
+
+	m_SharedMailbox.EndRead(m_ReadSlot);
+	m_ReadSlot = MAILBOX_NONE;
+	return bUnlocked != FALSE;
+}
+
+//-----------------------------------------------------------------------------
+// registerSharedSurfaces
+//
+// Zero-copy mode. Registers one GL texture per shared surface of the given
+// generation, replacing the previous registration. Call on the GL thread.
+// Fails if the surfaces were re-created since the generation was read; the
+// caller should try again with the new generation.
+//-----------------------------------------------------------------------------
+
+bool D3DPresentEngine::registerSharedSurfaces(UINT generation, const GLuint *pNames, int count)
+{
+	AutoLock lock(m_ObjectLock);
+
+	if (gl_handleD3D == NULL) gl_handleD3D = OpenGLDevice();
+
+	if (!gl_handleD3D)
+	{
+		CI_LOG_E( "Opening the shared device failed - Register shared surfaces failed" );
+		return false;
+	}
+
+	UnregisterSharedSurfaces();
+
+	if (generation != m_SurfaceTracker.Generation() || count != m_SurfaceTracker.Count())
+	{
+		return false;
+	}
+
+	for (int i = 0; i < count; i++)
+	{
+		if (!m_pSurfaceTextures[i] || !m_SurfaceShareHandles[i])
+		{
+			UnregisterSharedSurfaces();
+			return false;
+		}
+
+		wglDXSetResourceShareHandleNV(m_pSurfaceTextures[i], m_SurfaceShareHandles[i]);
+
+		m_GLHandles[i] = wglDXRegisterObjectNV(gl_handleD3D, m_pSurfaceTextures[i],
+			pNames[i],
+			GL_TEXTURE_RECTANGLE,
+			WGL_ACCESS_READ_ONLY_NV);
+
+		if (!m_GLHandles[i])
+		{
+			CI_LOG_E( "Registering shared surface " << i << " failed" );
+			UnregisterSharedSurfaces();
+			return false;
+		}
+
+		m_pGLTextures[i] = m_pSurfaceTextures[i];
+		m_pGLTextures[i]->AddRef();
+		m_cGLSurfaces++;
+	}
+
+	m_GLGeneration = generation;
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// UnregisterSharedSurfaces
+//
+// Undoes registerSharedSurfaces. Call on the GL thread, before the GL
+// textures are deleted.
+//-----------------------------------------------------------------------------
+
+void D3DPresentEngine::UnregisterSharedSurfaces()
+{
+	AutoLock lock(m_ObjectLock);
+
+	if (m_LockedSurface != SHARED_SURFACE_NONE)
+	{
+		wglDXUnlockObjectsNV(gl_handleD3D, 1, &m_GLHandles[m_LockedSurface]);
+		m_SurfaceTracker.Release();
+		m_LockedSurface = SHARED_SURFACE_NONE;
+	}
+
+	for (int i = 0; i < SHARED_SURFACE_MAX; i++)
+	{
+		if (m_GLHandles[i])
+		{
+			wglDXUnregisterObjectNV(gl_handleD3D, m_GLHandles[i]);
+			m_GLHandles[i] = NULL;
+		}
+		SAFE_RELEASE(m_pGLTextures[i]);
+	}
+
+	m_cGLSurfaces = 0;
+	m_GLGeneration = 0;
 }
 
 
@@ -297,6 +719,7 @@ HRESULT D3DPresentEngine::SetDestinationRect(const RECT& rcDest)
 // single back buffer. The video sample object holds a pointer to the swap
 // chain's back buffer surface. The mixer renders to this surface, and the
 // D3DPresentEngine renders the video frame by presenting the swap chain.
+// In headless mode the samples hold plain render targets instead.
 //-----------------------------------------------------------------------------
 
 HRESULT D3DPresentEngine::CreateVideoSamples(
@@ -304,7 +727,7 @@ HRESULT D3DPresentEngine::CreateVideoSamples(
     VideoSampleList& videoSampleQueue
     )
 {
-    if (m_hwnd == NULL)
+    if (m_hwnd == NULL && !m_bHeadless)
     {
         return MF_E_INVALIDREQUEST;
     }
@@ -329,31 +752,46 @@ HRESULT D3DPresentEngine::CreateVideoSamples(
 
     UpdateDestRect();
 
-    // Create the video samples.
-    for (int i = 0; i < PRESENTER_BUFFER_COUNT; i++)
+    if (m_bZeroCopy)
     {
-        // Create a new swap chain.
-        CHECK_HR(hr = m_pDevice->CreateAdditionalSwapChain(&pp, &pSwapChain));
+        // No swap chains: the mixer renders straight into surfaces shared with GL.
+        CHECK_HR(hr = CreateZeroCopySamples(pFormat, videoSampleQueue));
+    }
+    else if (m_bHeadless)
+    {
+        // No swap chains: frames are only copied to the shared textures.
+        CHECK_HR(hr = CreateHeadlessSamples(pp, videoSampleQueue));
+    }
+    else
+    {
+        // Create the video samples.
+        for (int i = 0; i < PRESENTER_BUFFER_COUNT; i++)
+        {
+            // Create a new swap chain.
+            CHECK_HR(hr = m_pDevice->CreateAdditionalSwapChain(&pp, &pSwapChain));
 
-        
-        // Create the video sample from the swap chain.
-        CHECK_HR(hr = CreateD3DSample(pSwapChain, &pVideoSample));
+            // Create the video sample from the swap chain.
+            CHECK_HR(hr = CreateD3DSample(pSwapChain, &pVideoSample));
 
-        // Add it to the list.
-        CHECK_HR(hr = videoSampleQueue.InsertBack(pVideoSample));
+            // Add it to the list.
+            CHECK_HR(hr = videoSampleQueue.InsertBack(pVideoSample));
 
-        // Set the swap chain pointer as a custom attribute on the sample. This keeps
-        // a reference count on the swap chain, so that the swap chain is kept alive
-        // for the duration of the sample's lifetime.
-        CHECK_HR(hr = pVideoSample->SetUnknown(MFSamplePresenter_SampleSwapChain, pSwapChain));
+            // Set the swap chain pointer as a custom attribute on the sample. This keeps
+            // a reference count on the swap chain, so that the swap chain is kept alive
+            // for the duration of the sample's lifetime.
+            CHECK_HR(hr = pVideoSample->SetUnknown(MFSamplePresenter_SampleSwapChain, pSwapChain));
 
-        SAFE_RELEASE(pVideoSample);
-        SAFE_RELEASE(pSwapChain);
+            SAFE_RELEASE(pVideoSample);
+            SAFE_RELEASE(pSwapChain);
+        }
     }
 
     // Let the derived class create any additional D3D resources that it needs.
     CHECK_HR(hr = OnCreateVideoSamples(pp));
 
+    UpdateVideoMemory(m_cbSamples, SurfaceBytes(pp.BackBufferFormat, pp.BackBufferWidth, pp.BackBufferHeight) *
+        (m_bZeroCopy ? ZERO_COPY_BUFFER_COUNT : PRESENTER_BUFFER_COUNT));
+
 done:
     if (FAILED(hr))
     {
@@ -378,6 +816,9 @@ void D3DPresentEngine::ReleaseResources()
     // Let the derived class release any resources it created.
     OnReleaseResources();
 
+    ReleaseZeroCopySurfaces();
+    UpdateVideoMemory(m_cbSamples, 0);
+
     SAFE_RELEASE(m_pSurfaceRepaint);
 }
 
@@ -396,11 +837,19 @@ HRESULT D3DPresentEngine::CheckDeviceState(DeviceState *pState)
 
     AutoLock lock(m_ObjectLock);
 
+    *pState = DeviceOK;
+
+    // Another presenter replaced the shared device.
+    if (m_pSharedDevice && m_pSharedDevice->Generation() != m_SharedDeviceGeneration)
+    {
+        CHECK_HR(hr = AdoptSharedDevice());
+        *pState = DeviceReset;
+        return S_OK;
+    }
+
     // Check the device state. Not every failure code is a critical failure.
     hr = m_pDevice->CheckDeviceState(m_hwnd);
 
-    *pState = DeviceOK;
-
     switch (hr)
     {
     case S_OK:
@@ -413,6 +862,10 @@ HRESULT D3DPresentEngine::CheckDeviceState(DeviceState *pState)
     case D3DERR_DEVICELOST:
     case D3DERR_DEVICEHUNG:
         // Lost/hung device. Destroy the device and create a new one.
+        if (m_pSharedDevice)
+        {
+            CHECK_HR(hr = m_pSharedDevice->RecreateDevice(m_pDevice));
+        }
         CHECK_HR(hr = CreateD3DDevice());
         *pState = DeviceReset;
         hr = S_OK;
@@ -448,6 +901,19 @@ done:
 
 HRESULT D3DPresentEngine::PresentSample(IMFSample* pSample, LONGLONG llTarget)
 {
+    WMF_TRACE_ZONE("PresentSample");
+
+    if (m_bZeroCopy)
+    {
+        HRESULT hrZeroCopy = PresentZeroCopySample(pSample);
+
+        if (pSample && SUCCEEDED(hrZeroCopy))
+        {
+            PublishPresentedFrame(pSample);
+        }
+        return hrZeroCopy;
+    }
+
     HRESULT hr = S_OK;
 
     IMFMediaBuffer* pBuffer = NULL;
@@ -469,7 +935,14 @@ HRESULT D3DPresentEngine::PresentSample(IMFSample* pSample, LONGLONG llTarget)
         pSurface->AddRef();
     }
 
-    if (pSurface)
+    if (pSurface && m_bHeadless)
+    {
+        // Plain render target: copy it for GL and skip the window.
+        CopyToSharedTexture(pSurface);
+
+        CopyComPointer(m_pSurfaceRepaint, pSurface);
+    }
+    else if (pSurface)
     {
         // Get the swap chain from the surface.
         CHECK_HR(hr = pSurface->GetContainer(__uuidof(IDirect3DSwapChain9), (LPVOID*)&pSwapChain));
@@ -480,12 +953,17 @@ HRESULT D3DPresentEngine::PresentSample(IMFSample* pSample, LONGLONG llTarget)
         // Store this pointer in case we need to repaint the surface.
         CopyComPointer(m_pSurfaceRepaint, pSurface);
     }
-    else
+    else if (!m_bHeadless)
     {
         // No surface. All we can do is paint a black rectangle.
         PaintFrameWithGDI();
     }
 
+    if (pSample)
+    {
+        PublishPresentedFrame(pSample);
+    }
+
 done:
     SAFE_RELEASE(pSwapChain);
     SAFE_RELEASE(pSurface);
@@ -496,7 +974,10 @@ done:
         if (hr == D3DERR_DEVICELOST || hr == D3DERR_DEVICENOTRESET || hr == D3DERR_DEVICEHUNG)
         {
             // We failed because the device was lost. Fill the destination rectangle.
-            PaintFrameWithGDI();
+            if (!m_bHeadless)
+            {
+                PaintFrameWithGDI();
+            }
 
             // Ignore. We need to reset or re-create the device, but this method
             // is probably being called from the scheduler thread, which is not the
@@ -513,6 +994,111 @@ done:
 
 
 
+//-----------------------------------------------------------------------------
+// RefreshPeriod
+//
+// The display's refresh period, in 100ns units. The display mode only has
+// whole hertz, and reports NTSC rates such as 59.94 Hz as 59; those are
+// taken as the 1000/1001 rate of the next whole one.
+//-----------------------------------------------------------------------------
+
+double D3DPresentEngine::RefreshPeriod() const
+{
+    DWM_TIMING_INFO timing;
+    ZeroMemory(&timing, sizeof(timing));
+    timing.cbSize = sizeof(timing);
+
+    if (SUCCEEDED(DwmGetCompositionTimingInfo(NULL, &timing)) &&
+        timing.rateRefresh.uiNumerator != 0 && timing.rateRefresh.uiDenominator != 0)
+    {
+        return 10000000.0 * timing.rateRefresh.uiDenominator / timing.rateRefresh.uiNumerator;
+    }
+
+    UINT hz = m_DisplayMode.RefreshRate;
+
+    switch (hz)
+    {
+    case 0:
+        return 0;
+
+    case 23: case 29: case 47: case 59: case 119:
+        return 10000000.0 * 1001 / ((hz + 1) * 1000);
+
+    default:
+        return 10000000.0 / hz;
+    }
+}
+
+//-----------------------------------------------------------------------------
+// GetVblankTiming
+//
+// How long ago the last vertical blank was, for cadence planning. Called on
+// the scheduler thread for every frame, so it must be cheap.
+//
+// With desktop composition, DWM reports the blank's performance counter
+// value and the exact refresh rate. Without it, the device's raster status
+// gives the current scan line, which puts the blank within the blanking
+// interval (well under a millisecond).
+//-----------------------------------------------------------------------------
+
+HRESULT D3DPresentEngine::GetVblankTiming(LONGLONG *phnsSinceVblank, double *phnsRefresh)
+{
+    HRESULT hr = S_OK;
+    LARGE_INTEGER qpcNow;
+    LARGE_INTEGER qpcFrequency;
+
+    DWM_TIMING_INFO timing;
+    ZeroMemory(&timing, sizeof(timing));
+    timing.cbSize = sizeof(timing);
+
+    double hnsRefresh = RefreshPeriod();
+
+    if (hnsRefresh <= 0)
+    {
+        return E_FAIL;
+    }
+
+    QueryPerformanceCounter(&qpcNow);
+    QueryPerformanceFrequency(&qpcFrequency);
+
+    if (SUCCEEDED(DwmGetCompositionTimingInfo(NULL, &timing)) && timing.qpcVBlank != 0)
+    {
+        // DWM can report the next blank rather than the last one.
+        double hnsSince = (double)((LONGLONG)qpcNow.QuadPart - (LONGLONG)timing.qpcVBlank) * 10000000.0 / qpcFrequency.QuadPart;
+
+        hnsSince = fmod(hnsSince, hnsRefresh);
+        if (hnsSince < 0)
+        {
+            hnsSince += hnsRefresh;
+        }
+
+        *phnsSinceVblank = (LONGLONG)hnsSince;
+        *phnsRefresh = hnsRefresh;
+        return S_OK;
+    }
+
+    D3DRASTER_STATUS raster;
+    ZeroMemory(&raster, sizeof(raster));
+
+    {
+        AutoLock lock(m_ObjectLock);
+
+        if (m_pDevice == NULL || m_DisplayMode.Height == 0)
+        {
+            return E_FAIL;
+        }
+        CHECK_HR(hr = m_pDevice->GetRasterStatus(0, &raster));
+    }
+
+    // The visible lines take almost all of the period.
+    *phnsSinceVblank = raster.InVBlank ? 0 : (LONGLONG)(hnsRefresh * raster.ScanLine / m_DisplayMode.Height);
+    *phnsRefresh = hnsRefresh;
+
+done:
+    return hr;
+}
+
+
 //-----------------------------------------------------------------------------
 // private/protected methods
 //-----------------------------------------------------------------------------
@@ -563,6 +1149,12 @@ HRESULT D3DPresentEngine::CreateD3DDevice()
     // Hold the lock because we might be discarding an exisiting device.
     AutoLock lock(m_ObjectLock);    
 
+    // The shared device follows no window; take whatever the service has.
+    if (m_pSharedDevice)
+    {
+        return AdoptSharedDevice();
+    }
+
     if (!m_pD3D9 || !m_pDeviceManager)
     {
         return MF_E_NOT_INITIALIZED;
@@ -634,6 +1226,7 @@ HRESULT D3DPresentEngine::CreateD3DDevice()
 
     m_pDevice = pDevice;
     m_pDevice->AddRef();
+    m_DeviceGeneration++;
 
 done:
     SAFE_RELEASE(pDevice);
@@ -697,11 +1290,7 @@ HRESULT D3DPresentEngine::PresentSwapChain(IDirect3DSwapChain9* pSwapChain, IDir
 	//pSwapChain->GetFrontBufferData(d3d_shared_surface);
 	IDirect3DSurface9 *surface;
 	pSwapChain->GetBackBuffer(0,D3DBACKBUFFER_TYPE_MONO,&surface);
-    if (m_pDevice->StretchRect(surface,NULL,d3d_shared_surface,NULL,D3DTEXF_NONE) != D3D_OK)
-	{
-		CI_LOG_E("Error while copying texture to gl context");
-		//printf("ciWMFVideoplayer: Error while copying texture to gl context \n");
-	}
+	CopyToSharedTexture(surface);
 	SAFE_RELEASE(surface);
 
 	//-----------------------------------------------------------------------------
@@ -714,13 +1303,289 @@ HRESULT D3DPresentEngine::PresentSwapChain(IDirect3DSwapChain9* pSwapChain, IDir
         return MF_E_INVALIDREQUEST;
     }
 	
-    hr = pSwapChain->Present(NULL, &m_rcDestRect, m_hwnd, NULL, 0);
+    {
+        WMF_TRACE_ZONE("SwapChain Present");
+        hr = pSwapChain->Present(NULL, &m_rcDestRect, m_hwnd, NULL, 0);
+    }
 	
     LOG_MSG_IF_FAILED(L"D3DPresentEngine::PresentSwapChain, IDirect3DSwapChain9::Present failed.", hr);
 	
     return hr;
 }
 
+//-----------------------------------------------------------------------------
+// CopyToSharedTexture
+//
+// Copies a video frame into a shared texture slot GL is not reading, then
+// makes it the newest. Called on the scheduler thread.
+//-----------------------------------------------------------------------------
+
+void D3DPresentEngine::CopyToSharedTexture(IDirect3DSurface9* pSurface)
+{
+	WMF_TRACE_ZONE("StretchRect");
+	AutoLock lock(m_ObjectLock);
+
+	// The textures belong to a device that has been replaced; GL re-creates them.
+	if (m_GLDeviceGeneration != m_DeviceGeneration.load())
+	{
+		return;
+	}
+
+	int slot = (m_cSharedTextures > 0) ? m_SharedMailbox.BeginWrite() : MAILBOX_NONE;
+
+	if (slot == MAILBOX_NONE)
+	{
+		return;
+	}
+
+	if (m_pDevice->StretchRect(pSurface,NULL,d3d_shared_surfaces[slot],NULL,D3DTEXF_NONE) == D3D_OK)
+	{
+		m_SharedMailbox.Publish(slot);
+	}
+	else
+	{
+		m_SharedMailbox.CancelWrite(slot);
+
+		// Runs on the scheduler thread; queue the message rather than log synchronously.
+		WMF_LOG_ERROR(L"Error while copying texture to gl context\n");
+	}
+}
+
+//-----------------------------------------------------------------------------
+// PublishPresentedFrame
+//
+// Records a sample that was just presented in m_PresentedFrame and the loop
+// and seek monitors. Repaints (no sample) are not new frames and are not
+// recorded.
+//-----------------------------------------------------------------------------
+
+void D3DPresentEngine::PublishPresentedFrame(IMFSample* pSample)
+{
+	LONGLONG hnsTime = 0;
+	LONGLONG hnsDuration = 0;
+
+	// Either can be missing; the frame was still presented.
+	(void)pSample->GetSampleTime(&hnsTime);
+	(void)pSample->GetSampleDuration(&hnsDuration);
+
+	// PresentSample can be called by the scheduler and the presenter.
+	AutoLock lock(m_ObjectLock);
+
+	const LONGLONG hnsNow = MFGetSystemTime();
+
+	m_PresentedFrame.Publish(hnsTime, hnsDuration, hnsNow);
+	m_LoopMonitor.OnFramePresented(hnsTime, hnsDuration, hnsNow);
+	m_SeekMonitor.OnFramePresented(hnsTime, hnsNow);
+}
+
+//-----------------------------------------------------------------------------
+// isBeforeSeekTarget
+//
+// Whether a frame the mixer just output comes before the target of a
+// frame-accurate seek, and should be dropped instead of presented. Called
+// by the presenter for each new (not repainted) frame.
+//-----------------------------------------------------------------------------
+
+bool D3DPresentEngine::isBeforeSeekTarget(IMFSample* pSample)
+{
+	LONGLONG hnsTime = 0;
+	LONGLONG hnsDuration = 0;
+
+	// Without a time stamp there is no telling; show the frame.
+	if (FAILED(pSample->GetSampleTime(&hnsTime)))
+	{
+		return false;
+	}
+	(void)pSample->GetSampleDuration(&hnsDuration);
+
+	return m_SeekMonitor.OnFrameDecoded(hnsTime, hnsDuration);
+}
+
+//-----------------------------------------------------------------------------
+// CreateHeadlessSamples
+//
+// Creates the video samples for headless mode. Each sample holds a plain
+// render-target surface in the swap chain's format: no swap chain, no
+// extra back buffer. Caller holds the object lock.
+//-----------------------------------------------------------------------------
+
+HRESULT D3DPresentEngine::CreateHeadlessSamples(const D3DPRESENT_PARAMETERS& pp, VideoSampleList& videoSampleQueue)
+{
+    HRESULT hr = S_OK;
+    D3DCOLOR clrBlack = D3DCOLOR_ARGB(0xFF, 0x00, 0x00, 0x00);
+
+    IDirect3DSurface9 *pSurface = NULL;
+    IMFSample *pVideoSample = NULL;
+
+    for (DWORD i = 0; i < PRESENTER_BUFFER_COUNT; i++)
+    {
+        CHECK_HR(hr = m_pDevice->CreateRenderTarget(pp.BackBufferWidth, pp.BackBufferHeight,
+            pp.BackBufferFormat, D3DMULTISAMPLE_NONE, 0, FALSE, &pSurface, NULL));
+
+        CHECK_HR(hr = m_pDevice->ColorFill(pSurface, NULL, clrBlack));
+
+        CHECK_HR(hr = MFCreateVideoSampleFromSurface(pSurface, &pVideoSample));
+        CHECK_HR(hr = videoSampleQueue.InsertBack(pVideoSample));
+
+        SAFE_RELEASE(pVideoSample);
+        SAFE_RELEASE(pSurface);
+    }
+
+done:
+    SAFE_RELEASE(pVideoSample);
+    SAFE_RELEASE(pSurface);
+    return hr;
+}
+
+//-----------------------------------------------------------------------------
+// CreateZeroCopySamples
+//
+// Creates the video samples for zero-copy mode. Each sample wraps the
+// surface of a shareable render-target texture; the mixer renders into it
+// and GL reads it directly once it is presented. Caller holds the object
+// lock.
+//-----------------------------------------------------------------------------
+
+HRESULT D3DPresentEngine::CreateZeroCopySamples(IMFMediaType *pFormat, VideoSampleList& videoSampleQueue)
+{
+    HRESULT hr = S_OK;
+    D3DCOLOR clrBlack = D3DCOLOR_ARGB(0xFF, 0x00, 0x00, 0x00);
+
+    UINT32 width = 0, height = 0;
+    DWORD d3dFormat = 0;
+
+    IMFSample *pVideoSample = NULL;
+
+    VideoType videoType(pFormat);
+
+    CHECK_HR(hr = videoType.GetFrameDimensions(&width, &height));
+    CHECK_HR(hr = videoType.GetFourCC(&d3dFormat));
+
+    m_SurfaceTracker.Reset(ZERO_COPY_BUFFER_COUNT);
+    m_SurfaceWidth = width;
+    m_SurfaceHeight = height;
+
+    for (DWORD i = 0; i < ZERO_COPY_BUFFER_COUNT; i++)
+    {
+        // The shared handle is required, otherwise the extension fails on ATI/Intel cards.
+        CHECK_HR(hr = m_pDevice->CreateTexture(width, height, 1, D3DUSAGE_RENDERTARGET, (D3DFORMAT)d3dFormat,
+            D3DPOOL_DEFAULT, &m_pSurfaceTextures[i], &m_SurfaceShareHandles[i]));
+
+        CHECK_HR(hr = m_pSurfaceTextures[i]->GetSurfaceLevel(0, &m_pSurfaces[i]));
+        CHECK_HR(hr = m_pDevice->ColorFill(m_pSurfaces[i], NULL, clrBlack));
+
+        CHECK_HR(hr = MFCreateVideoSampleFromSurface(m_pSurfaces[i], &pVideoSample));
+        CHECK_HR(hr = videoSampleQueue.InsertBack(pVideoSample));
+
+        SAFE_RELEASE(pVideoSample);
+    }
+
+done:
+    SAFE_RELEASE(pVideoSample);
+    return hr;
+}
+
+//-----------------------------------------------------------------------------
+// PresentZeroCopySample
+//
+// Publishes the sample's surface as the latest frame for GL, and keeps the
+// sample from the mixer until GL can no longer read it. A NULL sample
+// (repaint) leaves the latest frame as it is.
+//-----------------------------------------------------------------------------
+
+HRESULT D3DPresentEngine::PresentZeroCopySample(IMFSample* pSample)
+{
+    HRESULT hr = S_OK;
+
+    IMFMediaBuffer* pBuffer = NULL;
+    IDirect3DSurface9* pSurface = NULL;
+    IMFSample* pRecycle[SHARED_SURFACE_MAX] = { NULL };
+
+    if (pSample == NULL)
+    {
+        return S_OK;
+    }
+
+    CHECK_HR(hr = pSample->GetBufferByIndex(0, &pBuffer));
+    CHECK_HR(hr = MFGetService(pBuffer, MR_BUFFER_SERVICE, __uuidof(IDirect3DSurface9), (void**)&pSurface));
+
+    {
+        AutoLock lock(m_ObjectLock);
+
+        const int count = m_SurfaceTracker.Count();
+        int index = SHARED_SURFACE_NONE;
+
+        for (int i = 0; i < count; i++)
+        {
+            if (m_pSurfaces[i] == pSurface)
+            {
+                index = i;
+                break;
+            }
+        }
+
+        // A sample from an earlier batch has nothing to show.
+        if (index != SHARED_SURFACE_NONE)
+        {
+            m_SurfaceTracker.Publish(index);
+            CopyComPointer(m_pHeldSamples[index], pSample);
+
+            // Give back every other sample GL is not reading. Release them
+            // after dropping the lock, because returning a sample calls back
+            // into the presenter.
+            for (int i = 0; i < count; i++)
+            {
+                if (i != index && m_pHeldSamples[i] && m_SurfaceTracker.CanRecycle(i))
+                {
+                    pRecycle[i] = m_pHeldSamples[i];
+                    m_pHeldSamples[i] = NULL;
+                }
+            }
+        }
+    }
+
+done:
+    for (int i = 0; i < SHARED_SURFACE_MAX; i++)
+    {
+        SAFE_RELEASE(pRecycle[i]);
+    }
+    SAFE_RELEASE(pSurface);
+    SAFE_RELEASE(pBuffer);
+    return hr;
+}
+
+//-----------------------------------------------------------------------------
+// ReleaseZeroCopySurfaces
+//
+// Releases the zero-copy surfaces and any samples still held. Surfaces
+// registered with GL stay alive until UnregisterSharedSurfaces.
+//-----------------------------------------------------------------------------
+
+void D3DPresentEngine::ReleaseZeroCopySurfaces()
+{
+    IMFSample* pHeld[SHARED_SURFACE_MAX] = { NULL };
+
+    m_ObjectLock.Lock();
+
+    for (int i = 0; i < SHARED_SURFACE_MAX; i++)
+    {
+        pHeld[i] = m_pHeldSamples[i];
+        m_pHeldSamples[i] = NULL;
+
+        SAFE_RELEASE(m_pSurfaces[i]);
+        SAFE_RELEASE(m_pSurfaceTextures[i]);
+        m_SurfaceShareHandles[i] = NULL;
+    }
+
+    m_ObjectLock.Unlock();
+
+    // Returning a sample calls back into the presenter; do it unlocked.
+    for (int i = 0; i < SHARED_SURFACE_MAX; i++)
+    {
+        SAFE_RELEASE(pHeld[i]);
+    }
+}
+
 //-----------------------------------------------------------------------------
 // PaintFrameWithGDI
 // 
@@ -765,7 +1630,7 @@ HRESULT D3DPresentEngine::GetSwapChainPresentParameters(IMFMediaType *pType, D3D
     // Helper object for reading the proposed type.
     VideoType videoType(pType);
 
-    if (m_hwnd == NULL)
+    if (m_hwnd == NULL && !m_bHeadless)
     {
         return MF_E_INVALIDREQUEST;
     }
@@ -874,3 +1739,31 @@ HRESULT FindAdapter(IDirect3D9 *pD3D9, HMONITOR hMonitor, UINT *puAdapterID)
     }
     return hr;
 }
+
+
+//-----------------------------------------------------------------------------
+// SurfaceBytes
+//
+// Estimated size of a surface in video memory.
+//-----------------------------------------------------------------------------
+
+UINT64 SurfaceBytes(D3DFORMAT format, UINT width, UINT height)
+{
+    const UINT64 pixels = (UINT64)width * height;
+
+    switch ((DWORD)format)
+    {
+    case MAKEFOURCC('N', 'V', '1', '2'):
+    case MAKEFOURCC('Y', 'V', '1', '2'):
+        return pixels * 3 / 2;
+
+    case MAKEFOURCC('Y', 'U', 'Y', '2'):
+    case MAKEFOURCC('U', 'Y', 'V', 'Y'):
+    case D3DFMT_R5G6B5:
+    case D3DFMT_X1R5G5B5:
+        return pixels * 2;
+
+    default:
+        return pixels * 4;
+    }
+}
@@ -33,12 +33,31 @@
 
 const DWORD PRESENTER_BUFFER_COUNT = 3;
 
+// In zero-copy mode the latest presented surface and the one GL is reading
+// are both kept from the mixer, so it needs a few more.
+const DWORD ZERO_COPY_BUFFER_COUNT = 5;
+
+// Shared textures the frames are copied into, when not in zero-copy mode.
+const int SHARED_TEXTURE_MAX = MAILBOX_MAX_SLOTS;
+const int SHARED_TEXTURE_DEFAULT_COUNT = 3;
+
 #pragma comment (lib,"Evr.lib")
 #pragma comment(lib,"D3d9.lib")
 #pragma comment(lib,"Dxva2.lib")
+#pragma comment(lib,"Dwmapi.lib")
 
 typedef unsigned int GLuint;
 
+// Video memory a presenter has allocated, in bytes. Estimated from surface
+// sizes and formats; drivers pad and align on top of this.
+struct VideoMemoryUsage
+{
+    UINT64  samples;            // Surfaces the mixer renders into.
+    UINT64  sharedTextures;     // Textures frames are copied into for GL.
+    UINT64  sharedDeviceTotal;  // Every presenter on the shared device; 0 with a device of its own.
+    UINT64  available;          // The driver's estimate of free texture memory.
+};
+
 class D3DPresentEngine : public SchedulerCallback
 {
 public:
@@ -77,14 +96,31 @@ public:
     HRESULT PresentSample(IMFSample* pSample, LONGLONG llTarget); 
 
     UINT    RefreshRate() const { return m_DisplayMode.RefreshRate; }
+    double  RefreshPeriod() const;
+
+    // SchedulerCallback
+    HRESULT GetVblankTiming(LONGLONG *phnsSinceVblank, double *phnsRefresh);
 
 protected:
     HRESULT InitializeD3D();
     HRESULT GetSwapChainPresentParameters(IMFMediaType *pType, D3DPRESENT_PARAMETERS* pPP);
     HRESULT CreateD3DDevice();
+    HRESULT AdoptSharedDevice();
+    HANDLE  OpenGLDevice();
+    void    CloseGLDevice();
+    void    UpdateVideoMemory(std::atomic<UINT64>& counter, UINT64 cb);
     HRESULT CreateD3DSample(IDirect3DSwapChain9 *pSwapChain, IMFSample **ppVideoSample);
     HRESULT UpdateDestRect();
 
+    HRESULT CreateHeadlessSamples(const D3DPRESENT_PARAMETERS& pp, VideoSampleList& videoSampleQueue);
+    void    CopyToSharedTexture(IDirect3DSurface9* pSurface);
+    void    PublishPresentedFrame(IMFSample* pSample);
+
+    HRESULT CreateZeroCopySamples(IMFMediaType *pFormat, VideoSampleList& videoSampleQueue);
+    HRESULT PresentZeroCopySample(IMFSample* pSample);
+    void    ReleaseZeroCopySurfaces();
+    void    UnregisterSharedSurfaces();
+
     // A derived class can override these handlers to allocate any additional D3D resources.
     virtual HRESULT OnCreateVideoSamples(D3DPRESENT_PARAMETERS& pp) { return S_OK; }
    // virtual void    OnReleaseResources() ;
@@ -107,19 +143,72 @@ protected:
     IDirect3DDeviceManager9     *m_pDeviceManager;        // Direct3D device manager.
     IDirect3DSurface9           *m_pSurfaceRepaint;       // Surface for repaint requests.
 
+    // Shared device mode: the objects above come from the service.
+    SharedDeviceService         *m_pSharedDevice;
+    UINT                        m_SharedDeviceGeneration;
+
+    // Bumped whenever m_pDevice is replaced. The GL interop handle and the
+    // objects registered with it belong to m_GLDeviceGeneration.
+    std::atomic<UINT>           m_DeviceGeneration;
+    UINT                        m_GLDeviceGeneration;
+
+    std::atomic<UINT64>         m_cbSamples;
+    std::atomic<UINT64>         m_cbSharedTextures;
+
+    static bool                 s_bUseSharedDeviceByDefault;
+
 protected:
 	HANDLE gl_handleD3D;
 	HANDLE d3d_shared_handle;
-	
-	GLuint gl_name;
-	HANDLE gl_handle;
+
+	// Ring of shared textures, guarded by m_SharedMailbox.
+	GLuint gl_names[SHARED_TEXTURE_MAX];
+	HANDLE gl_handles[SHARED_TEXTURE_MAX];
 
 	DWORD _shared_handle_val;
-	IDirect3DSurface9 *d3d_shared_surface;
-	IDirect3DTexture9 *d3d_shared_texture;
+	IDirect3DSurface9 *d3d_shared_surfaces[SHARED_TEXTURE_MAX];
+	IDirect3DTexture9 *d3d_shared_textures[SHARED_TEXTURE_MAX];
+	int m_cSharedTextures;
+
+	TextureMailbox m_SharedMailbox;
+	int m_ReadSlot;                 // Slot locked by the GL thread, or MAILBOX_NONE.
 
 	int _w,_h;
 
+	void ReleaseSharedTextures();
+
+protected:
+	// Headless presentation: frames only go to the shared textures, never to the window.
+	bool                        m_bHeadless;
+
+
+	// The last frame PresentSample presented; read from any thread.
+	FrameSnapshot               m_PresentedFrame;
+
+	// Loop transitions, fed from the same place as m_PresentedFrame.
+	LoopMonitor                 m_LoopMonitor;
+
+	// Frame-accurate seeks: the presenter filters decoded frames through it,
+	// and presented ones complete the seek.
+	SeekMonitor                 m_SeekMonitor;
+
+	// Zero-copy presentation: the samples' own surfaces are shared with GL.
+	bool                        m_bZeroCopy;
+	SharedSurfaceTracker        m_SurfaceTracker;
+	UINT                        m_SurfaceWidth;
+	UINT                        m_SurfaceHeight;
+	IDirect3DTexture9           *m_pSurfaceTextures[SHARED_SURFACE_MAX];   // Current batch.
+	IDirect3DSurface9           *m_pSurfaces[SHARED_SURFACE_MAX];
+	HANDLE                      m_SurfaceShareHandles[SHARED_SURFACE_MAX];
+	IMFSample                   *m_pHeldSamples[SHARED_SURFACE_MAX];       // Presented samples not yet given back to the mixer.
+
+	// GL thread only. The textures are kept alive until they are unregistered.
+	IDirect3DTexture9           *m_pGLTextures[SHARED_SURFACE_MAX];
+	HANDLE                      m_GLHandles[SHARED_SURFACE_MAX];
+	int                         m_cGLSurfaces;
+	UINT                        m_GLGeneration;
+	int                         m_LockedSurface;
+
 public:
 
 	HANDLE getSharedDeviceHandle() { return gl_handleD3D;}
@@ -130,9 +219,74 @@ public:
 
 	}
 	bool createSharedTexture(int w, int h, int textureID);
+	bool createSharedTextures(int w, int h, const GLuint *textureIDs, int count);
 
 	void releaseSharedTexture();
 	bool lockSharedTexture();
 
+	// Device loss. Once the device is replaced, the interop handle and everything registered with it
+	// refer to the old one: GL releases them all with releaseGLDevice, and creates them again once
+	// canOpenGLDevice. With the shared device, that is when every presenter has released its own.
+	bool isGLDeviceLost() const { return gl_handleD3D != NULL && m_GLDeviceGeneration != m_DeviceGeneration.load(); }
+	bool canOpenGLDevice();
+	void releaseGLDevice();
+
 	bool unlockSharedTexture();
+
+	// Use the process-wide device from SharedDeviceService instead of one of
+	// our own. Fails with MF_E_INVALIDREQUEST once GL has opened the device,
+	// so call it before any shared texture is created.
+	HRESULT setUseSharedDevice(bool shared);
+	bool isUsingSharedDevice() const { return m_pSharedDevice != NULL; }
+
+	// Whether presenters created from now on start on the shared device.
+	static void setUseSharedDeviceByDefault(bool shared) { s_bUseSharedDeviceByDefault = shared; }
+
+	void getVideoMemoryUsage(VideoMemoryUsage *pUsage);
+
+
+	// The last presented frame, and just its serial for a cheap "has the
+	// video advanced" check. Lock-free; safe from any thread.
+	PresentedFrameInfo getPresentedFrameInfo() const { return m_PresentedFrame.Read(); }
+	UINT64 getPresentedFrameSerial() const { return m_PresentedFrame.Serial(); }
+
+	// Looping: the player reports each loop restart as it issues it, and
+	// where each gapless pass begins, in sample time. See LoopMonitor.
+	void noteLoopRestart() { m_LoopMonitor.OnLoopRestart(MFGetSystemTime()); }
+	void noteLoopBoundary(LONGLONG sampleTime) { m_LoopMonitor.OnLoopBoundary(sampleTime); }
+	void getLoopStats(LoopStats *pStats) const { m_LoopMonitor.GetStats(pStats); }
+	void resetLoopStats() { m_LoopMonitor.Reset(); }
+
+	// Frame-accurate seeking: the player reports each seek before it starts
+	// the session at the target, and the presenter drops the frames decoded
+	// before it. See SeekMonitor.
+	void noteSeek(LONGLONG target, LONGLONG keyframe, LONGLONG frameDuration) { m_SeekMonitor.OnSeekRequested(target, keyframe, frameDuration, MFGetSystemTime()); }
+	void noteClockSeek() { m_SeekMonitor.OnClockSeek(); }
+	void noteEndOfStream() { m_SeekMonitor.OnEndOfStream(); }
+	bool isBeforeSeekTarget(IMFSample* pSample);
+	bool isSeekPending() const { return m_SeekMonitor.IsPending(); }
+	void getSeekStats(SeekStats *pStats) const { m_SeekMonitor.GetStats(pStats); }
+	void resetSeekStats() { m_SeekMonitor.Reset(); }
+
+	// Headless mode: samples are plain render targets and nothing is presented
+	// to the video window. Takes effect the next time the samples are created.
+	void setHeadless(bool enable) { m_bHeadless = enable; }
+	bool isHeadless() const { return m_bHeadless; }
+
+	// Zero-copy mode. Takes effect the next time the samples are created.
+	void setZeroCopy(bool enable) { m_bZeroCopy = enable; }
+	bool isZeroCopy() const { return m_bZeroCopy; }
+
+	// The current batch of shared surfaces. The generation changes whenever
+	// the surfaces are re-created; the GL thread then registers a new set
+	// of textures with registerSharedSurfaces.
+	UINT getSharedSurfaceGeneration() const { return m_SurfaceTracker.Generation(); }
+	int  getSharedSurfaceCount() const { return m_SurfaceTracker.Count(); }
+	void getSharedSurfaceSize(UINT *pWidth, UINT *pHeight) const { *pWidth = m_SurfaceWidth; *pHeight = m_SurfaceHeight; }
+	bool registerSharedSurfaces(UINT generation, const GLuint *pNames, int count);
+
+	// The texture locked by lockSharedTexture (the latest presented frame):
+	// a surface index in zero-copy mode, otherwise a shared texture slot.
+	// Negative if nothing is locked.
+	int  getLockedSurface() const { return m_bZeroCopy ? m_LockedSurface : m_ReadSlot; }
 };
\ No newline at end of file
@@ -22,6 +22,9 @@ DEFINE_CLASSFACTORY_SERVER_LOCK;
 // Default frame rate.
 const MFRatio g_DefaultFrameRate = { 30, 1 };
 
+// Mixer latency histogram bin width: 0.1 ms.
+const LONGLONG MIXER_LATENCY_BIN_WIDTH = 1000;
+
 // Function declarations.
 RECT    CorrectAspectRatio(const RECT& src, const MFRatio& srcPAR, const MFRatio& destPAR);
 BOOL    AreMediaTypesEqual(IMFMediaType *pType1, IMFMediaType *pType2);
@@ -352,6 +355,8 @@ HRESULT EVRCustomPresenter::ProcessMessage(MFVP_MESSAGE_TYPE eMessage, ULONG_PTR
     case MFVP_MESSAGE_ENDOFSTREAM:
         // Set the EOS flag. 
         m_bEndStreaming = TRUE; 
+        // A seek target past the last frame will not be reached.
+        m_pD3DPresentEngine->noteEndOfStream();
         // Check if it's time to send the EC_COMPLETE event to the EVR.
         hr = CheckEndOfStream();
         break;
@@ -462,6 +467,13 @@ HRESULT EVRCustomPresenter::OnClockStart(MFTIME hnsSystemTime, LONGLONG llClockS
         CHECK_HR(hr = StartFrameStep());
     }
 
+    // Frames from the new position follow; a frame-accurate seek starts
+    // filtering them now.
+    if (llClockStartOffset != PRESENTATION_CURRENT_POSITION)
+    {
+        m_pD3DPresentEngine->noteClockSeek();
+    }
+
     // Now try to get new output samples from the mixer.
     ProcessOutputLoop();
 
@@ -940,9 +952,14 @@ EVRCustomPresenter::EVRCustomPresenter(HRESULT& hr) :
     m_bRepaint(FALSE),
     m_bEndStreaming(FALSE),
     m_bPrerolled(FALSE),
+    m_bOutputSizeChanged(false),
     m_fRate(1.0f),
     m_TokenCounter(0),
-    m_SampleFreeCB(this, &EVRCustomPresenter::OnSampleFree)
+    m_SampleFreeCB(this, &EVRCustomPresenter::OnSampleFree),
+    m_OutputSizeCB(this, &EVRCustomPresenter::OnOutputSizeChanged),
+    m_MixerLatency(MIXER_LATENCY_BIN_WIDTH, 0),
+    m_MixerLatencyLast(0),
+    m_cRepaints(0)
 {
     hr = S_OK;
 
@@ -961,6 +978,8 @@ EVRCustomPresenter::EVRCustomPresenter(HRESULT& hr) :
 
     m_scheduler.SetCallback(m_pD3DPresentEngine);
 
+    TRACE_INIT();
+
 done:
     if (FAILED(hr))
     {
@@ -982,6 +1001,8 @@ EVRCustomPresenter::~EVRCustomPresenter()
 
     // Deletable objects
     SAFE_DELETE(m_pD3DPresentEngine);
+
+    TRACE_CLOSE();
 }
 
 
@@ -1160,6 +1181,9 @@ HRESULT EVRCustomPresenter::Flush()
 
 HRESULT EVRCustomPresenter::ProcessInputNotify()
 {
+    // The decoder has delivered a sample to the mixer.
+    WMF_TRACE_ZONE("ProcessInputNotify");
+
     HRESULT hr = S_OK;
 
     // Set the flag that says the mixer has a new sample.
@@ -1439,6 +1463,18 @@ HRESULT EVRCustomPresenter::CreateOptimalVideoType(IMFMediaType* pProposedType,
         CHECK_HR(hr = CalculateOutputRectangle(pProposedType, &rcOutput));
     }
 
+    // Let the application shrink the frames; the mixer scales them for free.
+    {
+        AutoLock policyLock(m_OutputPolicyLock);
+
+        if (m_OutputPolicy.mode != OutputSizePolicy::Source)
+        {
+            UINT32 width = 0, height = 0;
+            m_OutputPolicy.Apply(rcOutput.right - rcOutput.left, rcOutput.bottom - rcOutput.top, &width, &height);
+            SetRect(&rcOutput, 0, 0, width, height);
+        }
+    }
+
     // Set the extended color information: Use BT.709
 	
     CHECK_HR(hr = mtOptimal.SetYUVMatrix(MFVideoTransferMatrix_BT709));
@@ -1623,6 +1659,9 @@ HRESULT EVRCustomPresenter::SetMediaType(IMFMediaType *pMediaType)
         m_scheduler.SetFrameRate(g_DefaultFrameRate);
     }
 
+    // The display refresh period is used for cadence planning.
+    m_scheduler.SetRefreshPeriod(m_pD3DPresentEngine->RefreshPeriod());
+
     // Store the media type.
     assert(pMediaType != NULL);
     m_pMediaType = pMediaType;
@@ -1814,7 +1853,10 @@ HRESULT EVRCustomPresenter::ProcessOutput()
     dataBuffer.pSample = pSample;
     dataBuffer.dwStatus = 0;
 
-    hr = m_pMixer->ProcessOutput(0, 1, &dataBuffer, &dwStatus);
+    {
+        WMF_TRACE_ZONE("Mixer ProcessOutput");
+        hr = m_pMixer->ProcessOutput(0, 1, &dataBuffer, &dwStatus);
+    }
 
     if (FAILED(hr))
     {
@@ -1855,6 +1897,18 @@ HRESULT EVRCustomPresenter::ProcessOutput()
 
             LONGLONG latencyTime = mixerEndTime - mixerStartTime;
             NotifyEvent(EC_PROCESSING_LATENCY, (LONG_PTR)&latencyTime, 0);
+
+            m_MixerLatency.Record(latencyTime);
+            m_MixerLatencyLast = latencyTime;
+        }
+
+        // A frame before the target of a frame-accurate seek: decoded from
+        // the keyframe, but not shown. Return it to the pool; the caller
+        // goes on to the next one.
+        if (!bRepaint && m_pD3DPresentEngine->isBeforeSeekTarget(pSample))
+        {
+            CHECK_HR(hr = m_SamplePool.ReturnSample(pSample));
+            goto done;
         }
 
         // Set up notification for when the sample is released.
@@ -1871,6 +1925,11 @@ HRESULT EVRCustomPresenter::ProcessOutput()
             CHECK_HR(hr = DeliverFrameStepSample(pSample));
         }
         m_bPrerolled = TRUE; // We have presented at least one sample now.
+
+        if (bRepaint)
+        {
+            m_cRepaints++;
+        }
     }
 
 done:
@@ -1895,6 +1954,8 @@ done:
 
 HRESULT EVRCustomPresenter::DeliverSample(IMFSample *pSample, BOOL bRepaint)
 {
+    WMF_TRACE_ZONE("DeliverSample");
+
     assert(pSample != NULL);
 
     HRESULT hr = S_OK;
@@ -2154,6 +2215,128 @@ float EVRCustomPresenter::GetMaxRate(BOOL bThin)
 }
 
 
+//-----------------------------------------------------------------------------
+// getStats
+//
+// Fills a statistics snapshot. Reads only atomics, so it does not take the
+// object lock and can be called from the app thread at any time.
+//-----------------------------------------------------------------------------
+
+void EVRCustomPresenter::getStats(PresenterStats *pStats) const
+{
+    ScheduleCounters counters;
+    m_scheduler.GetCounters(&counters);
+
+    m_scheduler.GetLateness(&pStats->lateness);
+    pStats->queueDepth = (uint32_t)m_scheduler.QueueDepth();
+    pStats->poolFree = m_SamplePool.FreeCount();
+    pStats->poolPending = m_SamplePool.PendingCount();
+
+    m_MixerLatency.GetSnapshot(&pStats->mixerLatency);
+    pStats->mixerLatencyLast = m_MixerLatencyLast;
+
+    pStats->onTime = counters.onTime;
+    pStats->late = counters.late;
+    pStats->dropped = counters.dropped;
+    pStats->repeated = counters.repeated;
+    pStats->presented = counters.onTime + counters.late + m_scheduler.PresentedNowCount();
+    pStats->repaints = m_cRepaints;
+}
+
+void EVRCustomPresenter::resetStats()
+{
+    m_scheduler.ResetCounters();
+    m_MixerLatency.Reset();
+    m_MixerLatencyLast = 0;
+    m_cRepaints = 0;
+}
+
+//-----------------------------------------------------------------------------
+// setOutputSizePolicy
+//
+// Changes the size the mixer outputs frames at. Returns at once: the new
+// policy is recorded, and the renegotiation (which re-creates the samples
+// and repaints the current frame) is posted to a Media Foundation work
+// queue, like the EVR's own calls into the presenter. The application
+// thread never waits for the streaming thread.
+//-----------------------------------------------------------------------------
+
+HRESULT EVRCustomPresenter::setOutputSizePolicy(const OutputSizePolicy& policy)
+{
+    {
+        AutoLock policyLock(m_OutputPolicyLock);
+
+        if (policy == m_OutputPolicy)
+        {
+            return S_OK;
+        }
+        m_OutputPolicy = policy;
+    }
+
+    // One work item covers any number of changes made before it runs.
+    if (m_bOutputSizeChanged.exchange(true))
+    {
+        return S_OK;
+    }
+
+    HRESULT hr = MFPutWorkItem(MFASYNC_CALLBACK_QUEUE_STANDARD, &m_OutputSizeCB, NULL);
+
+    if (FAILED(hr))
+    {
+        m_bOutputSizeChanged = false;
+    }
+    return hr;
+}
+
+//-----------------------------------------------------------------------------
+// OnOutputSizeChanged
+//
+// Work queue callback posted by setOutputSizePolicy. If the mixer already
+// has an output type, renegotiates it at the new size; otherwise the policy
+// applies to the first negotiation.
+//-----------------------------------------------------------------------------
+
+HRESULT EVRCustomPresenter::OnOutputSizeChanged(IMFAsyncResult *pResult)
+{
+    HRESULT hr = S_OK;
+
+    AutoLock lock(m_ObjectLock);
+
+    m_bOutputSizeChanged = false;
+
+    if (FAILED(CheckShutdown()) || m_pMixer == NULL || m_pMediaType == NULL)
+    {
+        return S_OK;
+    }
+
+    hr = RenegotiateMediaType();
+
+    if (hr == MF_E_TRANSFORM_TYPE_NOT_SET)
+    {
+        // The mixer is not ready for a type; the EVR will ask us later.
+        hr = S_OK;
+    }
+    else if (SUCCEEDED(hr))
+    {
+        m_bRepaint = TRUE;
+        (void)ProcessOutput(); // Ignore errors, the mixer might not have a video frame.
+    }
+
+    if (FAILED(hr))
+    {
+        WMF_LOG_ERROR(L"Renegotiating the output size failed, hr=0x%X\n", hr);
+    }
+    return S_OK;
+}
+
+void EVRCustomPresenter::getOutputSize(UINT srcWidth, UINT srcHeight, UINT *pWidth, UINT *pHeight)
+{
+    AutoLock policyLock(m_OutputPolicyLock);
+
+    m_OutputPolicy.Apply(srcWidth, srcHeight, pWidth, pHeight);
+}
+
+
 //-----------------------------------------------------------------------------
 // Static functions
 //-----------------------------------------------------------------------------
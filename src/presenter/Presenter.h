@@ -209,6 +209,10 @@ protected:
     HRESULT OnSampleFree(IMFAsyncResult *pResult);
     AsyncCallback<EVRCustomPresenter>   m_SampleFreeCB;
 
+    // Work item posted by setOutputSizePolicy to renegotiate off the caller's thread.
+    HRESULT OnOutputSizeChanged(IMFAsyncResult *pResult);
+    AsyncCallback<EVRCustomPresenter>   m_OutputSizeCB;
+
 protected:
 
     // FrameStep: Holds information related to frame-stepping. 
@@ -245,6 +249,9 @@ protected:
     BOOL                        m_bEndStreaming;        // Did we reach the end of the stream (EOS)?
 
     MFVideoNormalizedRect       m_nrcSource;            // Source rectangle.
+    OutputSizePolicy            m_OutputPolicy;         // Size the mixer outputs frames at. Guarded by m_OutputPolicyLock.
+    CritSec                     m_OutputPolicyLock;     // Never held while taking m_ObjectLock.
+    std::atomic<bool>           m_bOutputSizeChanged;   // Renegotiation posted and not yet done.
     float                       m_fRate;                // Playback rate.
 
     // Deletable objects.
@@ -256,13 +263,82 @@ protected:
     IMediaEventSink             *m_pMediaEventSink;      // The EVR's event-sink interface.
     IMFMediaType                *m_pMediaType;           // Output media type
 
+    // Statistics. See getStats.
+    TimingHistogram             m_MixerLatency;         // Mixer ProcessOutput time (100ns).
+    std::atomic<LONGLONG>       m_MixerLatencyLast;
+    std::atomic<ULONGLONG>      m_cRepaints;
+
 
 public:
 	HANDLE getSharedDeviceHandle();
 	bool createSharedTexture(int w, int h, int textureID) { return m_pD3DPresentEngine->createSharedTexture(w,h, textureID ); }
+	bool createSharedTextures(int w, int h, const GLuint *textureIDs, int count) { return m_pD3DPresentEngine->createSharedTextures(w, h, textureIDs, count); }
 	bool lockSharedTexture() { return m_pD3DPresentEngine->lockSharedTexture(); }
 	bool unlockSharedTexture() { return m_pD3DPresentEngine->unlockSharedTexture(); }
 	void releaseSharedTexture() { return m_pD3DPresentEngine->releaseSharedTexture(); } ;
+
+	// Device loss: GL releases and re-creates its interop objects. See D3DPresentEngine.
+	bool isGLDeviceLost() const { return m_pD3DPresentEngine->isGLDeviceLost(); }
+	bool canOpenGLDevice() { return m_pD3DPresentEngine->canOpenGLDevice(); }
+	void releaseGLDevice() { m_pD3DPresentEngine->releaseGLDevice(); }
+
+	// Shared device: one D3D device, device manager and GL interop handle for all presenters that opt in.
+	HRESULT setUseSharedDevice(bool shared) { return m_pD3DPresentEngine->setUseSharedDevice(shared); }
+	bool isUsingSharedDevice() const { return m_pD3DPresentEngine->isUsingSharedDevice(); }
+	void getVideoMemoryUsage(VideoMemoryUsage *pUsage) { m_pD3DPresentEngine->getVideoMemoryUsage(pUsage); }
+
+	// The last presented frame, published lock-free. See D3DPresentEngine.
+	PresentedFrameInfo getPresentedFrameInfo() const { return m_pD3DPresentEngine->getPresentedFrameInfo(); }
+	UINT64 getPresentedFrameSerial() const { return m_pD3DPresentEngine->getPresentedFrameSerial(); }
+
+	// Loop transition measurement. See D3DPresentEngine.
+	void noteLoopRestart() { m_pD3DPresentEngine->noteLoopRestart(); }
+	void noteLoopBoundary(LONGLONG sampleTime) { m_pD3DPresentEngine->noteLoopBoundary(sampleTime); }
+	void getLoopStats(LoopStats *pStats) const { m_pD3DPresentEngine->getLoopStats(pStats); }
+	void resetLoopStats() { m_pD3DPresentEngine->resetLoopStats(); }
+	void noteSeek(LONGLONG target, LONGLONG keyframe, LONGLONG frameDuration) { m_pD3DPresentEngine->noteSeek(target, keyframe, frameDuration); }
+	bool isSeekPending() const { return m_pD3DPresentEngine->isSeekPending(); }
+	void getSeekStats(SeekStats *pStats) const { m_pD3DPresentEngine->getSeekStats(pStats); }
+	void resetSeekStats() { m_pD3DPresentEngine->resetSeekStats(); }
+
+	// Headless presentation: no swap chains, nothing presented to the window.
+	void setHeadless(bool enable) { m_pD3DPresentEngine->setHeadless(enable); }
+	bool isHeadless() const { return m_pD3DPresentEngine->isHeadless(); }
+
+	// Zero-copy presentation: GL reads the mixer's surfaces directly. See D3DPresentEngine.
+	void setZeroCopy(bool enable) { m_pD3DPresentEngine->setZeroCopy(enable); }
+	bool isZeroCopy() const { return m_pD3DPresentEngine->isZeroCopy(); }
+	UINT getSharedSurfaceGeneration() const { return m_pD3DPresentEngine->getSharedSurfaceGeneration(); }
+	int  getSharedSurfaceCount() const { return m_pD3DPresentEngine->getSharedSurfaceCount(); }
+	void getSharedSurfaceSize(UINT *pWidth, UINT *pHeight) const { m_pD3DPresentEngine->getSharedSurfaceSize(pWidth, pHeight); }
+	bool registerSharedSurfaces(UINT generation, const GLuint *pNames, int count) { return m_pD3DPresentEngine->registerSharedSurfaces(generation, pNames, count); }
+	int  getLockedSurface() const { return m_pD3DPresentEngine->getLockedSurface(); }
+
+	void setHighResolutionTiming(bool enable, LONGLONG hnsSpinBudget)
+	{
+		m_scheduler.SetSpinBudget(hnsSpinBudget);
+		m_scheduler.SetTimingMode(enable ? ScheduleEngine::TimingHighResolution : ScheduleEngine::TimingCoarse);
+	}
+	void getPresentJitter(HistogramSnapshot *pSnapshot) const { m_scheduler.GetWakeJitter(pSnapshot); }
+	void resetPresentJitter() { m_scheduler.ResetWakeJitter(); }
+
+	void setUseSharedScheduler(bool shared) { m_scheduler.SetUseSharedThread(shared); }
+
+	void setLatePolicy(ScheduleEngine::LatePolicy policy, int lateFrames) { m_scheduler.SetLatePolicy(policy, lateFrames); }
+	void getFrameCounters(ScheduleCounters *pCounters) const { m_scheduler.GetCounters(pCounters); }
+	void resetFrameCounters() { m_scheduler.ResetCounters(); }
+
+	// Frame statistics. Lock-free; cheap enough to call every app frame.
+	void getStats(PresenterStats *pStats) const;
+	void resetStats();
+
+	void setCadenceMode(bool enable) { m_scheduler.SetCadenceMode(enable); }
+	void getCadenceStats(CadenceStats *pStats) const { m_scheduler.GetCadenceStats(pStats); }
+	void resetCadenceStats() { m_scheduler.ResetCadenceStats(); }
+
+	// Output size: renegotiates the mixer's output type when the policy changes, on a work queue thread.
+	HRESULT setOutputSizePolicy(const OutputSizePolicy& policy);
+	void getOutputSize(UINT srcWidth, UINT srcHeight, UINT *pWidth, UINT *pHeight);
 };
 
 
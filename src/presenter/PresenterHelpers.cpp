@@ -19,7 +19,7 @@
 // SamplePool class
 //-----------------------------------------------------------------------------
 
-SamplePool::SamplePool() : m_bInitialized(FALSE), m_cPending(0)
+SamplePool::SamplePool() : m_bInitialized(FALSE), m_cPending(0), m_cFree(0)
 {
 
 }
@@ -62,6 +62,7 @@ HRESULT SamplePool::GetSample(IMFSample **ppSample)
     CHECK_HR(hr = m_VideoSampleQueue.RemoveFront(&pSample));
 
     m_cPending++;
+    m_cFree--;
 
     // Give the sample to the caller.
     *ppSample = pSample;
@@ -92,6 +93,7 @@ HRESULT SamplePool::ReturnSample(IMFSample *pSample)
     CHECK_HR(hr = m_VideoSampleQueue.InsertBack(pSample));
 
     m_cPending--;
+    m_cFree++;
 
 done:
     return hr;
@@ -140,6 +142,7 @@ HRESULT SamplePool::Initialize(VideoSampleList& samples)
     {
         CHECK_HR(hr = samples.GetItemPos(pos, &pSample));
         CHECK_HR(hr = m_VideoSampleQueue.InsertBack(pSample));
+        m_cFree++;
 
         pos = samples.Next(pos);
         SAFE_RELEASE(pSample);
@@ -170,6 +173,7 @@ HRESULT SamplePool::Clear()
     m_VideoSampleQueue.Clear();
     m_bInitialized = FALSE;
     m_cPending = 0;
+    m_cFree = 0;
     return S_OK;
 }
 
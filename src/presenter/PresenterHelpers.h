@@ -33,66 +33,16 @@ public:
     HRESULT ReturnSample(IMFSample *pSample);   
     BOOL    AreSamplesPending();
 
+    // Lock-free counts, for statistics.
+    DWORD   FreeCount() const { return m_cFree; }
+    DWORD   PendingCount() const { return m_cPending; }
+
 private:
     CritSec                     m_lock;
 
     VideoSampleList             m_VideoSampleQueue;         // Available queue
 
     BOOL                        m_bInitialized;
-    DWORD                       m_cPending;
+    std::atomic<DWORD>          m_cPending;
+    std::atomic<DWORD>          m_cFree;                    // Samples in m_VideoSampleQueue.
 };
-
-
-//-----------------------------------------------------------------------------
-// ThreadSafeQueue template
-// Thread-safe queue of COM interface pointers.
-//
-// T: COM interface type.
-//
-// This class is used by the scheduler. 
-//
-// Note: This class uses a critical section to protect the state of the queue.
-// With a little work, the scheduler could probably use a lock-free queue.
-//-----------------------------------------------------------------------------
-
-template <class T>
-class ThreadSafeQueue
-{
-public:
-    HRESULT Queue(T *p)
-    {
-        AutoLock lock(m_lock);
-        return m_list.InsertBack(p);
-    }
-
-    HRESULT Dequeue(T **pp)
-    {
-        AutoLock lock(m_lock);
-
-        if (m_list.IsEmpty())
-        {
-            *pp = NULL;
-            return S_FALSE;
-        }
-
-        return m_list.RemoveFront(pp);
-    }
-
-    HRESULT PutBack(T *p)
-    {
-        AutoLock lock(m_lock);
-        return m_list.InsertFront(p);
-    }
-
-    void Clear() 
-    {
-        AutoLock lock(m_lock);
-        m_list.Clear();
-    }
-
-
-private:
-    CritSec         m_lock; 
-    ComPtrList<T>   m_list;
-};
-
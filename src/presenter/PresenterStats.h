@@ -0,0 +1,54 @@
+//////////////////////////////////////////////////////////////////////////
+//
+// PresenterStats.h: Snapshot of a presenter's frame statistics.
+//
+// This header has no Windows or Media Foundation dependencies.
+//
+//////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <stdint.h>
+
+#include "common/TimingHistogram.h"
+
+
+//-----------------------------------------------------------------------------
+// PresenterStats
+//
+// Filled by EVRCustomPresenter::getStats. Every field is read from lock-free
+// counters, so the snapshot is cheap enough to take every app frame; pass
+// the same object each time and the histogram storage is reused.
+//
+// Times are in 100ns units. Counts run from the time the presenter was
+// created, or from the last resetStats.
+//-----------------------------------------------------------------------------
+
+struct PresenterStats
+{
+    PresenterStats() :
+        queueDepth(0), poolFree(0), poolPending(0), mixerLatencyLast(0),
+        presented(0), onTime(0), late(0), dropped(0), repeated(0), repaints(0)
+    {
+    }
+
+    // Presentation clock minus sample time when each scheduled sample was
+    // presented. Negative values are early.
+    MediaFoundationSamples::HistogramSnapshot lateness;
+
+    uint32_t    queueDepth;         // Samples waiting in the scheduler.
+    uint32_t    poolFree;           // Samples in the pool, free for the mixer.
+    uint32_t    poolPending;        // Samples out of the pool (in the mixer, scheduler or on screen).
+
+    // Time the mixer took to produce each output sample (the value reported
+    // to the EVR as EC_PROCESSING_LATENCY).
+    MediaFoundationSamples::HistogramSnapshot mixerLatency;
+    int64_t     mixerLatencyLast;
+
+    uint64_t    presented;          // All samples presented, scheduled or immediate.
+    uint64_t    onTime;             // Scheduled samples presented inside their window.
+    uint64_t    late;               // Scheduled samples presented after their window.
+    uint64_t    dropped;            // Scheduled samples dropped by the late policy.
+    uint64_t    repeated;           // Extra frame periods the previous frame stayed on screen.
+    uint64_t    repaints;           // Repaints of the last frame.
+};
@@ -0,0 +1,916 @@
+//////////////////////////////////////////////////////////////////////////
+//
+// ScheduleEngine.cpp: Platform-neutral core of the sample scheduler.
+//
+//////////////////////////////////////////////////////////////////////////
+
+#include "ScheduleEngine.h"
+#include "PipelineTrace.h"
+
+#include <chrono>
+#include <cmath>
+
+// How long Flush waits for the worker thread before giving up.
+static const std::chrono::milliseconds SCHEDULER_FLUSH_TIMEOUT(5000);
+
+// Wake jitter histogram: 100us bins starting at 1 ms early.
+static const int64_t WAKE_JITTER_BIN_WIDTH = 1000;
+static const int64_t WAKE_JITTER_MIN = -10000;
+
+// Initial guess for how late the OS wakes a timed sleep (1 ms), and the
+// extra margin added on top of the measured average (100us).
+static const int64_t OVERSLEEP_INITIAL = 10000;
+static const int64_t OVERSLEEP_MARGIN = 1000;
+
+// Cadence error histogram: 0.5 ms bins covering +/- 16 ms (one 60 Hz tick).
+static const int64_t CADENCE_ERROR_BIN_WIDTH = 5000;
+static const int64_t CADENCE_ERROR_MIN = -160000;
+
+// Lateness histogram: 0.5 ms bins from 16 ms early to 16 ms late.
+static const int64_t LATENESS_BIN_WIDTH = 5000;
+static const int64_t LATENESS_MIN = -160000;
+
+//-----------------------------------------------------------------------------
+// Constructor
+//-----------------------------------------------------------------------------
+
+ScheduleEngine::ScheduleEngine() :
+    m_bHasPutBack(false),
+    m_bHasLastPresent(false),
+    m_hnsLastPresentTime(0),
+    m_pClock(NULL),
+    m_pSink(NULL),
+    m_pVsync(NULL),
+    m_fRate(1.0f),
+    m_PerFrameInterval(0),
+    m_bSchedule(false),
+    m_bFlush(false),
+    m_bTerminate(false),
+    m_bRunning(false),
+    m_bStarted(false),
+    m_bUseShared(false),
+    m_pService(NULL),
+    m_Wakeups(0),
+    m_bSignaled(false),
+    m_TimingMode(TimingCoarse),
+    m_SpinBudget(SCHEDULER_DEFAULT_SPIN_BUDGET),
+    m_hnsOversleep(OVERSLEEP_INITIAL),
+    m_WakeJitter(WAKE_JITTER_BIN_WIDTH, WAKE_JITTER_MIN),
+    m_LatePolicy(LatePresent),
+    m_LateFrames(1),
+    m_OnTime(0),
+    m_Late(0),
+    m_Dropped(0),
+    m_Repeated(0),
+    m_Lateness(LATENESS_BIN_WIDTH, LATENESS_MIN),
+    m_bCadence(false),
+    m_RefreshInterval(0.0),
+    m_bHasLastCadence(false),
+    m_hnsLastTarget(0),
+    m_hnsLastPresent(0),
+    m_CadenceTicks(0),
+    m_CadenceFrames(0),
+    m_CadenceBreaks(0),
+    m_CadenceResyncs(0),
+    m_CadenceError(CADENCE_ERROR_BIN_WIDTH, CADENCE_ERROR_MIN)
+{
+}
+
+//-----------------------------------------------------------------------------
+// Destructor
+//-----------------------------------------------------------------------------
+
+ScheduleEngine::~ScheduleEngine()
+{
+    Stop();
+}
+
+//-----------------------------------------------------------------------------
+// SetFrameInterval
+// Specifies the duration of each frame, in 100ns units.
+//-----------------------------------------------------------------------------
+
+void ScheduleEngine::SetFrameInterval(int64_t hnsPerFrame)
+{
+    m_PerFrameInterval.store(hnsPerFrame);
+}
+
+//-----------------------------------------------------------------------------
+// SetLatePolicy
+//-----------------------------------------------------------------------------
+
+void ScheduleEngine::SetLatePolicy(LatePolicy policy, int lateFrames)
+{
+    m_LateFrames.store(lateFrames > 0 ? lateFrames : 0);
+    m_LatePolicy.store(policy);
+}
+
+//-----------------------------------------------------------------------------
+// GetCounters
+//-----------------------------------------------------------------------------
+
+void ScheduleEngine::GetCounters(ScheduleCounters *pCounters) const
+{
+    pCounters->onTime = m_OnTime.load();
+    pCounters->late = m_Late.load();
+    pCounters->dropped = m_Dropped.load();
+    pCounters->repeated = m_Repeated.load();
+}
+
+void ScheduleEngine::ResetCounters()
+{
+    m_OnTime = 0;
+    m_Late = 0;
+    m_Dropped = 0;
+    m_Repeated = 0;
+    m_Lateness.Reset();
+}
+
+//-----------------------------------------------------------------------------
+// QueueDepth
+// Samples waiting, including one put back by the consumer.
+//-----------------------------------------------------------------------------
+
+size_t ScheduleEngine::QueueDepth() const
+{
+    return m_Queue.Size() + (m_bHasPutBack.load(std::memory_order_relaxed) ? 1 : 0);
+}
+
+//-----------------------------------------------------------------------------
+// Start
+// Starts the worker thread, or attaches to the shared service.
+//-----------------------------------------------------------------------------
+
+bool ScheduleEngine::Start()
+{
+    if (m_bStarted.load())
+    {
+        return false;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_bSchedule = false;
+        m_bFlush = false;
+        m_bTerminate = false;
+        m_bSignaled = false;
+    }
+
+    m_bRunning = true;
+    m_bStarted.store(true);
+
+    if (m_bUseShared)
+    {
+        m_pService = SharedScheduleService::Acquire();
+        m_pService->Attach(this);
+    }
+    else
+    {
+        m_Thread = std::thread(&ScheduleEngine::ThreadProc, this);
+    }
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+// Stop
+// Stops the worker thread and discards any queued samples.
+//-----------------------------------------------------------------------------
+
+void ScheduleEngine::Stop()
+{
+    if (m_pService)
+    {
+        // After Detach the service thread no longer runs this engine.
+        m_pService->Detach(this);
+        SharedScheduleService::Release();
+        m_pService = NULL;
+        m_bRunning = false;
+    }
+
+    if (m_Thread.joinable())
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            m_bTerminate = true;
+            m_bSignaled = true;
+        }
+        m_WakeCond.notify_one();
+        m_Thread.join();
+    }
+
+    m_bStarted.store(false);
+
+    // The worker thread has exited, so this thread is now the consumer.
+    DiscardQueue();
+}
+
+//-----------------------------------------------------------------------------
+// Signal
+// Wakes whichever thread runs this engine. Call after raising a flag.
+//-----------------------------------------------------------------------------
+
+void ScheduleEngine::Signal()
+{
+    if (m_pService)
+    {
+        m_pService->Wake(this);
+    }
+    else
+    {
+        m_WakeCond.notify_one();
+    }
+}
+
+//-----------------------------------------------------------------------------
+// ScheduleSample
+// Queues a sample and wakes the worker thread.
+//-----------------------------------------------------------------------------
+
+bool ScheduleEngine::ScheduleSample(const ScheduledFrame& frame)
+{
+    if (!m_Queue.TryPush(frame))
+    {
+        return false;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_bSchedule = true;
+        m_bSignaled = true;
+    }
+    Signal();
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+// Flush
+//
+// Discards all queued samples. If the worker thread is running, the queue
+// is cleared on that thread and this method waits for it to finish.
+//-----------------------------------------------------------------------------
+
+void ScheduleEngine::Flush()
+{
+    if (!m_bStarted.load())
+    {
+        DiscardQueue();
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_bFlush = true;
+        m_bSignaled = true;
+    }
+    Signal();
+
+    // Wait for the worker to clear the flag, OR for the thread to terminate.
+    std::unique_lock<std::mutex> lock(m_Mutex);
+    m_FlushCond.wait_for(lock, SCHEDULER_FLUSH_TIMEOUT, [this] { return !m_bFlush || !m_bRunning; });
+}
+
+//-----------------------------------------------------------------------------
+// Decide
+//
+// The sample is late if it is more than 1/4 frame behind the clock, and
+// early if it is more than 3/4 frame ahead. Early samples wait until they
+// are 3/4 frame ahead.
+//-----------------------------------------------------------------------------
+
+ScheduleEngine::Decision ScheduleEngine::Decide(int64_t hnsDelta, int64_t hnsPerFrame, float fRate, int64_t *phnsWait)
+{
+    const int64_t hnsQuarter = hnsPerFrame / 4;
+
+    if (fRate < 0)
+    {
+        // For reverse playback, the clock runs backward. Therefore the delta is reversed.
+        hnsDelta = - hnsDelta;
+    }
+
+    if (hnsDelta < - hnsQuarter)
+    {
+        return PresentLate;
+    }
+
+    if (hnsDelta > (3 * hnsQuarter))
+    {
+        int64_t hnsWait = hnsDelta - (3 * hnsQuarter);
+
+        // Adjust the wait for the clock rate. (The presentation clock runs
+        // at fRate, but waiting uses the system clock.)
+        if (fRate != 0)
+        {
+            hnsWait = (int64_t)(hnsWait / std::fabs(fRate));
+        }
+
+        // Never report a zero wait for an early sample; the caller would spin.
+        if (hnsWait < 1)
+        {
+            hnsWait = 1;
+        }
+
+        *phnsWait = hnsWait;
+        return Wait;
+    }
+
+    return PresentOnTime;
+}
+
+//-----------------------------------------------------------------------------
+// DecideCadence
+//
+// The sample is presented from half a tick before its planned tick until
+// half a tick after it. Earlier, it waits; later, it has missed its tick.
+//-----------------------------------------------------------------------------
+
+ScheduleEngine::Decision ScheduleEngine::DecideCadence(int64_t hnsDelta, int64_t hnsRefresh, int64_t *phnsWait)
+{
+    const int64_t hnsHalf = hnsRefresh / 2;
+
+    if (hnsDelta < - hnsHalf)
+    {
+        return PresentLate;
+    }
+
+    if (hnsDelta > hnsHalf)
+    {
+        *phnsWait = hnsDelta - hnsHalf;
+        return Wait;
+    }
+
+    return PresentOnTime;
+}
+
+//-----------------------------------------------------------------------------
+// ProcessSamplesInQueue
+//
+// Processes samples until the queue is empty or until the wait time > 0.
+//-----------------------------------------------------------------------------
+
+bool ScheduleEngine::ProcessSamplesInQueue(int64_t *phnsNextWait)
+{
+    return ProcessSamplesUntil(SteadyClock::time_point::max(), phnsNextWait);
+}
+
+//-----------------------------------------------------------------------------
+// ProcessSamplesUntil
+//
+// As ProcessSamplesInQueue, but stops after the sample that crosses stopAt,
+// and then receives a wait of 0 if samples are still queued.
+//-----------------------------------------------------------------------------
+
+bool ScheduleEngine::ProcessSamplesUntil(SteadyClock::time_point stopAt, int64_t *phnsNextWait)
+{
+    bool bOK = true;
+    int64_t hnsWait = 0;
+    ScheduledFrame frame;
+
+    while (Dequeue(&frame))
+    {
+        // Process the next sample in the queue. If the sample is not ready
+        // for presentation, hnsWait is > 0 and the sample is back in front.
+        bOK = ProcessSample(frame, &hnsWait);
+
+        if (!bOK || hnsWait > 0)
+        {
+            break;
+        }
+
+        if (SteadyClock::now() >= stopAt && QueueDepth() > 0)
+        {
+            *phnsNextWait = 0;
+            return true;
+        }
+    }
+
+    // A zero wait means we stopped because the queue is empty (or an error
+    // occurred). Sleep until something new is scheduled.
+    *phnsNextWait = (hnsWait > 0) ? hnsWait : SCHEDULE_WAIT_INFINITE;
+    return bOK;
+}
+
+//-----------------------------------------------------------------------------
+// ProcessSample
+//
+// Presents the sample, or puts it back and returns the time to wait.
+//-----------------------------------------------------------------------------
+
+bool ScheduleEngine::ProcessSample(const ScheduledFrame& frame, int64_t *phnsNextWait)
+{
+    int64_t hnsWait = 0;
+    Decision decision = PresentOnTime;
+
+    int64_t hnsTimeNow = 0;
+    int64_t hnsSystemTime = 0;
+
+    int64_t hnsTarget = 0;
+    int64_t hnsDelta = 0;
+    bool bCadence = false;
+    bool bTimed = false;
+
+    // Without a clock or a time stamp, the sample is presented immediately.
+    if (m_pClock && frame.bHasTime && m_pClock->GetCorrelatedTime(&hnsTimeNow, &hnsSystemTime))
+    {
+        bTimed = true;
+        bCadence = PlanCadence(frame, hnsTimeNow, &hnsTarget);
+
+        if (bCadence)
+        {
+            hnsDelta = hnsTarget - hnsTimeNow;
+            decision = DecideCadence(hnsDelta, m_Planner.RefreshInterval(), &hnsWait);
+        }
+        else
+        {
+            hnsDelta = frame.hnsTime - hnsTimeNow;
+            decision = Decide(hnsDelta, m_PerFrameInterval.load(), m_fRate.load(), &hnsWait);
+        }
+    }
+
+    *phnsNextWait = 0;
+
+    if (decision == Wait)
+    {
+        // The sample is not ready yet. Return it to the front of the queue.
+        m_PutBack = frame;
+        m_bHasPutBack = true;
+        *phnsNextWait = hnsWait;
+        return true;
+    }
+
+    if (decision == PresentLate)
+    {
+        if (ShouldDrop(hnsDelta, hnsTimeNow))
+        {
+            m_Dropped++;
+            m_pSink->ReleaseFrame(frame.pFrame);
+            return true;
+        }
+        m_Late++;
+    }
+    else
+    {
+        m_OnTime++;
+    }
+
+    if (bCadence)
+    {
+        RecordCadence(hnsTarget, hnsTimeNow);
+    }
+
+    if (bTimed)
+    {
+        RecordPresent(frame.hnsTime, hnsTimeNow);
+    }
+
+    bool bOK = m_pSink->PresentFrame(frame.pFrame, frame.bHasTime ? frame.hnsTime : 0);
+    m_pSink->ReleaseFrame(frame.pFrame);
+    return bOK;
+}
+
+//-----------------------------------------------------------------------------
+// RecordPresent
+//
+// Records the lateness of a presented sample, and counts the extra frame
+// periods the previous frame stayed on screen.
+//-----------------------------------------------------------------------------
+
+void ScheduleEngine::RecordPresent(int64_t hnsSampleTime, int64_t hnsTimeNow)
+{
+    bool bReverse = (m_fRate.load() < 0);
+    int64_t hnsPerFrame = m_PerFrameInterval.load();
+
+    m_Lateness.Record(bReverse ? hnsSampleTime - hnsTimeNow : hnsTimeNow - hnsSampleTime);
+
+    if (m_bHasLastPresent && hnsPerFrame > 0)
+    {
+        int64_t hnsGap = bReverse ? m_hnsLastPresentTime - hnsTimeNow : hnsTimeNow - m_hnsLastPresentTime;
+        int64_t frames = (hnsGap + hnsPerFrame / 2) / hnsPerFrame;
+
+        if (frames > 1)
+        {
+            m_Repeated += (uint64_t)(frames - 1);
+        }
+    }
+
+    m_hnsLastPresentTime = hnsTimeNow;
+    m_bHasLastPresent = true;
+}
+
+//-----------------------------------------------------------------------------
+// ShouldDrop
+//
+// Applies the late policy to a sample that Decide reported as late.
+// hnsDelta is negative (how late the sample is).
+//-----------------------------------------------------------------------------
+
+bool ScheduleEngine::ShouldDrop(int64_t hnsDelta, int64_t hnsTimeNow)
+{
+    switch (m_LatePolicy.load())
+    {
+    case LateDropByFrames:
+        if (m_fRate.load() < 0)
+        {
+            hnsDelta = - hnsDelta;
+        }
+        return (hnsDelta < - m_LateFrames.load() * m_PerFrameInterval.load());
+
+    case LateCatchUp:
+        {
+            // Drop this sample if the one behind it is also due now.
+            ScheduledFrame next;
+            int64_t hnsWait = 0;
+
+            if (!m_Queue.TryPeek(next) || !next.bHasTime)
+            {
+                return false;
+            }
+            return Decide(next.hnsTime - hnsTimeNow, m_PerFrameInterval.load(), m_fRate.load(), &hnsWait) != Wait;
+        }
+
+    default:
+        return false;
+    }
+}
+
+//-----------------------------------------------------------------------------
+// PlanCadence
+//
+// Returns true, with the planned tick time, if cadence mode applies to this
+// sample. Reconfigures the planner when the frame or refresh interval has
+// changed, and gives it the latest vertical blank in presentation time.
+//-----------------------------------------------------------------------------
+
+bool ScheduleEngine::PlanCadence(const ScheduledFrame& frame, int64_t hnsTimeNow, int64_t *phnsTarget)
+{
+    if (!m_bCadence.load() || m_fRate.load() != 1.0f)
+    {
+        m_bHasLastCadence = false;
+        m_Planner.Reset();
+        return false;
+    }
+
+    double hnsRefresh = m_RefreshInterval.load();
+    int64_t hnsPerFrame = m_PerFrameInterval.load();
+
+    // At 1x, presentation time runs with system time, so the blank was the
+    // same time ago on the presentation clock.
+    int64_t hnsSinceVblank = 0;
+    double hnsMeasured = 0;
+    bool bVblank = m_pVsync && m_pVsync->GetVblankTiming(&hnsSinceVblank, &hnsMeasured) && hnsMeasured > 0;
+
+    if (bVblank)
+    {
+        hnsRefresh = hnsMeasured;
+    }
+
+    if (m_Planner.FrameInterval() != hnsPerFrame || m_Planner.RefreshPeriod() != hnsRefresh)
+    {
+        m_Planner.Configure(hnsPerFrame, hnsRefresh);
+        m_CadenceTicks = m_Planner.TicksPerCycle();
+        m_CadenceFrames = m_Planner.FramesPerCycle();
+        m_bHasLastCadence = false;
+    }
+
+    if (!m_Planner.IsConfigured())
+    {
+        return false;
+    }
+
+    if (bVblank)
+    {
+        m_Planner.SetVblank(hnsTimeNow - hnsSinceVblank);
+    }
+    else
+    {
+        m_Planner.ClearVblank();
+    }
+
+    bool bResync = false;
+    *phnsTarget = m_Planner.PlanSample(frame.hnsTime, &bResync);
+
+    if (bResync)
+    {
+        m_CadenceResyncs++;
+        m_bHasLastCadence = false;
+    }
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+// RecordCadence
+//
+// Records how far the interval since the previous frame was from the
+// planned interval.
+//-----------------------------------------------------------------------------
+
+void ScheduleEngine::RecordCadence(int64_t hnsTarget, int64_t hnsTimeNow)
+{
+    if (m_bHasLastCadence)
+    {
+        int64_t hnsError = (hnsTimeNow - m_hnsLastPresent) - (hnsTarget - m_hnsLastTarget);
+
+        m_CadenceError.Record(hnsError);
+
+        if (hnsError > m_Planner.RefreshInterval() / 2 || hnsError < - m_Planner.RefreshInterval() / 2)
+        {
+            m_CadenceBreaks++;
+        }
+    }
+
+    m_hnsLastTarget = hnsTarget;
+    m_hnsLastPresent = hnsTimeNow;
+    m_bHasLastCadence = true;
+}
+
+//-----------------------------------------------------------------------------
+// GetCadenceStats
+//-----------------------------------------------------------------------------
+
+void ScheduleEngine::GetCadenceStats(CadenceStats *pStats) const
+{
+    pStats->patternTicks = m_CadenceTicks.load();
+    pStats->patternFrames = m_CadenceFrames.load();
+    CadencePlanner::BuildPattern(pStats->patternTicks, pStats->patternFrames, &pStats->pattern);
+    m_CadenceError.GetSnapshot(&pStats->error);
+    pStats->breaks = m_CadenceBreaks.load();
+    pStats->resyncs = m_CadenceResyncs.load();
+}
+
+void ScheduleEngine::ResetCadenceStats()
+{
+    m_CadenceError.Reset();
+    m_CadenceBreaks = 0;
+    m_CadenceResyncs = 0;
+}
+
+//-----------------------------------------------------------------------------
+// Dequeue
+// Consumer side. Returns the put-back sample first, if any.
+//-----------------------------------------------------------------------------
+
+bool ScheduleEngine::Dequeue(ScheduledFrame *pFrame)
+{
+    if (m_bHasPutBack)
+    {
+        *pFrame = m_PutBack;
+        m_bHasPutBack = false;
+        return true;
+    }
+    return m_Queue.TryPop(*pFrame);
+}
+
+//-----------------------------------------------------------------------------
+// DiscardQueue
+// Consumer side. Releases every queued sample without presenting it.
+//-----------------------------------------------------------------------------
+
+void ScheduleEngine::DiscardQueue()
+{
+    ScheduledFrame frame;
+
+    // The next sample starts a new cadence, and is not a repeat.
+    m_Planner.Reset();
+    m_bHasLastCadence = false;
+    m_bHasLastPresent = false;
+
+    while (Dequeue(&frame))
+    {
+        if (m_pSink)
+        {
+            m_pSink->ReleaseFrame(frame.pFrame);
+        }
+    }
+}
+
+//-----------------------------------------------------------------------------
+// SpinMargin
+//
+// How long before a deadline the high-resolution mode stops sleeping: twice
+// the average oversleep plus a small margin, capped by the spin budget.
+//-----------------------------------------------------------------------------
+
+ScheduleEngine::SteadyClock::duration ScheduleEngine::SpinMargin() const
+{
+    int64_t hnsMargin = 2 * m_hnsOversleep + OVERSLEEP_MARGIN;
+    int64_t hnsBudget = m_SpinBudget.load();
+
+    if (hnsMargin > hnsBudget)
+    {
+        hnsMargin = hnsBudget;
+    }
+
+    return std::chrono::duration_cast<SteadyClock::duration>(std::chrono::nanoseconds(hnsMargin * 100));
+}
+
+//-----------------------------------------------------------------------------
+// CalibrateSleep
+// Folds one measured oversleep into the running average (1/8 weight).
+//-----------------------------------------------------------------------------
+
+void ScheduleEngine::CalibrateSleep(SteadyClock::duration oversleep)
+{
+    int64_t hnsOversleep = std::chrono::duration_cast<std::chrono::nanoseconds>(oversleep).count() / 100;
+
+    if (hnsOversleep < 0)
+    {
+        hnsOversleep = 0;
+    }
+
+    m_hnsOversleep += (hnsOversleep - m_hnsOversleep) / 8;
+}
+
+//-----------------------------------------------------------------------------
+// SpinUntil
+//
+// Yields the CPU in a loop until the deadline. Returns false if a wake-up
+// flag was raised first.
+//-----------------------------------------------------------------------------
+
+bool ScheduleEngine::SpinUntil(SteadyClock::time_point deadline)
+{
+    WMF_TRACE_ZONE("Scheduler spin");
+
+    while (SteadyClock::now() < deadline)
+    {
+        if (m_bSignaled.load(std::memory_order_acquire))
+        {
+            return false;
+        }
+        std::this_thread::yield();
+    }
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+// RecordWake
+// Records the error of a wake-up that ran to its deadline.
+//-----------------------------------------------------------------------------
+
+void ScheduleEngine::RecordWake(SteadyClock::time_point deadline)
+{
+    int64_t hnsError = std::chrono::duration_cast<std::chrono::nanoseconds>(SteadyClock::now() - deadline).count() / 100;
+    m_WakeJitter.Record(hnsError);
+}
+
+//-----------------------------------------------------------------------------
+// DoWork
+//
+// Performs a flush, or presents as many samples as are due (stopping at
+// stopAt). Runs on the consumer thread (the worker thread or the shared
+// service thread). Returns false if the sink failed.
+//-----------------------------------------------------------------------------
+
+bool ScheduleEngine::DoWork(bool bFlush, SteadyClock::time_point stopAt, int64_t *phnsNextWait)
+{
+    *phnsNextWait = SCHEDULE_WAIT_INFINITE;
+
+    if (bFlush)
+    {
+        // Flushing: Clear the sample queue and signal the waiting thread.
+        DiscardQueue();
+
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            m_bFlush = false;
+            m_bSignaled = m_bTerminate;
+        }
+        m_FlushCond.notify_all();
+        return true;
+    }
+
+    // Either a new sample arrived or the wait expired. In both cases
+    // present as many samples as we can.
+    WMF_TRACE_ZONE("Scheduler process");
+    return ProcessSamplesUntil(stopAt, phnsNextWait);
+}
+
+//-----------------------------------------------------------------------------
+// ServiceStep
+//
+// Called by SharedScheduleService on its thread, which is this engine's
+// consumer thread while the engine is attached.
+//-----------------------------------------------------------------------------
+
+int64_t ScheduleEngine::ServiceStep(bool bTimedOut, SteadyClock::time_point deadline, SteadyClock::time_point stepEnd)
+{
+    bool bFlush = false;
+
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        bFlush = m_bFlush;
+        m_bSchedule = false;
+        m_bSignaled = m_bFlush || m_bTerminate;
+    }
+
+    if (!m_bRunning)
+    {
+        return SCHEDULE_WAIT_INFINITE;
+    }
+
+    if (bTimedOut)
+    {
+        RecordWake(deadline);
+    }
+
+    int64_t hnsWait = SCHEDULE_WAIT_INFINITE;
+
+    if (!DoWork(bFlush, stepEnd, &hnsWait))
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            m_bRunning = false;
+        }
+        m_FlushCond.notify_all();
+        return SCHEDULE_WAIT_INFINITE;
+    }
+    return hnsWait;
+}
+
+//-----------------------------------------------------------------------------
+// ThreadProc
+//
+// Worker thread. Sleeps on the condition variable until it is woken or the
+// current wait expires, then processes flush/terminate/schedule requests.
+//-----------------------------------------------------------------------------
+
+void ScheduleEngine::ThreadProc()
+{
+    SteadyClock::time_point deadline;
+    bool bHaveDeadline = false;
+    bool bExitThread = false;
+
+    WMF_TRACE_THREAD_NAME("Scheduler");
+
+    while (!bExitThread)
+    {
+        bool bFlush = false;
+        bool bTimedOut = false;
+        bool bHighRes = (m_TimingMode.load() == TimingHighResolution);
+        SteadyClock::time_point sleepUntil;
+
+        {
+            WMF_TRACE_ZONE("Scheduler wait");
+            std::unique_lock<std::mutex> lock(m_Mutex);
+
+            auto woken = [this] { return m_bSchedule || m_bFlush || m_bTerminate; };
+
+            if (!bHaveDeadline)
+            {
+                m_WakeCond.wait(lock, woken);
+            }
+            else
+            {
+                sleepUntil = bHighRes ? deadline - SpinMargin() : deadline;
+                bTimedOut = !m_WakeCond.wait_until(lock, sleepUntil, woken);
+            }
+
+            bExitThread = m_bTerminate;
+            bFlush = m_bFlush;
+            m_bSchedule = false;
+            m_bSignaled = m_bFlush || m_bTerminate;
+        }
+
+        m_Wakeups++;
+
+        if (bExitThread)
+        {
+            break;
+        }
+
+        if (bTimedOut)
+        {
+            bool bReached = true;
+
+            if (bHighRes)
+            {
+                CalibrateSleep(SteadyClock::now() - sleepUntil);
+                bReached = SpinUntil(deadline);
+            }
+
+            // Only waits that ran to the deadline say anything about timing.
+            if (bReached)
+            {
+                RecordWake(deadline);
+            }
+        }
+
+        int64_t hnsWait = SCHEDULE_WAIT_INFINITE;
+
+        if (!DoWork(bFlush, SteadyClock::time_point::max(), &hnsWait))
+        {
+            bExitThread = true;
+        }
+
+        bHaveDeadline = (hnsWait != SCHEDULE_WAIT_INFINITE);
+        if (bHaveDeadline)
+        {
+            deadline = SteadyClock::now() + std::chrono::duration_cast<SteadyClock::duration>(std::chrono::nanoseconds(hnsWait * 100));
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_bRunning = false;
+    }
+    m_FlushCond.notify_all();
+}
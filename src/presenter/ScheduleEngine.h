@@ -0,0 +1,344 @@
+//////////////////////////////////////////////////////////////////////////
+//
+// ScheduleEngine.h: Platform-neutral core of the sample scheduler.
+//
+// This file and ScheduleEngine.cpp have no Windows or Media Foundation
+// dependencies. The Scheduler class adapts the engine to IMFClock and
+// IMFSample; tools and simulations can drive it with their own clock.
+//
+//////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include "common/SpscRing.h"
+#include "common/TimingHistogram.h"
+#include "CadencePlanner.h"
+#include "SharedScheduleService.h"
+
+// Returned by ScheduleEngine::ProcessSamplesInQueue when the queue is empty.
+const int64_t SCHEDULE_WAIT_INFINITE = -1;
+
+// Capacity of the engine's sample queue. Only samples from the presenter's
+// sample pool (PRESENTER_BUFFER_COUNT) can be in flight, so this never fills.
+const size_t SCHEDULER_QUEUE_SIZE = 8;
+
+// Default spin budget for TimingHighResolution: 2 ms, in 100ns units.
+const int64_t SCHEDULER_DEFAULT_SPIN_BUDGET = 20000;
+
+
+//-----------------------------------------------------------------------------
+// ScheduleClock
+//
+// Abstract presentation clock. Replaces IMFClock inside the engine so that
+// a simulated clock can be substituted.
+//-----------------------------------------------------------------------------
+
+struct ScheduleClock
+{
+    // Returns the presentation time and the matching system time, in 100ns
+    // units. Returns false if the clock cannot report a time.
+    virtual bool GetCorrelatedTime(int64_t *phnsClockTime, int64_t *phnsSystemTime) = 0;
+};
+
+
+//-----------------------------------------------------------------------------
+// ScheduleVsync
+//
+// Reports the display's vertical blank, so cadence planning can put frames
+// on the ticks the display actually shows them on.
+//-----------------------------------------------------------------------------
+
+struct ScheduleVsync
+{
+    // Receives how long ago the most recent vertical blank was, and the
+    // refresh period, in 100ns units. Returns false if neither is known.
+    virtual bool GetVblankTiming(int64_t *phnsSinceVblank, double *phnsRefresh) = 0;
+};
+
+
+//-----------------------------------------------------------------------------
+// ScheduleSink
+//
+// Receives the samples that the engine decides to present. Samples are
+// opaque to the engine; the sink owns their lifetime.
+//-----------------------------------------------------------------------------
+
+struct ScheduleSink
+{
+    // Presents a sample. Returning false stops the scheduler thread.
+    virtual bool PresentFrame(void *pFrame, int64_t hnsPresentationTime) = 0;
+
+    // Called once for every frame the engine is finished with, whether it
+    // was presented, dropped as late, or discarded by a flush.
+    virtual void ReleaseFrame(void *pFrame) = 0;
+};
+
+
+//-----------------------------------------------------------------------------
+// ScheduledFrame
+//-----------------------------------------------------------------------------
+
+struct ScheduledFrame
+{
+    void    *pFrame;
+    int64_t hnsTime;            // Presentation time. Ignored if !bHasTime.
+    bool    bHasTime;           // It is valid for a sample to have no time stamp.
+};
+
+
+//-----------------------------------------------------------------------------
+// ScheduleCounters
+//
+// What happened to each sample the engine took off its queue.
+//-----------------------------------------------------------------------------
+
+struct ScheduleCounters
+{
+    ScheduleCounters() : onTime(0), late(0), dropped(0), repeated(0)
+    {
+    }
+
+    uint64_t    onTime;         // Presented inside the present window (or untimed).
+    uint64_t    late;           // Presented after the present window.
+    uint64_t    dropped;        // Released without being presented.
+    uint64_t    repeated;       // Extra frame periods the previous frame stayed on screen.
+};
+
+
+//-----------------------------------------------------------------------------
+// ScheduleEngine class
+//
+// Holds the queue of samples waiting for presentation and decides, for the
+// sample at the front of the queue, whether to present it now or how long
+// to wait. The worker thread runs on std::thread and wakes either on a
+// condition variable (new sample, flush, terminate) or when the computed
+// wait expires. Waits are computed in 100ns units, not milliseconds.
+//
+// ScheduleSample is called by one producer (the presenter). The queue is
+// drained only by the worker thread, or by the caller of
+// ProcessSamplesInQueue when the worker thread is not running (simulation).
+//
+// Timing modes:
+// TimingCoarse sleeps on the condition variable for the whole wait, so the
+// wake-up is only as precise as the OS timer (about 1-2 ms on Windows even
+// with timeBeginPeriod(1)). TimingHighResolution sleeps until shortly before
+// the target and then spins, yielding, until the target. The sleep margin is
+// calibrated from the measured oversleep and capped by the spin budget.
+//
+// Cadence mode:
+// When enabled and the refresh interval is known, each sample is planned
+// onto a refresh tick by CadencePlanner (3:2 for 24p on 60 Hz, and so on),
+// and the sample is presented within half a tick of its planned tick rather
+// than within the 1/4..3/4 frame window. Cadence mode is only used at
+// normal (1x) playback; other rates fall back to the frame-based rule.
+// With a ScheduleVsync the ticks are the display's measured blanks, and its
+// refresh period replaces the one given to SetRefreshInterval.
+//
+// Late samples:
+// LatePresent presents every late sample, as the original scheduler did.
+// LateDropByFrames drops a sample that is more than N frames late.
+// LateCatchUp drops a late sample whenever the next queued sample is also
+// due, so after a stall only the newest due sample is presented. Dropping
+// a sample only releases it through ScheduleSink::ReleaseFrame.
+//
+// Threading:
+// By default each engine runs its own worker thread. With SetUseSharedService
+// the engine's work runs on the process-wide SharedScheduleService thread
+// instead, so many players share one thread and one set of wake-ups. The
+// choice takes effect at the next Start.
+//
+// Every timed wake-up records its error (actual minus target) in the wake
+// jitter histogram, in both modes, so the two can be compared.
+//-----------------------------------------------------------------------------
+
+class ScheduleEngine
+{
+public:
+
+    enum Decision
+    {
+        PresentOnTime,
+        PresentLate,
+        Wait
+    };
+
+    enum LatePolicy
+    {
+        LatePresent,
+        LateDropByFrames,
+        LateCatchUp
+    };
+
+    enum TimingMode
+    {
+        TimingCoarse,
+        TimingHighResolution
+    };
+
+    ScheduleEngine();
+    ~ScheduleEngine();
+
+    void SetClock(ScheduleClock *pClock) { m_pClock = pClock; }     // Weak reference. Can be NULL.
+    void SetSink(ScheduleSink *pSink) { m_pSink = pSink; }          // Weak reference.
+    void SetVsync(ScheduleVsync *pVsync) { m_pVsync = pVsync; }     // Weak reference. Can be NULL.
+
+    void SetFrameInterval(int64_t hnsPerFrame);
+    void SetClockRate(float fRate) { m_fRate.store(fRate); }
+
+    int64_t FrameInterval() const { return m_PerFrameInterval.load(); }
+
+    // lateFrames: For LateDropByFrames, how many frames late a sample may be
+    //             and still be presented.
+    void SetLatePolicy(LatePolicy policy, int lateFrames);
+    LatePolicy GetLatePolicy() const { return (LatePolicy)m_LatePolicy.load(); }
+    void GetCounters(ScheduleCounters *pCounters) const;
+    void ResetCounters();       // Also resets the lateness histogram.
+
+    // Presentation clock minus sample time for each timed sample presented.
+    void GetLateness(MediaFoundationSamples::HistogramSnapshot *pSnapshot) const { m_Lateness.GetSnapshot(pSnapshot); }
+
+    // Samples waiting to be presented. Exact only on the consumer thread.
+    size_t QueueDepth() const;
+
+    // Display refresh period, in 100ns units. 0 if unknown.
+    void SetRefreshInterval(double hnsRefresh) { m_RefreshInterval.store(hnsRefresh); }
+    void SetCadenceMode(bool bEnable) { m_bCadence.store(bEnable); }
+    bool GetCadenceMode() const { return m_bCadence.load(); }
+    void GetCadenceStats(CadenceStats *pStats) const;
+    void ResetCadenceStats();
+
+    void SetTimingMode(TimingMode mode) { m_TimingMode.store(mode); }
+    TimingMode GetTimingMode() const { return (TimingMode)m_TimingMode.load(); }
+
+    // Maximum time to spin before each deadline, in 100ns units.
+    void SetSpinBudget(int64_t hnsBudget) { m_SpinBudget.store(hnsBudget > 0 ? hnsBudget : 0); }
+    int64_t GetSpinBudget() const { return m_SpinBudget.load(); }
+
+    // Number of times this engine's own worker thread has woken.
+    uint64_t Wakeups() const { return m_Wakeups.load(); }
+
+    void GetWakeJitter(MediaFoundationSamples::HistogramSnapshot *pSnapshot) const { m_WakeJitter.GetSnapshot(pSnapshot); }
+    void ResetWakeJitter() { m_WakeJitter.Reset(); }
+
+    void SetUseSharedService(bool bShared) { m_bUseShared = bShared; }
+    bool GetUseSharedService() const { return m_bUseShared; }
+
+    bool Start();
+    void Stop();
+    bool IsStarted() const { return m_bStarted.load(); }       // Start was called and Stop was not.
+    bool IsRunning() const { return m_bRunning.load(); }        // The worker thread has not exited.
+
+    // Queues a sample. Returns false if the queue is full.
+    bool ScheduleSample(const ScheduledFrame& frame);
+
+    // Discards all queued samples. Blocks until the worker thread has done so.
+    void Flush();
+
+    // Presents every sample that is due, stopping at the first one that is
+    // still early. Receives the time to wait (100ns) or SCHEDULE_WAIT_INFINITE.
+    // Returns false if the sink failed to present a sample.
+    bool ProcessSamplesInQueue(int64_t *phnsNextWait);
+
+    // The scheduling rule, separated out so that it can be evaluated without
+    // a clock or a queue.
+    //
+    // hnsDelta: Sample time minus clock time. Negative means late.
+    // phnsWait: Receives the wait, in system-clock 100ns units, if the
+    //           decision is Wait.
+    static Decision Decide(int64_t hnsDelta, int64_t hnsPerFrame, float fRate, int64_t *phnsWait);
+
+    // The cadence-mode rule. hnsDelta is the planned tick time minus clock
+    // time. Presents within half a tick either side of the planned tick.
+    static Decision DecideCadence(int64_t hnsDelta, int64_t hnsRefresh, int64_t *phnsWait);
+
+private:
+    friend class SharedScheduleService;
+
+    typedef std::chrono::steady_clock SteadyClock;
+
+    // Runs one round of work on the shared service thread, presenting due
+    // samples until stepEnd. Returns the next wait, SCHEDULE_WAIT_INFINITE,
+    // or 0 if it stopped at stepEnd with samples still queued.
+    int64_t ServiceStep(bool bTimedOut, SteadyClock::time_point deadline, SteadyClock::time_point stepEnd);
+
+    bool DoWork(bool bFlush, SteadyClock::time_point stopAt, int64_t *phnsNextWait);
+    bool ProcessSamplesUntil(SteadyClock::time_point stopAt, int64_t *phnsNextWait);
+    void Signal();
+    bool ProcessSample(const ScheduledFrame& frame, int64_t *phnsNextWait);
+    bool ShouldDrop(int64_t hnsDelta, int64_t hnsTimeNow);
+    void RecordPresent(int64_t hnsSampleTime, int64_t hnsTimeNow);
+    bool PlanCadence(const ScheduledFrame& frame, int64_t hnsTimeNow, int64_t *phnsTarget);
+    void RecordCadence(int64_t hnsTarget, int64_t hnsTimeNow);
+    bool Dequeue(ScheduledFrame *pFrame);
+    void DiscardQueue();
+    void ThreadProc();
+
+    // High-resolution timing. Used by the worker thread and the service.
+    SteadyClock::duration SpinMargin() const;
+    void CalibrateSleep(SteadyClock::duration oversleep);
+    bool SpinUntil(SteadyClock::time_point deadline);
+    void RecordWake(SteadyClock::time_point deadline);
+
+private:
+    MediaFoundationSamples::SpscRing<ScheduledFrame, SCHEDULER_QUEUE_SIZE>  m_Queue;    // Samples waiting to be presented.
+    ScheduledFrame          m_PutBack;              // Early sample returned by the worker. (Consumer-owned.)
+    std::atomic<bool>       m_bHasPutBack;          // (Written by the consumer only.)
+    bool                    m_bHasLastPresent;
+    int64_t                 m_hnsLastPresentTime;   // Clock time of the previous presented sample.
+
+    ScheduleClock           *m_pClock;
+    ScheduleSink            *m_pSink;
+    ScheduleVsync           *m_pVsync;
+
+    std::atomic<float>      m_fRate;                // Playback rate.
+    std::atomic<int64_t>    m_PerFrameInterval;     // Duration of each frame.
+
+    std::thread             m_Thread;
+    std::mutex              m_Mutex;                // Protects the wake-up flags below.
+    std::condition_variable m_WakeCond;             // Signals the worker thread.
+    std::condition_variable m_FlushCond;            // Signals completion of a flush.
+    bool                    m_bSchedule;
+    bool                    m_bFlush;
+    bool                    m_bTerminate;
+    std::atomic<bool>       m_bRunning;
+    std::atomic<bool>       m_bStarted;
+    bool                    m_bUseShared;
+    SharedScheduleService   *m_pService;            // Non-NULL while started in shared mode.
+    std::atomic<uint64_t>   m_Wakeups;
+    std::atomic<bool>       m_bSignaled;            // Set with any wake-up flag; ends a spin early.
+
+    std::atomic<int>        m_TimingMode;
+    std::atomic<int64_t>    m_SpinBudget;           // Maximum spin per wait (100ns).
+    int64_t                 m_hnsOversleep;         // Running average of sleep overshoot. (Worker-owned.)
+
+    MediaFoundationSamples::TimingHistogram m_WakeJitter;   // Wake-up error (100ns).
+
+    std::atomic<int>        m_LatePolicy;
+    std::atomic<int>        m_LateFrames;
+    std::atomic<uint64_t>   m_OnTime;
+    std::atomic<uint64_t>   m_Late;
+    std::atomic<uint64_t>   m_Dropped;
+    std::atomic<uint64_t>   m_Repeated;
+    MediaFoundationSamples::TimingHistogram m_Lateness;
+
+    // Cadence planning. The planner and the previous-frame times are
+    // worker-owned; the counters can be read from any thread.
+    std::atomic<bool>       m_bCadence;
+    std::atomic<double>     m_RefreshInterval;
+    CadencePlanner          m_Planner;
+    bool                    m_bHasLastCadence;
+    int64_t                 m_hnsLastTarget;        // Planned tick of the previous frame.
+    int64_t                 m_hnsLastPresent;       // Clock time the previous frame was presented.
+    std::atomic<int>        m_CadenceTicks;         // Published copy of the plan.
+    std::atomic<int>        m_CadenceFrames;
+    std::atomic<uint64_t>   m_CadenceBreaks;
+    std::atomic<uint64_t>   m_CadenceResyncs;
+    MediaFoundationSamples::TimingHistogram m_CadenceError;
+};
@@ -0,0 +1,170 @@
+//////////////////////////////////////////////////////////////////////////
+//
+// SeekMonitor.cpp: Frame-accurate seeks, and how long they take.
+//
+//////////////////////////////////////////////////////////////////////////
+
+#include "SeekMonitor.h"
+
+SeekMonitor::SeekMonitor() :
+    m_State(Idle),
+    m_Target(0),
+    m_Keyframe(-1),
+    m_FrameDuration(0),
+    m_RequestTime(0),
+    m_Landed(0),
+    m_Discarded(0),
+    m_Seeks(0),
+    m_Missed(0),
+    m_Overshot(0),
+    m_Cancelled(0),
+    m_LastLatency(0),
+    m_LastDiscarded(0),
+    m_LastKeyframeDistance(-1),
+    m_Latency(SEEK_LATENCY_BIN_WIDTH, 0),
+    m_DiscardedFrames(1, 0)
+{
+}
+
+void SeekMonitor::OnSeekRequested(int64_t target, int64_t keyframe, int64_t frameDuration, int64_t now)
+{
+    std::lock_guard<std::mutex> lock(m_Lock);
+
+    if (m_State != Idle)
+    {
+        Cancel();
+    }
+
+    m_State = Requested;
+    m_Target = target;
+    m_Keyframe = keyframe;
+    m_FrameDuration = frameDuration;
+    m_RequestTime = now;
+    m_Discarded = 0;
+}
+
+void SeekMonitor::OnClockSeek()
+{
+    std::lock_guard<std::mutex> lock(m_Lock);
+
+    if (m_State == Requested)
+    {
+        m_State = Discarding;
+    }
+    else if (m_State != Idle)
+    {
+        // Someone else moved the clock; this seek's frames were flushed.
+        Cancel();
+    }
+}
+
+bool SeekMonitor::OnFrameDecoded(int64_t sampleTime, int64_t sampleDuration)
+{
+    std::lock_guard<std::mutex> lock(m_Lock);
+
+    if (m_State != Discarding)
+    {
+        return false;
+    }
+
+    const int64_t duration = (sampleDuration > 0) ? sampleDuration : m_FrameDuration;
+
+    if (sampleTime + duration / 2 <= m_Target)
+    {
+        m_Discarded++;
+        return true;
+    }
+
+    m_State = Landed;
+    m_Landed = sampleTime;
+    return false;
+}
+
+void SeekMonitor::OnFramePresented(int64_t sampleTime, int64_t presentTime)
+{
+    std::lock_guard<std::mutex> lock(m_Lock);
+
+    // The target frame, or a later one if the scheduler dropped the target
+    // frame as late.
+    if (m_State != Landed || sampleTime < m_Landed)
+    {
+        return;
+    }
+
+    m_State = Idle;
+    m_Seeks++;
+
+    // Overshot if the source started after the target, having sought to
+    // the nearest keyframe rather than the preceding one: the target frame
+    // was never decoded. Otherwise missed if it was decoded but dropped.
+    if (m_Landed - m_FrameDuration / 2 > m_Target)
+    {
+        m_Overshot++;
+    }
+    else if (sampleTime != m_Landed)
+    {
+        m_Missed++;
+    }
+
+    m_LastLatency = presentTime - m_RequestTime;
+    m_LastDiscarded = m_Discarded;
+    m_LastKeyframeDistance = (m_Keyframe >= 0) ? m_Target - m_Keyframe : -1;
+
+    m_Latency.Record(m_LastLatency);
+    m_DiscardedFrames.Record(m_Discarded);
+}
+
+void SeekMonitor::OnEndOfStream()
+{
+    std::lock_guard<std::mutex> lock(m_Lock);
+
+    // The target was past the last frame. Stop discarding, or nothing
+    // after the next seek would be shown either.
+    if (m_State == Discarding)
+    {
+        Cancel();
+    }
+}
+
+bool SeekMonitor::IsPending() const
+{
+    std::lock_guard<std::mutex> lock(m_Lock);
+
+    return m_State != Idle;
+}
+
+void SeekMonitor::Cancel()
+{
+    m_State = Idle;
+    m_Cancelled++;
+}
+
+void SeekMonitor::GetStats(SeekStats *pStats) const
+{
+    std::lock_guard<std::mutex> lock(m_Lock);
+
+    pStats->seeks = m_Seeks;
+    pStats->missed = m_Missed;
+    pStats->overshot = m_Overshot;
+    pStats->cancelled = m_Cancelled;
+    pStats->lastLatency = m_LastLatency;
+    pStats->lastDiscarded = m_LastDiscarded;
+    pStats->lastKeyframeDistance = m_LastKeyframeDistance;
+    m_Latency.GetSnapshot(&pStats->latency);
+    m_DiscardedFrames.GetSnapshot(&pStats->discarded);
+}
+
+void SeekMonitor::Reset()
+{
+    std::lock_guard<std::mutex> lock(m_Lock);
+
+    m_Seeks = 0;
+    m_Missed = 0;
+    m_Overshot = 0;
+    m_Cancelled = 0;
+    m_LastLatency = 0;
+    m_LastDiscarded = 0;
+    m_LastKeyframeDistance = -1;
+    m_Latency.Reset();
+    m_DiscardedFrames.Reset();
+}
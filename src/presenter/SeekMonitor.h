@@ -0,0 +1,123 @@
+//////////////////////////////////////////////////////////////////////////
+//
+// SeekMonitor.h: Frame-accurate seeks, and how long they take.
+//
+// This file and SeekMonitor.cpp have no Windows or Media Foundation
+// dependencies. Times are in 100ns units.
+//
+//////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <stdint.h>
+#include <mutex>
+
+#include "common/TimingHistogram.h"
+
+// Seek latency is binned in 10 ms steps from 0. Discarded frames are
+// counted in a histogram of their own, one frame per bin.
+const int64_t SEEK_LATENCY_BIN_WIDTH = 100000;
+
+
+//-----------------------------------------------------------------------------
+// SeekStats
+//-----------------------------------------------------------------------------
+
+struct SeekStats
+{
+    SeekStats() : seeks(0), missed(0), overshot(0), cancelled(0), lastLatency(0), lastDiscarded(0), lastKeyframeDistance(-1)
+    {
+    }
+
+    uint64_t    seeks;              // Completed: the target frame, or a later one, was presented.
+    uint64_t    missed;             // Completed, but the target frame was decoded and dropped as late.
+    uint64_t    overshot;           // Completed, but the source started after the target; see SeekMonitor.
+    uint64_t    cancelled;          // Superseded by another seek or the end of the stream.
+
+    int64_t     lastLatency;
+    int64_t     lastDiscarded;
+    int64_t     lastKeyframeDistance;   // Target minus the preceding keyframe, or -1 if not known.
+
+    // From the seek request to the target frame being presented.
+    MediaFoundationSamples::HistogramSnapshot   latency;
+
+    // Frames decoded from the keyframe and not presented, per seek.
+    MediaFoundationSamples::HistogramSnapshot   discarded;
+};
+
+
+//-----------------------------------------------------------------------------
+// SeekMonitor class
+//
+// Media Foundation sources seek to the keyframe at or before the requested
+// position, and the decoder then outputs every frame from there. The
+// presenter asks the monitor about each decoded frame, and throws away
+// those before the target instead of presenting them, so the first frame on
+// screen is the target frame. Some sources seek to the nearest keyframe
+// instead, which can be after the target; such a seek lands on the first
+// frame decoded and counts as overshot, not missed. The keyframe passed to
+// OnSeekRequested is only reported, as lastKeyframeDistance.
+//
+// Sequence:
+//   OnSeekRequested      Player, just before it starts the session at the target.
+//   OnClockSeek          Presenter, when the clock jumps (after its flush): arms
+//                        a requested seek, or cancels one the clock has left.
+//   OnFrameDecoded       Presenter, per decoded frame: true to discard it.
+//   OnFramePresented     Present engine, per presented frame: completes the seek
+//                        when the target frame, or a later one, is on screen.
+//
+// A decoded frame is the target when it starts less than half a frame
+// before the target time, so a target on a frame boundary selects that
+// frame even after rounding. Any thread can call any method.
+//-----------------------------------------------------------------------------
+
+class SeekMonitor
+{
+public:
+    SeekMonitor();
+
+    // keyframe: the preceding keyframe's time, or -1 if not known.
+    void OnSeekRequested(int64_t target, int64_t keyframe, int64_t frameDuration, int64_t now);
+    void OnClockSeek();
+    bool OnFrameDecoded(int64_t sampleTime, int64_t sampleDuration);
+    void OnFramePresented(int64_t sampleTime, int64_t presentTime);
+    void OnEndOfStream();
+
+    // A seek was requested and its target frame is not on screen yet.
+    bool IsPending() const;
+
+    void GetStats(SeekStats *pStats) const;
+    void Reset();
+
+private:
+    enum State
+    {
+        Idle,
+        Requested,      // Waiting for the clock to jump.
+        Discarding,     // Frames before the target are thrown away.
+        Landed          // The first frame at the target was passed on.
+    };
+
+    void Cancel();
+
+    mutable std::mutex      m_Lock;
+    State                   m_State;
+    int64_t                 m_Target;
+    int64_t                 m_Keyframe;
+    int64_t                 m_FrameDuration;
+    int64_t                 m_RequestTime;
+    int64_t                 m_Landed;           // Sample time of the frame passed on.
+    int64_t                 m_Discarded;
+
+    uint64_t                m_Seeks;
+    uint64_t                m_Missed;
+    uint64_t                m_Overshot;
+    uint64_t                m_Cancelled;
+    int64_t                 m_LastLatency;
+    int64_t                 m_LastDiscarded;
+    int64_t                 m_LastKeyframeDistance;
+
+    // Written under m_Lock, so from one thread at a time.
+    MediaFoundationSamples::TimingHistogram     m_Latency;
+    MediaFoundationSamples::TimingHistogram     m_DiscardedFrames;
+};
@@ -0,0 +1,283 @@
+//////////////////////////////////////////////////////////////////////////
+//
+// SharedDeviceService.cpp: One Direct3D device for many presenters.
+//
+//////////////////////////////////////////////////////////////////////////
+
+#include "EVRPresenter.h"
+#include "cinder/gl/gl.h"
+#include "cinder/Log.h"
+#include "glload/wgl_all.h"
+
+// The process-wide instance and its reference count.
+static CritSec                  s_ServiceLock;
+static SharedDeviceService      *s_pService = NULL;
+static int                      s_ServiceRefCount = 0;
+
+volatile LONGLONG SharedDeviceService::s_cbVideoMemory = 0;
+
+//-----------------------------------------------------------------------------
+// Acquire
+// Returns the shared instance, creating it and its device on first use.
+//-----------------------------------------------------------------------------
+
+HRESULT SharedDeviceService::Acquire(SharedDeviceService **ppService)
+{
+    AutoLock lock(s_ServiceLock);
+
+    if (s_pService == NULL)
+    {
+        SharedDeviceService *pService = new SharedDeviceService();
+
+        HRESULT hr = pService->Initialize();
+
+        if (FAILED(hr))
+        {
+            delete pService;
+            return hr;
+        }
+        s_pService = pService;
+    }
+    s_ServiceRefCount++;
+    *ppService = s_pService;
+    return S_OK;
+}
+
+//-----------------------------------------------------------------------------
+// Release
+// Destroys the shared instance when the last reference goes away.
+//-----------------------------------------------------------------------------
+
+void SharedDeviceService::Release()
+{
+    SharedDeviceService *pService = NULL;
+
+    {
+        AutoLock lock(s_ServiceLock);
+
+        if (--s_ServiceRefCount == 0)
+        {
+            pService = s_pService;
+            s_pService = NULL;
+        }
+    }
+
+    delete pService;
+}
+
+//-----------------------------------------------------------------------------
+// Constructor / Destructor
+//-----------------------------------------------------------------------------
+
+SharedDeviceService::SharedDeviceService() :
+    m_pD3D9(NULL),
+    m_pDevice(NULL),
+    m_pDeviceManager(NULL),
+    m_DeviceResetToken(0),
+    m_Generation(0),
+    m_GLDevice(NULL),
+    m_GLDeviceGeneration(0),
+    m_cGLUsers(0)
+{
+    ZeroMemory(&m_DisplayMode, sizeof(m_DisplayMode));
+}
+
+SharedDeviceService::~SharedDeviceService()
+{
+    // Every presenter closed its interop reference on the GL thread first.
+    assert(m_cGLUsers == 0);
+
+    SAFE_RELEASE(m_pDevice);
+    SAFE_RELEASE(m_pDeviceManager);
+    SAFE_RELEASE(m_pD3D9);
+}
+
+HRESULT SharedDeviceService::Initialize()
+{
+    HRESULT hr = S_OK;
+
+    CHECK_HR(hr = Direct3DCreate9Ex(D3D_SDK_VERSION, &m_pD3D9));
+    CHECK_HR(hr = DXVA2CreateDirect3DDeviceManager9(&m_DeviceResetToken, &m_pDeviceManager));
+    CHECK_HR(hr = CreateDevice());
+
+done:
+    return hr;
+}
+
+//-----------------------------------------------------------------------------
+// CreateDevice
+//
+// Creates the device on the default adapter, with the same parameters as
+// D3DPresentEngine::CreateD3DDevice. A shared device cannot follow each
+// player's window to its monitor. Caller holds the object lock, or is
+// Initialize.
+//-----------------------------------------------------------------------------
+
+HRESULT SharedDeviceService::CreateDevice()
+{
+    HRESULT hr = S_OK;
+    UINT    uAdapterID = D3DADAPTER_DEFAULT;
+    DWORD   vp = 0;
+
+    D3DCAPS9 ddCaps;
+    ZeroMemory(&ddCaps, sizeof(ddCaps));
+
+    IDirect3DDevice9Ex* pDevice = NULL;
+
+    D3DPRESENT_PARAMETERS pp;
+    ZeroMemory(&pp, sizeof(pp));
+
+    pp.BackBufferWidth = 1;
+    pp.BackBufferHeight = 1;
+    pp.Windowed = TRUE;
+    pp.SwapEffect = D3DSWAPEFFECT_COPY;
+    pp.BackBufferFormat = D3DFMT_UNKNOWN;
+    pp.hDeviceWindow = GetDesktopWindow();
+    pp.Flags = D3DPRESENTFLAG_VIDEO;
+    pp.PresentationInterval = D3DPRESENT_INTERVAL_DEFAULT;
+
+    CHECK_HR(hr = m_pD3D9->GetDeviceCaps(uAdapterID, D3DDEVTYPE_HAL, &ddCaps));
+
+    if (ddCaps.DevCaps & D3DDEVCAPS_HWTRANSFORMANDLIGHT)
+    {
+        vp = D3DCREATE_HARDWARE_VERTEXPROCESSING;
+    }
+    else
+    {
+        CI_LOG_W("Software Cap, No bueno :P");
+        vp = D3DCREATE_SOFTWARE_VERTEXPROCESSING;
+    }
+
+    // Multithreaded: every presenter's scheduler thread uses the device.
+    CHECK_HR(hr = m_pD3D9->CreateDeviceEx(
+        uAdapterID,
+        D3DDEVTYPE_HAL,
+        pp.hDeviceWindow,
+        vp | D3DCREATE_NOWINDOWCHANGES | D3DCREATE_MULTITHREADED | D3DCREATE_FPU_PRESERVE,
+        &pp,
+        NULL,
+        &pDevice
+        ));
+
+    CHECK_HR(hr = m_pD3D9->GetAdapterDisplayMode(uAdapterID, &m_DisplayMode));
+
+    // Invalidates every mixer's device handle; each opens a new one.
+    CHECK_HR(hr = m_pDeviceManager->ResetDevice(pDevice, m_DeviceResetToken));
+
+    SAFE_RELEASE(m_pDevice);
+
+    m_pDevice = pDevice;
+    m_pDevice->AddRef();
+    m_Generation++;
+
+done:
+    SAFE_RELEASE(pDevice);
+    return hr;
+}
+
+HRESULT SharedDeviceService::GetDevice(IDirect3D9Ex **ppD3D9, IDirect3DDevice9Ex **ppDevice,
+    IDirect3DDeviceManager9 **ppDeviceManager, UINT *pGeneration)
+{
+    AutoLock lock(m_ObjectLock);
+
+    if (m_pDevice == NULL)
+    {
+        return MF_E_NOT_INITIALIZED;
+    }
+
+    *ppD3D9 = m_pD3D9;
+    (*ppD3D9)->AddRef();
+    *ppDevice = m_pDevice;
+    (*ppDevice)->AddRef();
+    *ppDeviceManager = m_pDeviceManager;
+    (*ppDeviceManager)->AddRef();
+    *pGeneration = m_Generation;
+    return S_OK;
+}
+
+HRESULT SharedDeviceService::RecreateDevice(IDirect3DDevice9Ex *pLostDevice)
+{
+    AutoLock lock(m_ObjectLock);
+
+    if (pLostDevice != m_pDevice)
+    {
+        return S_OK;
+    }
+
+    return CreateDevice();
+}
+
+//-----------------------------------------------------------------------------
+// AcquireGLDevice / ReleaseGLDevice
+//
+// Reference-counted wglDXOpenDeviceNV handle. Both must be called on the
+// GL thread, with the GL context current.
+//
+// After RecreateDevice, the open handle belongs to the old device. It is
+// not handed out again; it is closed when its last user releases it, and
+// only then is a handle opened on the new device.
+//-----------------------------------------------------------------------------
+
+HANDLE SharedDeviceService::AcquireGLDevice()
+{
+    AutoLock lock(m_ObjectLock);
+
+    if (m_GLDevice != NULL && m_GLDeviceGeneration != m_Generation)
+    {
+        return NULL;
+    }
+
+    if (m_GLDevice == NULL)
+    {
+        m_GLDevice = wglDXOpenDeviceNV(m_pDevice);
+
+        if (m_GLDevice == NULL)
+        {
+            return NULL;
+        }
+        m_GLDeviceGeneration = m_Generation;
+    }
+    m_cGLUsers++;
+    return m_GLDevice;
+}
+
+bool SharedDeviceService::CanOpenGLDevice()
+{
+    AutoLock lock(m_ObjectLock);
+
+    return m_GLDevice == NULL || m_GLDeviceGeneration == m_Generation;
+}
+
+void SharedDeviceService::ReleaseGLDevice()
+{
+    AutoLock lock(m_ObjectLock);
+
+    if (m_cGLUsers == 0 || --m_cGLUsers > 0)
+    {
+        return;
+    }
+
+    if (!wglDXCloseDeviceNV(m_GLDevice))
+    {
+        CI_LOG_I( "FAILED closing handle" );
+    }
+    m_GLDevice = NULL;
+}
+
+void SharedDeviceService::AddVideoMemory(INT64 delta)
+{
+    InterlockedExchangeAdd64(&s_cbVideoMemory, delta);
+}
+
+UINT64 SharedDeviceService::VideoMemory()
+{
+    return (UINT64)InterlockedCompareExchange64(&s_cbVideoMemory, 0, 0);
+}
+
+UINT64 SharedDeviceService::AvailableTextureMemory()
+{
+    AutoLock lock(m_ObjectLock);
+
+    // Rounded to the nearest MB by the runtime.
+    return m_pDevice ? (UINT64)m_pDevice->GetAvailableTextureMem() : 0;
+}
@@ -0,0 +1,87 @@
+//////////////////////////////////////////////////////////////////////////
+//
+// SharedDeviceService.h: One Direct3D device for many presenters.
+//
+//////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+
+//-----------------------------------------------------------------------------
+// SharedDeviceService class
+//
+// Owns a process-wide IDirect3DDevice9Ex, the IDirect3DDeviceManager9 the
+// mixers open it through, and the WGL_NV_DX_interop handle GL registers
+// shared textures with. Presenters that opt in use these instead of
+// creating their own, so N players cost one device, one device manager and
+// one interop handle.
+//
+// The service is shared by reference count, like SharedScheduleService:
+// Acquire creates the device on first use and Release destroys it when the
+// last presenter lets go. The interop handle has its own count, because it
+// must be opened and closed on the GL thread.
+//
+// If the device is lost, the first presenter to notice calls
+// RecreateDevice; the device generation changes and every other presenter
+// picks up the new device on its next CheckDeviceState. The interop handle
+// still refers to the old device: each presenter releases the objects it
+// registered with it, the last release closes it, and the next
+// AcquireGLDevice opens a handle on the new device.
+//
+// The service also totals the video memory its presenters allocate.
+//-----------------------------------------------------------------------------
+
+class SharedDeviceService
+{
+public:
+    static HRESULT Acquire(SharedDeviceService **ppService);
+    static void Release();
+
+    // Returns AddRef'd pointers to the current device objects, and the
+    // generation of the device.
+    HRESULT GetDevice(IDirect3D9Ex **ppD3D9, IDirect3DDevice9Ex **ppDevice,
+        IDirect3DDeviceManager9 **ppDeviceManager, UINT *pGeneration);
+
+    UINT Generation() const { return m_Generation; }
+    D3DDISPLAYMODE DisplayMode() const { return m_DisplayMode; }
+
+    // Replaces the device, unless pLostDevice is no longer the current one
+    // (another presenter got there first).
+    HRESULT RecreateDevice(IDirect3DDevice9Ex *pLostDevice);
+
+    // GL thread. Opens the interop handle on first use; NULL on failure, or
+    // while a handle on a replaced device is still in use.
+    HANDLE AcquireGLDevice();
+    void ReleaseGLDevice();
+
+    // False while a handle on a replaced device is still in use.
+    bool CanOpenGLDevice();
+
+    // Video memory allocated by the presenters using the service, in bytes.
+    void AddVideoMemory(INT64 delta);
+    static UINT64 VideoMemory();
+
+    // The driver's estimate of free texture memory, in bytes.
+    UINT64 AvailableTextureMemory();
+
+private:
+    SharedDeviceService();
+    ~SharedDeviceService();
+
+    HRESULT Initialize();
+    HRESULT CreateDevice();
+
+    CritSec                     m_ObjectLock;
+    IDirect3D9Ex                *m_pD3D9;
+    IDirect3DDevice9Ex          *m_pDevice;
+    IDirect3DDeviceManager9     *m_pDeviceManager;
+    UINT                        m_DeviceResetToken;
+    UINT                        m_Generation;       // Bumped whenever the device is replaced.
+    D3DDISPLAYMODE              m_DisplayMode;
+
+    HANDLE                      m_GLDevice;         // wglDXOpenDeviceNV handle.
+    UINT                        m_GLDeviceGeneration;   // Generation of the device m_GLDevice was opened on.
+    int                         m_cGLUsers;
+
+    static volatile LONGLONG    s_cbVideoMemory;
+};
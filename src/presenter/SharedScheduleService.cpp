@@ -0,0 +1,312 @@
+//////////////////////////////////////////////////////////////////////////
+//
+// SharedScheduleService.cpp: One scheduling thread for many presenters.
+//
+//////////////////////////////////////////////////////////////////////////
+
+#include "SharedScheduleService.h"
+#include "ScheduleEngine.h"
+#include "PipelineTrace.h"
+
+// The process-wide instance and its reference count.
+static std::mutex               s_ServiceLock;
+static SharedScheduleService    *s_pService = NULL;
+static int                      s_ServiceRefCount = 0;
+
+// Step time and dispatch delay: 100us bins from 0.
+static const int64_t SHARED_STEP_BIN_WIDTH = 1000;
+
+std::atomic<uint64_t> SharedScheduleService::s_Wakeups(0);
+std::atomic<int64_t> SharedScheduleService::s_StepBudget(SHARED_SCHEDULE_DEFAULT_STEP_BUDGET);
+std::atomic<uint64_t> SharedScheduleService::s_Overruns(0);
+std::atomic<uint64_t> SharedScheduleService::s_Yields(0);
+MediaFoundationSamples::TimingHistogram SharedScheduleService::s_StepTime(SHARED_STEP_BIN_WIDTH, 0);
+MediaFoundationSamples::TimingHistogram SharedScheduleService::s_DispatchDelay(SHARED_STEP_BIN_WIDTH, 0);
+
+// 100ns units from a steady_clock duration.
+static int64_t ToHns(std::chrono::steady_clock::duration d)
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(d).count() / 100;
+}
+
+//-----------------------------------------------------------------------------
+// Acquire
+// Returns the shared instance, creating it on first use.
+//-----------------------------------------------------------------------------
+
+SharedScheduleService* SharedScheduleService::Acquire()
+{
+    std::lock_guard<std::mutex> lock(s_ServiceLock);
+
+    if (s_pService == NULL)
+    {
+        s_pService = new SharedScheduleService();
+    }
+    s_ServiceRefCount++;
+    return s_pService;
+}
+
+//-----------------------------------------------------------------------------
+// Release
+// Destroys the shared instance when the last reference goes away.
+//-----------------------------------------------------------------------------
+
+void SharedScheduleService::Release()
+{
+    SharedScheduleService *pService = NULL;
+
+    {
+        std::lock_guard<std::mutex> lock(s_ServiceLock);
+
+        if (--s_ServiceRefCount == 0)
+        {
+            pService = s_pService;
+            s_pService = NULL;
+        }
+    }
+
+    // Join the thread outside the lock.
+    delete pService;
+}
+
+uint64_t SharedScheduleService::Wakeups()
+{
+    return s_Wakeups.load();
+}
+
+//-----------------------------------------------------------------------------
+// GetStats / ResetStats
+//-----------------------------------------------------------------------------
+
+void SharedScheduleService::GetStats(SharedScheduleStats *pStats)
+{
+    s_StepTime.GetSnapshot(&pStats->stepTime);
+    s_DispatchDelay.GetSnapshot(&pStats->dispatchDelay);
+    pStats->overruns = s_Overruns.load();
+    pStats->yields = s_Yields.load();
+}
+
+void SharedScheduleService::ResetStats()
+{
+    s_StepTime.Reset();
+    s_DispatchDelay.Reset();
+    s_Overruns = 0;
+    s_Yields = 0;
+}
+
+//-----------------------------------------------------------------------------
+// Constructor / Destructor
+//-----------------------------------------------------------------------------
+
+SharedScheduleService::SharedScheduleService() :
+    m_NextSeq(0),
+    m_pCurrent(NULL),
+    m_bTerminate(false),
+    m_bSignaled(false)
+{
+    m_Thread = std::thread(&SharedScheduleService::ThreadProc, this);
+}
+
+SharedScheduleService::~SharedScheduleService()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_bTerminate = true;
+        m_bSignaled = true;
+    }
+    m_WakeCond.notify_one();
+    m_Thread.join();
+}
+
+//-----------------------------------------------------------------------------
+// Attach / Detach
+//-----------------------------------------------------------------------------
+
+void SharedScheduleService::Attach(ScheduleEngine *pEngine)
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    m_Live[pEngine] = 0;
+}
+
+void SharedScheduleService::Detach(ScheduleEngine *pEngine)
+{
+    std::unique_lock<std::mutex> lock(m_Mutex);
+
+    // Any heap entries for this engine are now stale.
+    m_Live.erase(pEngine);
+
+    m_IdleCond.wait(lock, [this, pEngine] { return m_pCurrent != pEngine; });
+}
+
+//-----------------------------------------------------------------------------
+// Wake
+//-----------------------------------------------------------------------------
+
+void SharedScheduleService::Wake(ScheduleEngine *pEngine)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+
+        if (m_Live.find(pEngine) == m_Live.end())
+        {
+            return;
+        }
+        Push(pEngine, SteadyClock::now(), false);
+    }
+    m_WakeCond.notify_one();
+}
+
+//-----------------------------------------------------------------------------
+// Push
+// Files a new live entry for the engine. Call with m_Mutex held.
+//-----------------------------------------------------------------------------
+
+void SharedScheduleService::Push(ScheduleEngine *pEngine, SteadyClock::time_point deadline, bool bTimed)
+{
+    Entry entry;
+
+    entry.deadline = deadline;
+    entry.pEngine = pEngine;
+    entry.seq = ++m_NextSeq;
+    entry.bTimed = bTimed;
+
+    m_Live[pEngine] = entry.seq;
+    m_Heap.push(entry);
+    m_bSignaled = true;
+}
+
+//-----------------------------------------------------------------------------
+// ThreadProc
+//
+// Sleeps until the earliest live deadline, then runs that engine outside
+// the lock, for at most the step budget. Engines in TimingHighResolution
+// get the same sleep-then-spin treatment as on their own thread, using the
+// engine's calibration.
+//-----------------------------------------------------------------------------
+
+void SharedScheduleService::ThreadProc()
+{
+    std::unique_lock<std::mutex> lock(m_Mutex);
+
+    WMF_TRACE_THREAD_NAME("Shared scheduler");
+
+    while (!m_bTerminate)
+    {
+        if (m_Heap.empty())
+        {
+            m_WakeCond.wait(lock);
+            s_Wakeups++;
+            continue;
+        }
+
+        Entry top = m_Heap.top();
+        std::map<ScheduleEngine*, uint64_t>::iterator it = m_Live.find(top.pEngine);
+
+        if (it == m_Live.end() || it->second != top.seq)
+        {
+            // Stale entry.
+            m_Heap.pop();
+            continue;
+        }
+
+        bool bHighRes = top.bTimed && (top.pEngine->GetTimingMode() == ScheduleEngine::TimingHighResolution);
+        SteadyClock::time_point sleepUntil = bHighRes ? top.deadline - top.pEngine->SpinMargin() : top.deadline;
+
+        if (SteadyClock::now() < sleepUntil)
+        {
+            m_bSignaled = false;
+
+            std::cv_status status;
+            {
+                WMF_TRACE_ZONE("Scheduler wait");
+                status = m_WakeCond.wait_until(lock, sleepUntil);
+            }
+
+            if (status == std::cv_status::timeout && bHighRes)
+            {
+                top.pEngine->CalibrateSleep(SteadyClock::now() - sleepUntil);
+            }
+            s_Wakeups++;
+
+            // Something earlier may have been filed meanwhile.
+            continue;
+        }
+
+        if (bHighRes && SteadyClock::now() < top.deadline)
+        {
+            bool bInterrupted = false;
+
+            m_bSignaled = false;
+            lock.unlock();
+
+            WMF_TRACE_ZONE("Scheduler spin");
+            while (SteadyClock::now() < top.deadline)
+            {
+                if (m_bSignaled.load(std::memory_order_acquire))
+                {
+                    bInterrupted = true;
+                    break;
+                }
+                std::this_thread::yield();
+            }
+
+            lock.lock();
+
+            if (bInterrupted)
+            {
+                continue;
+            }
+
+            // The engine may have been detached while we spun.
+            it = m_Live.find(top.pEngine);
+            if (it == m_Live.end() || it->second != top.seq)
+            {
+                continue;
+            }
+        }
+
+        m_Heap.pop();
+        it->second = 0;
+        m_pCurrent = top.pEngine;
+
+        lock.unlock();
+
+        SteadyClock::time_point start = SteadyClock::now();
+        SteadyClock::duration budget = std::chrono::duration_cast<SteadyClock::duration>(std::chrono::nanoseconds(s_StepBudget.load() * 100));
+
+        if (top.bTimed)
+        {
+            s_DispatchDelay.Record(ToHns(start - top.deadline));
+        }
+
+        int64_t hnsWait = top.pEngine->ServiceStep(top.bTimed, top.deadline, start + budget);
+
+        SteadyClock::duration elapsed = SteadyClock::now() - start;
+        s_StepTime.Record(ToHns(elapsed));
+        if (elapsed > budget)
+        {
+            s_Overruns++;
+        }
+
+        lock.lock();
+
+        m_pCurrent = NULL;
+        m_IdleCond.notify_all();
+
+        // File the next deadline, unless the engine was detached or woken
+        // again while it ran (then a newer entry is already live). A zero
+        // wait means the budget ran out with samples still due: go to the
+        // back of the engines that are due now.
+        it = m_Live.find(top.pEngine);
+
+        if (it != m_Live.end() && it->second == 0 && hnsWait == 0)
+        {
+            s_Yields++;
+            Push(top.pEngine, SteadyClock::now(), false);
+        }
+        else if (it != m_Live.end() && it->second == 0 && hnsWait != SCHEDULE_WAIT_INFINITE)
+        {
+            Push(top.pEngine, SteadyClock::now() + std::chrono::duration_cast<SteadyClock::duration>(std::chrono::nanoseconds(hnsWait * 100)), true);
+        }
+    }
+}
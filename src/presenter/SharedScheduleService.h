@@ -0,0 +1,144 @@
+//////////////////////////////////////////////////////////////////////////
+//
+// SharedScheduleService.h: One scheduling thread for many presenters.
+//
+// This file and SharedScheduleService.cpp have no Windows or Media
+// Foundation dependencies.
+//
+//////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+#include "common/TimingHistogram.h"
+
+class ScheduleEngine;
+
+// Default for SharedScheduleService::SetStepBudget: 2 ms, in 100ns units.
+const int64_t SHARED_SCHEDULE_DEFAULT_STEP_BUDGET = 20000;
+
+
+//-----------------------------------------------------------------------------
+// SharedScheduleStats
+//
+// How much the engines on the shared thread delay each other. 100ns units.
+//-----------------------------------------------------------------------------
+
+struct SharedScheduleStats
+{
+    SharedScheduleStats() : overruns(0), yields(0)
+    {
+    }
+
+    MediaFoundationSamples::HistogramSnapshot   stepTime;       // How long each engine step ran.
+    MediaFoundationSamples::HistogramSnapshot   dispatchDelay;  // How long after its deadline each timed step started.
+    uint64_t    overruns;       // Steps that ran past the budget: one Present took that long.
+    uint64_t    yields;         // Steps that stopped at the budget with samples still due.
+};
+
+
+//-----------------------------------------------------------------------------
+// SharedScheduleService class
+//
+// Runs the scheduling work of every attached ScheduleEngine on a single
+// thread. Each engine has at most one live entry in a deadline-ordered
+// priority queue: either "now" (a sample arrived, or a flush was requested)
+// or the time its front sample becomes due. The thread sleeps until the
+// earliest deadline, runs that engine, and files the engine's next deadline.
+//
+// Entries are never removed from the heap; a newer entry for the same
+// engine, or detaching the engine, makes older ones stale, and stale
+// entries are skipped when they reach the top.
+//
+// Engines delay each other: while one engine presents, every other engine
+// that falls due waits. To bound that, a step presents due samples only
+// until the step budget has run out; an engine that still has due samples
+// is filed again at "now", behind every engine that fell due while it ran,
+// so due engines take turns in deadline order. The budget cannot cut a
+// single Present short, so one slow Present still delays the others by its
+// full length; the stats record each step's length and how late each timed
+// step started, which is that delay.
+//
+// The service is shared by reference count: Acquire returns the process-
+// wide instance (starting its thread on first use) and Release stops the
+// thread when the last engine lets go.
+//-----------------------------------------------------------------------------
+
+class SharedScheduleService
+{
+public:
+    static SharedScheduleService* Acquire();
+    static void Release();
+
+    // Total number of times the service thread has woken, across instances.
+    static uint64_t Wakeups();
+
+    // Longest an engine runs before other due engines get a turn, in 100ns
+    // units. 0 presents one sample per turn.
+    static void SetStepBudget(int64_t hnsBudget) { s_StepBudget.store(hnsBudget > 0 ? hnsBudget : 0); }
+    static int64_t GetStepBudget() { return s_StepBudget.load(); }
+
+    // Across instances, like Wakeups.
+    static void GetStats(SharedScheduleStats *pStats);
+    static void ResetStats();
+
+    // Adds an engine. The engine is not run until Wake is called.
+    void Attach(ScheduleEngine *pEngine);
+
+    // Removes an engine. If the service thread is running the engine, this
+    // waits until it is done; afterwards the service never touches it again.
+    void Detach(ScheduleEngine *pEngine);
+
+    // Asks the service to run the engine as soon as possible.
+    void Wake(ScheduleEngine *pEngine);
+
+private:
+    typedef std::chrono::steady_clock SteadyClock;
+
+    struct Entry
+    {
+        SteadyClock::time_point deadline;
+        ScheduleEngine          *pEngine;
+        uint64_t                seq;        // Matches m_Live[pEngine] while the entry is live.
+        bool                    bTimed;     // A sample deadline rather than a wake-up.
+
+        bool operator<(const Entry& rhs) const
+        {
+            // std::priority_queue is a max-heap; the earliest deadline must compare greatest.
+            return deadline > rhs.deadline;
+        }
+    };
+
+    SharedScheduleService();
+    ~SharedScheduleService();
+
+    void Push(ScheduleEngine *pEngine, SteadyClock::time_point deadline, bool bTimed);
+    void ThreadProc();
+
+    std::thread                             m_Thread;
+    std::mutex                              m_Mutex;        // Protects everything below.
+    std::condition_variable                 m_WakeCond;     // Signals the service thread.
+    std::condition_variable                 m_IdleCond;     // Signals that m_pCurrent changed.
+    std::priority_queue<Entry>              m_Heap;
+    std::map<ScheduleEngine*, uint64_t>     m_Live;         // Attached engines and their live entry (0 = none).
+    uint64_t                                m_NextSeq;
+    ScheduleEngine                          *m_pCurrent;    // Engine being run by the service thread.
+    bool                                    m_bTerminate;
+    std::atomic<bool>                       m_bSignaled;    // Ends a spin early.
+
+    static std::atomic<uint64_t>            s_Wakeups;
+    static std::atomic<int64_t>             s_StepBudget;
+    static std::atomic<uint64_t>            s_Overruns;
+    static std::atomic<uint64_t>            s_Yields;
+    static MediaFoundationSamples::TimingHistogram  s_StepTime;
+    static MediaFoundationSamples::TimingHistogram  s_DispatchDelay;
+};
@@ -0,0 +1,98 @@
+//////////////////////////////////////////////////////////////////////////
+//
+// SharedSurfaceTracker.cpp: Which shared video surface GL may read.
+//
+//////////////////////////////////////////////////////////////////////////
+
+#include "SharedSurfaceTracker.h"
+
+// The generation takes the upper 24 bits of a tag, the index + 1 the lower 8.
+static const uint32_t TAG_INDEX_BITS = 8;
+static const uint32_t TAG_GENERATION_MASK = 0x00FFFFFF;
+
+SharedSurfaceTracker::SharedSurfaceTracker() :
+    m_generation(1),
+    m_count(0),
+    m_latest(0),
+    m_reader(0),
+    m_cPublished(0)
+{
+}
+
+uint32_t SharedSurfaceTracker::Tag(uint32_t generation, int index)
+{
+    return ((generation & TAG_GENERATION_MASK) << TAG_INDEX_BITS) | (uint32_t)(index + 1);
+}
+
+int SharedSurfaceTracker::Index(uint32_t tag)
+{
+    return (tag == 0) ? SHARED_SURFACE_NONE : (int)(tag & ((1 << TAG_INDEX_BITS) - 1)) - 1;
+}
+
+void SharedSurfaceTracker::Reset(int count)
+{
+    const uint32_t generation = m_generation.load() + 1;
+
+    m_latest.store(0);
+    m_count.store(count < SHARED_SURFACE_MAX ? count : SHARED_SURFACE_MAX);
+    m_generation.store(generation);
+}
+
+void SharedSurfaceTracker::Publish(int index)
+{
+    if (index < 0 || index >= m_count.load())
+    {
+        return;
+    }
+
+    // Sequentially consistent, paired with Acquire: either this store is
+    // seen by the reader's re-check, or the reader's claim is seen by the
+    // presenter's next CanRecycle.
+    m_latest.store(Tag(m_generation.load(), index));
+    m_cPublished++;
+}
+
+bool SharedSurfaceTracker::CanRecycle(int index) const
+{
+    const uint32_t tag = Tag(m_generation.load(), index);
+
+    return (m_latest.load() != tag) && (m_reader.load() != tag);
+}
+
+int SharedSurfaceTracker::Latest() const
+{
+    return Index(m_latest.load());
+}
+
+int SharedSurfaceTracker::Acquire(uint32_t generation)
+{
+    for (;;)
+    {
+        const uint32_t latest = m_latest.load();
+
+        if (latest == 0 || (latest >> TAG_INDEX_BITS) != (generation & TAG_GENERATION_MASK))
+        {
+            m_reader.store(0);
+            return SHARED_SURFACE_NONE;
+        }
+
+        m_reader.store(latest);
+
+        // If the presenter published a newer surface before it could see
+        // our claim, it may already have recycled this one. Try again.
+        if (m_latest.load() == latest)
+        {
+            return Index(latest);
+        }
+    }
+}
+
+void SharedSurfaceTracker::Release()
+{
+    m_reader.store(0);
+}
+
+int SharedSurfaceTracker::Reading() const
+{
+    return Index(m_reader.load());
+}
@@ -0,0 +1,80 @@
+//////////////////////////////////////////////////////////////////////////
+//
+// SharedSurfaceTracker.h: Which shared video surface GL may read.
+//
+// This file and SharedSurfaceTracker.cpp have no Windows or Media
+// Foundation dependencies.
+//
+//////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+
+const int SHARED_SURFACE_MAX = 8;       // Most surfaces one tracker can follow.
+const int SHARED_SURFACE_NONE = -1;
+
+
+//-----------------------------------------------------------------------------
+// SharedSurfaceTracker class
+//
+// Bookkeeping for zero-copy presentation, where the mixer renders into
+// surfaces that GL reads directly. The presenter publishes the index of
+// each surface it presents; the GL thread acquires the latest one for
+// the duration of a draw. A surface may only go back to the mixer while
+// it is neither the latest presented nor being read.
+//
+// Each batch of surfaces is a generation. Indices are tagged with the
+// generation they belong to, so an index left over from a previous batch
+// never matches a surface in the current one.
+//
+// Threads:
+//   Reset, Publish, CanRecycle: the presenter (one thread at a time).
+//   Acquire, Release: the GL thread.
+//-----------------------------------------------------------------------------
+
+class SharedSurfaceTracker
+{
+public:
+    SharedSurfaceTracker();
+
+    // Starts a new generation of count surfaces. Nothing is published yet.
+    void Reset(int count);
+
+    uint32_t Generation() const { return m_generation.load(); }
+    int Count() const { return m_count.load(); }
+
+    // Marks the surface as the latest presented frame.
+    void Publish(int index);
+
+    // True if the surface can be handed back to the mixer.
+    bool CanRecycle(int index) const;
+
+    // The latest presented surface, or SHARED_SURFACE_NONE.
+    int Latest() const;
+
+    // Surfaces published since the tracker was created.
+    uint64_t PublishCount() const { return m_cPublished.load(); }
+
+    // Marks the latest surface of the given generation as being read, and
+    // returns its index. Returns SHARED_SURFACE_NONE if nothing has been
+    // published in that generation. Call Release when done; calling
+    // Acquire again releases the previous surface.
+    int Acquire(uint32_t generation);
+    void Release();
+
+    // The surface being read, or SHARED_SURFACE_NONE.
+    int Reading() const;
+
+private:
+    // Packed (generation, index) pairs; 0 means none.
+    static uint32_t Tag(uint32_t generation, int index);
+    static int Index(uint32_t tag);
+
+    std::atomic<uint32_t>   m_generation;
+    std::atomic<int>        m_count;
+    std::atomic<uint32_t>   m_latest;       // Written by the presenter.
+    std::atomic<uint32_t>   m_reader;       // Written by the GL thread.
+    std::atomic<uint64_t>   m_cPublished;
+};
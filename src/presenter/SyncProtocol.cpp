@@ -0,0 +1,327 @@
+//////////////////////////////////////////////////////////////////////////
+//
+// SyncProtocol.cpp: Master/follower playback sync across machines.
+//
+//////////////////////////////////////////////////////////////////////////
+
+#include "SyncProtocol.h"
+
+#include <chrono>
+#include <random>
+#include <string.h>
+
+static void Put16(uint8_t *p, uint16_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+static void Put32(uint8_t *p, uint32_t v)
+{
+    for (int i = 0; i < 4; i++)
+    {
+        p[i] = (uint8_t)(v >> (8 * i));
+    }
+}
+
+static void Put64(uint8_t *p, uint64_t v)
+{
+    for (int i = 0; i < 8; i++)
+    {
+        p[i] = (uint8_t)(v >> (8 * i));
+    }
+}
+
+static uint16_t Get16(const uint8_t *p)
+{
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t Get32(const uint8_t *p)
+{
+    uint32_t v = 0;
+    for (int i = 3; i >= 0; i--)
+    {
+        v = (v << 8) | p[i];
+    }
+    return v;
+}
+
+static uint64_t Get64(const uint8_t *p)
+{
+    uint64_t v = 0;
+    for (int i = 7; i >= 0; i--)
+    {
+        v = (v << 8) | p[i];
+    }
+    return v;
+}
+
+size_t SyncProtocol::Encode(const SyncBeacon& beacon, uint8_t *pBuffer)
+{
+    uint64_t rateBits = 0;
+    memcpy(&rateBits, &beacon.rate, sizeof(rateBits));
+
+    Put32(pBuffer + 0, SYNC_MAGIC);
+    Put16(pBuffer + 4, SYNC_VERSION);
+    Put16(pBuffer + 6, (uint16_t)SYNC_BEACON_SIZE);
+    Put32(pBuffer + 8, beacon.sequence);
+    Put32(pBuffer + 12, beacon.groupId);
+    Put64(pBuffer + 16, (uint64_t)beacon.masterTime);
+    Put64(pBuffer + 24, (uint64_t)beacon.presentationTime);
+    Put64(pBuffer + 32, rateBits);
+    Put32(pBuffer + 40, beacon.flags);
+    Put32(pBuffer + 44, beacon.session);
+    return SYNC_BEACON_SIZE;
+}
+
+bool SyncProtocol::Decode(const uint8_t *pBuffer, size_t cbBuffer, SyncBeacon *pBeacon)
+{
+    if (cbBuffer < SYNC_BEACON_SIZE ||
+        Get32(pBuffer) != SYNC_MAGIC ||
+        Get16(pBuffer + 4) != SYNC_VERSION ||
+        Get16(pBuffer + 6) != SYNC_BEACON_SIZE)
+    {
+        return false;
+    }
+
+    uint64_t rateBits = Get64(pBuffer + 32);
+
+    pBeacon->sequence = Get32(pBuffer + 8);
+    pBeacon->groupId = Get32(pBuffer + 12);
+    pBeacon->masterTime = (int64_t)Get64(pBuffer + 16);
+    pBeacon->presentationTime = (int64_t)Get64(pBuffer + 24);
+    memcpy(&pBeacon->rate, &rateBits, sizeof(rateBits));
+    pBeacon->flags = Get32(pBuffer + 40);
+    pBeacon->session = Get32(pBuffer + 44);
+    return true;
+}
+
+uint32_t SyncProtocol::NewSession()
+{
+    // random_device alone may be deterministic on some platforms; the clock
+    // tells runs apart there.
+    std::random_device device;
+    const uint64_t ticks = (uint64_t)std::chrono::high_resolution_clock::now().time_since_epoch().count();
+
+    uint32_t session = device() ^ (uint32_t)ticks ^ (uint32_t)(ticks >> 32);
+    return (session != 0) ? session : 1;
+}
+
+//-----------------------------------------------------------------------------
+// SyncClockEstimator
+//-----------------------------------------------------------------------------
+
+SyncClockEstimator::SyncClockEstimator() :
+    m_Latency(0)
+{
+    Reset();
+}
+
+void SyncClockEstimator::Reset()
+{
+    m_BucketStart = 0;
+    m_Newest = 0;
+    m_Count = 0;
+    m_Origin = 0;
+    m_Intercept = 0.0;
+    m_Slope = 0.0;
+}
+
+void SyncClockEstimator::AddSample(int64_t masterTime, int64_t localTime)
+{
+    const int64_t delta = localTime - masterTime;
+
+    if (m_Count == 0 || masterTime - m_BucketStart >= SYNC_ESTIMATOR_BUCKET || masterTime < m_BucketStart)
+    {
+        // A new bucket, over the oldest once the window is full.
+        m_Newest = (m_Count == 0) ? 0 : (m_Newest + 1) % SYNC_ESTIMATOR_BUCKETS;
+
+        if (m_Count < SYNC_ESTIMATOR_BUCKETS)
+        {
+            m_Count++;
+        }
+
+        m_BucketStart = masterTime;
+        m_Master[m_Newest] = masterTime;
+        m_Delta[m_Newest] = delta;
+    }
+    else if (delta < m_Delta[m_Newest])
+    {
+        m_Master[m_Newest] = masterTime;
+        m_Delta[m_Newest] = delta;
+    }
+
+    Fit();
+}
+
+void SyncClockEstimator::Fit()
+{
+    double sx = 0.0, sy = 0.0, sxx = 0.0, sxy = 0.0;
+    const double n = (double)m_Count;
+
+    m_Origin = m_Master[m_Newest];
+
+    for (size_t i = 0; i < m_Count; i++)
+    {
+        const double x = (double)(m_Master[i] - m_Origin);
+        const double y = (double)m_Delta[i];
+
+        sx += x;
+        sy += y;
+        sxx += x * x;
+        sxy += x * y;
+    }
+
+    const double det = n * sxx - sx * sx;
+
+    // The slope needs a few seconds of buckets.
+    if (m_Count < 3 || det <= 0.0)
+    {
+        m_Slope = 0.0;
+        m_Intercept = (double)m_Delta[m_Newest];
+        return;
+    }
+
+    m_Slope = (n * sxy - sx * sy) / det;
+    m_Intercept = (sy - m_Slope * sx) / n;
+}
+
+int64_t SyncClockEstimator::Offset(int64_t masterTime) const
+{
+    return (int64_t)(m_Intercept + m_Slope * (double)(masterTime - m_Origin)) - m_Latency;
+}
+
+int64_t SyncClockEstimator::ToLocal(int64_t masterTime) const
+{
+    return masterTime + Offset(masterTime);
+}
+
+int64_t SyncClockEstimator::ToMaster(int64_t localTime) const
+{
+    // local = master + intercept + slope * (master - origin) - latency.
+    const double master = ((double)localTime - m_Intercept + m_Slope * (double)m_Origin + (double)m_Latency) / (1.0 + m_Slope);
+
+    return (int64_t)master;
+}
+
+//-----------------------------------------------------------------------------
+// SyncMaster
+//-----------------------------------------------------------------------------
+
+SyncMaster::SyncMaster(uint32_t groupId, uint32_t session) :
+    m_GroupId(groupId),
+    m_Session((session != 0) ? session : SyncProtocol::NewSession()),
+    m_Sequence(0)
+{
+}
+
+SyncBeacon SyncMaster::MakeBeacon(int64_t presentationTime, int64_t now, double rate, bool playing)
+{
+    SyncBeacon beacon;
+
+    beacon.sequence = ++m_Sequence;
+    beacon.groupId = m_GroupId;
+    beacon.masterTime = now;
+    beacon.presentationTime = presentationTime;
+    beacon.rate = rate;
+    beacon.flags = playing ? SYNC_FLAG_PLAYING : 0;
+    beacon.session = m_Session;
+    return beacon;
+}
+
+//-----------------------------------------------------------------------------
+// SyncFollower
+//-----------------------------------------------------------------------------
+
+SyncFollower::SyncFollower(uint32_t groupId, const SyncTuning& tuning) :
+    m_GroupId(groupId),
+    m_bHaveBeacon(false),
+    m_Controller(tuning),
+    m_Beacons(0),
+    m_Dropped(0)
+{
+    memset(&m_Last, 0, sizeof(m_Last));
+}
+
+bool SyncFollower::OnDatagram(const uint8_t *pBuffer, size_t cbBuffer, int64_t now)
+{
+    SyncBeacon beacon;
+
+    if (!SyncProtocol::Decode(pBuffer, cbBuffer, &beacon))
+    {
+        m_Dropped++;
+        return false;
+    }
+    return OnBeacon(beacon, now);
+}
+
+bool SyncFollower::OnBeacon(const SyncBeacon& beacon, int64_t now)
+{
+    // Sequence numbers wrap; compare by difference. A restarted master is
+    // a new session and counts from 1 again: taken at once, with its clock
+    // estimated afresh.
+    const bool newSession = m_bHaveBeacon && beacon.session != m_Last.session;
+    const int32_t age = (int32_t)(beacon.sequence - m_Last.sequence);
+
+    if (beacon.groupId != m_GroupId || (m_bHaveBeacon && !newSession && age <= 0))
+    {
+        m_Dropped++;
+        return false;
+    }
+
+    if (newSession)
+    {
+        m_Estimator.Reset();
+    }
+
+    m_Estimator.AddSample(beacon.masterTime, now);
+    m_Last = beacon;
+    m_bHaveBeacon = true;
+    m_Beacons++;
+    return true;
+}
+
+int64_t SyncFollower::MasterPosition(int64_t now) const
+{
+    const int64_t masterNow = m_Estimator.ToMaster(now);
+
+    if (!IsMasterPlaying())
+    {
+        return m_Last.presentationTime;
+    }
+    return m_Last.presentationTime + (int64_t)((double)(masterNow - m_Last.masterTime) * m_Last.rate);
+}
+
+SyncCorrection SyncFollower::Update(int64_t presentationTime, int64_t now)
+{
+    if (!m_bHaveBeacon)
+    {
+        return SyncCorrection();
+    }
+    return m_Controller.Update(presentationTime - MasterPosition(now), now);
+}
+
+void SyncFollower::GetStats(SyncFollowerStats *pStats, int64_t now) const
+{
+    pStats->beacons = m_Beacons;
+    pStats->dropped = m_Dropped;
+    pStats->offset = m_Estimator.IsValid() ? now - m_Estimator.ToMaster(now) : 0;
+    pStats->drift = m_Estimator.Drift();
+    m_Controller.GetStats(&pStats->control);
+}
+
+void SyncFollower::ResetStats()
+{
+    m_Beacons = 0;
+    m_Dropped = 0;
+    m_Controller.ResetStats();
+}
+
+void SyncFollower::Reset()
+{
+    m_bHaveBeacon = false;
+    m_Estimator.Reset();
+    m_Controller.Reset();
+    ResetStats();
+}
@@ -0,0 +1,204 @@
+//////////////////////////////////////////////////////////////////////////
+//
+// SyncProtocol.h: Master/follower playback sync across machines.
+//
+// The master sends beacons (its presentation time, and its own clock
+// when it read it) over UDP; followers map the master's clock onto their
+// own, work out where the master's video is now, and steer their player
+// towards it with a PlaybackSyncController.
+//
+// This file and SyncProtocol.cpp have no Windows or Media Foundation
+// dependencies. Times are in 100ns units; each side uses its own
+// monotonic clock.
+//
+//////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "PlaybackSync.h"
+
+const uint32_t SYNC_MAGIC = 0x53464D57;     // "WMFS", little-endian.
+const uint16_t SYNC_VERSION = 2;
+const size_t SYNC_BEACON_SIZE = 48;
+
+const uint32_t SYNC_FLAG_PLAYING = 0x1;
+
+// The clock estimator keeps the least-delayed sample of each second (of
+// master time), for the last 16 seconds.
+const int64_t SYNC_ESTIMATOR_BUCKET = 10000000;
+const size_t SYNC_ESTIMATOR_BUCKETS = 16;
+
+
+//-----------------------------------------------------------------------------
+// SyncBeacon
+//
+// On the wire: magic, version, size (u16), sequence, groupId (u32),
+// masterTime, presentationTime (i64), rate (IEEE double), flags, session
+// (u32), all little-endian.
+//-----------------------------------------------------------------------------
+
+struct SyncBeacon
+{
+    uint32_t    sequence;
+    uint32_t    groupId;            // Followers ignore other groups.
+    int64_t     masterTime;         // Master's clock when presentationTime was read.
+    int64_t     presentationTime;
+    double      rate;
+    uint32_t    flags;
+    uint32_t    session;            // Chosen by the master each run; sequences only compare within one.
+};
+
+namespace SyncProtocol
+{
+    // A session for a new master run: random, and never 0.
+    uint32_t NewSession();
+
+    // Returns SYNC_BEACON_SIZE.
+    size_t Encode(const SyncBeacon& beacon, uint8_t *pBuffer);
+
+    // False if the datagram is not a beacon of this version.
+    bool Decode(const uint8_t *pBuffer, size_t cbBuffer, SyncBeacon *pBeacon);
+}
+
+
+//-----------------------------------------------------------------------------
+// SyncClockEstimator class
+//
+// Maps the master's clock onto the local one from (sent, received) pairs.
+// Network and scheduling delays only ever add to the difference, so the
+// estimator keeps the least-delayed pair from each second and fits a line
+// through those: the intercept is the offset, the slope the drift between
+// the two clocks. Buckets are by time, not by count, so the drift is fitted
+// over the same span whatever the beacon rate. A known one-way latency can
+// be taken off.
+//-----------------------------------------------------------------------------
+
+class SyncClockEstimator
+{
+public:
+    SyncClockEstimator();
+
+    void AddSample(int64_t masterTime, int64_t localTime);
+    void Reset();
+
+    bool IsValid() const { return m_Count > 0; }
+
+    void SetLatency(int64_t latency) { m_Latency = latency; }
+
+    // Local time minus master time, at the given master time.
+    int64_t Offset(int64_t masterTime) const;
+
+    // Master clock rate relative to the local one, minus 1 (positive: the
+    // local clock runs fast).
+    double Drift() const { return m_Slope; }
+
+    int64_t ToLocal(int64_t masterTime) const;
+    int64_t ToMaster(int64_t localTime) const;
+
+private:
+    void Fit();
+
+    // Least-delayed sample of each bucket; the newest is still filling.
+    int64_t     m_Master[SYNC_ESTIMATOR_BUCKETS];
+    int64_t     m_Delta[SYNC_ESTIMATOR_BUCKETS];    // Local minus master.
+    int64_t     m_BucketStart;                      // Master time the newest bucket began.
+    size_t      m_Newest;
+    size_t      m_Count;
+    int64_t     m_Latency;
+
+    // The fit, around m_Origin so the sums stay small.
+    int64_t     m_Origin;
+    double      m_Intercept;
+    double      m_Slope;
+};
+
+
+//-----------------------------------------------------------------------------
+// SyncMaster class
+//
+// Builds the master's beacons. The caller sends them, every 100 ms or so.
+// Each SyncMaster is a new session unless one is given, so followers
+// tell a restarted master from a late beacon of the old one.
+//-----------------------------------------------------------------------------
+
+class SyncMaster
+{
+public:
+    // session 0 picks a new one with SyncProtocol::NewSession.
+    explicit SyncMaster(uint32_t groupId, uint32_t session = 0);
+
+    SyncBeacon MakeBeacon(int64_t presentationTime, int64_t now, double rate, bool playing);
+
+private:
+    uint32_t    m_GroupId;
+    uint32_t    m_Session;
+    uint32_t    m_Sequence;
+};
+
+
+//-----------------------------------------------------------------------------
+// SyncFollower class
+//
+// Takes the master's beacons and steers the local player. Update returns
+// the correction to apply, as for a PlaybackSyncController, on the error
+// between the local presentation time and the master's at the same moment.
+//
+// Not thread-safe: one thread receives and updates.
+//-----------------------------------------------------------------------------
+
+struct SyncFollowerStats
+{
+    SyncFollowerStats() : beacons(0), dropped(0), offset(0), drift(0.0)
+    {
+    }
+
+    uint64_t    beacons;        // Accepted.
+    uint64_t    dropped;        // Other groups, duplicates and out of order within a session.
+    int64_t     offset;         // Local minus master clock, now.
+    double      drift;
+    SyncStats   control;
+};
+
+class SyncFollower
+{
+public:
+    SyncFollower(uint32_t groupId, const SyncTuning& tuning = SyncTuning());
+
+    // A datagram or beacon received at local time now. False if ignored.
+    bool OnDatagram(const uint8_t *pBuffer, size_t cbBuffer, int64_t now);
+    bool OnBeacon(const SyncBeacon& beacon, int64_t now);
+
+    bool HasMaster() const { return m_bHaveBeacon; }
+    bool IsMasterPlaying() const { return (m_Last.flags & SYNC_FLAG_PLAYING) != 0; }
+    double MasterRate() const { return m_Last.rate; }
+
+    // The master's presentation time at local time now. Only valid once
+    // HasMaster() is true.
+    int64_t MasterPosition(int64_t now) const;
+
+    // presentationTime: the local player's, at local time now.
+    SyncCorrection Update(int64_t presentationTime, int64_t now);
+
+    // After the caller moved the player itself; see PlaybackSyncController.
+    void Settle(int64_t now) { m_Controller.Settle(now); }
+
+    void SetLatency(int64_t latency) { m_Estimator.SetLatency(latency); }
+
+    void GetStats(SyncFollowerStats *pStats, int64_t now) const;
+    void ResetStats();
+
+    // Forgets the master, the clock estimate and the controller's state.
+    void Reset();
+
+private:
+    uint32_t                m_GroupId;
+    bool                    m_bHaveBeacon;
+    SyncBeacon              m_Last;
+    SyncClockEstimator      m_Estimator;
+    PlaybackSyncController  m_Controller;
+    uint64_t                m_Beacons;
+    uint64_t                m_Dropped;
+};
@@ -0,0 +1,204 @@
+//////////////////////////////////////////////////////////////////////////
+//
+// SyncSocket.cpp: Non-blocking UDP socket for the sync protocol.
+//
+//////////////////////////////////////////////////////////////////////////
+
+#include "SyncSocket.h"
+
+#include <string.h>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#pragma comment(lib, "Ws2_32.lib")
+typedef int socklen_t;
+#define CLOSE_SOCKET closesocket
+#define NATIVE(s) ((SOCKET)(s))
+#define WOULD_BLOCK (WSAGetLastError() == WSAEWOULDBLOCK)
+#else
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#define CLOSE_SOCKET close
+#define NATIVE(s) ((int)(s))
+#define WOULD_BLOCK (errno == EAGAIN || errno == EWOULDBLOCK)
+#endif
+
+static_assert(sizeof(sockaddr_in) <= 16, "sockaddr_in must fit m_Target");
+
+SyncSocket::SyncSocket() :
+    m_Socket(-1),
+    m_bStarted(false)
+{
+    memset(m_Target, 0, sizeof(m_Target));
+}
+
+SyncSocket::~SyncSocket()
+{
+    Close();
+}
+
+bool SyncSocket::IsOpen() const
+{
+    return m_Socket != -1;
+}
+
+bool SyncSocket::Create()
+{
+    Close();
+
+#ifdef _WIN32
+    WSADATA wsaData;
+
+    if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0)
+    {
+        return false;
+    }
+    m_bStarted = true;
+#endif
+
+    intptr_t s = (intptr_t)socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+
+#ifdef _WIN32
+    if (s == (intptr_t)INVALID_SOCKET)
+    {
+        s = -1;
+    }
+#endif
+
+    if (s == -1)
+    {
+        Close();
+        return false;
+    }
+
+    m_Socket = s;
+
+#ifdef _WIN32
+    u_long nonBlocking = 1;
+    bool ok = ioctlsocket(NATIVE(m_Socket), FIONBIO, &nonBlocking) == 0;
+#else
+    int flags = fcntl(NATIVE(m_Socket), F_GETFL, 0);
+    bool ok = flags != -1 && fcntl(NATIVE(m_Socket), F_SETFL, flags | O_NONBLOCK) == 0;
+#endif
+
+    if (!ok)
+    {
+        Close();
+    }
+    return ok;
+}
+
+bool SyncSocket::OpenSender(const std::string& address, uint16_t port)
+{
+    if (!Create())
+    {
+        return false;
+    }
+
+    sockaddr_in target;
+    memset(&target, 0, sizeof(target));
+    target.sin_family = AF_INET;
+    target.sin_port = htons(port);
+
+    if (inet_pton(AF_INET, address.c_str(), &target.sin_addr) != 1)
+    {
+        Close();
+        return false;
+    }
+
+    int broadcast = 1;
+    (void)setsockopt(NATIVE(m_Socket), SOL_SOCKET, SO_BROADCAST, (const char*)&broadcast, sizeof(broadcast));
+
+    memcpy(m_Target, &target, sizeof(target));
+    return true;
+}
+
+bool SyncSocket::OpenReceiver(uint16_t port, const std::string& multicastGroup)
+{
+    if (!Create())
+    {
+        return false;
+    }
+
+    // Several followers on one machine (or a master and a follower) can share the port.
+    int reuse = 1;
+    (void)setsockopt(NATIVE(m_Socket), SOL_SOCKET, SO_REUSEADDR, (const char*)&reuse, sizeof(reuse));
+
+    sockaddr_in local;
+    memset(&local, 0, sizeof(local));
+    local.sin_family = AF_INET;
+    local.sin_port = htons(port);
+    local.sin_addr.s_addr = htonl(INADDR_ANY);
+
+    if (bind(NATIVE(m_Socket), (const sockaddr*)&local, sizeof(local)) != 0)
+    {
+        Close();
+        return false;
+    }
+
+    if (!multicastGroup.empty())
+    {
+        ip_mreq request;
+        memset(&request, 0, sizeof(request));
+        request.imr_interface.s_addr = htonl(INADDR_ANY);
+
+        if (inet_pton(AF_INET, multicastGroup.c_str(), &request.imr_multiaddr) != 1 ||
+            setsockopt(NATIVE(m_Socket), IPPROTO_IP, IP_ADD_MEMBERSHIP, (const char*)&request, sizeof(request)) != 0)
+        {
+            Close();
+            return false;
+        }
+    }
+    return true;
+}
+
+void SyncSocket::Close()
+{
+    if (m_Socket != -1)
+    {
+        CLOSE_SOCKET(NATIVE(m_Socket));
+        m_Socket = -1;
+    }
+
+#ifdef _WIN32
+    if (m_bStarted)
+    {
+        WSACleanup();
+    }
+#endif
+    m_bStarted = false;
+}
+
+bool SyncSocket::Send(const uint8_t *pData, size_t cbData)
+{
+    if (m_Socket == -1)
+    {
+        return false;
+    }
+
+    int sent = (int)sendto(NATIVE(m_Socket), (const char*)pData, (int)cbData, 0, (const sockaddr*)m_Target, sizeof(sockaddr_in));
+
+    return sent == (int)cbData;
+}
+
+int SyncSocket::Receive(uint8_t *pBuffer, size_t cbBuffer)
+{
+    if (m_Socket == -1)
+    {
+        return -1;
+    }
+
+    int received = (int)recv(NATIVE(m_Socket), (char*)pBuffer, (int)cbBuffer, 0);
+
+    if (received < 0)
+    {
+        return WOULD_BLOCK ? 0 : -1;
+    }
+    return received;
+}
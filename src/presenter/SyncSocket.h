@@ -0,0 +1,51 @@
+//////////////////////////////////////////////////////////////////////////
+//
+// SyncSocket.h: Non-blocking UDP socket for the sync protocol.
+//
+// Winsock on Windows, BSD sockets elsewhere; no Media Foundation
+// dependencies.
+//
+//////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+
+//-----------------------------------------------------------------------------
+// SyncSocket class
+//
+// OpenSender sends to one address: a follower's, a subnet broadcast address
+// (broadcast is enabled), or a multicast group. OpenReceiver listens on a
+// port on all interfaces, and joins the group if given a multicast address.
+// Receive never blocks.
+//-----------------------------------------------------------------------------
+
+class SyncSocket
+{
+public:
+    SyncSocket();
+    ~SyncSocket();
+
+    bool OpenSender(const std::string& address, uint16_t port);
+    bool OpenReceiver(uint16_t port, const std::string& multicastGroup = "");
+    void Close();
+
+    bool IsOpen() const;
+
+    bool Send(const uint8_t *pData, size_t cbData);
+
+    // Bytes received, 0 if nothing is waiting, -1 on error.
+    int Receive(uint8_t *pBuffer, size_t cbBuffer);
+
+private:
+    SyncSocket(const SyncSocket&);
+    SyncSocket& operator=(const SyncSocket&);
+
+    bool Create();
+
+    intptr_t    m_Socket;           // SOCKET or file descriptor; -1 when closed.
+    uint8_t     m_Target[16];       // sockaddr_in of OpenSender's address.
+    bool        m_bStarted;         // WSAStartup was called (Windows).
+};
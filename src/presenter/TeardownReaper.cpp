@@ -0,0 +1,161 @@
+//////////////////////////////////////////////////////////////////////////
+//
+// TeardownReaper.cpp: Background thread for slow teardown work.
+//
+//////////////////////////////////////////////////////////////////////////
+
+#include "TeardownReaper.h"
+
+#include <chrono>
+
+using namespace MediaFoundationSamples;
+
+// The process-wide instance and its reference count.
+static std::mutex       s_ReaperLock;
+static TeardownReaper   *s_pReaper = NULL;
+static int              s_ReaperRefCount = 0;
+
+std::atomic<uint64_t>   TeardownReaper::s_Posted(0);
+std::atomic<uint64_t>   TeardownReaper::s_Completed(0);
+TimingHistogram         TeardownReaper::s_RunTimes(TEARDOWN_HISTOGRAM_BIN_WIDTH, 0);
+
+//-----------------------------------------------------------------------------
+// Acquire
+// Returns the shared instance, creating it on first use.
+//-----------------------------------------------------------------------------
+
+TeardownReaper* TeardownReaper::Acquire()
+{
+    std::lock_guard<std::mutex> lock(s_ReaperLock);
+
+    if (s_pReaper == NULL)
+    {
+        s_pReaper = new TeardownReaper();
+    }
+    s_ReaperRefCount++;
+    return s_pReaper;
+}
+
+//-----------------------------------------------------------------------------
+// Release
+// Destroys the shared instance when the last reference goes away.
+//-----------------------------------------------------------------------------
+
+void TeardownReaper::Release()
+{
+    TeardownReaper *pReaper = NULL;
+
+    {
+        std::lock_guard<std::mutex> lock(s_ReaperLock);
+
+        if (--s_ReaperRefCount == 0)
+        {
+            pReaper = s_pReaper;
+            s_pReaper = NULL;
+        }
+    }
+
+    // Drain and join outside the lock.
+    delete pReaper;
+}
+
+//-----------------------------------------------------------------------------
+// Constructor / Destructor
+//-----------------------------------------------------------------------------
+
+TeardownReaper::TeardownReaper() :
+    m_Posted(0),
+    m_Completed(0),
+    m_bTerminate(false)
+{
+    m_Thread = std::thread(&TeardownReaper::ThreadProc, this);
+}
+
+TeardownReaper::~TeardownReaper()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_bTerminate = true;
+    }
+    m_WorkCond.notify_one();
+    m_Thread.join();
+}
+
+void TeardownReaper::Post(const Job& job)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Jobs.push_back(job);
+        m_Posted++;
+    }
+    s_Posted.fetch_add(1);
+    m_WorkCond.notify_one();
+}
+
+void TeardownReaper::Flush()
+{
+    std::unique_lock<std::mutex> lock(m_Mutex);
+
+    const uint64_t target = m_Posted;
+
+    m_DoneCond.wait(lock, [this, target] { return m_Completed >= target; });
+}
+
+uint64_t TeardownReaper::Pending() const
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    return m_Posted - m_Completed;
+}
+
+void TeardownReaper::GetStats(TeardownStats *pStats)
+{
+    pStats->posted = s_Posted.load();
+    pStats->completed = s_Completed.load();
+    s_RunTimes.GetSnapshot(&pStats->background);
+}
+
+void TeardownReaper::ResetStats()
+{
+    s_RunTimes.Reset();
+}
+
+//-----------------------------------------------------------------------------
+// ThreadProc
+//
+// Runs jobs until told to terminate, and then runs whatever is left: every
+// posted job runs exactly once.
+//-----------------------------------------------------------------------------
+
+void TeardownReaper::ThreadProc()
+{
+    std::unique_lock<std::mutex> lock(m_Mutex);
+
+    for (;;)
+    {
+        m_WorkCond.wait(lock, [this] { return m_bTerminate || !m_Jobs.empty(); });
+
+        if (m_Jobs.empty())
+        {
+            break;  // Terminating, and nothing left to run.
+        }
+
+        Job job = m_Jobs.front();
+        m_Jobs.pop_front();
+
+        lock.unlock();
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+        job();
+
+        std::chrono::steady_clock::duration elapsed = std::chrono::steady_clock::now() - start;
+
+        // Durations are in 100ns units, like the scheduler's histograms.
+        s_RunTimes.Record(std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count() * 10);
+        s_Completed.fetch_add(1);
+
+        lock.lock();
+        m_Completed++;
+        m_DoneCond.notify_all();
+    }
+}
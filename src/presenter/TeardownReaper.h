@@ -0,0 +1,103 @@
+//////////////////////////////////////////////////////////////////////////
+//
+// TeardownReaper.h: Background thread for slow teardown work.
+//
+// This file and TeardownReaper.cpp have no Windows or Media Foundation
+// dependencies. CPlayer posts jobs that close and shut down a media
+// session; tests can post anything.
+//
+//////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+#include "common/TimingHistogram.h"
+
+// Teardown durations are binned in 10 ms steps (100ns units): 0 to 640 ms.
+const int64_t TEARDOWN_HISTOGRAM_BIN_WIDTH = 100000;
+
+
+//-----------------------------------------------------------------------------
+// TeardownStats
+//
+// Durations are in 100ns units.
+//-----------------------------------------------------------------------------
+
+struct TeardownStats
+{
+    TeardownStats() : posted(0), completed(0)
+    {
+    }
+
+    uint64_t    posted;         // Jobs handed to the reaper.
+    uint64_t    completed;      // Jobs it has finished.
+
+    // How long the posting thread was held up by each teardown: the
+    // hand-off when asynchronous, the whole teardown when not.
+    MediaFoundationSamples::HistogramSnapshot   blocking;
+
+    // How long each job ran on the reaper thread.
+    MediaFoundationSamples::HistogramSnapshot   background;
+};
+
+
+//-----------------------------------------------------------------------------
+// TeardownReaper class
+//
+// Runs posted jobs one at a time, in order, on its own thread, so the
+// thread that posts them never waits for a teardown.
+//
+// The reaper is shared by reference count: Acquire returns the process-wide
+// instance (starting its thread on first use) and Release runs whatever is
+// still queued, then stops the thread, when the last user lets go. Do not
+// call Release from inside a job.
+//-----------------------------------------------------------------------------
+
+class TeardownReaper
+{
+public:
+    typedef std::function<void()> Job;
+
+    static TeardownReaper* Acquire();
+    static void Release();
+
+    // Queues a job and returns at once.
+    void Post(const Job& job);
+
+    // Blocks until every job posted before the call has run.
+    void Flush();
+
+    // Jobs posted but not finished.
+    uint64_t Pending() const;
+
+    // Posted/completed counts and the background histogram, across every
+    // instance. The caller fills in the blocking histogram.
+    static void GetStats(TeardownStats *pStats);
+    static void ResetStats();
+
+private:
+    TeardownReaper();
+    ~TeardownReaper();
+
+    void ThreadProc();
+
+    std::thread                 m_Thread;
+    mutable std::mutex          m_Mutex;        // Protects everything below.
+    std::condition_variable     m_WorkCond;     // Signals the reaper thread.
+    std::condition_variable     m_DoneCond;     // Signals that a job finished.
+    std::deque<Job>             m_Jobs;
+    uint64_t                    m_Posted;
+    uint64_t                    m_Completed;
+    bool                        m_bTerminate;
+
+    static std::atomic<uint64_t>                        s_Posted;
+    static std::atomic<uint64_t>                        s_Completed;
+    static MediaFoundationSamples::TimingHistogram      s_RunTimes;     // Written by the reaper thread only.
+};
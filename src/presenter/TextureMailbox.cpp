@@ -0,0 +1,132 @@
+//////////////////////////////////////////////////////////////////////////
+//
+// TextureMailbox.cpp: Lock-free slot states for a ring of shared textures.
+//
+//////////////////////////////////////////////////////////////////////////
+
+#include "TextureMailbox.h"
+
+TextureMailbox::TextureMailbox() :
+    m_count(0),
+    m_newest(MAILBOX_NONE),
+    m_cPublished(0),
+    m_cSkipped(0)
+{
+    for (int i = 0; i < MAILBOX_MAX_SLOTS; i++)
+    {
+        m_state[i].store(SlotFree);
+    }
+}
+
+void TextureMailbox::Reset(int count)
+{
+    if (count < 1)
+    {
+        count = 1;
+    }
+    if (count > MAILBOX_MAX_SLOTS)
+    {
+        count = MAILBOX_MAX_SLOTS;
+    }
+
+    for (int i = 0; i < MAILBOX_MAX_SLOTS; i++)
+    {
+        m_state[i].store(SlotFree);
+    }
+
+    m_count = count;
+    m_newest.store(MAILBOX_NONE);
+}
+
+bool TextureMailbox::Transition(int slot, SlotState from, SlotState to)
+{
+    int expected = from;
+    return m_state[slot].compare_exchange_strong(expected, to);
+}
+
+int TextureMailbox::BeginWrite()
+{
+    // Only the writer changes m_newest, so it cannot move under us.
+    const int newest = m_newest.load();
+
+    // Prefer slots that were never written, then stale ready ones.
+    for (int i = 0; i < m_count; i++)
+    {
+        if (Transition(i, SlotFree, SlotWriting))
+        {
+            return i;
+        }
+    }
+
+    for (int i = 0; i < m_count; i++)
+    {
+        if (i != newest && Transition(i, SlotReady, SlotWriting))
+        {
+            return i;
+        }
+    }
+
+    m_cSkipped++;
+    return MAILBOX_NONE;
+}
+
+void TextureMailbox::Publish(int slot)
+{
+    if (slot < 0 || slot >= m_count)
+    {
+        return;
+    }
+
+    // Mark the slot ready before making it newest, so a reader that sees
+    // it as newest can claim it.
+    m_state[slot].store(SlotReady);
+    m_newest.store(slot);
+    m_cPublished++;
+}
+
+void TextureMailbox::CancelWrite(int slot)
+{
+    if (slot < 0 || slot >= m_count)
+    {
+        return;
+    }
+
+    // The contents are no longer trustworthy.
+    m_state[slot].store(SlotFree);
+}
+
+int TextureMailbox::BeginRead()
+{
+    for (;;)
+    {
+        const int newest = m_newest.load();
+
+        if (newest == MAILBOX_NONE)
+        {
+            return MAILBOX_NONE;
+        }
+
+        if (Transition(newest, SlotReady, SlotReading))
+        {
+            return newest;
+        }
+
+        // The writer reclaimed the slot after publishing a newer one
+        // (or we already hold it). Look again.
+        if (m_state[newest].load() == SlotReading)
+        {
+            return newest;
+        }
+    }
+}
+
+void TextureMailbox::EndRead(int slot)
+{
+    if (slot < 0 || slot >= m_count)
+    {
+        return;
+    }
+
+    // Still a complete frame; the writer may reuse it once it is not the newest.
+    Transition(slot, SlotReading, SlotReady);
+}
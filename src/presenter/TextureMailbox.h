@@ -0,0 +1,93 @@
+//////////////////////////////////////////////////////////////////////////
+//
+// TextureMailbox.h: Lock-free slot states for a ring of shared textures.
+//
+// This file and TextureMailbox.cpp have no Windows or Media Foundation
+// dependencies.
+//
+//////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+
+const int MAILBOX_MAX_SLOTS = 8;
+const int MAILBOX_NONE = -1;
+
+
+//-----------------------------------------------------------------------------
+// TextureMailbox class
+//
+// One writer (the scheduler thread copying frames in) and one reader (the
+// GL thread drawing them) share a ring of N slots with mailbox semantics:
+// the writer never waits for the reader, and the reader always gets the
+// newest completely written slot. Frames the reader never saw are simply
+// overwritten.
+//
+// Each slot moves through these states:
+//
+//   Free ---> Writing ---> Ready <---> Reading
+//                ^           |
+//                +-----------+  (only if not the newest)
+//
+// The writer claims any Free slot, or any Ready slot other than the newest,
+// with a CAS; the reader claims the newest slot with a CAS from Ready to
+// Reading. Because each transition is a CAS from a known state, the two
+// never hold the same slot. With three or more slots the writer always
+// finds one: at most one is newest and one is being read.
+//-----------------------------------------------------------------------------
+
+class TextureMailbox
+{
+public:
+    enum SlotState
+    {
+        SlotFree,
+        SlotWriting,
+        SlotReady,
+        SlotReading
+    };
+
+    TextureMailbox();
+
+    // Sets the number of slots (clamped to 1..MAILBOX_MAX_SLOTS) and marks
+    // them all free. Not thread-safe; call while neither side is active.
+    void Reset(int count);
+
+    int Count() const { return m_count; }
+
+    // Writer side. Returns the slot to write, or MAILBOX_NONE if every slot
+    // is busy (only possible with fewer than three slots).
+    int BeginWrite();
+
+    // Writer side. Makes the slot the newest; the reader picks it up next.
+    void Publish(int slot);
+
+    // Writer side. Gives up a slot from BeginWrite without publishing it.
+    void CancelWrite(int slot);
+
+    // Reader side. Claims the newest written slot, or returns MAILBOX_NONE
+    // if nothing has been published yet.
+    int BeginRead();
+
+    // Reader side. The slot stays valid for a later BeginRead if nothing
+    // newer has been published.
+    void EndRead(int slot);
+
+    int Newest() const { return m_newest.load(); }
+    SlotState State(int slot) const { return (SlotState)m_state[slot].load(); }
+
+    // Frames published, and frames the writer had no free slot for.
+    uint64_t Published() const { return m_cPublished.load(); }
+    uint64_t Skipped() const { return m_cSkipped.load(); }
+
+private:
+    bool Transition(int slot, SlotState from, SlotState to);
+
+    int                     m_count;
+    std::atomic<int>        m_newest;
+    std::atomic<int>        m_state[MAILBOX_MAX_SLOTS];
+    std::atomic<uint64_t>   m_cPublished;
+    std::atomic<uint64_t>   m_cSkipped;
+};
@@ -0,0 +1,129 @@
+//////////////////////////////////////////////////////////////////////////
+//
+// MpscRing.h: Fixed-capacity multi-producer/single-consumer ring.
+//
+// This header has no Windows or Media Foundation dependencies so that it
+// can be built and exercised on any platform.
+//
+//////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+
+#include "SpscRing.h"   // SPSC_CACHE_ALIGN
+
+namespace MediaFoundationSamples
+{
+    //-------------------------------------------------------------------
+    // MpscRing template
+    //
+    // Lock-free, allocation-free queue for any number of producer
+    // threads and exactly one consumer thread.
+    //
+    // T: Element type. Copied in and out, so keep it a plain struct.
+    // N: Capacity. Must be a power of two.
+    //
+    // Each cell carries a sequence number. A producer claims a cell by
+    // advancing m_enqueue with a CAS, writes the item, then publishes it
+    // by setting the cell's sequence to position + 1. The consumer only
+    // reads a cell once it is published, and hands it back to producers
+    // by setting its sequence to position + N. A full ring makes TryPush
+    // fail immediately; producers never wait for the consumer.
+    //-------------------------------------------------------------------
+
+    template <class T, size_t N>
+    class MpscRing
+    {
+        static_assert(N >= 2 && (N & (N - 1)) == 0, "MpscRing capacity must be a power of two");
+
+    public:
+        MpscRing() : m_enqueue(0), m_dequeue(0)
+        {
+            for (size_t i = 0; i < N; i++)
+            {
+                m_cells[i].seq.store(i, std::memory_order_relaxed);
+            }
+        }
+
+        // Producer side. Safe from any thread. Returns false if the ring is full.
+        bool TryPush(const T& item)
+        {
+            size_t pos = m_enqueue.load(std::memory_order_relaxed);
+            Cell *pCell = NULL;
+
+            for (;;)
+            {
+                pCell = &m_cells[pos & (N - 1)];
+
+                const size_t seq = pCell->seq.load(std::memory_order_acquire);
+                const ptrdiff_t diff = (ptrdiff_t)seq - (ptrdiff_t)pos;
+
+                if (diff == 0)
+                {
+                    // The cell is free for this position; try to claim it.
+                    if (m_enqueue.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    {
+                        break;
+                    }
+                    // pos was reloaded by the failed CAS.
+                }
+                else if (diff < 0)
+                {
+                    // The consumer has not released this cell yet.
+                    return false;
+                }
+                else
+                {
+                    // Another producer claimed this position first.
+                    pos = m_enqueue.load(std::memory_order_relaxed);
+                }
+            }
+
+            pCell->item = item;
+            pCell->seq.store(pos + 1, std::memory_order_release);
+            return true;
+        }
+
+        // Consumer side. Returns false if the ring is empty, or if the next
+        // item has been claimed but not yet published.
+        bool TryPop(T& item)
+        {
+            const size_t pos = m_dequeue.load(std::memory_order_relaxed);
+            Cell& cell = m_cells[pos & (N - 1)];
+
+            if (cell.seq.load(std::memory_order_acquire) != pos + 1)
+            {
+                return false;
+            }
+
+            item = cell.item;
+            cell.seq.store(pos + N, std::memory_order_release);
+            m_dequeue.store(pos + 1, std::memory_order_release);
+            return true;
+        }
+
+        // Approximate: counts claimed items, including ones still being written.
+        size_t Size() const
+        {
+            return m_enqueue.load(std::memory_order_acquire) - m_dequeue.load(std::memory_order_acquire);
+        }
+
+        bool IsEmpty() const { return Size() == 0; }
+
+        static size_t Capacity() { return N; }
+
+    private:
+        struct Cell
+        {
+            std::atomic<size_t>     seq;
+            T                       item;
+        };
+
+        SPSC_CACHE_ALIGN std::atomic<size_t>    m_enqueue;  // Next position to claim. (Producers)
+        SPSC_CACHE_ALIGN std::atomic<size_t>    m_dequeue;  // Next position to read. (Consumer)
+        SPSC_CACHE_ALIGN Cell                   m_cells[N];
+    };
+
+}; // namespace MediaFoundationSamples
@@ -0,0 +1,113 @@
+//////////////////////////////////////////////////////////////////////////
+//
+// SpscRing.h: Fixed-capacity single-producer/single-consumer ring.
+//
+// This header has no Windows or Media Foundation dependencies so that it
+// can be built and exercised on any platform.
+//
+//////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+
+// Visual C++ 2013 has no alignas.
+#if defined(_MSC_VER) && (_MSC_VER < 1900)
+#define SPSC_CACHE_ALIGN __declspec(align(64))
+#else
+#define SPSC_CACHE_ALIGN alignas(64)
+#endif
+
+namespace MediaFoundationSamples
+{
+    //-------------------------------------------------------------------
+    // SpscRing template
+    //
+    // Lock-free, allocation-free queue for exactly one producer thread
+    // and one consumer thread.
+    //
+    // T: Element type. Must be cheap to copy (pointers, small structs).
+    // N: Capacity. Must be a power of two.
+    //
+    // The producer owns m_head and the consumer owns m_tail. Each side
+    // only reads the other side's index, so no locks or CAS loops are
+    // needed. The indices run freely and are masked on access.
+    //-------------------------------------------------------------------
+
+    template <class T, size_t N>
+    class SpscRing
+    {
+        static_assert(N >= 2 && (N & (N - 1)) == 0, "SpscRing capacity must be a power of two");
+
+    public:
+        SpscRing() : m_head(0), m_tail(0)
+        {
+        }
+
+        // Producer side. Returns false if the ring is full.
+        bool TryPush(const T& item)
+        {
+            const size_t head = m_head.load(std::memory_order_relaxed);
+            const size_t tail = m_tail.load(std::memory_order_acquire);
+
+            if (head - tail >= N)
+            {
+                return false;
+            }
+
+            m_items[head & (N - 1)] = item;
+            m_head.store(head + 1, std::memory_order_release);
+            return true;
+        }
+
+        // Consumer side. Returns false if the ring is empty.
+        bool TryPop(T& item)
+        {
+            const size_t tail = m_tail.load(std::memory_order_relaxed);
+            const size_t head = m_head.load(std::memory_order_acquire);
+
+            if (head == tail)
+            {
+                return false;
+            }
+
+            item = m_items[tail & (N - 1)];
+            m_tail.store(tail + 1, std::memory_order_release);
+            return true;
+        }
+
+        // Consumer side. Reads the front item without removing it.
+        bool TryPeek(T& item) const
+        {
+            const size_t tail = m_tail.load(std::memory_order_relaxed);
+            const size_t head = m_head.load(std::memory_order_acquire);
+
+            if (head == tail)
+            {
+                return false;
+            }
+
+            item = m_items[tail & (N - 1)];
+            return true;
+        }
+
+        // Approximate when called from a third thread; exact from either end.
+        size_t Size() const
+        {
+            return m_head.load(std::memory_order_acquire) - m_tail.load(std::memory_order_acquire);
+        }
+
+        bool IsEmpty() const { return Size() == 0; }
+
+        static size_t Capacity() { return N; }
+
+    private:
+        // Keep the two indices on separate cache lines so the producer and
+        // consumer do not invalidate each other on every operation.
+        SPSC_CACHE_ALIGN std::atomic<size_t>    m_head;     // Next slot to write. (Producer)
+        SPSC_CACHE_ALIGN std::atomic<size_t>    m_tail;     // Next slot to read. (Consumer)
+        SPSC_CACHE_ALIGN T                      m_items[N];
+    };
+
+}; // namespace MediaFoundationSamples
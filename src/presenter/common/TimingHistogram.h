@@ -0,0 +1,178 @@
+//////////////////////////////////////////////////////////////////////////
+//
+// TimingHistogram.h: Fixed-bin histogram of timing errors.
+//
+// This header has no Windows or Media Foundation dependencies so that it
+// can be built and exercised on any platform.
+//
+//////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+namespace MediaFoundationSamples
+{
+    //-------------------------------------------------------------------
+    // HistogramSnapshot
+    //
+    // Plain copy of a TimingHistogram. All values are in 100ns units.
+    //-------------------------------------------------------------------
+
+    struct HistogramSnapshot
+    {
+        HistogramSnapshot() : binWidth(0), minValue(0), count(0), underflow(0), overflow(0), sum(0), lowest(0), highest(0)
+        {
+        }
+
+        int64_t                 binWidth;       // Width of each bin.
+        int64_t                 minValue;       // Lower edge of bins[0].
+        std::vector<uint64_t>   bins;
+        uint64_t                count;          // Total samples, including underflow and overflow.
+        uint64_t                underflow;      // Samples below minValue.
+        uint64_t                overflow;       // Samples at or above the last bin.
+        int64_t                 sum;
+        int64_t                 lowest;         // Smallest sample. Valid if count > 0.
+        int64_t                 highest;        // Largest sample. Valid if count > 0.
+
+        double Mean() const
+        {
+            return count ? (double)sum / (double)count : 0.0;
+        }
+
+        // Upper edge of the bin that contains the given fraction (0..1) of
+        // the samples, capped at highest.
+        int64_t Percentile(double fraction) const
+        {
+            if (count == 0)
+            {
+                return 0;
+            }
+
+            uint64_t target = (uint64_t)(fraction * (double)count);
+            uint64_t seen = underflow;
+
+            if (seen > target)
+            {
+                return minValue;
+            }
+
+            for (size_t i = 0; i < bins.size(); i++)
+            {
+                seen += bins[i];
+                if (seen > target)
+                {
+                    int64_t edge = minValue + (int64_t)(i + 1) * binWidth;
+                    return (edge < highest) ? edge : highest;
+                }
+            }
+            return highest;
+        }
+    };
+
+
+    //-------------------------------------------------------------------
+    // TimingHistogram class
+    //
+    // Records timing errors from one writer thread. Any thread can take a
+    // snapshot; a snapshot taken while the writer is active may be off by
+    // the samples recorded during the copy.
+    //-------------------------------------------------------------------
+
+    class TimingHistogram
+    {
+    public:
+        enum { BIN_COUNT = 64 };
+
+        // binWidth: Width of each bin, in 100ns units.
+        // minValue: Lower edge of the first bin. Can be negative (early).
+        TimingHistogram(int64_t binWidth, int64_t minValue) : m_binWidth(binWidth), m_minValue(minValue)
+        {
+            Reset();
+        }
+
+        // Writer side.
+        void Record(int64_t value)
+        {
+            if (value < m_minValue)
+            {
+                m_underflow.fetch_add(1, std::memory_order_relaxed);
+            }
+            else
+            {
+                int64_t bin = (value - m_minValue) / m_binWidth;
+
+                if (bin >= BIN_COUNT)
+                {
+                    m_overflow.fetch_add(1, std::memory_order_relaxed);
+                }
+                else
+                {
+                    m_bins[bin].fetch_add(1, std::memory_order_relaxed);
+                }
+            }
+
+            if (m_count.load(std::memory_order_relaxed) == 0 || value < m_lowest.load(std::memory_order_relaxed))
+            {
+                m_lowest.store(value, std::memory_order_relaxed);
+            }
+            if (m_count.load(std::memory_order_relaxed) == 0 || value > m_highest.load(std::memory_order_relaxed))
+            {
+                m_highest.store(value, std::memory_order_relaxed);
+            }
+
+            m_sum.fetch_add(value, std::memory_order_relaxed);
+            m_count.fetch_add(1, std::memory_order_release);
+        }
+
+        void Reset()
+        {
+            for (size_t i = 0; i < BIN_COUNT; i++)
+            {
+                m_bins[i].store(0, std::memory_order_relaxed);
+            }
+            m_underflow.store(0, std::memory_order_relaxed);
+            m_overflow.store(0, std::memory_order_relaxed);
+            m_sum.store(0, std::memory_order_relaxed);
+            m_lowest.store(0, std::memory_order_relaxed);
+            m_highest.store(0, std::memory_order_relaxed);
+            m_count.store(0, std::memory_order_release);
+        }
+
+        void GetSnapshot(HistogramSnapshot *pSnapshot) const
+        {
+            pSnapshot->count = m_count.load(std::memory_order_acquire);
+            pSnapshot->binWidth = m_binWidth;
+            pSnapshot->minValue = m_minValue;
+            pSnapshot->bins.resize(BIN_COUNT);
+
+            for (size_t i = 0; i < BIN_COUNT; i++)
+            {
+                pSnapshot->bins[i] = m_bins[i].load(std::memory_order_relaxed);
+            }
+            pSnapshot->underflow = m_underflow.load(std::memory_order_relaxed);
+            pSnapshot->overflow = m_overflow.load(std::memory_order_relaxed);
+            pSnapshot->sum = m_sum.load(std::memory_order_relaxed);
+            pSnapshot->lowest = m_lowest.load(std::memory_order_relaxed);
+            pSnapshot->highest = m_highest.load(std::memory_order_relaxed);
+        }
+
+    private:
+        TimingHistogram(const TimingHistogram&);
+        TimingHistogram& operator=(const TimingHistogram&);
+
+        const int64_t           m_binWidth;
+        const int64_t           m_minValue;
+        std::atomic<uint64_t>   m_bins[BIN_COUNT];
+        std::atomic<uint64_t>   m_underflow;
+        std::atomic<uint64_t>   m_overflow;
+        std::atomic<uint64_t>   m_count;
+        std::atomic<int64_t>    m_sum;
+        std::atomic<int64_t>    m_lowest;
+        std::atomic<int64_t>    m_highest;
+    };
+
+}; // namespace MediaFoundationSamples
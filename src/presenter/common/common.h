@@ -124,5 +124,7 @@ bool AreComObjectsEqual(T1 *p1, T2 *p2)
 #include "linklist.h"
 #include "mediatype.h"
 #include "propvar.h"
+#include "SpscRing.h"
+#include "TimingHistogram.h"
 #include "TinyMap.h"
 #include "trace.h"
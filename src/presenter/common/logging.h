@@ -6,68 +6,54 @@
 #include <assert.h>
 #endif
 
+#include "../DeferredLog.h"
+
 namespace MediaFoundationSamples
 {
     //--------------------------------------------------------------------------------------
     // Debug logging functions
     // Description: Contains debug logging functions.
     //
-    //     Initialize: Opens a logging file with the specified file name.
-    //     Trace: Writes a sprintf-formatted string to the logging file.
-    //     Close: Closes the logging file and reports any memory leaks.
+    //     Initialize: Starts the deferred logger, writing to the debugger output.
+    //     Trace: Queues a printf-formatted message (see DeferredLog.h).
+    //     Close: Flushes the queued messages and stops the logger.
     //
-    // To enable logging in debug builds, #define USE_LOGGING.
+    // To enable logging, #define USE_LOGGING.
     // The TRACE_INIT, TRACE, and TRACE_CLOSE macros are mapped to the logging functions.
-    // 
-    // In retail builds, these macros are mapped to nothing.
+    //
+    // TRACE and LOG_HRESULT only queue the format string and the argument values;
+    // the text is formatted on the logger's thread, so they are safe to use on the
+    // scheduler thread. Format strings must be string literals. Which levels are
+    // compiled in is set by WMF_LOG_LEVEL: in retail builds TRACE maps to nothing.
     //--------------------------------------------------------------------------------------
 
-#ifdef _DEBUG
-
-    class DebugLog
+    class DebugLog : public LogSink
     {
     public:
         static void Initialize()
         {
-            _CrtSetReportMode(_CRT_WARN, _CRTDBG_MODE_DEBUG);
+            DeferredLog::Start(&s_Sink);
         }
 
-        static void  Trace(const WCHAR *sFormatString, ...)
+        static void Close()
         {
-            HRESULT hr = S_OK;
-            va_list va;
-
-            const DWORD TRACE_STRING_LEN = 512;
-
-            WCHAR message[TRACE_STRING_LEN];
-
-            va_start(va, sFormatString);
-            hr = StringCchVPrintf(message, TRACE_STRING_LEN, sFormatString, va);
-            va_end(va);
-
-            if (SUCCEEDED(hr))
-            {
-                _CrtDbgReport(_CRT_WARN, NULL, NULL, NULL, "%S", message);
-            }
+            DeferredLog::Stop();
         }
 
-        static void Close()
+        void Write(LogLevel level, const WCHAR *message)
         {
-            int bLeak = _CrtDumpMemoryLeaks();
-            assert( bLeak == FALSE );
+            OutputDebugStringW(message);
         }
-    };
 
-#else
-// For retail builds, turn off USE_LOGGING
-#undef USE_LOGGING
-#endif
+    private:
+        static DebugLog s_Sink;
+    };
 
-#undef USE_LOGGING
+    __declspec(selectany) DebugLog DebugLog::s_Sink;
 
 #ifdef USE_LOGGING
     #define TRACE_INIT() DebugLog::Initialize()
-    #define TRACE(x) DebugLog::Trace x
+    #define TRACE(x) WMF_LOG_TRACE x
     #define TRACE_CLOSE() DebugLog::Close()
 
     // Log HRESULTs on failure.
@@ -75,20 +61,18 @@ namespace MediaFoundationSamples
     {
         if (FAILED(hr))
         {
-            TRACE((L"%S\n", sFileName)); 
-            TRACE((L"Line: %d hr=0x%X\n", lLineNo, hr));
+            WMF_LOG_ERROR(L"%S\nLine: %d hr=0x%X\n", sFileName, lLineNo, hr);
         }
         return hr;
     }
 
     #define LOG_HRESULT(hr) _LOG_HRESULT(hr, __FILE__, __LINE__)
-    #define LOG_MSG_IF_FAILED(msg, hr) if (FAILED(hr)) { TRACE((msg)); }
+    #define LOG_MSG_IF_FAILED(msg, hr) if (FAILED(hr)) { WMF_LOG_ERROR(msg L" hr=0x%X\n", hr); }
 
 #else
     #define TRACE_INIT() 
     #define TRACE(x) 
     #define TRACE_CLOSE()
-    #define LOG_MSG_IF_FAILED(x, hr)
     #define LOG_HRESULT(hr)
     #define LOG_MSG_IF_FAILED(msg, hr)
 #endif
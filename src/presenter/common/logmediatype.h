@@ -78,11 +78,11 @@ namespace MediaFoundationSamples
 
             case VT_CLSID:
                 CHECK_HR(hr = GetGUIDName(*var.puuid, &pGuidValName));
-                TRACE((pGuidValName));
+                TRACE((L"%s", pGuidValName));
                 break;
 
             case VT_LPWSTR:
-                TRACE((var.pwszVal));
+                TRACE((L"%s", var.pwszVal));
                 break;
 
             case VT_VECTOR | VT_UI1:
@@ -17,17 +17,6 @@
 
 #pragma comment(lib, "Winmm")
 
-// ScheduleEvent
-// Messages for the scheduler thread.
-enum ScheduleEvent
-{
-    eTerminate =    WM_USER,
-    eSchedule =     WM_USER + 1,
-    eFlush =        WM_USER + 2
-};
-
-const DWORD SCHEDULER_TIMEOUT = 5000;
-
 //-----------------------------------------------------------------------------
 // Constructor
 //-----------------------------------------------------------------------------
@@ -35,15 +24,13 @@ const DWORD SCHEDULER_TIMEOUT = 5000;
 Scheduler::Scheduler() : 
     m_pCB(NULL),
     m_pClock(NULL), 
-    m_dwThreadID(0),
-    m_hSchedulerThread(NULL),
-    m_hThreadReadyEvent(NULL),
-    m_hFlushEvent(NULL),
     m_fRate(1.0f),
-    m_LastSampleTime(0), 
-    m_PerFrameInterval(0), 
-    m_PerFrame_1_4th(0)
+    m_PerFrameInterval(0),
+    m_LastSampleTime(0),
+    m_cPresentedNow(0)
 {
+    m_engine.SetSink(this);
+    m_engine.SetVsync(this);
 }
 
 
@@ -53,6 +40,9 @@ Scheduler::Scheduler() :
 
 Scheduler::~Scheduler()
 {
+    // Stop the worker thread before the clock goes away.
+    m_engine.Stop();
+
     SAFE_RELEASE(m_pClock);
 }
 
@@ -71,12 +61,23 @@ void Scheduler::SetFrameRate(const MFRatio& fps)
 
     m_PerFrameInterval = (MFTIME)AvgTimePerFrame;
 
-    // Calculate 1/4th of this value, because we use it frequently.
-    m_PerFrame_1_4th = m_PerFrameInterval / 4;
+    m_engine.SetFrameInterval(m_PerFrameInterval);
 }
 
 
 
+//-----------------------------------------------------------------------------
+// SetRefreshPeriod
+// Specifies the display refresh period, in 100ns units. 0 means unknown.
+// A measured period from the callback's GetVblankTiming takes precedence.
+//-----------------------------------------------------------------------------
+
+void Scheduler::SetRefreshPeriod(double hnsRefresh)
+{
+    m_engine.SetRefreshInterval(hnsRefresh);
+}
+
+
 //-----------------------------------------------------------------------------
 // StartScheduler
 // Starts the scheduler's worker thread.
@@ -86,65 +87,26 @@ void Scheduler::SetFrameRate(const MFRatio& fps)
 
 HRESULT Scheduler::StartScheduler(IMFClock *pClock)
 {
-    if (m_hSchedulerThread != NULL)
+    if (m_engine.IsStarted())
     {
         return E_UNEXPECTED;
     }
 
-    HRESULT hr = S_OK;
-    DWORD dwID = 0;
-
     CopyComPointer(m_pClock, pClock);
 
+    // The engine reads the clock through our ScheduleClock implementation.
+    m_engine.SetClock(m_pClock ? this : NULL);
+
     // Set a high the timer resolution (ie, short timer period).
     timeBeginPeriod(1);
 
-    // Create an event to wait for the thread to start.
-    m_hThreadReadyEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
-    if (m_hThreadReadyEvent == NULL)
-    {
-        CHECK_HR(hr = HRESULT_FROM_WIN32(GetLastError()));
-    }
-
-    // Create an event to wait for flush commands to complete.
-    m_hFlushEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
-    if (m_hFlushEvent == NULL)
-    {
-        CHECK_HR(hr = HRESULT_FROM_WIN32(GetLastError()));
-    }
-
-    // Create the scheduler thread.
-    m_hSchedulerThread = CreateThread(NULL, 0, SchedulerThreadProc, (LPVOID)this, 0, &dwID);
-    if (m_hSchedulerThread == NULL)
-    {
-        CHECK_HR(hr = HRESULT_FROM_WIN32(GetLastError()));
-    }
-
-    HANDLE hObjects[] = { m_hThreadReadyEvent, m_hSchedulerThread };
-    DWORD dwWait = 0;
-
-    // Wait for the thread to signal the "thread ready" event.
-    dwWait = WaitForMultipleObjects(2, hObjects, FALSE, INFINITE);  // Wait for EITHER of these handles.
-    if (WAIT_OBJECT_0 != dwWait)
-    {
-        // The thread terminated early for some reason. This is an error condition.
-        CloseHandle(m_hSchedulerThread);
-        m_hSchedulerThread = NULL;
-        CHECK_HR(hr = E_UNEXPECTED);
-    }
-
-    m_dwThreadID = dwID;
-
-done:
-
-    // Regardless success/failure, we are done using the "thread ready" event.
-    if (m_hThreadReadyEvent)
+    if (!m_engine.Start())
     {
-        CloseHandle(m_hThreadReadyEvent);
-        m_hThreadReadyEvent = NULL;
+        timeEndPeriod(1);
+        return E_UNEXPECTED;
     }
 
-    return hr;
+    return S_OK;
 }
 
 
@@ -156,26 +118,13 @@ done:
 
 HRESULT Scheduler::StopScheduler()
 {
-    if (m_hSchedulerThread == NULL)
+    if (!m_engine.IsStarted())
     {
         return S_OK;
     }
 
-    // Ask the scheduler thread to exit.
-    PostThreadMessage(m_dwThreadID, eTerminate, 0, 0);
-    
-    // Wait for the thread to exit.
-    WaitForSingleObject(m_hSchedulerThread, INFINITE);
-
-    // Close handles.
-    CloseHandle(m_hSchedulerThread);
-    m_hSchedulerThread = NULL;
-
-    CloseHandle(m_hFlushEvent);
-    m_hFlushEvent = NULL;
-
-    // Discard samples.
-    m_ScheduledSamples.Clear();
+    // Ask the scheduler thread to exit, wait for it, and discard samples.
+    m_engine.Stop();
 
     // Restore the timer resolution.
     timeEndPeriod(1);
@@ -197,24 +146,14 @@ HRESULT Scheduler::Flush()
 {
     TRACE((L"Scheduler::Flush\n"));
 
-    if (m_hSchedulerThread == NULL)
+    if (!m_engine.IsStarted())
     {
         TRACE((L"No scheduler thread!\n"));
     }
 
-    if (m_hSchedulerThread)
-    {
-        // Ask the scheduler thread to flush.
-        PostThreadMessage(m_dwThreadID, eFlush, 0 , 0);
-
-        // Wait for the scheduler thread to signal the flush event,
-        // OR for the thread to terminate.
-        HANDLE objects[] = { m_hFlushEvent, m_hSchedulerThread };
-
-        WaitForMultipleObjects(ARRAY_SIZE(objects), objects, FALSE, SCHEDULER_TIMEOUT); 
+    m_engine.Flush();
 
-        TRACE((L"Scheduler::Flush completed.\n"));
-    }
+    TRACE((L"Scheduler::Flush completed.\n"));
 
     return S_OK;
 }
@@ -237,33 +176,43 @@ HRESULT Scheduler::ScheduleSample(IMFSample *pSample, BOOL bPresentNow)
         return MF_E_NOT_INITIALIZED;
     }
 
-    if (m_hSchedulerThread == NULL)
+    if (!m_engine.IsStarted())
     {
         return MF_E_NOT_INITIALIZED;
     }
 
-    HRESULT hr = S_OK;
-    DWORD dwExitCode = 0;
-
-    GetExitCodeThread(m_hSchedulerThread, &dwExitCode);
-    if (dwExitCode != STILL_ACTIVE)
+    if (!m_engine.IsRunning())
     {
+        // The scheduler thread exited after a failure.
         return E_FAIL;
     }
 
+    HRESULT hr = S_OK;
+
     if (bPresentNow || (m_pClock == NULL))
     {
         // Present the sample immediately.
         m_pCB->PresentSample(pSample, 0);
+        RecordSampleTime(pSample);
+        m_cPresentedNow++;
     }
     else
     {
-        // Queue the sample and ask the scheduler thread to wake up.
-        hr = m_ScheduledSamples.Queue(pSample);
+        ScheduledFrame frame;
+        LONGLONG hnsTime = 0;
 
-        if (SUCCEEDED(hr))
+        frame.pFrame = pSample;
+        frame.bHasTime = SUCCEEDED(pSample->GetSampleTime(&hnsTime));
+        frame.hnsTime = hnsTime;
+
+        // The queue holds a reference until ReleaseFrame.
+        pSample->AddRef();
+
+        // Queue the sample. The engine wakes the scheduler thread.
+        if (!m_engine.ScheduleSample(frame))
         {
-            PostThreadMessage(m_dwThreadID, eSchedule, 0, 0);
+            pSample->Release();
+            hr = E_OUTOFMEMORY;
         }
     }
 
@@ -272,220 +221,95 @@ HRESULT Scheduler::ScheduleSample(IMFSample *pSample, BOOL bPresentNow)
     return hr;
 }
 
+
 //-----------------------------------------------------------------------------
-// ProcessSamplesInQueue
+// GetCorrelatedTime (ScheduleClock)
 //
-// Processes all the samples in the queue.
-//
-// plNextSleep: Receives the length of time the scheduler thread should sleep
-//              before it calls ProcessSamplesInQueue again.
+// Called on the scheduler thread. Reads the EVR's presentation clock.
 //-----------------------------------------------------------------------------
 
-HRESULT Scheduler::ProcessSamplesInQueue(LONG *plNextSleep)
+bool Scheduler::GetCorrelatedTime(int64_t *phnsClockTime, int64_t *phnsSystemTime)
 {
-    HRESULT hr = S_OK;
-    LONG lWait = 0;
-    IMFSample *pSample = NULL;
-
-    // Process samples until the queue is empty or until the wait time > 0.
-
-    // Note: Dequeue returns S_FALSE when the queue is empty.
-    while (m_ScheduledSamples.Dequeue(&pSample) == S_OK) 
-    {
-        // Process the next sample in the queue. If the sample is not ready
-        // for presentation. the value returned in lWait is > 0, which
-        // means the scheduler should sleep for that amount of time.
-
-        hr = ProcessSample(pSample, &lWait);
-        SAFE_RELEASE(pSample);
-
-        if (FAILED(hr))
-        {
-            break;
-        }
-        if (lWait > 0)
-        {
-            break;
-        }
-    }
+    LONGLONG hnsTimeNow = 0;
+    MFTIME   hnsSystemTime = 0;
 
-    // If the wait time is zero, it means we stopped because the queue is
-    // empty (or an error occurred). Set the wait time to infinite; this will
-    // make the scheduler thread sleep until it gets another thread message.
-    if (lWait == 0)
+    if (m_pClock == NULL || FAILED(m_pClock->GetCorrelatedTime(0, &hnsTimeNow, &hnsSystemTime)))
     {
-        lWait = INFINITE;
+        return false;
     }
 
-    *plNextSleep = lWait;
-    return hr;
+    *phnsClockTime = hnsTimeNow;
+    *phnsSystemTime = hnsSystemTime;
+    return true;
 }
 
 
 //-----------------------------------------------------------------------------
-// ProcessSample
-//
-// Processes a sample.
+// GetVblankTiming (ScheduleVsync)
 //
-// plNextSleep: Receives the length of time the scheduler thread should sleep.
+// Called on the scheduler thread when planning cadence.
 //-----------------------------------------------------------------------------
- 
 
-HRESULT Scheduler::ProcessSample(IMFSample *pSample, LONG *plNextSleep)
+bool Scheduler::GetVblankTiming(int64_t *phnsSinceVblank, double *phnsRefresh)
 {
-    HRESULT hr = S_OK;
-
-    LONGLONG hnsPresentationTime = 0;
-    LONGLONG hnsTimeNow = 0;
-    MFTIME   hnsSystemTime = 0;
-
-    BOOL bPresentNow = TRUE;
-    LONG lNextSleep = 0;
+    LONGLONG hnsSinceVblank = 0;
 
-    if (m_pClock)
+    if (m_pCB == NULL || FAILED(m_pCB->GetVblankTiming(&hnsSinceVblank, phnsRefresh)))
     {
-        // Get the sample's time stamp. It is valid for a sample to
-        // have no time stamp.
-        hr = pSample->GetSampleTime(&hnsPresentationTime);
-    
-        // Get the clock time. (But if the sample does not have a time stamp, 
-        // we don't need the clock time.)
-        if (SUCCEEDED(hr))
-        {
-            hr = m_pClock->GetCorrelatedTime(0, &hnsTimeNow, &hnsSystemTime);
-        }
+        return false;
+    }
 
-        // Calculate the time until the sample's presentation time. 
-        // A negative value means the sample is late.
-        LONGLONG hnsDelta = hnsPresentationTime - hnsTimeNow;   
-        if (m_fRate < 0)
-        {
-            // For reverse playback, the clock runs backward. Therefore the delta is reversed.
-            hnsDelta = - hnsDelta;
-        }
+    *phnsSinceVblank = hnsSinceVblank;
+    return true;
+}
 
-        if (hnsDelta < - m_PerFrame_1_4th)
-        {
-            // This sample is late. 
-            bPresentNow = TRUE;
-        }
-        else if (hnsDelta > (3 * m_PerFrame_1_4th))
-        {
-            // This sample is still too early. Go to sleep.
-            lNextSleep = MFTimeToMsec(hnsDelta - (3 * m_PerFrame_1_4th));
 
-            // Adjust the sleep time for the clock rate. (The presentation clock runs
-            // at m_fRate, but sleeping uses the system clock.)
-            lNextSleep = (LONG)(lNextSleep / fabsf(m_fRate));
+//-----------------------------------------------------------------------------
+// PresentFrame (ScheduleSink)
+//
+// Called on the scheduler thread when a queued sample is due.
+//-----------------------------------------------------------------------------
+
+bool Scheduler::PresentFrame(void *pFrame, int64_t hnsPresentationTime)
+{
+    IMFSample *pSample = static_cast<IMFSample*>(pFrame);
 
-            // Don't present yet.
-            bPresentNow = FALSE;
-        }
-    }
+    HRESULT hr = m_pCB->PresentSample(pSample, hnsPresentationTime);
 
-    if (bPresentNow)
+    if (SUCCEEDED(hr))
     {
-        hr = m_pCB->PresentSample(pSample, hnsPresentationTime);
+        RecordSampleTime(pSample);
     }
-    else
-    {
-        // The sample is not ready yet. Return it to the queue.
-        hr = m_ScheduledSamples.PutBack(pSample);
-    }
-
-    *plNextSleep = lNextSleep;
 
-    return hr;
+    return SUCCEEDED(hr);
 }
 
 
 //-----------------------------------------------------------------------------
-// SchedulerThreadProc (static method)
-// 
-// ThreadProc for the scheduler thread.
+// RecordSampleTime
+//
+// Remembers the time stamp of a presented sample, for repaints. Called on
+// the scheduler thread, or on the caller's thread for immediate samples.
 //-----------------------------------------------------------------------------
 
-DWORD WINAPI Scheduler::SchedulerThreadProc(LPVOID lpParameter)
+void Scheduler::RecordSampleTime(IMFSample *pSample)
 {
-    Scheduler* pScheduler = reinterpret_cast<Scheduler*>(lpParameter);
-    if (pScheduler == NULL)
+    LONGLONG hnsTime = 0;
+
+    if (SUCCEEDED(pSample->GetSampleTime(&hnsTime)))
     {
-        return -1;
+        m_LastSampleTime.store(hnsTime);
     }
-    return pScheduler->SchedulerThreadProcPrivate();
 }
 
+
 //-----------------------------------------------------------------------------
-// SchedulerThreadProcPrivate
-// 
-// Non-static version of the ThreadProc.
+// ReleaseFrame (ScheduleSink)
+//
+// Releases the reference taken in ScheduleSample.
 //-----------------------------------------------------------------------------
 
-DWORD Scheduler::SchedulerThreadProcPrivate()
+void Scheduler::ReleaseFrame(void *pFrame)
 {
-    HRESULT hr = S_OK;
-    MSG     msg;
-    LONG    lWait = INFINITE;
-    BOOL    bExitThread = FALSE;
-
-    // Force the system to create a message queue for this thread.
-    // (See MSDN documentation for PostThreadMessage.)
-    PeekMessage(&msg, NULL, WM_USER, WM_USER, PM_NOREMOVE);
-
-    // Signal to the scheduler that the thread is ready.
-    SetEvent(m_hThreadReadyEvent);
-
-    while( !bExitThread )
-    {
-        // Wait for a thread message OR until the wait time expires.
-        DWORD dwResult = MsgWaitForMultipleObjects(0, NULL, FALSE, lWait, QS_POSTMESSAGE);
-
-        if (dwResult == WAIT_TIMEOUT)
-        {
-            // If we timed out, then process the samples in the queue
-            hr = ProcessSamplesInQueue(&lWait);
-            if (FAILED(hr))
-            {
-                bExitThread = TRUE;
-            }
-        }
-
-        while (PeekMessage(&msg, NULL, 0, 0, PM_REMOVE))
-        {
-            BOOL bProcessSamples = TRUE;
-
-            switch (msg.message) 
-            {
-            case eTerminate:
-                TRACE((L"eTerminate\n"));
-                bExitThread = TRUE;
-                break;
-
-            case eFlush:
-                // Flushing: Clear the sample queue and set the event.
-                m_ScheduledSamples.Clear();
-                lWait = INFINITE;
-                SetEvent(m_hFlushEvent);
-                break;
-
-            case eSchedule:
-                // Process as many samples as we can.
-                if (bProcessSamples)
-                {
-                    hr = ProcessSamplesInQueue(&lWait);
-                    if (FAILED(hr))
-                    {
-                        bExitThread = TRUE;
-                    }
-                    bProcessSamples = (lWait != INFINITE); 
-                }
-                break;
-            } // switch  
-
-        } // while PeekMessage
-    
-    }  // while (!bExitThread)
-
-    TRACE((L"Exit scheduler thread.\n"));
-    return (SUCCEEDED(hr) ? 0 : 1);
+    static_cast<IMFSample*>(pFrame)->Release();
 }
@@ -29,14 +29,15 @@ struct SchedulerCallback;
 // General design:
 // The scheduler generally receives samples before their presentation time. It
 // puts the samples on a queue and presents them in FIFO order on a worker 
-// thread. The scheduler communicates with the worker thread by posting thread
-// messages.
+// thread. The queue, the worker thread and the present/sleep/flush decisions
+// live in ScheduleEngine, which has no Windows dependencies; this class
+// adapts it to IMFClock, IMFSample and SchedulerCallback.
 //
 // The caller has the option of presenting samples immediately (for example,
 // for repaints). 
 //-----------------------------------------------------------------------------
 
-class Scheduler
+class Scheduler : private ScheduleClock, private ScheduleSink, private ScheduleVsync
 {
 public:
     Scheduler();
@@ -48,42 +49,68 @@ public:
     }
 
     void SetFrameRate(const MFRatio& fps);
-    void SetClockRate(float fRate) { m_fRate = fRate; }
-
-    const LONGLONG& LastSampleTime() const { return m_LastSampleTime; }
+    void SetClockRate(float fRate) { m_fRate = fRate; m_engine.SetClockRate(fRate); }
+    void SetRefreshPeriod(double hnsRefresh);
+
+    // High-resolution timing. See ScheduleEngine.
+    void SetTimingMode(ScheduleEngine::TimingMode mode) { m_engine.SetTimingMode(mode); }
+    ScheduleEngine::TimingMode GetTimingMode() const { return m_engine.GetTimingMode(); }
+    void SetSpinBudget(LONGLONG hnsBudget) { m_engine.SetSpinBudget(hnsBudget); }
+    void GetWakeJitter(HistogramSnapshot *pSnapshot) const { m_engine.GetWakeJitter(pSnapshot); }
+    void ResetWakeJitter() { m_engine.ResetWakeJitter(); }
+
+    // Late samples. See ScheduleEngine::LatePolicy.
+    void SetLatePolicy(ScheduleEngine::LatePolicy policy, int lateFrames) { m_engine.SetLatePolicy(policy, lateFrames); }
+    void GetCounters(ScheduleCounters *pCounters) const { m_engine.GetCounters(pCounters); }
+    void ResetCounters() { m_engine.ResetCounters(); m_cPresentedNow = 0; }
+    void GetLateness(HistogramSnapshot *pSnapshot) const { m_engine.GetLateness(pSnapshot); }
+    size_t QueueDepth() const { return m_engine.QueueDepth(); }
+    ULONGLONG PresentedNowCount() const { return m_cPresentedNow; }    // Samples presented without scheduling.
+
+    // Refresh-cadence planning. See ScheduleEngine and CadencePlanner.
+    void SetCadenceMode(bool bEnable) { m_engine.SetCadenceMode(bEnable); }
+    void GetCadenceStats(CadenceStats *pStats) const { m_engine.GetCadenceStats(pStats); }
+    void ResetCadenceStats() { m_engine.ResetCadenceStats(); }
+
+    // Time stamp of the most recently presented sample. A repaint asks the
+    // mixer for this frame again.
+    LONGLONG LastSampleTime() const { return m_LastSampleTime.load(); }
     const LONGLONG& FrameDuration() const { return m_PerFrameInterval; }
 
+    // Run on the process-wide scheduling thread instead of a thread of our
+    // own. Takes effect at the next StartScheduler.
+    void SetUseSharedThread(bool bShared) { m_engine.SetUseSharedService(bShared); }
+
     HRESULT StartScheduler(IMFClock *pClock);
     HRESULT StopScheduler();
 
     HRESULT ScheduleSample(IMFSample *pSample, BOOL bPresentNow);
-    HRESULT ProcessSamplesInQueue(LONG *plNextSleep);
-    HRESULT ProcessSample(IMFSample *pSample, LONG *plNextSleep);
     HRESULT Flush();
 
-    // ThreadProc for the scheduler thread.
-    static DWORD WINAPI SchedulerThreadProc(LPVOID lpParameter);
+private:
+    void RecordSampleTime(IMFSample *pSample);
+
+    // ScheduleClock
+    bool GetCorrelatedTime(int64_t *phnsClockTime, int64_t *phnsSystemTime);
 
-private: 
-    // non-static version of SchedulerThreadProc.
-    DWORD SchedulerThreadProcPrivate();
+    // ScheduleVsync
+    bool GetVblankTiming(int64_t *phnsSinceVblank, double *phnsRefresh);
 
+    // ScheduleSink
+    bool PresentFrame(void *pFrame, int64_t hnsPresentationTime);
+    void ReleaseFrame(void *pFrame);
 
 private:
-    ThreadSafeQueue<IMFSample>  m_ScheduledSamples;     // Samples waiting to be presented.
+    ScheduleEngine      m_engine;   // Sample queue and worker thread.
 
     IMFClock            *m_pClock;  // Presentation clock. Can be NULL.
     SchedulerCallback   *m_pCB;     // Weak reference; do not delete.
 
-    DWORD               m_dwThreadID;
-    HANDLE              m_hSchedulerThread;
-    HANDLE              m_hThreadReadyEvent;
-    HANDLE              m_hFlushEvent;
-
     float               m_fRate;                // Playback rate.
     MFTIME              m_PerFrameInterval;     // Duration of each frame.
-    LONGLONG            m_PerFrame_1_4th;       // 1/4th of the frame duration.
-    MFTIME              m_LastSampleTime;       // Most recent sample time.
+
+    std::atomic<LONGLONG>   m_LastSampleTime;   // Most recent presented sample time.
+    std::atomic<ULONGLONG>  m_cPresentedNow;
 };
 
 
@@ -96,4 +123,8 @@ private:
 struct SchedulerCallback
 {
     virtual HRESULT PresentSample(IMFSample *pSample, LONGLONG llTarget) = 0;
+
+    // Time since the last vertical blank, and the refresh period, in 100ns
+    // units. Cadence planning locks its ticks to these.
+    virtual HRESULT GetVblankTiming(LONGLONG *phnsSinceVblank, double *phnsRefresh) = 0;
 };
@@ -0,0 +1,375 @@
+//////////////////////////////////////////////////////////////////////////
+//
+// CadencePlannerTest.cpp: Pulldown patterns and tick sequences for common
+// frame rates on 60 Hz and 59.94 Hz displays, and phase-locking to the
+// measured vertical blank.
+//
+//////////////////////////////////////////////////////////////////////////
+
+#include "TestCheck.h"
+#include "ScheduleEngine.h"
+
+#include <cmath>
+#include <vector>
+
+// Frame intervals as MFFrameRateToAverageTimePerFrame gives them.
+const int64_t FRAME_23_976 = 417083;
+const int64_t FRAME_24 = 416667;
+const int64_t FRAME_25 = 400000;
+const int64_t FRAME_29_97 = 333667;
+
+const double REFRESH_60 = 10000000.0 / 60;
+const double REFRESH_59_94 = 10000000.0 * 1001 / 60000;
+
+// Ticks each of the first frames is held for, from the planned targets.
+// vblank: presentation time of a blank; period: the display's true period.
+static std::vector<int> Holds(CadencePlanner& planner, int64_t hnsFrame, int frames, double vblank, double period, int *pOffGrid, int *pResyncs)
+{
+    std::vector<int> holds;
+    double previousTick = 0;
+
+    *pOffGrid = 0;
+    *pResyncs = 0;
+
+    for (int n = 0; n <= frames; n++)
+    {
+        bool bResync = false;
+        int64_t target = planner.PlanSample(n * hnsFrame, &bResync);
+
+        double tick = (target - vblank) / period;
+        double nearest = std::floor(tick + 0.5);
+
+        if (std::fabs(tick - nearest) * period > 1)
+        {
+            (*pOffGrid)++;
+        }
+        if (bResync)
+        {
+            (*pResyncs)++;
+        }
+        if (n > 0)
+        {
+            holds.push_back((int)(nearest - previousTick));
+        }
+        previousTick = nearest;
+    }
+    return holds;
+}
+
+static bool IsPattern(const std::vector<int>& holds, const int *pattern, int length)
+{
+    for (size_t i = 0; i < holds.size(); i++)
+    {
+        if (holds[i] != pattern[i % length])
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+static int CountHolds(const std::vector<int>& holds, int value)
+{
+    int count = 0;
+    for (size_t i = 0; i < holds.size(); i++)
+    {
+        count += (holds[i] == value) ? 1 : 0;
+    }
+    return count;
+}
+
+static void TestPatterns()
+{
+    CadencePlanner planner;
+    std::vector<int> pattern;
+
+    CHECK(planner.Configure(FRAME_24, REFRESH_60));
+    planner.GetPattern(&pattern);
+    CHECK_EQ(pattern.size(), 2);
+    CHECK_EQ(pattern[0], 3);
+    CHECK_EQ(pattern[1], 2);
+
+    // Within the ratio tolerance of 24p, so the same 3:2.
+    CHECK(planner.Configure(FRAME_23_976, REFRESH_60));
+    CHECK_EQ(planner.TicksPerCycle(), 5);
+    CHECK_EQ(planner.FramesPerCycle(), 2);
+
+    CHECK(planner.Configure(FRAME_23_976, REFRESH_59_94));
+    CHECK_EQ(planner.TicksPerCycle(), 5);
+    CHECK_EQ(planner.FramesPerCycle(), 2);
+
+    CHECK(planner.Configure(FRAME_25, REFRESH_60));
+    planner.GetPattern(&pattern);
+    const int expected25[] = { 3, 2, 3, 2, 2 };
+    CHECK_EQ(pattern.size(), 5);
+    CHECK(IsPattern(pattern, expected25, 5));
+
+    CHECK(planner.Configure(FRAME_29_97, REFRESH_60));
+    CHECK_EQ(planner.TicksPerCycle(), 2);
+    CHECK_EQ(planner.FramesPerCycle(), 1);
+
+    // The fractional period survives.
+    CHECK_NEAR(planner.RefreshPeriod(), REFRESH_60, 1e-6);
+    CHECK_EQ(planner.RefreshInterval(), 166667);
+
+    CHECK(!planner.Configure(0, REFRESH_60));
+    CHECK(!planner.IsConfigured());
+}
+
+static void Test24On60()
+{
+    CadencePlanner planner;
+    int offGrid = 0;
+    int resyncs = 0;
+    const int pattern[] = { 3, 2 };
+
+    // Blanks 3 ms after the frame times: every target moves onto a blank.
+    const double vblank = 30000;
+
+    planner.Configure(FRAME_24, REFRESH_60);
+    planner.SetVblank((int64_t)vblank);
+
+    std::vector<int> holds = Holds(planner, FRAME_24, 2400, vblank, REFRESH_60, &offGrid, &resyncs);
+
+    CHECK(IsPattern(holds, pattern, 2));
+    CHECK_EQ(offGrid, 0);
+    CHECK_EQ(resyncs, 0);
+}
+
+static void Test23976On5994()
+{
+    CadencePlanner planner;
+    int offGrid = 0;
+    int resyncs = 0;
+    const int pattern[] = { 3, 2 };
+    const double vblank = 12345;
+
+    // The exact NTSC rates: a steady 3:2 with no re-anchoring. A period
+    // rounded to whole units would be a third of a unit short every tick.
+    planner.Configure(FRAME_23_976, REFRESH_59_94);
+    planner.SetVblank((int64_t)vblank);
+
+    std::vector<int> holds = Holds(planner, FRAME_23_976, 24000, vblank, REFRESH_59_94, &offGrid, &resyncs);
+
+    CHECK(IsPattern(holds, pattern, 2));
+    CHECK_EQ(offGrid, 0);
+    CHECK_EQ(resyncs, 0);
+}
+
+static void Test23976On60()
+{
+    CadencePlanner planner;
+    int offGrid = 0;
+    int resyncs = 0;
+
+    // 23.976p is 0.1% slow for 3:2 on 60 Hz, so every 1000 ticks (400
+    // frames) or so one frame is held for an extra tick. Everything else
+    // stays 3:2.
+    planner.Configure(FRAME_23_976, REFRESH_60);
+    planner.SetVblank(0);
+
+    std::vector<int> holds = Holds(planner, FRAME_23_976, 4800, 0, REFRESH_60, &offGrid, &resyncs);
+
+    CHECK_EQ(offGrid, 0);
+    CHECK(resyncs >= 11 && resyncs <= 13);
+    CHECK_EQ(CountHolds(holds, 3) + CountHolds(holds, 2) + CountHolds(holds, 4), (int)holds.size());
+    CHECK(CountHolds(holds, 4) <= resyncs);
+}
+
+static void Test25On60()
+{
+    CadencePlanner planner;
+    int offGrid = 0;
+    int resyncs = 0;
+    const int pattern[] = { 3, 2, 3, 2, 2 };
+
+    planner.Configure(FRAME_25, REFRESH_60);
+    planner.SetVblank(0);
+
+    std::vector<int> holds = Holds(planner, FRAME_25, 2500, 0, REFRESH_60, &offGrid, &resyncs);
+
+    CHECK(IsPattern(holds, pattern, 5));
+    CHECK_EQ(offGrid, 0);
+    CHECK_EQ(resyncs, 0);
+}
+
+static void Test2997On60()
+{
+    CadencePlanner planner;
+    int offGrid = 0;
+    int resyncs = 0;
+
+    // 2:2, with an extra tick about every 1000 ticks (500 frames).
+    planner.Configure(FRAME_29_97, REFRESH_60);
+    planner.SetVblank(0);
+
+    std::vector<int> holds = Holds(planner, FRAME_29_97, 3000, 0, REFRESH_60, &offGrid, &resyncs);
+
+    CHECK_EQ(offGrid, 0);
+    CHECK(resyncs >= 4 && resyncs <= 7);
+    CHECK(CountHolds(holds, 2) >= (int)holds.size() - resyncs);
+}
+
+static void TestFollowsDisplayDrift()
+{
+    CadencePlanner planner;
+    const int pattern[] = { 3, 2 };
+    std::vector<int> holds;
+    int offGrid = 0;
+    int previousTick = 0;
+
+    // The display runs 50 ppm fast against its nominal 60 Hz and the
+    // presentation clock. Each frame the planner is given the latest blank,
+    // as the engine does. Left alone, the grid would be 5 ms off the blanks
+    // by the end; locked, a target is off by no more than the nominal period's
+    // error over the few ticks between the blank and the target.
+    const double period = REFRESH_60 * (1 - 50e-6);
+
+    planner.Configure(FRAME_24, REFRESH_60);
+
+    for (int n = 0; n <= 2400; n++)
+    {
+        int64_t sampleTime = n * FRAME_24;
+        int latest = (int)std::floor(sampleTime / period);
+
+        planner.SetVblank((int64_t)std::floor(latest * period + 0.5));
+
+        bool bResync = false;
+        int64_t target = planner.PlanSample(sampleTime, &bResync);
+
+        double tick = target / period;
+        int nearest = (int)std::floor(tick + 0.5);
+
+        if (std::fabs(tick - nearest) * period > 50)
+        {
+            offGrid++;
+        }
+        if (n > 0)
+        {
+            holds.push_back(nearest - previousTick);
+        }
+        previousTick = nearest;
+    }
+
+    CHECK_EQ(offGrid, 0);
+    CHECK(IsPattern(holds, pattern, 2));
+}
+
+static void TestWithoutVblank()
+{
+    CadencePlanner planner;
+    bool bResync = false;
+
+    // No measurement: the grid starts at the first sample.
+    planner.Configure(FRAME_24, REFRESH_60);
+    CHECK_EQ(planner.PlanSample(1000000, &bResync), 1000000);
+    CHECK(!bResync);
+    CHECK_EQ(planner.PlanSample(1000000 + FRAME_24, &bResync), 1000000 + 500000);
+}
+
+//-----------------------------------------------------------------------------
+// Engine: frames presented by ScheduleEngine in cadence mode, with the
+// clock stepped from blank to blank.
+//-----------------------------------------------------------------------------
+
+struct DisplayClock : ScheduleClock, ScheduleVsync
+{
+    DisplayClock() : now(0), vblank(0), period(REFRESH_59_94) {}
+
+    bool GetCorrelatedTime(int64_t *phnsClockTime, int64_t *phnsSystemTime)
+    {
+        *phnsClockTime = now;
+        *phnsSystemTime = now;
+        return true;
+    }
+
+    bool GetVblankTiming(int64_t *phnsSinceVblank, double *phnsRefresh)
+    {
+        *phnsSinceVblank = now - vblank;
+        *phnsRefresh = period;
+        return true;
+    }
+
+    int64_t now;
+    int64_t vblank;
+    double  period;
+};
+
+struct TickSink : ScheduleSink
+{
+    TickSink(DisplayClock *pClock) : pClock(pClock) {}
+
+    bool PresentFrame(void *, int64_t)
+    {
+        presentedAt.push_back(pClock->vblank);
+        return true;
+    }
+
+    void ReleaseFrame(void *) {}
+
+    DisplayClock            *pClock;
+    std::vector<int64_t>    presentedAt;
+};
+
+static void TestEngineCadence()
+{
+    DisplayClock display;
+    TickSink sink(&display);
+    ScheduleEngine engine;
+    const int ticks = 6000;
+    int64_t next = 0;
+
+    engine.SetClock(&display);
+    engine.SetVsync(&display);
+    engine.SetSink(&sink);
+    engine.SetFrameInterval(FRAME_23_976);
+    engine.SetRefreshInterval(166667);      // Overridden by the measured period.
+    engine.SetCadenceMode(true);
+
+    for (int tick = 0; tick < ticks; tick++)
+    {
+        // 2 ms after the blank, as a compositor-driven wake-up might be.
+        display.vblank = (int64_t)std::floor(tick * REFRESH_59_94 + 0.5);
+        display.now = display.vblank + 20000;
+
+        while (engine.ScheduleSample(ScheduledFrame { (void*)1, next * FRAME_23_976, true }))
+        {
+            next++;
+        }
+
+        int64_t hnsWait = 0;
+        engine.ProcessSamplesInQueue(&hnsWait);
+    }
+
+    CadenceStats stats;
+    engine.GetCadenceStats(&stats);
+
+    CHECK_EQ(stats.patternTicks, 5);
+    CHECK_EQ(stats.patternFrames, 2);
+    CHECK_EQ(stats.resyncs, 0);
+    CHECK_EQ(stats.breaks, 0);
+
+    std::vector<int> holds;
+    for (size_t i = 1; i < sink.presentedAt.size(); i++)
+    {
+        holds.push_back((int)std::floor((sink.presentedAt[i] - sink.presentedAt[i - 1]) / REFRESH_59_94 + 0.5));
+    }
+
+    const int pattern[] = { 3, 2 };
+    CHECK(holds.size() > 2000);
+    CHECK(IsPattern(holds, pattern, 2) || IsPattern(std::vector<int>(holds.begin() + 1, holds.end()), pattern, 2));
+}
+
+int main()
+{
+    RUN_TEST(TestPatterns);
+    RUN_TEST(Test24On60);
+    RUN_TEST(Test23976On5994);
+    RUN_TEST(Test23976On60);
+    RUN_TEST(Test25On60);
+    RUN_TEST(Test2997On60);
+    RUN_TEST(TestFollowsDisplayDrift);
+    RUN_TEST(TestWithoutVblank);
+    RUN_TEST(TestEngineCadence);
+    return TestResult();
+}
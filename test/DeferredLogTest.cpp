@@ -0,0 +1,376 @@
+//////////////////////////////////////////////////////////////////////////
+//
+// DeferredLogTest.cpp: MpscRing with several producer threads, and
+// DeferredLog's capture, formatting and delivery.
+//
+//////////////////////////////////////////////////////////////////////////
+
+#include "TestCheck.h"
+#include "DeferredLog.h"
+#include "common/MpscRing.h"
+
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <wchar.h>
+
+using namespace MediaFoundationSamples;
+
+const int PRODUCERS = 4;
+
+// A producer id, its own sequence number, and a check value derived from
+// both: a torn copy shows up as a mismatch.
+struct Item
+{
+    uint32_t producer;
+    uint32_t sequence;
+    uint64_t check;
+};
+
+static uint64_t CheckValue(uint32_t producer, uint32_t sequence)
+{
+    return ((uint64_t)producer << 32 | sequence) * 0x9E3779B97F4A7C15ULL;
+}
+
+// Keeps every message, for checking on the test thread after a Flush.
+class RecordingSink : public LogSink
+{
+public:
+    void Write(LogLevel level, const wchar_t *message)
+    {
+        std::lock_guard<std::mutex> lock(m_Lock);
+        m_Levels.push_back(level);
+        m_Lines.push_back(message);
+    }
+
+    std::vector<std::wstring> Lines()
+    {
+        std::lock_guard<std::mutex> lock(m_Lock);
+        return m_Lines;
+    }
+
+    std::vector<LogLevel> Levels()
+    {
+        std::lock_guard<std::mutex> lock(m_Lock);
+        return m_Levels;
+    }
+
+    void Clear()
+    {
+        std::lock_guard<std::mutex> lock(m_Lock);
+        m_Lines.clear();
+        m_Levels.clear();
+    }
+
+private:
+    std::mutex                  m_Lock;
+    std::vector<std::wstring>   m_Lines;
+    std::vector<LogLevel>       m_Levels;
+};
+
+// The message without the "[time] Tn level: " prefix the consumer adds.
+static std::wstring Body(const std::wstring& line)
+{
+    size_t colon = line.find(L": ");
+    return (colon == std::wstring::npos) ? line : line.substr(colon + 2);
+}
+
+
+//-----------------------------------------------------------------------------
+// MpscRing
+//-----------------------------------------------------------------------------
+
+static void TestRingFillAndDrain()
+{
+    MpscRing<int, 4> ring;
+    int value = 0;
+
+    CHECK(ring.IsEmpty());
+    CHECK(!ring.TryPop(value));
+    CHECK_EQ(ring.Capacity(), 4);
+
+    for (int i = 0; i < 4; i++)
+    {
+        CHECK(ring.TryPush(i));
+    }
+    CHECK(!ring.TryPush(4));
+    CHECK_EQ(ring.Size(), 4);
+
+    for (int i = 0; i < 4; i++)
+    {
+        CHECK(ring.TryPop(value));
+        CHECK_EQ(value, i);
+    }
+    CHECK(ring.IsEmpty());
+
+    // Wrap the positions many times over.
+    for (int i = 0; i < 1000; i++)
+    {
+        CHECK(ring.TryPush(i));
+        CHECK(ring.TryPop(value));
+        CHECK_EQ(value, i);
+    }
+}
+
+static void TestRingProducersAndConsumer()
+{
+    // Small, so producers keep finding it full and retrying.
+    static MpscRing<Item, 16> ring;
+    const uint32_t count = 100000;
+
+    std::vector<std::thread> producers;
+
+    for (uint32_t p = 0; p < PRODUCERS; p++)
+    {
+        producers.push_back(std::thread([p, count] {
+            for (uint32_t i = 0; i < count; )
+            {
+                Item item = { p, i, CheckValue(p, i) };
+
+                if (ring.TryPush(item))
+                {
+                    i++;
+                }
+                else
+                {
+                    std::this_thread::yield();
+                }
+            }
+        }));
+    }
+
+    // Every item arrives once, intact, and in its producer's order.
+    std::vector<uint32_t> next(PRODUCERS, 0);
+    int torn = 0;
+    int outOfOrder = 0;
+    Item item;
+
+    for (uint64_t received = 0; received < (uint64_t)count * PRODUCERS; )
+    {
+        if (!ring.TryPop(item))
+        {
+            std::this_thread::yield();
+            continue;
+        }
+
+        received++;
+
+        if (item.producer >= (uint32_t)PRODUCERS || item.check != CheckValue(item.producer, item.sequence))
+        {
+            torn++;
+            continue;
+        }
+        if (item.sequence != next[item.producer])
+        {
+            outOfOrder++;
+        }
+        next[item.producer] = item.sequence + 1;
+    }
+
+    for (size_t i = 0; i < producers.size(); i++)
+    {
+        producers[i].join();
+    }
+
+    CHECK_EQ(torn, 0);
+    CHECK_EQ(outOfOrder, 0);
+    for (int p = 0; p < PRODUCERS; p++)
+    {
+        CHECK_EQ(next[p], count);
+    }
+    CHECK(ring.IsEmpty());
+    CHECK(!ring.TryPop(item));
+}
+
+
+//-----------------------------------------------------------------------------
+// DeferredLog
+//-----------------------------------------------------------------------------
+
+static std::wstring FormatOf(const LogRecord& rec)
+{
+    return DeferredLog::Format(rec);
+}
+
+template <typename... Args>
+static std::wstring Captured(const wchar_t *format, Args... args)
+{
+    // Write's capture path, without the ring.
+    RecordingSink sink;
+    DeferredLog::Start(&sink);
+    DeferredLog::Write(LogLevelInfo, format, args...);
+    DeferredLog::Flush();
+    DeferredLog::Stop();
+
+    std::vector<std::wstring> lines = sink.Lines();
+    return lines.empty() ? std::wstring(L"<none>") : Body(lines.back());
+}
+
+static void TestFormat()
+{
+    wchar_t transient[16];
+    wcscpy(transient, L"transient");
+
+    long hr = (long)0x8000FFFF;
+    long long offset = -123456789012LL;
+
+    CHECK(Captured(L"no arguments\n") == L"no arguments\n");
+    CHECK(Captured(L"offset = %I64d\n", offset) == L"offset = -123456789012\n");
+    CHECK(Captured(L"%S line %d hr=0x%X\n", "file.cpp", 77, hr) == L"file.cpp line 77 hr=0x8000FFFF\n");
+    CHECK(Captured(L"%5.2f|%-6s|%c|%%|%u\n", 2.0, L"ab", L'Z', 42u) == L" 2.00|ab    |Z|%|42\n");
+
+    // Missing arguments are marked, not read from the stack.
+    CHECK(Captured(L"%d %d\n", 1) == L"1 <?>\n");
+
+    // A record with fewer arguments than conversions.
+    LogRecord rec;
+    rec.format = L"%s";
+    rec.argCount = 0;
+    rec.textUsed = 0;
+    CHECK(FormatOf(rec) == L"<?>");
+}
+
+static void TestStringCopied()
+{
+    RecordingSink sink;
+    wchar_t text[16];
+
+    wcscpy(text, L"before");
+
+    DeferredLog::Start(&sink);
+    WMF_LOG_ERROR(L"%s\n", text);
+    wcscpy(text, L"after");
+    DeferredLog::Flush();
+    DeferredLog::Stop();
+
+    std::vector<std::wstring> lines = sink.Lines();
+    CHECK_EQ(lines.size(), 1);
+    CHECK(!lines.empty() && Body(lines[0]) == L"before\n");
+    CHECK(!sink.Levels().empty() && sink.Levels()[0] == LogLevelError);
+}
+
+static void TestProducers()
+{
+    RecordingSink sink;
+    const int count = 4000;
+
+    const uint64_t droppedBefore = DeferredLog::Dropped();
+
+    DeferredLog::Start(&sink);
+
+    std::vector<std::thread> producers;
+
+    for (int p = 0; p < PRODUCERS; p++)
+    {
+        producers.push_back(std::thread([p, count] {
+            for (int i = 0; i < count; i++)
+            {
+                DeferredLog::Write(LogLevelWarning, L"producer %d message %d\n", p, i);
+
+                // Mostly slow enough for the consumer, which looks every
+                // 10 ms; a late wakeup still overflows the ring.
+                if ((i & 7) == 7)
+                {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                }
+            }
+        }));
+    }
+
+    for (size_t i = 0; i < producers.size(); i++)
+    {
+        producers[i].join();
+    }
+
+    DeferredLog::Flush();
+    DeferredLog::Stop();
+
+    const uint64_t dropped = DeferredLog::Dropped() - droppedBefore;
+
+    // Each message is whole and in its producer's order; everything not
+    // dropped was delivered.
+    std::vector<int> last(PRODUCERS, -1);
+    int delivered = 0;
+    int outOfOrder = 0;
+    int malformed = 0;
+    uint64_t droppedReported = 0;
+    std::vector<std::wstring> lines = sink.Lines();
+
+    for (size_t i = 0; i < lines.size(); i++)
+    {
+        unsigned long long reported = 0;
+
+        // The dropped-message report has no prefix.
+        if (swscanf(lines[i].c_str(), L"DeferredLog: %llu messages dropped", &reported) == 1)
+        {
+            droppedReported += reported;
+            continue;
+        }
+
+        std::wstring body = Body(lines[i]);
+        int p = -1;
+        int n = -1;
+
+        if (swscanf(body.c_str(), L"producer %d message %d\n", &p, &n) != 2 || p < 0 || p >= PRODUCERS)
+        {
+            malformed++;
+            continue;
+        }
+        if (n <= last[p])
+        {
+            outOfOrder++;
+        }
+        last[p] = n;
+        delivered++;
+    }
+
+    CHECK_EQ(malformed, 0);
+    CHECK_EQ(outOfOrder, 0);
+    CHECK_EQ(delivered + dropped, (uint64_t)count * PRODUCERS);
+    CHECK_EQ(droppedReported, dropped);
+
+    std::printf("    delivered %d, dropped %llu\n", delivered, (unsigned long long)dropped);
+}
+
+static void TestDroppedWhenStopped()
+{
+    RecordingSink sink;
+
+    // Nobody drains the ring while the consumer is stopped.
+    DeferredLog::SetSink(&sink);
+
+    const uint64_t droppedBefore = DeferredLog::Dropped();
+
+    for (size_t i = 0; i < LOG_RING_SIZE + 10; i++)
+    {
+        WMF_LOG_ERROR(L"queued %d\n", (int)i);
+    }
+
+    CHECK_EQ(DeferredLog::Dropped() - droppedBefore, 10);
+    CHECK(sink.Lines().empty());
+
+    // Starting the consumer delivers what was queued, oldest first.
+    DeferredLog::Start(NULL);
+    DeferredLog::Flush();
+    DeferredLog::Stop();
+
+    std::vector<std::wstring> lines = sink.Lines();
+    CHECK_EQ(lines.size(), LOG_RING_SIZE);
+    CHECK(!lines.empty() && Body(lines.front()) == L"queued 0\n");
+    CHECK(!lines.empty() && Body(lines.back()) == L"queued " + std::to_wstring(LOG_RING_SIZE - 1) + L"\n");
+
+    DeferredLog::SetSink(NULL);
+}
+
+int main()
+{
+    RUN_TEST(TestRingFillAndDrain);
+    RUN_TEST(TestRingProducersAndConsumer);
+    RUN_TEST(TestFormat);
+    RUN_TEST(TestStringCopied);
+    RUN_TEST(TestProducers);
+    RUN_TEST(TestDroppedWhenStopped);
+    return TestResult();
+}
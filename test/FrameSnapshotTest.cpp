@@ -0,0 +1,132 @@
+//////////////////////////////////////////////////////////////////////////
+//
+// FrameSnapshotTest.cpp: FrameSnapshot publishing frames, and readers on
+// other threads never seeing a frame torn between two publishes.
+//
+//////////////////////////////////////////////////////////////////////////
+
+#include "TestCheck.h"
+#include "FrameSnapshot.h"
+
+#include <thread>
+#include <vector>
+
+const int READERS = 3;
+const uint64_t FRAMES = 500000;
+
+// Every field is derived from the serial, so a torn copy cannot match.
+static int64_t SampleTimeOf(uint64_t serial) { return (int64_t)serial * 166667; }
+static int64_t DurationOf(uint64_t serial) { return 166667 + (int64_t)(serial % 7); }
+static int64_t PresentTimeOf(uint64_t serial) { return 5000000000LL + (int64_t)serial * 166681; }
+
+static void TestEmpty()
+{
+    FrameSnapshot snapshot;
+
+    PresentedFrameInfo info = snapshot.Read();
+
+    CHECK_EQ(snapshot.Serial(), 0);
+    CHECK_EQ(info.serial, 0);
+    CHECK_EQ(info.sampleTime, 0);
+    CHECK_EQ(info.sampleDuration, 0);
+    CHECK_EQ(info.presentTime, 0);
+}
+
+static void TestPublish()
+{
+    FrameSnapshot snapshot;
+
+    snapshot.Publish(1000, 400, 90000);
+
+    PresentedFrameInfo info = snapshot.Read();
+
+    CHECK_EQ(snapshot.Serial(), 1);
+    CHECK_EQ(info.serial, 1);
+    CHECK_EQ(info.sampleTime, 1000);
+    CHECK_EQ(info.sampleDuration, 400);
+    CHECK_EQ(info.presentTime, 90000);
+
+    // Each publish counts, even with the same times, and the last one wins.
+    snapshot.Publish(1000, 400, 90000);
+    snapshot.Publish(-5, 0, 91000);
+
+    info = snapshot.Read();
+
+    CHECK_EQ(info.serial, 3);
+    CHECK_EQ(info.sampleTime, -5);
+    CHECK_EQ(info.sampleDuration, 0);
+    CHECK_EQ(info.presentTime, 91000);
+}
+
+// One writer publishing as fast as it can while readers copy the frame:
+// every copy is one whole publish, and serials never go backwards.
+static void TestConcurrent()
+{
+    FrameSnapshot snapshot;
+    std::atomic<bool> done(false);
+    std::vector<std::thread> readers;
+    std::vector<uint64_t> reads(READERS, 0);
+    std::vector<uint64_t> torn(READERS, 0);
+    std::vector<uint64_t> backwards(READERS, 0);
+
+    for (int r = 0; r < READERS; r++)
+    {
+        readers.push_back(std::thread([&, r]
+        {
+            uint64_t last = 0;
+
+            while (!done.load())
+            {
+                PresentedFrameInfo info = snapshot.Read();
+
+                if (info.serial != 0 &&
+                    (info.sampleTime != SampleTimeOf(info.serial) ||
+                     info.sampleDuration != DurationOf(info.serial) ||
+                     info.presentTime != PresentTimeOf(info.serial)))
+                {
+                    torn[r]++;
+                }
+                if (info.serial < last || snapshot.Serial() < info.serial)
+                {
+                    backwards[r]++;
+                }
+                last = info.serial;
+                reads[r]++;
+            }
+        }));
+    }
+
+    for (uint64_t serial = 1; serial <= FRAMES; serial++)
+    {
+        snapshot.Publish(SampleTimeOf(serial), DurationOf(serial), PresentTimeOf(serial));
+    }
+    done = true;
+
+    uint64_t totalReads = 0;
+
+    for (int r = 0; r < READERS; r++)
+    {
+        readers[r].join();
+
+        CHECK_EQ(torn[r], 0);
+        CHECK_EQ(backwards[r], 0);
+        totalReads += reads[r];
+    }
+
+    PresentedFrameInfo info = snapshot.Read();
+
+    CHECK_EQ(info.serial, FRAMES);
+    CHECK_EQ(info.sampleTime, SampleTimeOf(FRAMES));
+    CHECK(totalReads > 0);
+
+    std::printf("    %llu frames published, %llu reads across %d readers\n",
+        (unsigned long long)FRAMES, (unsigned long long)totalReads, READERS);
+}
+
+int main()
+{
+    RUN_TEST(TestEmpty);
+    RUN_TEST(TestPublish);
+    RUN_TEST(TestConcurrent);
+    return TestResult();
+}
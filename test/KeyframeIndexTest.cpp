@@ -0,0 +1,119 @@
+//////////////////////////////////////////////////////////////////////////
+//
+// KeyframeIndexTest.cpp: Keyframe lookup and intervals, and frame/time
+// conversions round-tripping at common frame rates.
+//
+//////////////////////////////////////////////////////////////////////////
+
+#include "TestCheck.h"
+#include "KeyframeIndex.h"
+
+const int64_t SECOND = 10000000;
+
+static void TestEmpty()
+{
+    KeyframeIndex index;
+
+    CHECK(index.IsEmpty());
+    CHECK_EQ(index.Count(), 0);
+    CHECK_EQ(index.Preceding(SECOND), -1);
+
+    index.Finish(10 * SECOND);
+    CHECK(index.IsEmpty());
+    CHECK_EQ(index.LongestInterval(), 0);
+}
+
+// Keyframes added in decode order, with a repeat, come out sorted and once.
+static void TestFinish()
+{
+    KeyframeIndex index;
+
+    index.Add(4 * SECOND);
+    index.Add(0);
+    index.Add(2 * SECOND);
+    index.Add(2 * SECOND);
+    index.Finish(10 * SECOND);
+
+    CHECK_EQ(index.Count(), 3);
+    CHECK_EQ(index.At(0), 0);
+    CHECK_EQ(index.At(1), 2 * SECOND);
+    CHECK_EQ(index.At(2), 4 * SECOND);
+
+    // The last keyframe to the end of the stream is the longest.
+    CHECK_EQ(index.LongestInterval(), 6 * SECOND);
+}
+
+static void TestPreceding()
+{
+    KeyframeIndex index;
+
+    index.Add(SECOND);
+    index.Add(3 * SECOND);
+    index.Add(5 * SECOND);
+    index.Finish(6 * SECOND);
+
+    CHECK_EQ(index.LongestInterval(), 2 * SECOND);
+
+    // At or before.
+    CHECK_EQ(index.Preceding(3 * SECOND), 3 * SECOND);
+    CHECK_EQ(index.Preceding(3 * SECOND - 1), SECOND);
+    CHECK_EQ(index.Preceding(4 * SECOND), 3 * SECOND);
+    CHECK_EQ(index.Preceding(100 * SECOND), 5 * SECOND);
+
+    // Before the first keyframe: the first one.
+    CHECK_EQ(index.Preceding(0), SECOND);
+    CHECK_EQ(index.Preceding(-SECOND), SECOND);
+}
+
+static void TestFrameTime()
+{
+    // 29.97: frame 1 starts at 33366.67 us, rounded to the nearest 100ns.
+    CHECK_EQ(FrameTime::ToTime(1, 30000, 1001), 333667);
+    CHECK_EQ(FrameTime::ToTime(30000, 30000, 1001), 1001 * SECOND);
+    CHECK_EQ(FrameTime::ToTime(25, 25, 1), SECOND);
+
+    CHECK_EQ(FrameTime::ToFrame(0, 25, 1), 0);
+    CHECK_EQ(FrameTime::ToFrame(SECOND / 25 - 2, 25, 1), 0);
+    CHECK_EQ(FrameTime::ToFrame(SECOND / 25, 25, 1), 1);
+
+    // A zero rate is no rate at all.
+    CHECK_EQ(FrameTime::ToTime(10, 0, 1), 0);
+    CHECK_EQ(FrameTime::ToFrame(SECOND, 25, 0), 0);
+}
+
+// Every frame's start time maps back to the frame, and so does any time up
+// to just before the next frame's start, at rates with and without rounding.
+static void TestFrameTimeRoundTrip()
+{
+    const uint32_t rates[][2] = { { 24, 1 }, { 25, 1 }, { 24000, 1001 }, { 30000, 1001 }, { 60000, 1001 } };
+    int failures = 0;
+
+    for (size_t r = 0; r < sizeof(rates) / sizeof(rates[0]); r++)
+    {
+        const uint32_t num = rates[r][0];
+        const uint32_t den = rates[r][1];
+
+        for (int64_t frame = 0; frame < 200000; frame++)
+        {
+            const int64_t start = FrameTime::ToTime(frame, num, den);
+            const int64_t next = FrameTime::ToTime(frame + 1, num, den);
+
+            if (FrameTime::ToFrame(start, num, den) != frame || FrameTime::ToFrame(next - 2, num, den) != frame)
+            {
+                failures++;
+            }
+        }
+    }
+
+    CHECK_EQ(failures, 0);
+}
+
+int main()
+{
+    RUN_TEST(TestEmpty);
+    RUN_TEST(TestFinish);
+    RUN_TEST(TestPreceding);
+    RUN_TEST(TestFrameTime);
+    RUN_TEST(TestFrameTimeRoundTrip);
+    return TestResult();
+}
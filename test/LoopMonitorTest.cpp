@@ -0,0 +1,217 @@
+//////////////////////////////////////////////////////////////////////////
+//
+// LoopMonitorTest.cpp: LoopMonitor finding the first frame of each pass,
+// for loops that restart and for gapless loops, and what it records.
+//
+//////////////////////////////////////////////////////////////////////////
+
+#include "TestCheck.h"
+#include "LoopMonitor.h"
+
+const int64_t MS = 10000;
+const int64_t FRAME = 166667;       // 60 fps.
+const int FRAMES_PER_PASS = 120;
+
+//-----------------------------------------------------------------------------
+// Presents frames as a player would: each one its duration after the last,
+// with the sample times the caller asks for.
+//-----------------------------------------------------------------------------
+
+struct FrameClock
+{
+    FrameClock() : now(1000 * MS)
+    {
+    }
+
+    void Present(LoopMonitor& monitor, int64_t sampleTime)
+    {
+        monitor.OnFramePresented(sampleTime, FRAME, now);
+        now += FRAME;
+    }
+
+    // One pass of frames, sample times from first.
+    void Pass(LoopMonitor& monitor, int64_t first)
+    {
+        for (int i = 0; i < FRAMES_PER_PASS; i++)
+        {
+            Present(monitor, first + i * FRAME);
+        }
+    }
+
+    int64_t now;
+};
+
+static LoopStats Stats(const LoopMonitor& monitor)
+{
+    LoopStats stats;
+    monitor.GetStats(&stats);
+    return stats;
+}
+
+// Stop and Play: sample times start over, and the new frame comes late by
+// however long the restart took.
+static void TestRestart()
+{
+    LoopMonitor monitor;
+    FrameClock clock;
+
+    clock.Pass(monitor, 0);
+    CHECK_EQ(Stats(monitor).loops, 0);
+
+    // The last frame is on screen until now; the restart is issued at its end
+    // and the first new frame arrives 40 ms later.
+    const int64_t restartAt = clock.now;
+    monitor.OnLoopRestart(restartAt);
+    clock.now += 40 * MS;
+    clock.Pass(monitor, 0);
+
+    LoopStats stats = Stats(monitor);
+    CHECK_EQ(stats.loops, 1);
+    CHECK_EQ(stats.gap.count, 1);
+    CHECK_EQ(stats.gap.sum, 40 * MS);
+    CHECK_EQ(stats.restart.count, 1);
+    CHECK_EQ(stats.restart.sum, 40 * MS);
+}
+
+// Gapless: sample times run on across passes, and the frame at the
+// boundary follows the last one with no gap and no restart.
+static void TestBoundary()
+{
+    LoopMonitor monitor;
+    FrameClock clock;
+    const int64_t pass = FRAMES_PER_PASS * FRAME;
+
+    clock.Pass(monitor, 0);
+
+    for (int i = 1; i <= 3; i++)
+    {
+        // Announced ahead of the pass, while the previous one still plays.
+        monitor.OnLoopBoundary(i * pass);
+        clock.Pass(monitor, i * pass);
+    }
+
+    LoopStats stats = Stats(monitor);
+    CHECK_EQ(stats.loops, 3);
+    CHECK_EQ(stats.gap.count, 3);
+    CHECK_EQ(stats.gap.sum, 0);
+    CHECK_EQ(stats.gap.highest, 0);
+    CHECK_EQ(stats.restart.count, 0);
+}
+
+// The first sample of a pass is a little early: within half a frame it
+// still starts the pass, and the frame before it does not.
+static void TestBoundaryTolerance()
+{
+    LoopMonitor monitor;
+    FrameClock clock;
+    const int64_t boundary = 10 * FRAME;
+
+    monitor.OnLoopBoundary(boundary);
+
+    for (int i = 0; i < 10; i++)
+    {
+        clock.Present(monitor, i * FRAME);
+    }
+    CHECK_EQ(Stats(monitor).loops, 0);
+
+    clock.Present(monitor, boundary - FRAME / 3);
+    CHECK_EQ(Stats(monitor).loops, 1);
+
+    // Counted once.
+    clock.Present(monitor, boundary + FRAME);
+    CHECK_EQ(Stats(monitor).loops, 1);
+}
+
+// A sink that sees each pass from 0 again: the frame that goes backwards
+// starts the pass, wherever the boundary was.
+static void TestBoundaryTimesStartOver()
+{
+    LoopMonitor monitor;
+    FrameClock clock;
+
+    clock.Pass(monitor, 0);
+    monitor.OnLoopBoundary(FRAMES_PER_PASS * FRAME);
+
+    // One frame held 5 ms too long.
+    clock.now += 5 * MS;
+    clock.Pass(monitor, 0);
+
+    LoopStats stats = Stats(monitor);
+    CHECK_EQ(stats.loops, 1);
+    CHECK_EQ(stats.gap.sum, 5 * MS);
+}
+
+// A boundary reported after its pass has begun is dropped, not matched to a
+// later frame.
+static void TestBoundaryLate()
+{
+    LoopMonitor monitor;
+    FrameClock clock;
+    const int64_t pass = FRAMES_PER_PASS * FRAME;
+
+    clock.Pass(monitor, 0);
+    clock.Present(monitor, pass);
+    clock.Present(monitor, pass + FRAME);
+
+    monitor.OnLoopBoundary(pass);
+
+    for (int i = 2; i < FRAMES_PER_PASS; i++)
+    {
+        clock.Present(monitor, pass + i * FRAME);
+    }
+
+    CHECK_EQ(Stats(monitor).loops, 0);
+
+    // The next one is seen again.
+    monitor.OnLoopBoundary(2 * pass);
+    clock.Pass(monitor, 2 * pass);
+    CHECK_EQ(Stats(monitor).loops, 1);
+}
+
+// Seeks the player does not report, backwards or forwards, are not loops.
+static void TestUnreportedSeeks()
+{
+    LoopMonitor monitor;
+    FrameClock clock;
+
+    clock.Pass(monitor, 0);
+    clock.Pass(monitor, 0);
+    clock.Pass(monitor, 50 * FRAME);
+
+    CHECK_EQ(Stats(monitor).loops, 0);
+}
+
+static void TestReset()
+{
+    LoopMonitor monitor;
+    FrameClock clock;
+
+    clock.Pass(monitor, 0);
+    monitor.OnLoopRestart(clock.now);
+    clock.Pass(monitor, 0);
+    CHECK_EQ(Stats(monitor).loops, 1);
+
+    monitor.Reset();
+
+    LoopStats stats = Stats(monitor);
+    CHECK_EQ(stats.loops, 0);
+    CHECK_EQ(stats.gap.count, 0);
+    CHECK_EQ(stats.restart.count, 0);
+
+    // Still measures after a reset.
+    monitor.OnLoopRestart(clock.now);
+    clock.Pass(monitor, 0);
+    CHECK_EQ(Stats(monitor).loops, 1);
+}
+
+int main()
+{
+    RUN_TEST(TestRestart);
+    RUN_TEST(TestBoundary);
+    RUN_TEST(TestBoundaryTolerance);
+    RUN_TEST(TestBoundaryTimesStartOver);
+    RUN_TEST(TestBoundaryLate);
+    RUN_TEST(TestUnreportedSeeks);
+    RUN_TEST(TestReset);
+    return TestResult();
+}
@@ -0,0 +1,95 @@
+//////////////////////////////////////////////////////////////////////////
+//
+// OutputSizePolicyTest.cpp: The output size each policy picks, with its
+// rounding and clamping.
+//
+//////////////////////////////////////////////////////////////////////////
+
+#include "TestCheck.h"
+#include "OutputSizePolicy.h"
+
+static void CheckSize(const OutputSizePolicy& policy, uint32_t srcWidth, uint32_t srcHeight,
+    uint32_t expectedWidth, uint32_t expectedHeight)
+{
+    uint32_t width = 0, height = 0;
+
+    policy.Apply(srcWidth, srcHeight, &width, &height);
+
+    CHECK_EQ(width, expectedWidth);
+    CHECK_EQ(height, expectedHeight);
+}
+
+// The source size is passed through untouched, odd or not.
+static void TestSource()
+{
+    const OutputSizePolicy policy = OutputSizePolicy::SourceSize();
+
+    CHECK_EQ(policy.mode, OutputSizePolicy::Source);
+    CheckSize(policy, 1920, 1080, 1920, 1080);
+    CheckSize(policy, 1279, 719, 1279, 719);
+}
+
+static void TestFixed()
+{
+    CheckSize(OutputSizePolicy::FixedSize(640, 360), 1920, 1080, 640, 360);
+
+    // Scaling up is allowed when asked for exactly.
+    CheckSize(OutputSizePolicy::FixedSize(3840, 2160), 1920, 1080, 3840, 2160);
+
+    // Rounded down to even, and at least 2 x 2.
+    CheckSize(OutputSizePolicy::FixedSize(641, 361), 1920, 1080, 640, 360);
+    CheckSize(OutputSizePolicy::FixedSize(1, 1), 1920, 1080, 2, 2);
+
+    // A zero side is no policy at all.
+    CHECK_EQ(OutputSizePolicy::FixedSize(0, 360).mode, OutputSizePolicy::Source);
+    CHECK_EQ(OutputSizePolicy::FixedSize(640, 0).mode, OutputSizePolicy::Source);
+}
+
+static void TestMaxDimension()
+{
+    // Landscape and portrait: the longer side becomes maxDimension.
+    CheckSize(OutputSizePolicy::MaxSize(640), 1920, 1080, 640, 360);
+    CheckSize(OutputSizePolicy::MaxSize(640), 1080, 1920, 360, 640);
+
+    // The shorter side is rounded to nearest, then down to even:
+    // 1080 * 500 / 1920 = 281.25.
+    CheckSize(OutputSizePolicy::MaxSize(500), 1920, 1080, 500, 280);
+
+    // An odd maxDimension is rounded down to even too.
+    CheckSize(OutputSizePolicy::MaxSize(641), 1920, 1080, 640, 360);
+
+    // Never scales up, and a source that fits is left exactly as it is.
+    CheckSize(OutputSizePolicy::MaxSize(1920), 1280, 720, 1280, 720);
+    CheckSize(OutputSizePolicy::MaxSize(640), 640, 640, 640, 640);
+    CheckSize(OutputSizePolicy::MaxSize(1920), 1279, 719, 1279, 719);
+
+    // One side over is enough to scale.
+    CheckSize(OutputSizePolicy::MaxSize(1000), 800, 1200, 666, 1000);
+
+    // Extreme aspect ratios clamp the short side to 2.
+    CheckSize(OutputSizePolicy::MaxSize(100), 4000, 2, 100, 2);
+
+    // Large sizes do not overflow the arithmetic.
+    CheckSize(OutputSizePolicy::MaxSize(1000), 0xFFFFFFFF, 0xFFFFFFFF, 1000, 1000);
+    CheckSize(OutputSizePolicy::MaxSize(1000), 0xFFFFFFFF, 0x7FFFFFFF, 1000, 500);
+
+    CHECK_EQ(OutputSizePolicy::MaxSize(0).mode, OutputSizePolicy::Source);
+}
+
+static void TestEquality()
+{
+    CHECK(OutputSizePolicy::SourceSize() == OutputSizePolicy());
+    CHECK(OutputSizePolicy::FixedSize(640, 360) == OutputSizePolicy::FixedSize(640, 360));
+    CHECK(OutputSizePolicy::FixedSize(640, 360) != OutputSizePolicy::FixedSize(360, 640));
+    CHECK(OutputSizePolicy::MaxSize(640) != OutputSizePolicy::MaxSize(720));
+    CHECK(OutputSizePolicy::MaxSize(640) != OutputSizePolicy::FixedSize(640, 640));
+}
+
+int main()
+{
+    RUN_TEST(TestSource);
+    RUN_TEST(TestFixed);
+    RUN_TEST(TestMaxDimension);
+    RUN_TEST(TestEquality);
+    return TestResult();
+}
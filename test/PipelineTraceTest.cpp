@@ -0,0 +1,185 @@
+//////////////////////////////////////////////////////////////////////////
+//
+// PipelineTraceTest.cpp: Trace rings, zones, and the Chrome Trace JSON
+// serializer.
+//
+//////////////////////////////////////////////////////////////////////////
+
+#include "TestCheck.h"
+#include "PipelineTrace.h"
+
+#include <atomic>
+#include <memory>
+#include <sstream>
+#include <thread>
+
+static const char *NAMES[] = { "Mixer", "Present", "Draw" };
+
+static void TestSerializer()
+{
+    std::vector<TraceEventRecord> events;
+    std::vector<std::string> threadNames;
+
+    TraceEventRecord late = { "Present", 2500, 1234567, 2 };
+    TraceEventRecord early = { "Say \"hi\"\\\n", 1000, 5, 1 };
+    events.push_back(late);
+    events.push_back(early);
+
+    threadNames.push_back("Scheduler");
+    threadNames.push_back("");
+
+    std::ostringstream out;
+    TraceRecorder::WriteChromeTrace(out, events, threadNames);
+
+    // Named threads get metadata; events are sorted by start and their
+    // times written in microseconds with three decimals.
+    const std::string expected =
+        "{\"displayTimeUnit\":\"ms\",\"traceEvents\":["
+        "\n{\"ph\":\"M\",\"pid\":1,\"tid\":1,\"name\":\"thread_name\",\"args\":{\"name\":\"Scheduler\"}},"
+        "\n{\"ph\":\"X\",\"pid\":1,\"tid\":1,\"name\":\"Say \\\"hi\\\"\\\\\\u000a\",\"ts\":1.000,\"dur\":0.005},"
+        "\n{\"ph\":\"X\",\"pid\":1,\"tid\":2,\"name\":\"Present\",\"ts\":2.500,\"dur\":1234.567}"
+        "\n]}\n";
+
+    CHECK(out.str() == expected);
+    if (out.str() != expected)
+    {
+        std::printf("%s", out.str().c_str());
+    }
+}
+
+static void TestEmptyTrace()
+{
+    std::ostringstream out;
+    TraceRecorder::WriteChromeTrace(out, std::vector<TraceEventRecord>(), std::vector<std::string>());
+
+    CHECK(out.str() == "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n]}\n");
+}
+
+static void TestRingOverwrite()
+{
+    std::unique_ptr<TraceRing> ring(new TraceRing(7));
+    std::vector<TraceEventRecord> events;
+
+    const int extra = 100;
+    for (int i = 0; i < (int)TRACE_RING_SIZE + extra; i++)
+    {
+        ring->Record(NAMES[i % 3], i, 1);
+    }
+
+    // Only the newest TRACE_RING_SIZE events, oldest first.
+    ring->CopyTo(&events);
+    CHECK_EQ(events.size(), TRACE_RING_SIZE);
+    CHECK_EQ(events.front().startNs, extra);
+    CHECK_EQ(events.back().startNs, (int)TRACE_RING_SIZE + extra - 1);
+    CHECK_EQ(events.front().tid, 7);
+
+    ring->Clear();
+    events.clear();
+    ring->CopyTo(&events);
+    CHECK_EQ(events.size(), 0);
+
+    ring->Record("After", 1, 2);
+    ring->CopyTo(&events);
+    CHECK_EQ(events.size(), 1);
+}
+
+static void TestCopyWhileRecording()
+{
+    // The writer records events whose fields agree with each other; a
+    // reader copying at the same time must never see a mixed-up event.
+    std::unique_ptr<TraceRing> ring(new TraceRing(1));
+    std::atomic<bool> bDone(false);
+    const int64_t count = 500000;
+
+    std::thread writer([&]
+    {
+        for (int64_t i = 0; i < count; i++)
+        {
+            ring->Record(NAMES[i % 3], i, i * 2);
+        }
+        bDone = true;
+    });
+
+    uint64_t copies = 0;
+    uint64_t torn = 0;
+    uint64_t unordered = 0;
+
+    while (!bDone || copies == 0)
+    {
+        std::vector<TraceEventRecord> events;
+        ring->CopyTo(&events);
+
+        for (size_t i = 0; i < events.size(); i++)
+        {
+            const TraceEventRecord& ev = events[i];
+
+            if (ev.durationNs != ev.startNs * 2 || ev.name != NAMES[ev.startNs % 3])
+            {
+                torn++;
+            }
+            if (i > 0 && ev.startNs <= events[i - 1].startNs)
+            {
+                unordered++;
+            }
+        }
+        copies++;
+    }
+
+    writer.join();
+
+    CHECK_EQ(torn, 0);
+    CHECK_EQ(unordered, 0);
+}
+
+static void TestZones()
+{
+    TraceRecorder::Clear();
+
+    // Disabled: nothing is recorded.
+    TraceRecorder::SetEnabled(false);
+    {
+        TraceZone zone("Off");
+    }
+
+    TraceRecorder::SetEnabled(true);
+    TraceRecorder::SetThreadName("Main");
+    {
+        TraceZone zone("On");
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    std::thread other([]
+    {
+        TraceRecorder::SetThreadName("Other");
+        TraceZone zone("Elsewhere");
+    });
+    other.join();
+
+    TraceRecorder::SetEnabled(false);
+
+    std::ostringstream out;
+    TraceRecorder::WriteChromeTrace(out);
+    const std::string json = out.str();
+
+    CHECK(json.find("\"Off\"") == std::string::npos);
+    CHECK(json.find("\"On\"") != std::string::npos);
+    CHECK(json.find("\"Elsewhere\"") != std::string::npos);
+    CHECK(json.find("{\"name\":\"Main\"}") != std::string::npos);
+    CHECK(json.find("{\"name\":\"Other\"}") != std::string::npos);
+
+    // Each thread has its own ring: this one only holds "On".
+    std::vector<TraceEventRecord> events;
+    TraceRecorder::ThreadRing()->CopyTo(&events);
+    CHECK_EQ(events.size(), 1);
+    CHECK(events.size() == 1 && events[0].durationNs >= 1000000);
+}
+
+int main()
+{
+    RUN_TEST(TestSerializer);
+    RUN_TEST(TestEmptyTrace);
+    RUN_TEST(TestRingOverwrite);
+    RUN_TEST(TestCopyWhileRecording);
+    RUN_TEST(TestZones);
+    return TestResult();
+}
@@ -0,0 +1,299 @@
+//////////////////////////////////////////////////////////////////////////
+//
+// PlaybackSyncTest.cpp: Clock skew arithmetic, and PlaybackSyncController
+// keeping a simulated player with a drifting clock in step with a
+// reference.
+//
+//////////////////////////////////////////////////////////////////////////
+
+#include "TestCheck.h"
+#include "PlaybackSync.h"
+
+#include <math.h>
+
+const int64_t MS = 10000;
+const int64_t SECOND = 10000000;
+
+// Updates at 60 Hz, as the player's update() would make them.
+const int64_t UPDATE_INTERVAL = SECOND / 60;
+
+
+//-----------------------------------------------------------------------------
+// SimulatedPair
+//
+// A reference clock running at exactly 1.0 and a member whose clock runs
+// driftPpm fast, times whatever rate the controller sets. Measurements
+// carry deterministic jitter, and seeks land seekLatency updates after
+// they are asked for, as a real session restarts late.
+//-----------------------------------------------------------------------------
+
+struct SimulatedPair
+{
+    SimulatedPair(double driftPpm, int64_t offset, int64_t jitter, int seekLatency) :
+        m_Drift(driftPpm * 1e-6),
+        m_Jitter(jitter),
+        m_SeekLatency(seekLatency),
+        m_Now(0),
+        m_Reference(0.0),
+        m_Member((double)offset),
+        m_Nudge(0.0),
+        m_PendingSeek(-1),
+        m_PendingBy(0),
+        m_Random(12345),
+        m_MaxNudge(0.0),
+        m_Corrections(0)
+    {
+    }
+
+    // Advances one update and returns what the controller asked for.
+    SyncCorrection Step(PlaybackSyncController& controller)
+    {
+        m_Now += UPDATE_INTERVAL;
+        m_Reference += (double)UPDATE_INTERVAL;
+        m_Member += (double)UPDATE_INTERVAL * (1.0 + m_Drift) * (1.0 + m_Nudge);
+
+        if (m_PendingSeek >= 0 && --m_PendingSeek < 0)
+        {
+            m_Member += (double)m_PendingBy;
+        }
+
+        SyncCorrection correction = controller.Update(Error() + NextJitter(), m_Now);
+
+        if (correction.action == SyncNudge)
+        {
+            m_Nudge = correction.nudge;
+            m_Corrections++;
+        }
+        else if (correction.action == SyncSeek)
+        {
+            m_Nudge = 0.0;
+            m_PendingSeek = m_SeekLatency;
+            m_PendingBy = correction.seekBy;
+            m_Corrections++;
+        }
+
+        if (fabs(m_Nudge) > m_MaxNudge)
+        {
+            m_MaxNudge = fabs(m_Nudge);
+        }
+        return correction;
+    }
+
+    // Runs for the given time; returns the largest error in its last tail.
+    int64_t Run(PlaybackSyncController& controller, int64_t duration, int64_t tail)
+    {
+        int64_t worst = 0;
+
+        for (int64_t t = 0; t < duration; t += UPDATE_INTERVAL)
+        {
+            Step(controller);
+
+            const int64_t error = (Error() < 0) ? -Error() : Error();
+
+            if (t >= duration - tail && error > worst)
+            {
+                worst = error;
+            }
+        }
+        return worst;
+    }
+
+    // True error, without jitter.
+    int64_t Error() const { return (int64_t)(m_Member - m_Reference); }
+
+    int64_t NextJitter()
+    {
+        if (m_Jitter == 0)
+        {
+            return 0;
+        }
+        m_Random = m_Random * 6364136223846793005ULL + 1442695040888963407ULL;
+        return (int64_t)((m_Random >> 33) % (uint64_t)(2 * m_Jitter + 1)) - m_Jitter;
+    }
+
+    double      m_Drift;
+    int64_t     m_Jitter;
+    int         m_SeekLatency;
+    int64_t     m_Now;
+    double      m_Reference;
+    double      m_Member;
+    double      m_Nudge;
+    int         m_PendingSeek;
+    int64_t     m_PendingBy;
+    uint64_t    m_Random;
+    double      m_MaxNudge;
+    uint64_t    m_Corrections;
+};
+
+
+static void TestSkew()
+{
+    // Read at the same moment: the difference in presentation time.
+    ClockSample reference = { 10 * SECOND, 100 * SECOND, 1.0 };
+    ClockSample member = { 10 * SECOND + 5 * MS, 100 * SECOND, 1.0 };
+    CHECK_EQ(PlaybackSync::Skew(member, reference), 5 * MS);
+    CHECK_EQ(PlaybackSync::Skew(reference, member), -5 * MS);
+
+    // Member read a second earlier: projected forward at its rate.
+    member.presentationTime = 9 * SECOND;
+    member.systemTime = 99 * SECOND;
+    CHECK_EQ(PlaybackSync::Skew(member, reference), 0);
+
+    member.rate = 2.0;
+    CHECK_EQ(PlaybackSync::Skew(member, reference), SECOND);
+
+    // Paused: the member's time does not advance.
+    member.rate = 0.0;
+    CHECK_EQ(PlaybackSync::Skew(member, reference), -SECOND);
+}
+
+static void TestWrapSkew()
+{
+    const int64_t duration = 10 * SECOND;
+
+    CHECK_EQ(PlaybackSync::WrapSkew(2 * SECOND, duration), 2 * SECOND);
+    CHECK_EQ(PlaybackSync::WrapSkew(-2 * SECOND, duration), -2 * SECOND);
+
+    // Wrapped round the end of the loop: just behind or ahead, not a pass off.
+    CHECK_EQ(PlaybackSync::WrapSkew(9 * SECOND, duration), -SECOND);
+    CHECK_EQ(PlaybackSync::WrapSkew(-9 * SECOND, duration), SECOND);
+    CHECK_EQ(PlaybackSync::WrapSkew(23 * SECOND, duration), 3 * SECOND);
+
+    // Half a pass is ahead, not behind.
+    CHECK_EQ(PlaybackSync::WrapSkew(5 * SECOND, duration), 5 * SECOND);
+    CHECK_EQ(PlaybackSync::WrapSkew(-5 * SECOND, duration), 5 * SECOND);
+
+    // Not looping: left alone.
+    CHECK_EQ(PlaybackSync::WrapSkew(23 * SECOND, 0), 23 * SECOND);
+}
+
+// No skew and no drift: nothing to do.
+static void TestInSync()
+{
+    PlaybackSyncController controller;
+    SimulatedPair pair(0.0, 0, 0, 0);
+
+    CHECK_EQ(pair.Run(controller, 30 * SECOND, 30 * SECOND), 0);
+    CHECK_EQ(pair.m_Corrections, 0);
+}
+
+// A clock that drifts is pulled in with rate nudges alone, and the nudge
+// it settles on cancels the drift.
+static void TestDrift()
+{
+    const double drifts[] = { 100.0, -300.0, 1000.0 };
+
+    for (int i = 0; i < 3; i++)
+    {
+        PlaybackSyncController controller;
+        SimulatedPair pair(drifts[i], 50 * MS, 2000, 0);
+
+        const int64_t worst = pair.Run(controller, 120 * SECOND, 10 * SECOND);
+
+        SyncStats stats;
+        controller.GetStats(&stats);
+
+        CHECK(worst < MS);
+        CHECK_EQ(stats.seeks, 0);
+        CHECK(stats.nudges > 0);
+
+        // The settled nudge is within a couple of steps of the drift.
+        CHECK_NEAR(controller.Nudge(), -drifts[i] * 1e-6, 0.0002);
+
+        // The rate is set rarely compared to how often errors are measured.
+        CHECK(stats.nudges * 10 < stats.updates);
+
+        std::printf("    %+.0f ppm: worst %.3f ms in the last 10 s, %llu rate changes, nudge %+.4f\n",
+            drifts[i], worst / (double)MS, (unsigned long long)stats.nudges, controller.Nudge());
+    }
+}
+
+// An error past the threshold is seeked away once, the seek landing late;
+// errors during the settle time do not trigger another.
+static void TestLargeOffset()
+{
+    PlaybackSyncController controller;
+    SimulatedPair pair(50.0, 4 * SECOND, 2000, 6);
+
+    SyncCorrection first = pair.Step(controller);
+    CHECK_EQ(first.action, SyncSeek);
+    CHECK_NEAR(first.seekBy, -pair.Error(), 2000);
+
+    const int64_t worst = pair.Run(controller, 120 * SECOND, 10 * SECOND);
+
+    SyncStats stats;
+    controller.GetStats(&stats);
+
+    CHECK_EQ(stats.seeks, 1);
+    CHECK(worst < MS);
+}
+
+// The rate change never exceeds its bound, however large the error below
+// the seek threshold, or the drift.
+static void TestNudgeBounded()
+{
+    SyncTuning tuning;
+    PlaybackSyncController controller(tuning);
+    SimulatedPair pair(20000.0, 200 * MS, 0, 0);
+
+    pair.Run(controller, 30 * SECOND, 0);
+
+    CHECK(pair.m_MaxNudge <= tuning.maxNudge + 1e-9);
+}
+
+// Measurement jitter alone moves the rate little and seldom.
+static void TestJitterOnly()
+{
+    PlaybackSyncController controller;
+    SimulatedPair pair(0.0, 0, 20000, 0);
+
+    pair.Run(controller, 60 * SECOND, 0);
+
+    SyncStats stats;
+    controller.GetStats(&stats);
+
+    CHECK(pair.m_MaxNudge <= 0.002);
+    CHECK(stats.nudges * 10 < stats.updates);
+    CHECK_EQ(stats.seeks, 0);
+}
+
+static void TestReset()
+{
+    PlaybackSyncController controller;
+    SimulatedPair pair(500.0, 100 * MS, 0, 0);
+
+    pair.Run(controller, 10 * SECOND, 0);
+    CHECK(controller.Nudge() != 0.0);
+
+    SyncStats stats;
+    controller.GetStats(&stats);
+    CHECK(stats.error.count > 0);
+
+    controller.ResetStats();
+    controller.GetStats(&stats);
+    CHECK_EQ(stats.updates, 0);
+    CHECK_EQ(stats.error.count, 0);
+    CHECK(controller.Nudge() != 0.0);
+
+    controller.Reset();
+    CHECK(controller.Nudge() == 0.0);
+
+    // Settle ignores errors for the settle time, even past the threshold.
+    SyncTuning tuning;
+    controller.Settle(0);
+    CHECK_EQ(controller.Update(10 * SECOND, tuning.settleTime - 1).action, SyncNone);
+    CHECK_EQ(controller.Update(10 * SECOND, tuning.settleTime).action, SyncSeek);
+}
+
+int main()
+{
+    RUN_TEST(TestSkew);
+    RUN_TEST(TestWrapSkew);
+    RUN_TEST(TestInSync);
+    RUN_TEST(TestDrift);
+    RUN_TEST(TestLargeOffset);
+    RUN_TEST(TestNudgeBounded);
+    RUN_TEST(TestJitterOnly);
+    RUN_TEST(TestReset);
+    return TestResult();
+}
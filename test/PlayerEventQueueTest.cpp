@@ -0,0 +1,189 @@
+//////////////////////////////////////////////////////////////////////////
+//
+// PlayerEventQueueTest.cpp: PlayerEventQueue ordering, batching and
+// overflow, and Media Foundation callbacks posting from several threads
+// while the app thread drains.
+//
+//////////////////////////////////////////////////////////////////////////
+
+#include "TestCheck.h"
+#include "PlayerEventQueue.h"
+
+#include <thread>
+#include <vector>
+
+const int PRODUCERS = 4;
+const int EVENTS_PER_PRODUCER = 50000;
+
+// Events are opaque to the queue; the tests store integers in the pointer.
+static void* ToEvent(intptr_t value)
+{
+    return (void*)value;
+}
+
+static intptr_t FromEvent(const PlayerEvent& ev)
+{
+    return (intptr_t)ev.pEvent;
+}
+
+static void TestOrder()
+{
+    PlayerEventQueue queue;
+
+    CHECK_EQ(queue.Pending(), 0);
+
+    for (int i = 1; i <= 10; i++)
+    {
+        CHECK(queue.Post(ToEvent(i), (uint32_t)(100 + i)));
+    }
+    CHECK_EQ(queue.Pending(), 10);
+
+    int next = 1;
+    size_t drained = queue.Drain([&](const PlayerEvent& ev)
+    {
+        CHECK_EQ(FromEvent(ev), next);
+        CHECK_EQ(ev.type, 100 + next);
+        next++;
+    });
+
+    CHECK_EQ(drained, 10);
+    CHECK_EQ(queue.Pending(), 0);
+    CHECK_EQ(queue.Posted(), 10);
+    CHECK_EQ(queue.Drained(), 10);
+    CHECK_EQ(queue.Dropped(), 0);
+
+    // Nothing pending: the handler is not called.
+    CHECK_EQ(queue.Drain([&](const PlayerEvent&) { CHECK(false); }), 0);
+}
+
+// Events a handler posts (a state change raising another event, say) wait
+// for the next Drain, so one Drain cannot loop forever.
+static void TestPostFromHandler()
+{
+    PlayerEventQueue queue;
+
+    queue.Post(ToEvent(1), 0);
+    queue.Post(ToEvent(2), 0);
+
+    size_t drained = queue.Drain([&](const PlayerEvent& ev)
+    {
+        queue.Post(ToEvent(FromEvent(ev) + 10), 0);
+    });
+
+    CHECK_EQ(drained, 2);
+    CHECK_EQ(queue.Pending(), 2);
+
+    std::vector<intptr_t> seen;
+    queue.Drain([&](const PlayerEvent& ev) { seen.push_back(FromEvent(ev)); });
+
+    CHECK_EQ(seen.size(), 2);
+    CHECK_EQ(seen[0], 11);
+    CHECK_EQ(seen[1], 12);
+}
+
+// A full ring refuses the event and counts it; the caller still owns it.
+static void TestOverflow()
+{
+    PlayerEventQueue queue;
+
+    for (size_t i = 0; i < PLAYER_EVENT_QUEUE_SIZE; i++)
+    {
+        CHECK(queue.Post(ToEvent((intptr_t)i + 1), 0));
+    }
+
+    CHECK(!queue.Post(ToEvent(-1), 0));
+    CHECK(!queue.Post(ToEvent(-2), 0));
+    CHECK_EQ(queue.Posted(), PLAYER_EVENT_QUEUE_SIZE);
+    CHECK_EQ(queue.Dropped(), 2);
+
+    intptr_t next = 1;
+    queue.Drain([&](const PlayerEvent& ev)
+    {
+        CHECK_EQ(FromEvent(ev), next);
+        next++;
+    });
+    CHECK_EQ(next, (intptr_t)PLAYER_EVENT_QUEUE_SIZE + 1);
+
+    // Room again once drained.
+    CHECK(queue.Post(ToEvent(1), 0));
+    CHECK_EQ(queue.Pending(), 1);
+}
+
+// Each producer's events arrive in its order, none are lost or duplicated,
+// and the counters add up. Producers retry when the ring is full, as a
+// caller that keeps the event would.
+static void TestProducers()
+{
+    PlayerEventQueue queue;
+    std::vector<std::thread> producers;
+    std::atomic<int> finished(0);
+
+    for (int p = 0; p < PRODUCERS; p++)
+    {
+        producers.push_back(std::thread([&queue, &finished, p]
+        {
+            for (int k = 0; k < EVENTS_PER_PRODUCER; k++)
+            {
+                while (!queue.Post(ToEvent((intptr_t)k + 1), (uint32_t)p))
+                {
+                    std::this_thread::yield();
+                }
+            }
+            finished.fetch_add(1);
+        }));
+    }
+
+    std::vector<intptr_t> last(PRODUCERS, 0);
+    uint64_t received = 0;
+    uint64_t outOfOrder = 0;
+    uint64_t batches = 0;
+
+    auto handler = [&](const PlayerEvent& ev)
+    {
+        if (ev.type >= (uint32_t)PRODUCERS || FromEvent(ev) != last[ev.type] + 1)
+        {
+            outOfOrder++;
+        }
+        else
+        {
+            last[ev.type] = FromEvent(ev);
+        }
+        received++;
+    };
+
+    while (finished.load() < PRODUCERS || queue.Pending() > 0)
+    {
+        if (queue.Drain(handler) > 0)
+        {
+            batches++;
+        }
+    }
+
+    for (size_t i = 0; i < producers.size(); i++)
+    {
+        producers[i].join();
+    }
+    queue.Drain(handler);
+
+    CHECK_EQ(outOfOrder, 0);
+    CHECK_EQ(received, (uint64_t)PRODUCERS * EVENTS_PER_PRODUCER);
+    CHECK_EQ(queue.Posted(), received);
+    CHECK_EQ(queue.Drained(), received);
+
+    for (int p = 0; p < PRODUCERS; p++)
+    {
+        CHECK_EQ(last[p], EVENTS_PER_PRODUCER);
+    }
+
+    std::printf("    %llu events in %llu batches, %llu full-ring retries\n",
+        (unsigned long long)received, (unsigned long long)batches, (unsigned long long)queue.Dropped());
+}
+
+int main()
+{
+    RUN_TEST(TestOrder);
+    RUN_TEST(TestPostFromHandler);
+    RUN_TEST(TestOverflow);
+    RUN_TEST(TestProducers);
+    return TestResult();
+}
@@ -0,0 +1,178 @@
+//////////////////////////////////////////////////////////////////////////
+//
+// PlaylistOrderTest.cpp: PlaylistOrder keys staying with their entries as
+// others are inserted and removed, and the order Next walks them in.
+//
+//////////////////////////////////////////////////////////////////////////
+
+#include "TestCheck.h"
+#include "PlaylistOrder.h"
+
+static void TestInsert()
+{
+    PlaylistOrder order;
+
+    CHECK_EQ(order.Size(), 0);
+
+    const uint64_t b = order.Insert(0, L"b");
+    const uint64_t a = order.Insert(0, L"a");
+    const uint64_t d = order.Insert(2, L"d");
+    const uint64_t c = order.Insert(2, L"c");
+
+    // Past the end is clamped to an append.
+    const uint64_t e = order.Insert(100, L"e");
+
+    CHECK_EQ(order.Size(), 5);
+    CHECK(order.At(0).url == L"a");
+    CHECK(order.At(1).url == L"b");
+    CHECK(order.At(2).url == L"c");
+    CHECK(order.At(3).url == L"d");
+    CHECK(order.At(4).url == L"e");
+
+    CHECK_EQ(order.At(0).key, a);
+    CHECK_EQ(order.At(1).key, b);
+    CHECK_EQ(order.At(2).key, c);
+    CHECK_EQ(order.At(3).key, d);
+    CHECK_EQ(order.At(4).key, e);
+
+    // Keys are unique and never 0.
+    for (size_t i = 0; i < order.Size(); i++)
+    {
+        CHECK(order.At(i).key != 0);
+
+        for (size_t j = i + 1; j < order.Size(); j++)
+        {
+            CHECK(order.At(i).key != order.At(j).key);
+        }
+    }
+}
+
+// An entry is found by key wherever it has moved to, and not once removed.
+static void TestFind()
+{
+    PlaylistOrder order;
+
+    const uint64_t a = order.Insert(0, L"a");
+    const uint64_t b = order.Insert(1, L"b");
+    const uint64_t c = order.Insert(2, L"c");
+
+    size_t index = 99;
+    CHECK(order.Find(c, &index));
+    CHECK_EQ(index, 2);
+
+    order.Insert(0, L"first");
+    CHECK(order.Find(c, &index));
+    CHECK_EQ(index, 3);
+
+    CHECK(order.Remove(2));
+    CHECK(!order.Find(b, &index));
+    CHECK(order.Find(a, &index));
+    CHECK_EQ(index, 1);
+    CHECK(order.Find(c, &index));
+    CHECK_EQ(index, 2);
+
+    CHECK(!order.Find(0, &index));
+}
+
+static void TestRemove()
+{
+    PlaylistOrder order;
+
+    order.Insert(0, L"a");
+    order.Insert(1, L"b");
+
+    CHECK(!order.Remove(2));
+    CHECK_EQ(order.Size(), 2);
+
+    CHECK(order.Remove(0));
+    CHECK_EQ(order.Size(), 1);
+    CHECK(order.At(0).url == L"b");
+
+    CHECK(order.Remove(0));
+    CHECK_EQ(order.Size(), 0);
+    CHECK(!order.Remove(0));
+}
+
+// Keys of removed and cleared entries are never handed out again, so a
+// stale key cannot match a new entry.
+static void TestKeysNotReused()
+{
+    PlaylistOrder order;
+
+    const uint64_t a = order.Insert(0, L"a");
+    const uint64_t b = order.Insert(1, L"b");
+
+    order.Remove(1);
+    const uint64_t c = order.Insert(1, L"b");
+    CHECK(c != a && c != b);
+
+    order.Clear();
+    CHECK_EQ(order.Size(), 0);
+
+    size_t index = 0;
+    CHECK(!order.Find(a, &index));
+
+    const uint64_t d = order.Insert(0, L"a");
+    CHECK(d != a && d != b && d != c);
+    CHECK(!order.Find(a, &index));
+}
+
+static void TestNext()
+{
+    PlaylistOrder order;
+
+    const uint64_t a = order.Insert(0, L"a");
+    const uint64_t b = order.Insert(1, L"b");
+    const uint64_t c = order.Insert(2, L"c");
+
+    uint64_t next = 0;
+
+    CHECK(order.Next(a, false, &next));
+    CHECK_EQ(next, b);
+    CHECK(order.Next(b, false, &next));
+    CHECK_EQ(next, c);
+
+    // The end, unless looping.
+    next = 0;
+    CHECK(!order.Next(c, false, &next));
+    CHECK_EQ(next, 0);
+    CHECK(order.Next(c, true, &next));
+    CHECK_EQ(next, a);
+
+    // Follows edits: b removed, a new entry after a.
+    order.Remove(1);
+    const uint64_t d = order.Insert(1, L"d");
+    CHECK(order.Next(a, false, &next));
+    CHECK_EQ(next, d);
+
+    // A removed key has no next, looping or not.
+    CHECK(!order.Next(b, false, &next));
+    CHECK(!order.Next(b, true, &next));
+}
+
+// A single entry loops to itself, as a gapless loop of one clip does.
+static void TestNextSingle()
+{
+    PlaylistOrder order;
+
+    const uint64_t a = order.Insert(0, L"a");
+    uint64_t next = 0;
+
+    CHECK(!order.Next(a, false, &next));
+    CHECK(order.Next(a, true, &next));
+    CHECK_EQ(next, a);
+
+    order.Clear();
+    CHECK(!order.Next(a, true, &next));
+}
+
+int main()
+{
+    RUN_TEST(TestInsert);
+    RUN_TEST(TestFind);
+    RUN_TEST(TestRemove);
+    RUN_TEST(TestKeysNotReused);
+    RUN_TEST(TestNext);
+    RUN_TEST(TestNextSingle);
+    return TestResult();
+}
@@ -0,0 +1,254 @@
+//////////////////////////////////////////////////////////////////////////
+//
+// ScheduleEngineTest.cpp: ScheduleEngine driven by a simulated clock, and
+// on its own worker thread.
+//
+//////////////////////////////////////////////////////////////////////////
+
+#include "TestCheck.h"
+#include "ScheduleEngine.h"
+
+#include <mutex>
+#include <vector>
+
+// 25 fps.
+const int64_t FRAME = 400000;
+
+struct SimClock : ScheduleClock
+{
+    SimClock() : now(0) {}
+
+    bool GetCorrelatedTime(int64_t *phnsClockTime, int64_t *phnsSystemTime)
+    {
+        *phnsClockTime = now;
+        *phnsSystemTime = now;
+        return true;
+    }
+
+    int64_t now;
+};
+
+// Frames are small integers cast to pointers.
+struct RecordingSink : ScheduleSink
+{
+    RecordingSink() : released(0) {}
+
+    bool PresentFrame(void *pFrame, int64_t)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        presented.push_back((intptr_t)pFrame);
+        return true;
+    }
+
+    void ReleaseFrame(void *)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        released++;
+    }
+
+    size_t Presented()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return presented.size();
+    }
+
+    std::mutex              mutex;
+    std::vector<intptr_t>   presented;
+    int                     released;
+};
+
+static ScheduledFrame Frame(intptr_t id, int64_t hnsTime)
+{
+    ScheduledFrame frame;
+    frame.pFrame = (void*)id;
+    frame.hnsTime = hnsTime;
+    frame.bHasTime = true;
+    return frame;
+}
+
+static void TestDecide()
+{
+    int64_t hnsWait = 0;
+
+    // On time from 1/4 frame late to 3/4 frame early.
+    CHECK(ScheduleEngine::Decide(0, FRAME, 1.0f, &hnsWait) == ScheduleEngine::PresentOnTime);
+    CHECK(ScheduleEngine::Decide(-FRAME / 4, FRAME, 1.0f, &hnsWait) == ScheduleEngine::PresentOnTime);
+    CHECK(ScheduleEngine::Decide(3 * FRAME / 4, FRAME, 1.0f, &hnsWait) == ScheduleEngine::PresentOnTime);
+    CHECK(ScheduleEngine::Decide(-FRAME / 4 - 1, FRAME, 1.0f, &hnsWait) == ScheduleEngine::PresentLate);
+
+    // Early samples wait until they are 3/4 frame ahead.
+    CHECK(ScheduleEngine::Decide(FRAME, FRAME, 1.0f, &hnsWait) == ScheduleEngine::Wait);
+    CHECK_EQ(hnsWait, FRAME / 4);
+
+    // At 2x the clock runs twice as fast, so the system-clock wait halves.
+    CHECK(ScheduleEngine::Decide(FRAME, FRAME, 2.0f, &hnsWait) == ScheduleEngine::Wait);
+    CHECK_EQ(hnsWait, FRAME / 8);
+
+    // In reverse, a sample behind the clock is early.
+    CHECK(ScheduleEngine::Decide(-FRAME, FRAME, -1.0f, &hnsWait) == ScheduleEngine::Wait);
+    CHECK(ScheduleEngine::Decide(FRAME, FRAME, -1.0f, &hnsWait) == ScheduleEngine::PresentLate);
+}
+
+static void TestSimulatedClock()
+{
+    SimClock clock;
+    RecordingSink sink;
+    ScheduleEngine engine;
+    int64_t hnsWait = 0;
+
+    engine.SetClock(&clock);
+    engine.SetSink(&sink);
+    engine.SetFrameInterval(FRAME);
+
+    for (intptr_t i = 0; i < 4; i++)
+    {
+        CHECK(engine.ScheduleSample(Frame(i, i * FRAME)));
+    }
+    CHECK_EQ(engine.QueueDepth(), 4);
+
+    // Frame 0 is due; frame 1 is a whole frame early.
+    CHECK(engine.ProcessSamplesInQueue(&hnsWait));
+    CHECK_EQ(sink.presented.size(), 1);
+    CHECK_EQ(hnsWait, FRAME / 4);
+    CHECK_EQ(engine.QueueDepth(), 3);
+
+    clock.now = FRAME;
+    CHECK(engine.ProcessSamplesInQueue(&hnsWait));
+    CHECK_EQ(sink.presented.size(), 2);
+    CHECK_EQ(sink.presented[1], 1);
+
+    // A flush releases the rest without presenting them.
+    engine.Flush();
+    CHECK_EQ(sink.presented.size(), 2);
+    CHECK_EQ(sink.released, 4);
+    CHECK_EQ(engine.QueueDepth(), 0);
+
+    CHECK(engine.ProcessSamplesInQueue(&hnsWait));
+    CHECK_EQ(hnsWait, SCHEDULE_WAIT_INFINITE);
+}
+
+static void TestUntimedSamples()
+{
+    SimClock clock;
+    RecordingSink sink;
+    ScheduleEngine engine;
+    int64_t hnsWait = 0;
+
+    engine.SetClock(&clock);
+    engine.SetSink(&sink);
+    engine.SetFrameInterval(FRAME);
+
+    // No time stamp: presented at once, whatever the clock says.
+    ScheduledFrame frame = Frame(7, 100 * FRAME);
+    frame.bHasTime = false;
+    CHECK(engine.ScheduleSample(frame));
+
+    CHECK(engine.ProcessSamplesInQueue(&hnsWait));
+    CHECK_EQ(sink.presented.size(), 1);
+    CHECK_EQ(hnsWait, SCHEDULE_WAIT_INFINITE);
+}
+
+static void TestQueueFull()
+{
+    RecordingSink sink;
+    ScheduleEngine engine;
+
+    engine.SetSink(&sink);
+
+    for (size_t i = 0; i < SCHEDULER_QUEUE_SIZE; i++)
+    {
+        CHECK(engine.ScheduleSample(Frame((intptr_t)i, 0)));
+    }
+    CHECK(!engine.ScheduleSample(Frame(99, 0)));
+
+    engine.Flush();
+    CHECK_EQ(sink.released, (int)SCHEDULER_QUEUE_SIZE);
+}
+
+static void TestWorkerThread()
+{
+    RecordingSink sink;
+    ScheduleEngine engine;
+    const intptr_t count = 1000;
+
+    // Without a clock every sample is presented as soon as it is queued.
+    engine.SetSink(&sink);
+    engine.SetFrameInterval(FRAME);
+
+    CHECK(!engine.IsStarted());
+    CHECK(engine.Start());
+    CHECK(!engine.Start());
+    CHECK(engine.IsStarted());
+    CHECK(engine.IsRunning());
+
+    for (intptr_t i = 0; i < count; )
+    {
+        if (engine.ScheduleSample(Frame(i, 0)))
+        {
+            i++;
+        }
+        else
+        {
+            std::this_thread::yield();
+        }
+
+        // Setters are called from the presenter's thread while the worker
+        // reads them.
+        engine.SetFrameInterval(FRAME + (i & 1));
+    }
+
+    while (sink.Presented() < (size_t)count)
+    {
+        std::this_thread::yield();
+    }
+
+    engine.Stop();
+    CHECK(!engine.IsStarted());
+    CHECK(!engine.IsRunning());
+
+    CHECK_EQ(sink.presented.size(), count);
+    CHECK_EQ(sink.released, count);
+
+    bool bInOrder = true;
+    for (intptr_t i = 0; i < count; i++)
+    {
+        bInOrder = bInOrder && (sink.presented[i] == i);
+    }
+    CHECK(bInOrder);
+}
+
+static void TestFlushWhileRunning()
+{
+    SimClock clock;
+    RecordingSink sink;
+    ScheduleEngine engine;
+
+    // Every sample is far in the future, so the worker holds them all.
+    engine.SetClock(&clock);
+    engine.SetSink(&sink);
+    engine.SetFrameInterval(FRAME);
+    CHECK(engine.Start());
+
+    for (intptr_t i = 0; i < 4; i++)
+    {
+        CHECK(engine.ScheduleSample(Frame(i, 1000 * FRAME)));
+    }
+
+    engine.Flush();
+    CHECK_EQ(engine.QueueDepth(), 0);
+    CHECK_EQ(sink.released, 4);
+    CHECK_EQ(sink.presented.size(), 0);
+
+    engine.Stop();
+}
+
+int main()
+{
+    RUN_TEST(TestDecide);
+    RUN_TEST(TestSimulatedClock);
+    RUN_TEST(TestUntimedSamples);
+    RUN_TEST(TestQueueFull);
+    RUN_TEST(TestWorkerThread);
+    RUN_TEST(TestFlushWhileRunning);
+    return TestResult();
+}
@@ -0,0 +1,228 @@
+//////////////////////////////////////////////////////////////////////////
+//
+// SeekMonitorTest.cpp: Which decoded frames a seek discards, when it
+// completes, how it is counted (landed, missed, overshot or cancelled),
+// and its stats.
+//
+//////////////////////////////////////////////////////////////////////////
+
+#include "TestCheck.h"
+#include "SeekMonitor.h"
+
+const int64_t MS = 10000;
+const int64_t FRAME = 333333;   // 30 fps.
+
+// Decodes frames first..last; returns how many were discarded.
+static int Decode(SeekMonitor& monitor, int first, int last)
+{
+    int discarded = 0;
+
+    for (int frame = first; frame <= last; frame++)
+    {
+        if (monitor.OnFrameDecoded(frame * FRAME, FRAME))
+        {
+            discarded++;
+        }
+    }
+    return discarded;
+}
+
+// From the keyframe, every frame before the target is discarded and the
+// target is the first passed on; presenting it completes the seek.
+static void TestLands()
+{
+    SeekMonitor monitor;
+    SeekStats stats;
+
+    CHECK(!monitor.IsPending());
+
+    monitor.OnSeekRequested(10 * FRAME, 0, FRAME, 0);
+    CHECK(monitor.IsPending());
+
+    // Frames still queued before the clock jumps are not this seek's.
+    CHECK(!monitor.OnFrameDecoded(50 * FRAME, FRAME));
+
+    monitor.OnClockSeek();
+    CHECK_EQ(Decode(monitor, 0, 9), 10);
+    CHECK(!monitor.OnFrameDecoded(10 * FRAME, FRAME));
+    CHECK(!monitor.OnFrameDecoded(11 * FRAME, FRAME));
+    CHECK(monitor.IsPending());
+
+    // A frame from before the flush being presented late does not count.
+    monitor.OnFramePresented(5 * FRAME, 20 * MS);
+    CHECK(monitor.IsPending());
+
+    monitor.OnFramePresented(10 * FRAME, 40 * MS);
+    CHECK(!monitor.IsPending());
+
+    monitor.GetStats(&stats);
+    CHECK_EQ(stats.seeks, 1);
+    CHECK_EQ(stats.missed, 0);
+    CHECK_EQ(stats.overshot, 0);
+    CHECK_EQ(stats.cancelled, 0);
+    CHECK_EQ(stats.lastLatency, 40 * MS);
+    CHECK_EQ(stats.lastDiscarded, 10);
+    CHECK_EQ(stats.lastKeyframeDistance, 10 * FRAME);
+    CHECK_EQ(stats.latency.count, 1);
+    CHECK_EQ(stats.discarded.count, 1);
+
+    // Idle again: nothing is discarded.
+    CHECK(!monitor.OnFrameDecoded(0, FRAME));
+}
+
+// A target within half a frame of a frame's start selects that frame, so
+// rounding either way does not skip it.
+static void TestHalfFrame()
+{
+    const int64_t targets[] = { 10 * FRAME - FRAME / 2 + 1, 10 * FRAME - 50, 10 * FRAME, 10 * FRAME + FRAME / 2 - 1 };
+
+    for (size_t i = 0; i < sizeof(targets) / sizeof(targets[0]); i++)
+    {
+        SeekMonitor monitor;
+
+        monitor.OnSeekRequested(targets[i], 0, FRAME, 0);
+        monitor.OnClockSeek();
+
+        CHECK_EQ(Decode(monitor, 0, 10), 10);
+    }
+
+    // Past half a frame, the next frame.
+    SeekMonitor monitor;
+
+    monitor.OnSeekRequested(10 * FRAME + FRAME / 2, 0, FRAME, 0);
+    monitor.OnClockSeek();
+    CHECK_EQ(Decode(monitor, 0, 11), 11);
+
+    // A sample without a duration is judged on the seek's frame duration.
+    monitor.OnSeekRequested(10 * FRAME, 0, FRAME, 0);
+    monitor.OnClockSeek();
+    CHECK(monitor.OnFrameDecoded(9 * FRAME, 0));
+    CHECK(!monitor.OnFrameDecoded(10 * FRAME, 0));
+}
+
+// The target frame was decoded but the scheduler dropped it as late: the
+// next frame presented completes the seek, as missed.
+static void TestMissed()
+{
+    SeekMonitor monitor;
+    SeekStats stats;
+
+    monitor.OnSeekRequested(10 * FRAME, 0, FRAME, 0);
+    monitor.OnClockSeek();
+    Decode(monitor, 0, 12);
+    monitor.OnFramePresented(11 * FRAME, 50 * MS);
+
+    monitor.GetStats(&stats);
+    CHECK_EQ(stats.seeks, 1);
+    CHECK_EQ(stats.missed, 1);
+    CHECK_EQ(stats.overshot, 0);
+}
+
+// A source that sought to the nearest keyframe, after the target: nothing
+// is discarded, the first frame lands, and the seek counts as overshot.
+static void TestOvershot()
+{
+    SeekMonitor monitor;
+    SeekStats stats;
+
+    monitor.OnSeekRequested(10 * FRAME, 0, FRAME, 0);
+    monitor.OnClockSeek();
+    CHECK_EQ(Decode(monitor, 15, 16), 0);
+    monitor.OnFramePresented(15 * FRAME, 30 * MS);
+
+    monitor.GetStats(&stats);
+    CHECK_EQ(stats.seeks, 1);
+    CHECK_EQ(stats.missed, 0);
+    CHECK_EQ(stats.overshot, 1);
+    CHECK_EQ(stats.lastDiscarded, 0);
+    CHECK_EQ(stats.lastKeyframeDistance, 10 * FRAME);
+    CHECK(!monitor.IsPending());
+}
+
+static void TestCancel()
+{
+    SeekMonitor monitor;
+    SeekStats stats;
+
+    // Superseded by another seek before the clock jumped.
+    monitor.OnSeekRequested(10 * FRAME, 0, FRAME, 0);
+    monitor.OnSeekRequested(20 * FRAME, -1, FRAME, 0);
+    monitor.GetStats(&stats);
+    CHECK_EQ(stats.cancelled, 1);
+    CHECK(monitor.IsPending());
+
+    // The clock moved again before the target landed: someone else seeked.
+    monitor.OnClockSeek();
+    Decode(monitor, 0, 5);
+    monitor.OnClockSeek();
+    monitor.GetStats(&stats);
+    CHECK_EQ(stats.cancelled, 2);
+    CHECK(!monitor.IsPending());
+    CHECK(!monitor.OnFrameDecoded(0, FRAME));
+
+    // A target past the last frame: the end of the stream stops discarding.
+    monitor.OnSeekRequested(100 * FRAME, -1, FRAME, 0);
+    monitor.OnClockSeek();
+    CHECK_EQ(Decode(monitor, 90, 95), 6);
+    monitor.OnEndOfStream();
+    CHECK(!monitor.IsPending());
+    CHECK(!monitor.OnFrameDecoded(0, FRAME));
+
+    // The end of the stream before the clock jumped leaves the seek alone.
+    monitor.OnSeekRequested(10 * FRAME, -1, FRAME, 0);
+    monitor.OnEndOfStream();
+    CHECK(monitor.IsPending());
+
+    monitor.GetStats(&stats);
+    CHECK_EQ(stats.cancelled, 3);
+    CHECK_EQ(stats.seeks, 0);
+}
+
+static void TestStats()
+{
+    SeekMonitor monitor;
+    SeekStats stats;
+
+    // Keyframe unknown: no distance.
+    for (int i = 0; i < 4; i++)
+    {
+        monitor.OnSeekRequested(10 * FRAME, -1, FRAME, i * 1000 * MS);
+        monitor.OnClockSeek();
+        Decode(monitor, 10 - 2 * i, 10);
+        monitor.OnFramePresented(10 * FRAME, i * 1000 * MS + (i + 1) * 10 * MS);
+    }
+
+    monitor.GetStats(&stats);
+    CHECK_EQ(stats.seeks, 4);
+    CHECK_EQ(stats.lastLatency, 40 * MS);
+    CHECK_EQ(stats.lastDiscarded, 6);
+    CHECK_EQ(stats.lastKeyframeDistance, -1);
+    CHECK_EQ(stats.latency.count, 4);
+    CHECK_EQ(stats.latency.lowest, 10 * MS);
+    CHECK_EQ(stats.latency.highest, 40 * MS);
+    CHECK_EQ(stats.discarded.count, 4);
+    CHECK_EQ(stats.discarded.lowest, 0);
+    CHECK_EQ(stats.discarded.highest, 6);
+
+    monitor.Reset();
+    monitor.GetStats(&stats);
+    CHECK_EQ(stats.seeks, 0);
+    CHECK_EQ(stats.missed, 0);
+    CHECK_EQ(stats.overshot, 0);
+    CHECK_EQ(stats.cancelled, 0);
+    CHECK_EQ(stats.lastLatency, 0);
+    CHECK_EQ(stats.lastKeyframeDistance, -1);
+    CHECK_EQ(stats.latency.count, 0);
+    CHECK_EQ(stats.discarded.count, 0);
+}
+
+int main()
+{
+    RUN_TEST(TestLands);
+    RUN_TEST(TestHalfFrame);
+    RUN_TEST(TestMissed);
+    RUN_TEST(TestOvershot);
+    RUN_TEST(TestCancel);
+    RUN_TEST(TestStats);
+    return TestResult();
+}
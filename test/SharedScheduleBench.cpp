@@ -0,0 +1,172 @@
+//////////////////////////////////////////////////////////////////////////
+//
+// SharedScheduleBench.cpp: Many players on one thread each against the
+// same players on the shared scheduler thread.
+//
+// Every player runs a 30 fps stream, fed three frames ahead, for the given
+// time. Reported per mode: scheduler wake-ups, process context switches
+// (where the platform counts them), presentation lateness across all
+// players, and for the shared thread how long steps ran and how late the
+// players' frames were dispatched. Lateness is negative when a frame is
+// shown early: the frame rule presents up to 3/4 of a frame ahead.
+//
+// Usage: SharedScheduleBench [players] [seconds]
+//
+//////////////////////////////////////////////////////////////////////////
+
+#include "ScheduleEngine.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#if defined(_WIN32)
+#define BENCH_HAVE_RUSAGE 0
+#else
+#define BENCH_HAVE_RUSAGE 1
+#include <sys/resource.h>
+#endif
+
+using namespace MediaFoundationSamples;
+
+typedef std::chrono::steady_clock SteadyClock;
+
+const int64_t BENCH_FRAME = 333333;     // 30 fps.
+const int BENCH_LEAD_FRAMES = 3;
+
+struct SteadyScheduleClock : ScheduleClock
+{
+    SteadyScheduleClock() : start(SteadyClock::now()) {}
+
+    bool GetCorrelatedTime(int64_t *phnsClockTime, int64_t *phnsSystemTime)
+    {
+        *phnsClockTime = std::chrono::duration_cast<std::chrono::nanoseconds>(SteadyClock::now() - start).count() / 100;
+        *phnsSystemTime = *phnsClockTime;
+        return true;
+    }
+
+    SteadyClock::time_point start;
+};
+
+struct CountingSink : ScheduleSink
+{
+    CountingSink() : presented(0) {}
+
+    bool PresentFrame(void *, int64_t) { presented++; return true; }
+    void ReleaseFrame(void *) {}
+
+    std::atomic<uint64_t> presented;
+};
+
+static long ContextSwitches()
+{
+#if BENCH_HAVE_RUSAGE
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_nvcsw + usage.ru_nivcsw;
+#else
+    return -1;
+#endif
+}
+
+static void Run(bool bShared, int players, double seconds)
+{
+    SteadyScheduleClock clock;
+    CountingSink sink;
+    std::vector<ScheduleEngine> engines(players);
+    std::vector<int64_t> next(players, 0);
+
+    for (int i = 0; i < players; i++)
+    {
+        engines[i].SetClock(&clock);
+        engines[i].SetSink(&sink);
+        engines[i].SetFrameInterval(BENCH_FRAME);
+        engines[i].SetUseSharedService(bShared);
+        engines[i].Start();
+    }
+
+    SharedScheduleService::ResetStats();
+    long switchesBefore = ContextSwitches();
+    uint64_t sharedWakeupsBefore = SharedScheduleService::Wakeups();
+
+    const int frames = (int)(seconds * 30);
+
+    for (int f = 0; f < frames; f++)
+    {
+        for (int i = 0; i < players; i++)
+        {
+            // Players are staggered by 0.1 ms so their deadlines differ.
+            while (next[i] <= f + BENCH_LEAD_FRAMES - 1)
+            {
+                ScheduledFrame frame = { NULL, next[i] * BENCH_FRAME + i * 1000, true };
+                engines[i].ScheduleSample(frame);
+                next[i]++;
+            }
+        }
+        std::this_thread::sleep_until(clock.start + std::chrono::microseconds((f + 1) * 33333));
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(150));
+
+    long switches = ContextSwitches() - switchesBefore;
+    uint64_t wakeups = SharedScheduleService::Wakeups() - sharedWakeupsBefore;
+    HistogramSnapshot lateness;
+    double latenessSum = 0;
+    uint64_t latenessCount = 0;
+    int64_t latenessWorst = 0;
+    int64_t latenessP99 = 0;
+
+    for (int i = 0; i < players; i++)
+    {
+        wakeups += engines[i].Wakeups();
+        engines[i].GetLateness(&lateness);
+        latenessSum += (double)lateness.sum;
+        latenessCount += lateness.count;
+        if (lateness.count > 0 && lateness.highest > latenessWorst)
+        {
+            latenessWorst = lateness.highest;
+        }
+        if (lateness.Percentile(0.99) > latenessP99)
+        {
+            latenessP99 = lateness.Percentile(0.99);
+        }
+    }
+
+    SharedScheduleStats stats;
+    SharedScheduleService::GetStats(&stats);
+
+    for (int i = 0; i < players; i++)
+    {
+        engines[i].Stop();
+    }
+
+    std::printf("%s\n", bShared ? "shared thread:" : "thread per player:");
+    std::printf("  presented          %llu\n", (unsigned long long)sink.presented.load());
+    std::printf("  scheduler wake-ups %llu\n", (unsigned long long)wakeups);
+    if (switches >= 0)
+    {
+        std::printf("  context switches   %ld\n", switches);
+    }
+    std::printf("  lateness           mean %.2f ms, worst player p99 %.2f ms, max %.2f ms\n",
+        latenessCount ? latenessSum / latenessCount / 10000 : 0.0, latenessP99 / 10000.0, latenessWorst / 10000.0);
+
+    if (bShared)
+    {
+        std::printf("  step time          mean %.3f ms, max %.3f ms, %llu over budget\n",
+            stats.stepTime.Mean() / 10000, stats.stepTime.highest / 10000.0, (unsigned long long)stats.overruns);
+        std::printf("  dispatch delay     mean %.3f ms, p99 %.3f ms, max %.3f ms\n",
+            stats.dispatchDelay.Mean() / 10000, stats.dispatchDelay.Percentile(0.99) / 10000.0, stats.dispatchDelay.highest / 10000.0);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    int players = (argc > 1) ? std::atoi(argv[1]) : 30;
+    double seconds = (argc > 2) ? std::atof(argv[2]) : 2.0;
+
+    std::printf("%d players, 30 fps, %.1f s\n", players, seconds);
+    Run(false, players, seconds);
+    Run(true, players, seconds);
+    return 0;
+}
@@ -0,0 +1,299 @@
+//////////////////////////////////////////////////////////////////////////
+//
+// SharedScheduleServiceTest.cpp: Engines on the shared scheduler thread:
+// deadline order, and how one engine's slow Present delays the others.
+//
+//////////////////////////////////////////////////////////////////////////
+
+#include "TestCheck.h"
+#include "ScheduleEngine.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+typedef std::chrono::steady_clock SteadyClock;
+
+// Presentation time is steady_clock time since the test started.
+struct SteadyScheduleClock : ScheduleClock
+{
+    SteadyScheduleClock() : start(SteadyClock::now()) {}
+
+    bool GetCorrelatedTime(int64_t *phnsClockTime, int64_t *phnsSystemTime)
+    {
+        *phnsClockTime = Now();
+        *phnsSystemTime = *phnsClockTime;
+        return true;
+    }
+
+    int64_t Now() const
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(SteadyClock::now() - start).count() / 100;
+    }
+
+    SteadyClock::time_point start;
+};
+
+// Every engine presents into the same log, tagged with its own id.
+struct PresentLog
+{
+    void Add(int id)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        order.push_back(id);
+    }
+
+    size_t Count()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return order.size();
+    }
+
+    std::mutex          mutex;
+    std::vector<int>    order;
+};
+
+struct LoggingSink : ScheduleSink
+{
+    LoggingSink(PresentLog *pLog, int id) : pLog(pLog), id(id), presentMs(0), bHold(false), bHolding(false) {}
+
+    bool PresentFrame(void *, int64_t)
+    {
+        {
+            // Optionally hold the first Present until the test has queued
+            // everything, so the queue contents are known.
+            std::unique_lock<std::mutex> lock(mutex);
+            bHolding = bHold;
+            cond.notify_all();
+            cond.wait(lock, [this] { return !bHold; });
+        }
+
+        if (presentMs > 0)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(presentMs));
+        }
+        pLog->Add(id);
+        return true;
+    }
+
+    void ReleaseFrame(void *) {}
+
+    void WaitUntilHolding()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        cond.wait(lock, [this] { return bHolding; });
+    }
+
+    void Release()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        bHold = false;
+        cond.notify_all();
+    }
+
+    PresentLog                  *pLog;
+    int                         id;
+    int                         presentMs;
+    std::mutex                  mutex;
+    std::condition_variable     cond;
+    bool                        bHold;
+    bool                        bHolding;
+};
+
+static ScheduledFrame Frame(int64_t hnsTime)
+{
+    ScheduledFrame frame;
+    frame.pFrame = NULL;
+    frame.hnsTime = hnsTime;
+    frame.bHasTime = true;
+    return frame;
+}
+
+static void WaitForCount(PresentLog& log, size_t count)
+{
+    SteadyClock::time_point giveUp = SteadyClock::now() + std::chrono::seconds(5);
+
+    while (log.Count() < count && SteadyClock::now() < giveUp)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+}
+
+static void TestDeadlineOrder()
+{
+    const int count = 4;
+    SteadyScheduleClock clock;
+    PresentLog log;
+    std::unique_ptr<LoggingSink> sinks[count];
+    ScheduleEngine engines[count];
+
+    for (int i = 0; i < count; i++)
+    {
+        sinks[i].reset(new LoggingSink(&log, i));
+        engines[i].SetClock(&clock);
+        engines[i].SetSink(sinks[i].get());
+        engines[i].SetFrameInterval(400000);
+        engines[i].SetUseSharedService(true);
+        CHECK(engines[i].Start());
+    }
+
+    // Queued in reverse order of their deadlines, 20 ms apart.
+    int64_t base = clock.Now() + 200000;
+    for (int i = count - 1; i >= 0; i--)
+    {
+        CHECK(engines[i].ScheduleSample(Frame(base + i * 200000)));
+    }
+
+    WaitForCount(log, count);
+
+    for (int i = 0; i < count; i++)
+    {
+        engines[i].Stop();
+    }
+
+    CHECK_EQ(log.order.size(), count);
+    for (int i = 0; i < count && i < (int)log.order.size(); i++)
+    {
+        CHECK_EQ(log.order[i], i);
+    }
+}
+
+// Engine 0 presents slowly and has four samples due; engine 1 has one
+// sample due, queued just after them. Engine 2 holds the service thread
+// while they are queued, so both are waiting when it lets go. Returns
+// where engine 1's frame landed among the frames of engines 0 and 1.
+static int RunSlowPresent(int64_t hnsBudget, SharedScheduleStats *pStats)
+{
+    PresentLog log;
+    LoggingSink slow(&log, 0);
+    LoggingSink fast(&log, 1);
+    LoggingSink holder(&log, 2);
+    ScheduleEngine slowEngine;
+    ScheduleEngine fastEngine;
+    ScheduleEngine holderEngine;
+
+    SharedScheduleService::SetStepBudget(hnsBudget);
+
+    // No clock: every sample is due as soon as it is queued.
+    slow.presentMs = 5;
+    holder.bHold = true;
+    slowEngine.SetSink(&slow);
+    slowEngine.SetUseSharedService(true);
+    fastEngine.SetSink(&fast);
+    fastEngine.SetUseSharedService(true);
+    holderEngine.SetSink(&holder);
+    holderEngine.SetUseSharedService(true);
+    CHECK(slowEngine.Start());
+    CHECK(fastEngine.Start());
+    CHECK(holderEngine.Start());
+
+    CHECK(holderEngine.ScheduleSample(Frame(0)));
+    holder.WaitUntilHolding();
+
+    for (int i = 0; i < 4; i++)
+    {
+        CHECK(slowEngine.ScheduleSample(Frame(0)));
+    }
+    CHECK(fastEngine.ScheduleSample(Frame(0)));
+
+    SharedScheduleService::ResetStats();
+    holder.Release();
+
+    WaitForCount(log, 6);
+
+    slowEngine.Stop();
+    fastEngine.Stop();
+    holderEngine.Stop();
+
+    SharedScheduleService::GetStats(pStats);
+    SharedScheduleService::SetStepBudget(SHARED_SCHEDULE_DEFAULT_STEP_BUDGET);
+
+    int position = 0;
+    for (size_t i = 0; i < log.order.size(); i++)
+    {
+        if (log.order[i] == 1)
+        {
+            return position;
+        }
+        if (log.order[i] == 0)
+        {
+            position++;
+        }
+    }
+    return -1;
+}
+
+static void TestStepBudget()
+{
+    SharedScheduleStats stats;
+
+    // The slow engine's first Present cannot be cut short, but after it
+    // the waiting engine gets its turn.
+    CHECK_EQ(RunSlowPresent(SHARED_SCHEDULE_DEFAULT_STEP_BUDGET, &stats), 1);
+    CHECK(stats.yields >= 1);
+    CHECK(stats.overruns >= 1);
+    CHECK(stats.stepTime.highest >= 50000);
+}
+
+static void TestStallWithoutBudget()
+{
+    SharedScheduleStats stats;
+
+    // With a budget longer than the whole backlog the slow engine presents
+    // all four frames first; the other engine waits 20 ms for its turn.
+    CHECK_EQ(RunSlowPresent(10000000, &stats), 4);
+    CHECK_EQ(stats.yields, 0);
+    CHECK(stats.stepTime.highest >= 4 * 50000);
+}
+
+static void TestDispatchDelay()
+{
+    SteadyScheduleClock clock;
+    PresentLog log;
+    LoggingSink slow(&log, 0);
+    LoggingSink timed(&log, 1);
+    ScheduleEngine slowEngine;
+    ScheduleEngine timedEngine;
+    SharedScheduleStats stats;
+
+    SharedScheduleService::ResetStats();
+
+    // A 30 ms Present that starts just before the other engine's sample
+    // falls due: the stall shows up as that engine's dispatch delay.
+    slow.presentMs = 30;
+    slowEngine.SetSink(&slow);
+    slowEngine.SetUseSharedService(true);
+    timedEngine.SetClock(&clock);
+    timedEngine.SetSink(&timed);
+    timedEngine.SetFrameInterval(400000);
+    timedEngine.SetUseSharedService(true);
+    CHECK(slowEngine.Start());
+    CHECK(timedEngine.Start());
+
+    // Due in 10 ms (the engine wakes 3/4 frame early, so set it 40 ms out).
+    CHECK(timedEngine.ScheduleSample(Frame(clock.Now() + 100000 + 300000)));
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    CHECK(slowEngine.ScheduleSample(Frame(0)));
+
+    WaitForCount(log, 2);
+
+    slowEngine.Stop();
+    timedEngine.Stop();
+
+    SharedScheduleService::GetStats(&stats);
+
+    CHECK_EQ(log.order.size(), 2);
+    CHECK(stats.dispatchDelay.count >= 1);
+    CHECK(stats.dispatchDelay.highest >= 150000);
+}
+
+int main()
+{
+    RUN_TEST(TestDeadlineOrder);
+    RUN_TEST(TestStepBudget);
+    RUN_TEST(TestStallWithoutBudget);
+    RUN_TEST(TestDispatchDelay);
+    return TestResult();
+}
@@ -0,0 +1,188 @@
+//////////////////////////////////////////////////////////////////////////
+//
+// SharedSurfaceTrackerTest.cpp: SharedSurfaceTracker on one thread, and
+// with the presenter and the GL thread racing.
+//
+//////////////////////////////////////////////////////////////////////////
+
+#include "TestCheck.h"
+#include "SharedSurfaceTracker.h"
+
+#include <atomic>
+#include <thread>
+
+const int SURFACES = 4;
+
+static void TestPublishAndRecycle()
+{
+    SharedSurfaceTracker tracker;
+
+    tracker.Reset(SURFACES);
+    const uint32_t generation = tracker.Generation();
+
+    CHECK_EQ(tracker.Count(), SURFACES);
+    CHECK_EQ(tracker.Latest(), SHARED_SURFACE_NONE);
+    CHECK_EQ(tracker.Acquire(generation), SHARED_SURFACE_NONE);
+    CHECK_EQ(tracker.Reading(), SHARED_SURFACE_NONE);
+
+    // The latest surface is not recycled, even with nobody reading it.
+    tracker.Publish(2);
+    CHECK_EQ(tracker.Latest(), 2);
+    CHECK(!tracker.CanRecycle(2));
+    CHECK(tracker.CanRecycle(1));
+
+    // A surface being read is not recycled after a newer one is published.
+    CHECK_EQ(tracker.Acquire(generation), 2);
+    CHECK_EQ(tracker.Reading(), 2);
+    tracker.Publish(3);
+    CHECK(!tracker.CanRecycle(2));
+    CHECK(!tracker.CanRecycle(3));
+
+    tracker.Release();
+    CHECK(tracker.CanRecycle(2));
+    CHECK_EQ(tracker.Reading(), SHARED_SURFACE_NONE);
+
+    // Acquiring again moves the claim to the latest surface.
+    CHECK_EQ(tracker.Acquire(generation), 3);
+    tracker.Publish(0);
+    CHECK_EQ(tracker.Acquire(generation), 0);
+    CHECK(tracker.CanRecycle(3));
+    tracker.Release();
+
+    // Out of range indices are ignored.
+    tracker.Publish(SURFACES);
+    tracker.Publish(-1);
+    CHECK_EQ(tracker.Latest(), 0);
+    CHECK_EQ(tracker.PublishCount(), 3);
+}
+
+static void TestGenerations()
+{
+    SharedSurfaceTracker tracker;
+
+    tracker.Reset(SURFACES);
+    const uint32_t old = tracker.Generation();
+
+    tracker.Publish(1);
+    CHECK_EQ(tracker.Acquire(old), 1);
+
+    // A new batch: nothing is published in it, and the claim on the old
+    // batch's surface 1 does not stop the new surface 1 being recycled.
+    tracker.Reset(SURFACES);
+    const uint32_t generation = tracker.Generation();
+
+    CHECK(generation != old);
+    CHECK_EQ(tracker.Latest(), SHARED_SURFACE_NONE);
+    CHECK(tracker.CanRecycle(1));
+
+    tracker.Publish(1);
+    CHECK_EQ(tracker.Acquire(old), SHARED_SURFACE_NONE);
+    CHECK_EQ(tracker.Reading(), SHARED_SURFACE_NONE);
+    CHECK_EQ(tracker.Acquire(generation), 1);
+    CHECK(!tracker.CanRecycle(1));
+    tracker.Release();
+
+    // More surfaces than the tracker follows are clamped.
+    tracker.Reset(SHARED_SURFACE_MAX + 4);
+    CHECK_EQ(tracker.Count(), SHARED_SURFACE_MAX);
+}
+
+// The presenter renders into surfaces it may recycle and publishes them;
+// the GL thread reads the latest one. A surface must never be written
+// while it is being read.
+static void TestPresenterAndReader()
+{
+    SharedSurfaceTracker tracker;
+    tracker.Reset(SURFACES);
+    const uint32_t generation = tracker.Generation();
+
+    std::atomic<int> writing[SURFACES];
+    std::atomic<uint64_t> content[SURFACES];
+    std::atomic<bool> bStop(false);
+
+    for (int i = 0; i < SURFACES; i++)
+    {
+        writing[i].store(0);
+        content[i].store(0);
+    }
+
+    uint64_t reads = 0;
+    uint64_t violations = 0;
+
+    std::thread reader([&] {
+        while (!bStop.load())
+        {
+            const int i = tracker.Acquire(generation);
+
+            if (i == SHARED_SURFACE_NONE)
+            {
+                std::this_thread::yield();
+                continue;
+            }
+
+            // Read for a while; the content must not change under us.
+            const uint64_t before = content[i].load();
+
+            for (int k = 0; k < 50; k++)
+            {
+                if (writing[i].load() != 0)
+                {
+                    violations++;
+                }
+            }
+            if (content[i].load() != before)
+            {
+                violations++;
+            }
+
+            reads++;
+            tracker.Release();
+        }
+    });
+
+    // Like the mixer's free list: a surface, once published, stays out of
+    // the pool until the tracker says it can be recycled.
+    bool held[SURFACES] = { false };
+    uint64_t frame = 0;
+    uint64_t skipped = 0;
+
+    for (int n = 0; n < 200000; n++)
+    {
+        const int i = n % SURFACES;
+
+        if (held[i])
+        {
+            if (!tracker.CanRecycle(i))
+            {
+                skipped++;
+                continue;
+            }
+            held[i] = false;
+        }
+
+        writing[i].store(1);
+        content[i].store(++frame);
+        writing[i].store(0);
+
+        tracker.Publish(i);
+        held[i] = true;
+    }
+
+    bStop.store(true);
+    reader.join();
+
+    CHECK_EQ(violations, 0);
+    CHECK(reads > 0);
+    CHECK_EQ(tracker.PublishCount(), frame);
+
+    std::printf("    published %llu, skipped %llu, reads %llu\n",
+        (unsigned long long)frame, (unsigned long long)skipped, (unsigned long long)reads);
+}
+
+int main()
+{
+    RUN_TEST(TestPublishAndRecycle);
+    RUN_TEST(TestGenerations);
+    RUN_TEST(TestPresenterAndReader);
+    return TestResult();
+}
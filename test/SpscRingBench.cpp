@@ -0,0 +1,112 @@
+//////////////////////////////////////////////////////////////////////////
+//
+// SpscRingBench.cpp: Hand-off cost of SpscRing against a locked queue.
+//
+// The locked queue stands in for the ThreadSafeQueue the scheduler used
+// before: a critical section around a list. One producer pushes and one
+// consumer pops the given number of items, both spinning (with a yield)
+// when the queue is full or empty.
+//
+// Usage: SpscRingBench [items]
+//
+//////////////////////////////////////////////////////////////////////////
+
+#include "common/SpscRing.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+using namespace MediaFoundationSamples;
+
+// Capacity matching SCHEDULER_QUEUE_SIZE.
+const size_t BENCH_CAPACITY = 8;
+
+class LockedQueue
+{
+public:
+    bool TryPush(uint64_t item)
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        if (m_Items.size() >= BENCH_CAPACITY)
+        {
+            return false;
+        }
+        m_Items.push_back(item);
+        return true;
+    }
+
+    bool TryPop(uint64_t& item)
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        if (m_Items.empty())
+        {
+            return false;
+        }
+        item = m_Items.front();
+        m_Items.pop_front();
+        return true;
+    }
+
+private:
+    std::mutex              m_Mutex;
+    std::deque<uint64_t>    m_Items;
+};
+
+template <class Queue>
+static double Run(Queue& queue, uint64_t count)
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    std::thread producer([&]
+    {
+        for (uint64_t i = 0; i < count; )
+        {
+            if (queue.TryPush(i))
+            {
+                i++;
+            }
+            else
+            {
+                std::this_thread::yield();
+            }
+        }
+    });
+
+    uint64_t item = 0;
+    for (uint64_t received = 0; received < count; )
+    {
+        if (queue.TryPop(item))
+        {
+            received++;
+        }
+        else
+        {
+            std::this_thread::yield();
+        }
+    }
+
+    producer.join();
+
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / (double)count;
+}
+
+int main(int argc, char **argv)
+{
+    uint64_t count = (argc > 1) ? std::strtoull(argv[1], NULL, 10) : 2000000;
+
+    SpscRing<uint64_t, BENCH_CAPACITY> ring;
+    LockedQueue locked;
+
+    double nsRing = Run(ring, count);
+    double nsLocked = Run(locked, count);
+
+    std::printf("items:        %llu\n", (unsigned long long)count);
+    std::printf("SpscRing:     %.1f ns/item\n", nsRing);
+    std::printf("locked queue: %.1f ns/item\n", nsLocked);
+    return 0;
+}
@@ -0,0 +1,179 @@
+//////////////////////////////////////////////////////////////////////////
+//
+// SpscRingTest.cpp: SpscRing, single-threaded and with one producer and
+// one consumer thread.
+//
+//////////////////////////////////////////////////////////////////////////
+
+#include "TestCheck.h"
+#include "common/SpscRing.h"
+
+#include <thread>
+
+using namespace MediaFoundationSamples;
+
+// Two fields that must always be seen together: a torn copy shows up as a
+// mismatch.
+struct Payload
+{
+    uint64_t sequence;
+    uint64_t check;
+};
+
+static void TestFillAndDrain()
+{
+    SpscRing<int, 4> ring;
+    int value = 0;
+
+    CHECK(ring.IsEmpty());
+    CHECK(!ring.TryPop(value));
+    CHECK(!ring.TryPeek(value));
+    CHECK_EQ(ring.Capacity(), 4);
+
+    for (int i = 0; i < 4; i++)
+    {
+        CHECK(ring.TryPush(i));
+    }
+    CHECK(!ring.TryPush(4));
+    CHECK_EQ(ring.Size(), 4);
+
+    CHECK(ring.TryPeek(value));
+    CHECK_EQ(value, 0);
+    CHECK_EQ(ring.Size(), 4);
+
+    for (int i = 0; i < 4; i++)
+    {
+        CHECK(ring.TryPop(value));
+        CHECK_EQ(value, i);
+    }
+    CHECK(ring.IsEmpty());
+}
+
+static void TestWrapAround()
+{
+    // Many more items than the capacity, so the indices wrap many times.
+    SpscRing<int, 2> ring;
+    int value = 0;
+
+    for (int i = 0; i < 1000; i++)
+    {
+        CHECK(ring.TryPush(i));
+        CHECK(ring.TryPush(i + 1));
+        CHECK(!ring.TryPush(i + 2));
+        CHECK(ring.TryPop(value));
+        CHECK_EQ(value, i);
+        CHECK(ring.TryPop(value));
+        CHECK_EQ(value, i + 1);
+    }
+    CHECK(ring.IsEmpty());
+}
+
+static void TestProducerConsumer()
+{
+    // The scheduler's capacity, so the ring is full most of the time.
+    SpscRing<Payload, 8> ring;
+    const uint64_t count = 200000;
+
+    std::thread producer([&]
+    {
+        for (uint64_t i = 1; i <= count; )
+        {
+            Payload item = { i, ~i };
+            if (ring.TryPush(item))
+            {
+                i++;
+            }
+            else
+            {
+                std::this_thread::yield();
+            }
+        }
+    });
+
+    uint64_t expected = 1;
+    uint64_t outOfOrder = 0;
+    uint64_t torn = 0;
+
+    while (expected <= count)
+    {
+        Payload item;
+        if (!ring.TryPop(item))
+        {
+            std::this_thread::yield();
+            continue;
+        }
+
+        if (item.sequence != expected)
+        {
+            outOfOrder++;
+        }
+        if (item.check != ~item.sequence)
+        {
+            torn++;
+        }
+        expected = item.sequence + 1;
+    }
+
+    producer.join();
+
+    CHECK_EQ(outOfOrder, 0);
+    CHECK_EQ(torn, 0);
+    CHECK(ring.IsEmpty());
+}
+
+static void TestPeekWhileProducing()
+{
+    // The consumer peeks before it pops, as the late-frame policy does.
+    SpscRing<uint64_t, 8> ring;
+    const uint64_t count = 100000;
+
+    std::thread producer([&]
+    {
+        for (uint64_t i = 1; i <= count; )
+        {
+            if (ring.TryPush(i))
+            {
+                i++;
+            }
+            else
+            {
+                std::this_thread::yield();
+            }
+        }
+    });
+
+    uint64_t expected = 1;
+    uint64_t mismatches = 0;
+
+    while (expected <= count)
+    {
+        uint64_t peeked = 0;
+        uint64_t popped = 0;
+
+        if (!ring.TryPeek(peeked))
+        {
+            std::this_thread::yield();
+            continue;
+        }
+        CHECK(ring.TryPop(popped));
+
+        if (peeked != expected || popped != expected)
+        {
+            mismatches++;
+        }
+        expected++;
+    }
+
+    producer.join();
+
+    CHECK_EQ(mismatches, 0);
+}
+
+int main()
+{
+    RUN_TEST(TestFillAndDrain);
+    RUN_TEST(TestWrapAround);
+    RUN_TEST(TestProducerConsumer);
+    RUN_TEST(TestPeekWhileProducing);
+    return TestResult();
+}
@@ -0,0 +1,186 @@
+//////////////////////////////////////////////////////////////////////////
+//
+// SyncProtocolBench.cpp: A master and a follower over UDP on localhost,
+// measuring how fast the follower converges and how closely it tracks.
+//
+// The master thread sends a beacon every 20 ms. The follower's clock runs
+// 250 ppm fast and starts far off, and its simulated player advances at
+// the rate the follower sets, with seeks landing five frames late.
+// Reported: beacons, the drift estimate, seeks and rate changes, when the
+// error first fell below 1 ms, and the error over the second half of the
+// run (true error, from the shared steady clock, not the estimate).
+//
+// Usage: SyncProtocolBench [seconds] [port]
+//
+//////////////////////////////////////////////////////////////////////////
+
+#include "SyncProtocol.h"
+#include "SyncSocket.h"
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+
+const int64_t BENCH_MS = 10000;
+const int64_t BENCH_FRAME = 166667;             // 60 fps updates.
+const int64_t BENCH_MASTER_START = 100000000;   // The master's video is 10 s in.
+const double BENCH_DRIFT = 250e-6;
+const int64_t BENCH_LOCAL_OFFSET = 555555555;
+const int BENCH_SEEK_FRAMES = 5;
+
+static int64_t Now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count() / 100;
+}
+
+int main(int argc, char **argv)
+{
+    double seconds = (argc > 1) ? std::atof(argv[1]) : 20.0;
+    uint16_t port = (uint16_t)((argc > 2) ? std::atoi(argv[2]) : 47811);
+
+    SyncSocket receiver;
+
+    if (!receiver.OpenReceiver(port))
+    {
+        std::printf("cannot listen on port %u\n", (unsigned)port);
+        return 1;
+    }
+
+    const int64_t start = Now();
+    std::atomic<bool> running(true);
+    std::atomic<bool> sendFailed(false);
+
+    std::thread master([&]
+    {
+        SyncSocket sender;
+        SyncMaster syncMaster(7);
+        uint8_t buffer[SYNC_BEACON_SIZE];
+
+        if (!sender.OpenSender("127.0.0.1", port))
+        {
+            sendFailed = true;
+            return;
+        }
+
+        while (running)
+        {
+            const int64_t now = Now();
+            SyncBeacon beacon = syncMaster.MakeBeacon(now - start + BENCH_MASTER_START, now, 1.0, true);
+
+            sender.Send(buffer, SyncProtocol::Encode(beacon, buffer));
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        }
+    });
+
+    // The follower's own clock: offset, and running fast.
+    auto localClock = [&](int64_t steady)
+    {
+        return (int64_t)((double)(steady - start) * (1.0 + BENCH_DRIFT)) + BENCH_LOCAL_OFFSET;
+    };
+
+    SyncFollower follower(7);
+    uint8_t buffer[64];
+
+    double position = 0.0;
+    double rate = 1.0;
+    int64_t lastLocal = localClock(Now());
+    int pendingSeek = -1;
+    int64_t seekTarget = 0;
+
+    int64_t worst = 0;
+    double sumSquares = 0.0;
+    int samples = 0;
+    double convergedAt = -1.0;
+
+    for (;;)
+    {
+        std::this_thread::sleep_for(std::chrono::microseconds(BENCH_FRAME / 10));
+
+        const int64_t steady = Now();
+        const int64_t now = localClock(steady);
+        const double elapsed = (double)(steady - start) / 1e7;
+
+        if (elapsed > seconds)
+        {
+            break;
+        }
+
+        // The player advances in local time, at the rate the follower set.
+        position += (double)(now - lastLocal) * rate;
+        lastLocal = now;
+
+        if (pendingSeek >= 0 && --pendingSeek < 0)
+        {
+            position = (double)seekTarget;
+        }
+
+        int received;
+        while ((received = receiver.Receive(buffer, sizeof(buffer))) > 0)
+        {
+            follower.OnDatagram(buffer, (size_t)received, localClock(Now()));
+        }
+
+        if (!follower.HasMaster())
+        {
+            continue;
+        }
+
+        SyncCorrection correction = follower.Update((int64_t)position, now);
+
+        if (correction.action == SyncNudge)
+        {
+            rate = 1.0 + correction.nudge;
+        }
+        else if (correction.action == SyncSeek)
+        {
+            // Aim where the master will be when the seek lands.
+            rate = 1.0;
+            pendingSeek = BENCH_SEEK_FRAMES;
+            seekTarget = follower.MasterPosition(now) + BENCH_SEEK_FRAMES * BENCH_FRAME;
+        }
+
+        int64_t error = (int64_t)position - (steady - start + BENCH_MASTER_START);
+        error = (error < 0) ? -error : error;
+
+        if (convergedAt < 0.0 && error < BENCH_MS && elapsed > 1.0)
+        {
+            convergedAt = elapsed;
+        }
+
+        if (elapsed > seconds / 2)
+        {
+            if (error > worst)
+            {
+                worst = error;
+            }
+            sumSquares += (double)error * (double)error;
+            samples++;
+        }
+    }
+
+    running = false;
+    master.join();
+
+    if (sendFailed)
+    {
+        std::printf("cannot send to 127.0.0.1:%u\n", (unsigned)port);
+        return 1;
+    }
+
+    SyncFollowerStats stats;
+    follower.GetStats(&stats, localClock(Now()));
+
+    std::printf("%.1f s over 127.0.0.1:%u\n", seconds, (unsigned)port);
+    std::printf("    %llu beacons, %llu dropped; drift %+.1f ppm (true %+.1f)\n",
+        (unsigned long long)stats.beacons, (unsigned long long)stats.dropped, stats.drift * 1e6, BENCH_DRIFT * 1e6);
+    std::printf("    %llu seeks, %llu rate changes; within 1 ms at %.2f s\n",
+        (unsigned long long)stats.control.seeks, (unsigned long long)stats.control.nudges, convergedAt);
+    std::printf("    second half: rms %.3f ms, worst %.3f ms\n",
+        (samples > 0) ? std::sqrt(sumSquares / samples) / BENCH_MS : 0.0, worst / (double)BENCH_MS);
+
+    return (stats.beacons > 0) ? 0 : 1;
+}
@@ -0,0 +1,392 @@
+//////////////////////////////////////////////////////////////////////////
+//
+// SyncProtocolTest.cpp: Beacon encoding, the clock estimator against
+// delayed and drifting clocks, and a follower steering a simulated player
+// from a simulated master.
+//
+//////////////////////////////////////////////////////////////////////////
+
+#include "TestCheck.h"
+#include "SyncProtocol.h"
+
+#include <string.h>
+
+const int64_t MS = 10000;
+const int64_t SECOND = 10000000;
+
+// Deterministic network delay: a floor plus up to spread on top.
+struct DelayModel
+{
+    DelayModel(int64_t floor, int64_t spread) : m_Floor(floor), m_Spread(spread), m_Random(777)
+    {
+    }
+
+    int64_t Next()
+    {
+        m_Random = m_Random * 6364136223846793005ULL + 1442695040888963407ULL;
+        return m_Floor + (int64_t)((m_Random >> 33) % (uint64_t)(m_Spread + 1));
+    }
+
+    int64_t     m_Floor;
+    int64_t     m_Spread;
+    uint64_t    m_Random;
+};
+
+static SyncBeacon MakeTestBeacon()
+{
+    SyncBeacon beacon;
+    beacon.sequence = 0x01020304;
+    beacon.groupId = 0xA0B0C0D0;
+    beacon.masterTime = 0x1122334455667788LL;
+    beacon.presentationTime = -123456789;
+    beacon.rate = 1.0;
+    beacon.flags = SYNC_FLAG_PLAYING;
+    beacon.session = 0x0A0B0C0D;
+    return beacon;
+}
+
+static void TestRoundTrip()
+{
+    const SyncBeacon in = MakeTestBeacon();
+    uint8_t buffer[SYNC_BEACON_SIZE];
+
+    CHECK_EQ(SyncProtocol::Encode(in, buffer), SYNC_BEACON_SIZE);
+
+    SyncBeacon out;
+    memset(&out, 0, sizeof(out));
+    CHECK(SyncProtocol::Decode(buffer, sizeof(buffer), &out));
+
+    CHECK_EQ(out.sequence, in.sequence);
+    CHECK_EQ(out.groupId, in.groupId);
+    CHECK_EQ(out.masterTime, in.masterTime);
+    CHECK_EQ(out.presentationTime, in.presentationTime);
+    CHECK(out.rate == in.rate);
+    CHECK_EQ(out.flags, in.flags);
+    CHECK_EQ(out.session, in.session);
+
+    // Rates other than 1 survive bit for bit.
+    SyncBeacon slow = in;
+    slow.rate = 0.999875;
+    SyncProtocol::Encode(slow, buffer);
+    CHECK(SyncProtocol::Decode(buffer, sizeof(buffer), &out));
+    CHECK(out.rate == slow.rate);
+}
+
+// The layout is fixed and little-endian, whatever the host.
+static void TestWireLayout()
+{
+    uint8_t buffer[SYNC_BEACON_SIZE];
+    SyncProtocol::Encode(MakeTestBeacon(), buffer);
+
+    CHECK(memcmp(buffer, "WMFS", 4) == 0);
+    CHECK_EQ(buffer[4], SYNC_VERSION);
+    CHECK_EQ(buffer[5], 0);
+    CHECK_EQ(buffer[6], SYNC_BEACON_SIZE);
+    CHECK_EQ(buffer[7], 0);
+
+    // sequence
+    CHECK_EQ(buffer[8], 0x04);
+    CHECK_EQ(buffer[11], 0x01);
+
+    // masterTime
+    CHECK_EQ(buffer[16], 0x88);
+    CHECK_EQ(buffer[23], 0x11);
+
+    // rate 1.0 is 0x3FF0000000000000.
+    CHECK_EQ(buffer[32], 0x00);
+    CHECK_EQ(buffer[38], 0xF0);
+    CHECK_EQ(buffer[39], 0x3F);
+
+    CHECK_EQ(buffer[40], SYNC_FLAG_PLAYING);
+
+    // session
+    CHECK_EQ(buffer[44], 0x0D);
+    CHECK_EQ(buffer[47], 0x0A);
+}
+
+static void TestRejects()
+{
+    uint8_t buffer[SYNC_BEACON_SIZE + 8];
+    SyncBeacon out;
+
+    memset(buffer, 0, sizeof(buffer));
+    SyncProtocol::Encode(MakeTestBeacon(), buffer);
+
+    // Trailing bytes are ignored; a short datagram is not a beacon.
+    CHECK(SyncProtocol::Decode(buffer, sizeof(buffer), &out));
+    CHECK(!SyncProtocol::Decode(buffer, SYNC_BEACON_SIZE - 1, &out));
+    CHECK(!SyncProtocol::Decode(buffer, 0, &out));
+
+    uint8_t bad[SYNC_BEACON_SIZE];
+
+    memcpy(bad, buffer, sizeof(bad));
+    bad[0] ^= 0xFF;
+    CHECK(!SyncProtocol::Decode(bad, sizeof(bad), &out));
+
+    memcpy(bad, buffer, sizeof(bad));
+    bad[4] = SYNC_VERSION + 1;
+    CHECK(!SyncProtocol::Decode(bad, sizeof(bad), &out));
+
+    memcpy(bad, buffer, sizeof(bad));
+    bad[6] = SYNC_BEACON_SIZE + 4;
+    CHECK(!SyncProtocol::Decode(bad, sizeof(bad), &out));
+}
+
+// Feeds beacons every interval for the given time: the local clock is
+// offset from the master's and runs drift fast, and each beacon arrives
+// after a delay.
+static void FeedEstimator(SyncClockEstimator& estimator, int64_t offset, double drift, DelayModel& delay,
+    int64_t interval, int64_t duration)
+{
+    for (int64_t master = 0; master < duration; master += interval)
+    {
+        const int64_t local = offset + (int64_t)((double)master * (1.0 + drift)) + delay.Next();
+        estimator.AddSample(master, local);
+    }
+}
+
+// With a constant offset the estimate lands near the least-delayed samples,
+// not the average delay.
+static void TestEstimatorOffset()
+{
+    SyncClockEstimator estimator;
+    DelayModel delay(2 * MS, 20 * MS);
+
+    CHECK(!estimator.IsValid());
+
+    FeedEstimator(estimator, 5 * SECOND, 0.0, delay, 100 * MS, 20 * SECOND);
+
+    CHECK(estimator.IsValid());
+
+    // The delay averages 12 ms; the estimate is within a few of its floor.
+    const int64_t offset = estimator.Offset(20 * SECOND);
+    CHECK(offset >= 5 * SECOND + 2 * MS - MS / 2);
+    CHECK(offset < 5 * SECOND + 6 * MS);
+
+    // A known latency is taken off.
+    estimator.SetLatency(2 * MS);
+    CHECK_EQ(estimator.Offset(20 * SECOND), offset - 2 * MS);
+}
+
+// A drifting clock: the slope follows it, and the estimate stays right as
+// the clocks move apart.
+static void TestEstimatorDrift()
+{
+    const double drifts[] = { 250e-6, -100e-6 };
+
+    for (int i = 0; i < 2; i++)
+    {
+        SyncClockEstimator estimator;
+        DelayModel delay(MS, 5 * MS);
+
+        FeedEstimator(estimator, -3 * SECOND, drifts[i], delay, 50 * MS, 30 * SECOND);
+
+        CHECK_NEAR(estimator.Drift(), drifts[i], 20e-6);
+
+        const int64_t master = 30 * SECOND;
+        const int64_t local = -3 * SECOND + (int64_t)((double)master * (1.0 + drifts[i]));
+
+        CHECK_NEAR(estimator.ToLocal(master) - MS, local, MS);
+        CHECK_NEAR(estimator.ToMaster(local + MS), master, MS);
+
+        std::printf("    %+.0f ppm: estimated %+.1f ppm\n", drifts[i] * 1e6, estimator.Drift() * 1e6);
+    }
+}
+
+static void TestEstimatorInverse()
+{
+    SyncClockEstimator estimator;
+    DelayModel delay(MS, 3 * MS);
+
+    FeedEstimator(estimator, 42 * SECOND, 500e-6, delay, 100 * MS, 10 * SECOND);
+    estimator.SetLatency(MS / 2);
+
+    for (int64_t master = 0; master < 20 * SECOND; master += 1234567)
+    {
+        CHECK_NEAR(estimator.ToMaster(estimator.ToLocal(master)), master, 2);
+    }
+}
+
+// Only the last SYNC_ESTIMATOR_BUCKETS seconds count: after a step in the
+// offset, the old samples are forgotten once the window has passed.
+static void TestEstimatorWindow()
+{
+    SyncClockEstimator estimator;
+
+    for (int64_t master = 0; master < 20 * SECOND; master += 100 * MS)
+    {
+        estimator.AddSample(master, master + SECOND);
+    }
+    for (int64_t master = 20 * SECOND; master < 40 * SECOND; master += 100 * MS)
+    {
+        estimator.AddSample(master, master + 2 * SECOND);
+    }
+
+    CHECK_NEAR(estimator.Offset(40 * SECOND), 2 * SECOND, 1);
+    CHECK_NEAR(estimator.Drift(), 0.0, 1e-9);
+
+    estimator.Reset();
+    CHECK(!estimator.IsValid());
+}
+
+static void TestFollowerFilters()
+{
+    SyncMaster master(7, 1);
+    SyncMaster other(8, 1);
+    SyncFollower follower(7);
+
+    CHECK(!follower.HasMaster());
+
+    SyncBeacon first = master.MakeBeacon(0, 0, 1.0, true);
+    SyncBeacon second = master.MakeBeacon(SECOND, SECOND, 1.0, true);
+
+    CHECK(!follower.OnBeacon(other.MakeBeacon(0, 0, 1.0, true), 0));
+    CHECK(follower.OnBeacon(second, SECOND));
+    CHECK(follower.HasMaster());
+
+    // Duplicate, then out of order.
+    CHECK(!follower.OnBeacon(second, SECOND));
+    CHECK(!follower.OnBeacon(first, SECOND));
+
+    // Not a beacon.
+    uint8_t junk[SYNC_BEACON_SIZE];
+    memset(junk, 0, sizeof(junk));
+    CHECK(!follower.OnDatagram(junk, sizeof(junk), SECOND));
+
+    // Encoded on the wire.
+    uint8_t buffer[SYNC_BEACON_SIZE];
+    SyncProtocol::Encode(master.MakeBeacon(2 * SECOND, 2 * SECOND, 1.0, true), buffer);
+    CHECK(follower.OnDatagram(buffer, sizeof(buffer), 2 * SECOND));
+
+    SyncFollowerStats stats;
+    follower.GetStats(&stats, 2 * SECOND);
+    CHECK_EQ(stats.beacons, 2);
+    CHECK_EQ(stats.dropped, 4);
+
+    // A restarted master is a new session counting from 1 again: accepted
+    // at once, however few beacons the old run sent, with its own clock.
+    SyncMaster restarted(7, 2);
+    CHECK(follower.OnBeacon(restarted.MakeBeacon(0, 100 * SECOND, 1.0, false), 3 * SECOND));
+    CHECK_EQ(follower.MasterPosition(4 * SECOND), 0);
+
+    // Its sequence is then checked as the old one's was.
+    SyncBeacon next = restarted.MakeBeacon(SECOND, 101 * SECOND, 1.0, true);
+    CHECK(follower.OnBeacon(next, 4 * SECOND));
+    CHECK(!follower.OnBeacon(next, 4 * SECOND));
+    CHECK_EQ(follower.MasterPosition(4 * SECOND), SECOND);
+
+    // Every SyncMaster left to pick its own session is a new one.
+    CHECK(SyncMaster(7).MakeBeacon(0, 0, 1.0, true).session != SyncMaster(7).MakeBeacon(0, 0, 1.0, true).session);
+    CHECK(SyncProtocol::NewSession() != 0);
+
+    follower.Reset();
+    CHECK(!follower.HasMaster());
+}
+
+static void TestMasterPosition()
+{
+    SyncMaster master(1);
+    SyncFollower follower(1);
+
+    // Local clock 10 s ahead of the master's, no delay.
+    CHECK(follower.OnBeacon(master.MakeBeacon(60 * SECOND, 5 * SECOND, 1.0, true), 15 * SECOND));
+
+    CHECK_EQ(follower.MasterPosition(15 * SECOND), 60 * SECOND);
+    CHECK_EQ(follower.MasterPosition(16 * SECOND), 61 * SECOND);
+
+    // At half speed.
+    CHECK(follower.OnBeacon(master.MakeBeacon(60 * SECOND, 5 * SECOND + 1, 0.5, true), 15 * SECOND + 1));
+    CHECK_NEAR(follower.MasterPosition(17 * SECOND), 61 * SECOND, 1);
+
+    // Paused: stays where the master stopped.
+    CHECK(follower.OnBeacon(master.MakeBeacon(70 * SECOND, 6 * SECOND, 1.0, false), 16 * SECOND));
+    CHECK(!follower.IsMasterPlaying());
+    CHECK_EQ(follower.MasterPosition(30 * SECOND), 70 * SECOND);
+}
+
+// A follower whose clock drifts 250 ppm from the master's, with beacons
+// every 100 ms over a jittery network, is pulled within a millisecond.
+static void TestFollowerConverges()
+{
+    const double drift = 250e-6;
+    const int64_t step = SECOND / 60;
+    const int64_t localOffset = 55 * SECOND;
+
+    SyncMaster master(3);
+    SyncFollower follower(3);
+    DelayModel delay(MS / 2, 2 * MS);
+
+    double position = 0.0;      // Follower's presentation time.
+    double rate = 1.0;
+    int pendingSeek = -1;
+    int64_t seekBy = 0;
+    int64_t worst = 0;
+
+    for (int64_t masterNow = 0; masterNow < 60 * SECOND; masterNow += step)
+    {
+        const int64_t localNow = localOffset + (int64_t)((double)masterNow * (1.0 + drift));
+
+        // The master's video started 10 s in.
+        if (masterNow % (100 * MS) < step)
+        {
+            SyncBeacon beacon = master.MakeBeacon(masterNow + 10 * SECOND, masterNow, 1.0, true);
+            uint8_t buffer[SYNC_BEACON_SIZE];
+
+            SyncProtocol::Encode(beacon, buffer);
+            follower.OnDatagram(buffer, sizeof(buffer), localNow + delay.Next());
+        }
+
+        position += (double)step * (1.0 + drift) * rate;
+
+        if (pendingSeek >= 0 && --pendingSeek < 0)
+        {
+            position += (double)seekBy;
+        }
+
+        SyncCorrection correction = follower.Update((int64_t)position, localNow);
+
+        if (correction.action == SyncNudge)
+        {
+            rate = 1.0 + correction.nudge;
+        }
+        else if (correction.action == SyncSeek)
+        {
+            rate = 1.0;
+            pendingSeek = 5;
+            seekBy = correction.seekBy;
+        }
+
+        int64_t error = (int64_t)position - (masterNow + 10 * SECOND);
+        error = (error < 0) ? -error : error;
+
+        if (masterNow > 50 * SECOND && error > worst)
+        {
+            worst = error;
+        }
+    }
+
+    SyncFollowerStats stats;
+    follower.GetStats(&stats, localOffset + 60 * SECOND);
+
+    CHECK(worst < 2 * MS);
+    CHECK_EQ(stats.control.seeks, 1);
+    CHECK_NEAR(stats.drift, drift, 30e-6);
+
+    std::printf("    worst %.3f ms in the last 10 s, drift estimated %+.1f ppm, %llu rate changes\n",
+        worst / (double)MS, stats.drift * 1e6, (unsigned long long)stats.control.nudges);
+}
+
+int main()
+{
+    RUN_TEST(TestRoundTrip);
+    RUN_TEST(TestWireLayout);
+    RUN_TEST(TestRejects);
+    RUN_TEST(TestEstimatorOffset);
+    RUN_TEST(TestEstimatorDrift);
+    RUN_TEST(TestEstimatorInverse);
+    RUN_TEST(TestEstimatorWindow);
+    RUN_TEST(TestFollowerFilters);
+    RUN_TEST(TestMasterPosition);
+    RUN_TEST(TestFollowerConverges);
+    return TestResult();
+}
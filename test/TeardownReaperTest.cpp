@@ -0,0 +1,186 @@
+//////////////////////////////////////////////////////////////////////////
+//
+// TeardownReaperTest.cpp: TeardownReaper running jobs in order off the
+// posting thread, Flush, sharing by reference count, and the last Release
+// running everything still queued.
+//
+//////////////////////////////////////////////////////////////////////////
+
+#include "TestCheck.h"
+#include "TeardownReaper.h"
+
+#include <chrono>
+#include <thread>
+#include <vector>
+
+const int POSTERS = 4;
+const int JOBS_PER_POSTER = 2000;
+
+static void TestOrder()
+{
+    TeardownReaper *pReaper = TeardownReaper::Acquire();
+
+    std::vector<int> ran;
+    const std::thread::id poster = std::this_thread::get_id();
+    bool onPoster = false;
+
+    for (int i = 0; i < 100; i++)
+    {
+        pReaper->Post([&ran, &onPoster, poster, i]
+        {
+            onPoster = onPoster || (std::this_thread::get_id() == poster);
+            ran.push_back(i);
+        });
+    }
+
+    pReaper->Flush();
+
+    CHECK_EQ(pReaper->Pending(), 0);
+    CHECK_EQ(ran.size(), 100);
+    CHECK(!onPoster);
+
+    for (size_t i = 0; i < ran.size(); i++)
+    {
+        CHECK_EQ(ran[i], (int)i);
+    }
+
+    TeardownReaper::Release();
+}
+
+// Post returns while a slow job runs; Flush waits for it.
+static void TestPostDoesNotBlock()
+{
+    TeardownReaper *pReaper = TeardownReaper::Acquire();
+
+    std::atomic<bool> finished(false);
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    pReaper->Post([&finished]
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        finished = true;
+    });
+
+    std::chrono::steady_clock::duration posting = std::chrono::steady_clock::now() - start;
+
+    CHECK(std::chrono::duration_cast<std::chrono::milliseconds>(posting).count() < 100);
+    CHECK(!finished.load());
+    CHECK_EQ(pReaper->Pending(), 1);
+
+    pReaper->Flush();
+
+    CHECK(finished.load());
+    CHECK_EQ(pReaper->Pending(), 0);
+
+    TeardownReaper::Release();
+}
+
+// Every user shares one instance; it stays up until the last Release.
+static void TestSharing()
+{
+    TeardownReaper *pFirst = TeardownReaper::Acquire();
+    TeardownReaper *pSecond = TeardownReaper::Acquire();
+
+    CHECK(pFirst == pSecond);
+
+    TeardownReaper::Release();
+
+    int ran = 0;
+    pSecond->Post([&ran] { ran++; });
+    pSecond->Flush();
+    CHECK_EQ(ran, 1);
+
+    TeardownReaper::Release();
+}
+
+// The last Release runs the jobs still queued, then stops the thread: a
+// session closed just before the app exits is still shut down.
+static void TestShutdownDrains()
+{
+    TeardownReaper *pReaper = TeardownReaper::Acquire();
+
+    std::atomic<int> ran(0);
+
+    // Hold the reaper in the first job so the rest are still queued.
+    pReaper->Post([&ran]
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        ran++;
+    });
+    for (int i = 0; i < 20; i++)
+    {
+        pReaper->Post([&ran] { ran++; });
+    }
+
+    CHECK(pReaper->Pending() > 0);
+
+    TeardownReaper::Release();
+
+    CHECK_EQ(ran.load(), 21);
+}
+
+// Several threads posting at once: every job runs exactly once, and each
+// thread's jobs run in the order it posted them.
+static void TestPosters()
+{
+    TeardownReaper::ResetStats();
+
+    TeardownStats before;
+    TeardownReaper::GetStats(&before);
+
+    TeardownReaper *pReaper = TeardownReaper::Acquire();
+
+    std::vector<int> last(POSTERS, 0);
+    std::vector<int> outOfOrder(POSTERS, 0);
+    std::vector<std::thread> posters;
+
+    for (int p = 0; p < POSTERS; p++)
+    {
+        posters.push_back(std::thread([&, p]
+        {
+            for (int k = 1; k <= JOBS_PER_POSTER; k++)
+            {
+                // Jobs run one at a time, so they need no lock of their own.
+                pReaper->Post([&last, &outOfOrder, p, k]
+                {
+                    if (last[p] + 1 != k)
+                    {
+                        outOfOrder[p]++;
+                    }
+                    last[p] = k;
+                });
+            }
+        }));
+    }
+
+    for (size_t i = 0; i < posters.size(); i++)
+    {
+        posters[i].join();
+    }
+
+    TeardownReaper::Release();
+
+    for (int p = 0; p < POSTERS; p++)
+    {
+        CHECK_EQ(last[p], JOBS_PER_POSTER);
+        CHECK_EQ(outOfOrder[p], 0);
+    }
+
+    TeardownStats stats;
+    TeardownReaper::GetStats(&stats);
+
+    CHECK_EQ(stats.posted - before.posted, POSTERS * JOBS_PER_POSTER);
+    CHECK_EQ(stats.completed - before.completed, POSTERS * JOBS_PER_POSTER);
+    CHECK_EQ(stats.background.count, POSTERS * JOBS_PER_POSTER);
+}
+
+int main()
+{
+    RUN_TEST(TestOrder);
+    RUN_TEST(TestPostDoesNotBlock);
+    RUN_TEST(TestSharing);
+    RUN_TEST(TestShutdownDrains);
+    RUN_TEST(TestPosters);
+    return TestResult();
+}
@@ -0,0 +1,62 @@
+//////////////////////////////////////////////////////////////////////////
+//
+// TestCheck.h: Minimal checks for the presenter's portable cores.
+//
+// Each test program calls its test functions with RUN_TEST and returns
+// TestResult() from main, which is non-zero if any check failed.
+//
+//////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <stdint.h>
+#include <cstdio>
+
+inline int& TestFailures()
+{
+    static int failures = 0;
+    return failures;
+}
+
+inline int TestResult()
+{
+    if (TestFailures() != 0)
+    {
+        std::printf("%d check(s) failed\n", TestFailures());
+        return 1;
+    }
+    std::printf("all checks passed\n");
+    return 0;
+}
+
+#define CHECK(cond) \
+    do { \
+        if (!(cond)) { \
+            std::printf("%s(%d): CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+            TestFailures()++; \
+        } \
+    } while (0)
+
+#define CHECK_EQ(a, b) \
+    do { \
+        long long _a = (long long)(a), _b = (long long)(b); \
+        if (_a != _b) { \
+            std::printf("%s(%d): CHECK_EQ(%s, %s) failed: %lld != %lld\n", __FILE__, __LINE__, #a, #b, _a, _b); \
+            TestFailures()++; \
+        } \
+    } while (0)
+
+#define CHECK_NEAR(a, b, tol) \
+    do { \
+        double _a = (double)(a), _b = (double)(b); \
+        if (_a - _b > (tol) || _b - _a > (tol)) { \
+            std::printf("%s(%d): CHECK_NEAR(%s, %s) failed: %g vs %g\n", __FILE__, __LINE__, #a, #b, _a, _b); \
+            TestFailures()++; \
+        } \
+    } while (0)
+
+#define RUN_TEST(fn) \
+    do { \
+        std::printf("%s\n", #fn); \
+        fn(); \
+    } while (0)
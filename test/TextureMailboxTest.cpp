@@ -0,0 +1,207 @@
+//////////////////////////////////////////////////////////////////////////
+//
+// TextureMailboxTest.cpp: TextureMailbox slot transitions, and the
+// scheduler and the GL thread racing over a ring of slots.
+//
+//////////////////////////////////////////////////////////////////////////
+
+#include "TestCheck.h"
+#include "TextureMailbox.h"
+
+#include <atomic>
+#include <thread>
+
+// Words per simulated texture. The writer fills a slot with one frame
+// number; a reader that sees two different numbers saw a torn frame.
+const int SLOT_WORDS = 64;
+
+static std::atomic<uint64_t> s_Slots[MAILBOX_MAX_SLOTS][SLOT_WORDS];
+
+static void TestTransitions()
+{
+    TextureMailbox mailbox;
+    mailbox.Reset(3);
+
+    CHECK_EQ(mailbox.Count(), 3);
+    CHECK_EQ(mailbox.BeginRead(), MAILBOX_NONE);
+    CHECK_EQ(mailbox.Newest(), MAILBOX_NONE);
+
+    int write = mailbox.BeginWrite();
+    CHECK_EQ(write, 0);
+    CHECK_EQ(mailbox.State(0), TextureMailbox::SlotWriting);
+    mailbox.Publish(write);
+    CHECK_EQ(mailbox.Newest(), 0);
+
+    int read = mailbox.BeginRead();
+    CHECK_EQ(read, 0);
+    CHECK_EQ(mailbox.State(0), TextureMailbox::SlotReading);
+
+    mailbox.Publish(mailbox.BeginWrite());
+    mailbox.Publish(mailbox.BeginWrite());
+    CHECK_EQ(mailbox.Newest(), 2);
+
+    // Slot 0 is being read and slot 2 is the newest: only 1 is left.
+    write = mailbox.BeginWrite();
+    CHECK_EQ(write, 1);
+    mailbox.CancelWrite(write);
+    CHECK_EQ(mailbox.State(1), TextureMailbox::SlotFree);
+
+    // The reader moves on to the newest slot.
+    mailbox.EndRead(read);
+    CHECK_EQ(mailbox.State(0), TextureMailbox::SlotReady);
+    read = mailbox.BeginRead();
+    CHECK_EQ(read, 2);
+    mailbox.EndRead(read);
+
+    // Nothing newer: reading again gets the same slot.
+    CHECK_EQ(mailbox.BeginRead(), 2);
+    mailbox.EndRead(2);
+
+    CHECK_EQ(mailbox.Published(), 3);
+    CHECK_EQ(mailbox.Skipped(), 0);
+}
+
+static void TestTwoSlotsStarve()
+{
+    // With two slots, one being read and one newest leave the writer
+    // nothing: the frame is skipped rather than waited for.
+    TextureMailbox mailbox;
+    mailbox.Reset(2);
+
+    mailbox.Publish(mailbox.BeginWrite());
+    const int read = mailbox.BeginRead();
+    mailbox.Publish(mailbox.BeginWrite());
+
+    CHECK_EQ(mailbox.BeginWrite(), MAILBOX_NONE);
+    CHECK_EQ(mailbox.Skipped(), 1);
+
+    mailbox.EndRead(read);
+    CHECK(mailbox.BeginWrite() != MAILBOX_NONE);
+}
+
+static void TestReset()
+{
+    TextureMailbox mailbox;
+
+    mailbox.Reset(MAILBOX_MAX_SLOTS + 3);
+    CHECK_EQ(mailbox.Count(), MAILBOX_MAX_SLOTS);
+
+    mailbox.Reset(0);
+    CHECK_EQ(mailbox.Count(), 1);
+
+    mailbox.Reset(3);
+    mailbox.Publish(mailbox.BeginWrite());
+    mailbox.Reset(3);
+    CHECK_EQ(mailbox.BeginRead(), MAILBOX_NONE);
+    for (int i = 0; i < 3; i++)
+    {
+        CHECK_EQ(mailbox.State(i), TextureMailbox::SlotFree);
+    }
+}
+
+// The writer never waits and never finds the ring full; the reader never
+// sees a slot being written, and never goes back to an older frame.
+static void RunWriterAndReader(int slots)
+{
+    TextureMailbox mailbox;
+    mailbox.Reset(slots);
+
+    for (int s = 0; s < MAILBOX_MAX_SLOTS; s++)
+    {
+        for (int k = 0; k < SLOT_WORDS; k++)
+        {
+            s_Slots[s][k].store(0);
+        }
+    }
+
+    std::atomic<bool> bStop(false);
+    uint64_t reads = 0;
+    uint64_t torn = 0;
+    uint64_t regressed = 0;
+
+    std::thread reader([&] {
+        uint64_t last = 0;
+
+        while (!bStop.load())
+        {
+            const int slot = mailbox.BeginRead();
+
+            if (slot == MAILBOX_NONE)
+            {
+                std::this_thread::yield();
+                continue;
+            }
+
+            // Read the whole slot twice, as a draw would take a while.
+            const uint64_t frame = s_Slots[slot][0].load();
+
+            for (int pass = 0; pass < 2; pass++)
+            {
+                for (int k = 0; k < SLOT_WORDS; k++)
+                {
+                    if (s_Slots[slot][k].load() != frame)
+                    {
+                        torn++;
+                    }
+                }
+            }
+
+            if (frame < last)
+            {
+                regressed++;
+            }
+            last = frame;
+            reads++;
+
+            mailbox.EndRead(slot);
+        }
+    });
+
+    const uint64_t frames = 200000;
+    uint64_t skipped = 0;
+
+    for (uint64_t n = 1; n <= frames; n++)
+    {
+        const int slot = mailbox.BeginWrite();
+
+        if (slot == MAILBOX_NONE)
+        {
+            skipped++;
+            continue;
+        }
+
+        for (int k = 0; k < SLOT_WORDS; k++)
+        {
+            s_Slots[slot][k].store(n);
+        }
+        mailbox.Publish(slot);
+    }
+
+    bStop.store(true);
+    reader.join();
+
+    CHECK_EQ(torn, 0);
+    CHECK_EQ(regressed, 0);
+    CHECK_EQ(skipped, 0);
+    CHECK_EQ(mailbox.Published(), frames);
+    CHECK(reads > 0);
+
+    std::printf("    %d slots: %llu reads\n", slots, (unsigned long long)reads);
+}
+
+static void TestWriterAndReader()
+{
+    for (int slots = 3; slots <= 5; slots++)
+    {
+        RunWriterAndReader(slots);
+    }
+}
+
+int main()
+{
+    RUN_TEST(TestTransitions);
+    RUN_TEST(TestTwoSlotsStarve);
+    RUN_TEST(TestReset);
+    RUN_TEST(TestWriterAndReader);
+    return TestResult();
+}